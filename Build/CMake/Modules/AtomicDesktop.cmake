@@ -12,3 +12,18 @@ if (NOT MINGW)
         endif ()
     endif ()
 endif ()
+
+# SSE code paths are opt-in with -DATOMIC_SSE=ON, and only available when targeting x86 or x86_64
+if (ATOMIC_SSE)
+    if (CMAKE_SYSTEM_PROCESSOR MATCHES "^(i[3-6]86|x86|x86_64|AMD64|amd64)$" AND NOT CMAKE_OSX_ARCHITECTURES MATCHES "arm")
+        add_definitions(-DATOMIC_SSE)
+        # 32-bit GCC and Clang need SSE2 enabled explicitly
+        if (NOT MSVC AND NOT ATOMIC_64BIT)
+            set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -msse -msse2")
+            set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -msse -msse2")
+        endif ()
+    else ()
+        message(STATUS "ATOMIC_SSE is not supported on ${CMAKE_SYSTEM_PROCESSOR}, SSE code paths are disabled")
+        set (ATOMIC_SSE OFF)
+    endif ()
+endif ()
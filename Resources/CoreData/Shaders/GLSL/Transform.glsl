@@ -23,7 +23,40 @@ attribute vec4 iCubeTexCoord1;
 #endif
 attribute float iObjectIndex;
 
-#ifdef SKINNED
+#if defined(SKINNED) && defined(DUALQUATERNION)
+mat4 GetSkinMatrix(vec4 blendWeights, vec4 blendIndices)
+{
+    // The model's world transform is stored first, followed by the real and dual part of each bone in model space
+    ivec4 idx = ivec4(blendIndices) * 2 + 3;
+    const vec4 lastColumn = vec4(0.0, 0.0, 0.0, 1.0);
+    vec4 real0 = cSkinMatrices[idx.x];
+    vec4 real1 = cSkinMatrices[idx.y];
+    vec4 real2 = cSkinMatrices[idx.z];
+    vec4 real3 = cSkinMatrices[idx.w];
+
+    // Flip the bones on the opposite hemisphere from the first bone to blend along the shortest path
+    vec4 weights = blendWeights * (step(0.0, vec4(1.0, dot(real0, real1), dot(real0, real2), dot(real0, real3))) * 2.0 - 1.0);
+    vec4 real = real0 * weights.x + real1 * weights.y + real2 * weights.z + real3 * weights.w;
+    vec4 dual = cSkinMatrices[idx.x + 1] * weights.x + cSkinMatrices[idx.y + 1] * weights.y +
+        cSkinMatrices[idx.z + 1] * weights.z + cSkinMatrices[idx.w + 1] * weights.w;
+    float invLength = 1.0 / length(real);
+    real *= invLength;
+    dual *= invLength;
+
+    vec3 t = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    vec3 r2 = 2.0 * real.xyz * real.xyz;
+    vec3 rw = 2.0 * real.w * real.xyz;
+    float xy = 2.0 * real.x * real.y;
+    float xz = 2.0 * real.x * real.z;
+    float yz = 2.0 * real.y * real.z;
+    mat4 boneMatrix = mat4(
+        vec4(1.0 - r2.y - r2.z, xy - rw.z, xz + rw.y, t.x),
+        vec4(xy + rw.z, 1.0 - r2.x - r2.z, yz - rw.x, t.y),
+        vec4(xz - rw.y, yz + rw.x, 1.0 - r2.x - r2.y, t.z),
+        lastColumn);
+    return boneMatrix * mat4(cSkinMatrices[0], cSkinMatrices[1], cSkinMatrices[2], lastColumn);
+}
+#elif defined(SKINNED)
 mat4 GetSkinMatrix(vec4 blendWeights, vec4 blendIndices)
 {
     ivec4 idx = ivec4(blendIndices) * 3;
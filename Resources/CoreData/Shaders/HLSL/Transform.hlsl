@@ -6,7 +6,39 @@
 #define OUTPOSITION POSITION
 #endif
 
-#ifdef SKINNED
+#if defined(SKINNED) && defined(DUALQUATERNION)
+float4x3 GetSkinMatrix(float4 blendWeights, int4 blendIndices)
+{
+    // The model's world transform is stored first, followed by the real and dual part of each bone in model space
+    int4 idx = blendIndices * 2 + 3;
+    float4 real0 = cSkinMatrices[idx.x];
+    float4 real1 = cSkinMatrices[idx.y];
+    float4 real2 = cSkinMatrices[idx.z];
+    float4 real3 = cSkinMatrices[idx.w];
+
+    // Flip the bones on the opposite hemisphere from the first bone to blend along the shortest path
+    float4 weights = blendWeights * (step(0.0, float4(1.0, dot(real0, real1), dot(real0, real2), dot(real0, real3))) * 2.0 - 1.0);
+    float4 real = real0 * weights.x + real1 * weights.y + real2 * weights.z + real3 * weights.w;
+    float4 dual = cSkinMatrices[idx.x + 1] * weights.x + cSkinMatrices[idx.y + 1] * weights.y +
+        cSkinMatrices[idx.z + 1] * weights.z + cSkinMatrices[idx.w + 1] * weights.w;
+    float invLength = 1.0 / length(real);
+    real *= invLength;
+    dual *= invLength;
+
+    float3 t = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    float3 r2 = 2.0 * real.xyz * real.xyz;
+    float3 rw = 2.0 * real.w * real.xyz;
+    float xy = 2.0 * real.x * real.y;
+    float xz = 2.0 * real.x * real.z;
+    float yz = 2.0 * real.y * real.z;
+    float4x4 boneMatrix = transpose(float4x4(
+        float4(1.0 - r2.y - r2.z, xy - rw.z, xz + rw.y, t.x),
+        float4(xy + rw.z, 1.0 - r2.x - r2.z, yz - rw.x, t.y),
+        float4(xz - rw.y, yz + rw.x, 1.0 - r2.x - r2.y, t.z),
+        float4(0.0, 0.0, 0.0, 1.0)));
+    return mul(boneMatrix, transpose(float3x4(cSkinMatrices[0], cSkinMatrices[1], cSkinMatrices[2])));
+}
+#elif defined(SKINNED)
 float4x3 GetSkinMatrix(float4 blendWeights, int4 blendIndices)
 {
     return cSkinMatrices[blendIndices.x] * blendWeights.x +
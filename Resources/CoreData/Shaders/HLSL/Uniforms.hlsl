@@ -28,7 +28,9 @@ uniform float4x4 cViewProj;
 uniform float4 cUOffset;
 uniform float4 cVOffset;
 uniform float4x3 cZone;
-#ifdef SKINNED
+#if defined(SKINNED) && defined(DUALQUATERNION)
+    uniform float4 cSkinMatrices[MAXBONES*3];
+#elif defined(SKINNED)
     uniform float4x3 cSkinMatrices[MAXBONES];
 #endif
 #ifdef NUMVERTEXLIGHTS
@@ -138,7 +140,9 @@ cbuffer ObjectVS : register(b5)
 #ifdef BILLBOARD
     float3x3 cBillboardRot;
 #endif
-#ifdef SKINNED
+#if defined(SKINNED) && defined(DUALQUATERNION)
+    uniform float4 cSkinMatrices[MAXBONES*3];
+#elif defined(SKINNED)
     uniform float4x3 cSkinMatrices[MAXBONES];
 #endif
 }
@@ -45,8 +45,22 @@ class ModelInspector extends InspectorWidget {
         this.importer.scale = Number(this.scaleEdit.text);
 
         this.importer.importAnimations = this.importAnimationBox.value ? true : false;
+        this.importer.compressAnimations = this.compressAnimationBox.value ? true : false;
+
+        var _positionError = Number(this.positionErrorEdit.text);
+        var _rotationError = Number(this.rotationErrorEdit.text);
+        if (!isNaN(_positionError)) this.importer.animationPositionError = _positionError;
+        if (!isNaN(_rotationError)) this.importer.animationRotationError = _rotationError;
         this.importer.setImportMaterials(this.importMaterials.value ? true : false);
 
+        this.importer.generateLods = this.generateLodsBox.value ? true : false;
+
+        var _lodErrors = this.lodErrorsEdit.text.split(" ").filter(function(value) { return value.length && !isNaN(Number(value)); });
+        this.importer.numLodErrors = _lodErrors.length;
+        for (var i = 0; i < _lodErrors.length; i++) {
+            this.importer.setLodError(i, Number(_lodErrors[i]));
+        }
+
         for (var i = 0; i < this.importer.animationCount; i++) {
 
           var info = this.importer.getAnimationInfo(i);
@@ -106,12 +120,32 @@ class ModelInspector extends InspectorWidget {
         this.importMaterials = this.createAttrCheckBox("Import Materials", modelLayout);
         this.importMaterials.value = this.importer.getImportMaterials() ? 1 : 0;
 
+        this.generateLodsBox = this.createAttrCheckBox("Generate LODs", modelLayout);
+        this.generateLodsBox.value = this.importer.generateLods ? 1 : 0;
+
+        var _lodErrors = [];
+        for (var i = 0; i < this.importer.numLodErrors; i++) {
+            _lodErrors.push(this.importer.getLodError(i).toString());
+        }
+
+        this.lodErrorsEdit = InspectorUtils.createAttrEditField("LOD Errors", modelLayout);
+        this.lodErrorsEdit.text = _lodErrors.join(" ");
+
         // Animations Section
         var animationLayout = this.createSection(rootLayout, "Animation", 1);
 
         this.importAnimationBox = this.createAttrCheckBox("Import Animations", animationLayout);
         this.importAnimationBox.value = this.importer.importAnimations ? 1 : 0;
 
+        this.compressAnimationBox = this.createAttrCheckBox("Compress Animations", animationLayout);
+        this.compressAnimationBox.value = this.importer.compressAnimations ? 1 : 0;
+
+        this.positionErrorEdit = InspectorUtils.createAttrEditField("Position Error", animationLayout);
+        this.positionErrorEdit.text = this.importer.animationPositionError.toString();
+
+        this.rotationErrorEdit = InspectorUtils.createAttrEditField("Rotation Error", animationLayout);
+        this.rotationErrorEdit.text = this.importer.animationRotationError.toString();
+
         this.importAnimationArray = new ArrayEditWidget("Animation Count");
         animationLayout.addChild(this.importAnimationArray);
 
@@ -196,7 +230,12 @@ class ModelInspector extends InspectorWidget {
 
     // animation
     importAnimationBox: Atomic.UICheckBox;
+    compressAnimationBox: Atomic.UICheckBox;
+    positionErrorEdit: Atomic.UIEditField;
+    rotationErrorEdit: Atomic.UIEditField;
     importMaterials: Atomic.UICheckBox;
+    generateLodsBox: Atomic.UICheckBox;
+    lodErrorsEdit: Atomic.UIEditField;
     importAnimationArray: ArrayEditWidget;
     animationInfoLayout: Atomic.UILayout;
 
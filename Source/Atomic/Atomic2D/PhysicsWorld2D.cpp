@@ -695,6 +695,22 @@ void PhysicsWorld2D::GetRigidBodies(PODVector<RigidBody2D*>& results, const Rect
     world_->QueryAABB(&callback, b2Aabb);
 }
 
+void PhysicsWorld2D::SetApplyingTransforms(bool enable)
+{
+    applyingTransforms_ = enable;
+
+    // With batched transforms the listeners are notified later, so the scene records the flag with the queued nodes
+    Scene* scene = GetScene();
+    if (scene)
+        scene->GetTransformHierarchy().SetApplyingTransforms(enable);
+}
+
+bool PhysicsWorld2D::IsApplyingTransforms() const
+{
+    Scene* scene = GetScene();
+    return applyingTransforms_ || (scene && scene->GetTransformHierarchy().IsApplyingTransforms());
+}
+
 bool PhysicsWorld2D::GetAllowSleeping() const
 {
     return world_->GetAllowSleeping();
@@ -206,10 +206,10 @@ public:
     b2World* GetWorld() { return world_.Get(); }
 
     /// Set node dirtying to be disregarded.
-    void SetApplyingTransforms(bool enable) { applyingTransforms_ = enable; }
+    void SetApplyingTransforms(bool enable);
 
     /// Return whether node dirtying should be disregarded.
-    bool IsApplyingTransforms() const { return applyingTransforms_; }
+    bool IsApplyingTransforms() const;
 
 protected:
     /// Handle scene being assigned.
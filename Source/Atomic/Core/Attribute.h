@@ -51,6 +51,50 @@ static const unsigned AM_FILEREADONLY = 0x81;
 
 class Serializable;
 
+/// Network replication quantization mode of an attribute.
+enum QuantizationMode
+{
+    /// Full precision.
+    QM_NONE = 0,
+    /// Float, Vector2, Vector3 or Vector4 components quantized to bits within the min - max range.
+    QM_RANGE,
+    /// Quaternion sent as the index of its largest component and the three smallest components quantized to bits.
+    QM_QUATERNION,
+    /// Vector3 position sent as integer cell coordinates and the position within the cell quantized to bits. Max is the cell size.
+    QM_CELL
+};
+
+/// Network replication quantization hint of an attribute.
+struct AttributeQuantization
+{
+    /// Construct full precision.
+    AttributeQuantization() :
+        mode_(QM_NONE),
+        min_(0.0f),
+        max_(0.0f),
+        bits_(0)
+    {
+    }
+
+    /// Construct with mode, range and bits per quantized component.
+    AttributeQuantization(QuantizationMode mode, float min, float max, unsigned bits) :
+        mode_(mode),
+        min_(min),
+        max_(max),
+        bits_(bits)
+    {
+    }
+
+    /// Quantization mode.
+    QuantizationMode mode_;
+    /// Range minimum.
+    float min_;
+    /// Range maximum, or cell size.
+    float max_;
+    /// Bits per quantized component.
+    unsigned bits_;
+};
+
 /// Abstract base class for invoking attribute accessors.
 class ATOMIC_API AttributeAccessor : public RefCounted
 {
@@ -164,6 +208,8 @@ struct AttributeInfo
     unsigned mode_;
     /// Attribute data pointer if elsewhere than in the Serializable.
     void* ptr_;
+    /// Network replication quantization hint.
+    AttributeQuantization quantization_;
 };
 
 }
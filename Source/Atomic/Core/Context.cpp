@@ -229,6 +229,57 @@ void Context::UpdateAttributeDefaultValue(StringHash objectType, const char* nam
         info->defaultValue_ = defaultValue;
 }
 
+bool Context::SetAttributeQuantization(StringHash objectType, const char* name, const AttributeQuantization& quantization)
+{
+    AttributeInfo* info = GetAttribute(objectType, name);
+    if (!info)
+        return false;
+
+    bool valid = true;
+    switch (quantization.mode_)
+    {
+    case QM_RANGE:
+        valid = (info->type_ == VAR_FLOAT || info->type_ == VAR_VECTOR2 || info->type_ == VAR_VECTOR3 ||
+            info->type_ == VAR_VECTOR4) && quantization.max_ > quantization.min_;
+        break;
+
+    case QM_QUATERNION:
+        valid = info->type_ == VAR_QUATERNION;
+        break;
+
+    case QM_CELL:
+        valid = info->type_ == VAR_VECTOR3 && quantization.max_ > 0.0f;
+        break;
+
+    default:
+        break;
+    }
+
+    if (quantization.mode_ != QM_NONE && (quantization.bits_ < 1 || quantization.bits_ > 24))
+        valid = false;
+
+    if (!valid)
+    {
+        ATOMIC_LOGWARNING("Invalid network quantization for attribute " + String(name) + " of class " + GetTypeName(objectType));
+        return false;
+    }
+
+    info->quantization_ = quantization;
+
+    // The network attributes are copies, update them too
+    HashMap<StringHash, Vector<AttributeInfo> >::Iterator i = networkAttributes_.Find(objectType);
+    if (i != networkAttributes_.End())
+    {
+        for (Vector<AttributeInfo>::Iterator j = i->second_.Begin(); j != i->second_.End(); ++j)
+        {
+            if (!j->name_.Compare(name, true))
+                j->quantization_ = quantization;
+        }
+    }
+
+    return true;
+}
+
 VariantMap& Context::GetEventDataMap()
 {
     unsigned nestingLevel = eventSenders_.Size();
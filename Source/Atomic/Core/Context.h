@@ -113,6 +113,8 @@ public:
     void RemoveAttribute(StringHash objectType, const char* name);
     /// Update object attribute's default value.
     void UpdateAttributeDefaultValue(StringHash objectType, const char* name, const Variant& defaultValue);
+    /// Set object attribute's network replication quantization hint. Return true if the hint is valid for the attribute type.
+    bool SetAttributeQuantization(StringHash objectType, const char* name, const AttributeQuantization& quantization);
     /// Return a preallocated map for event data. Used for optimization to avoid constant re-allocation of event data maps.
     VariantMap& GetEventDataMap();
     /// Initialises the specified SDL systems, if not already. Returns true if successful. This call must be matched with ReleaseSDL() when SDL functions are no longer required, even if this call fails.
@@ -142,6 +144,8 @@ public:
     template <class T, class U> void CopyBaseAttributes();
     /// Template version of updating an object attribute's default value.
     template <class T> void UpdateAttributeDefaultValue(const char* name, const Variant& defaultValue);
+    /// Template version of setting an object attribute's network replication quantization hint.
+    template <class T> bool SetAttributeQuantization(const char* name, const AttributeQuantization& quantization);
 
     /// Return subsystem by type.
     Object* GetSubsystem(StringHash type) const;
@@ -363,4 +367,9 @@ template <class T> void Context::UpdateAttributeDefaultValue(const char* name, c
     UpdateAttributeDefaultValue(T::GetTypeStatic(), name, defaultValue);
 }
 
+template <class T> bool Context::SetAttributeQuantization(const char* name, const AttributeQuantization& quantization)
+{
+    return SetAttributeQuantization(T::GetTypeStatic(), name, quantization);
+}
+
 }
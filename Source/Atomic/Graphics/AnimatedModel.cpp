@@ -41,6 +41,7 @@
 #include "../Resource/ResourceCache.h"
 #include "../Resource/ResourceEvents.h"
 #include "../Scene/Scene.h"
+#include "../Scene/SceneEvents.h"
 
 #include "../DebugNew.h"
 
@@ -68,6 +69,24 @@ static bool CompareAnimationOrder(const SharedPtr<AnimationState>& lhs, const Sh
 
 static const unsigned MAX_ANIMATION_STATES = 256;
 
+static void WriteModelTransform(Vector4* dest, const Matrix3x4& transform)
+{
+    dest[0] = Vector4(&transform.m00_);
+    dest[1] = Vector4(&transform.m10_);
+    dest[2] = Vector4(&transform.m20_);
+}
+
+static void WriteDualQuaternion(Vector4* dest, const Matrix3x4& transform)
+{
+    // Scale is discarded, as dual quaternions can only represent rigid transforms
+    Quaternion real = transform.Rotation();
+    Vector3 translation = transform.Translation();
+    Quaternion dual = Quaternion(0.0f, translation.x_, translation.y_, translation.z_) * real * 0.5f;
+
+    dest[0] = Vector4(real.x_, real.y_, real.z_, real.w_);
+    dest[1] = Vector4(dual.x_, dual.y_, dual.z_, dual.w_);
+}
+
 AnimatedModel::AnimatedModel(Context* context) :
     StaticModel(context),
     animationLodFrameNumber_(0),
@@ -79,13 +98,21 @@ AnimatedModel::AnimatedModel(Context* context) :
     animationDirty_(false),
     animationOrderDirty_(false),
     morphsDirty_(false),
+    morphsUploadPending_(false),
     skinningDirty_(true),
     boneBoundingBoxDirty_(true),
     isMaster_(true),
     loading_(false),
     assignBonesPending_(false),
     forceAnimationUpdate_(false),
-    boneCreationOverride_(true)
+    boneCreationOverride_(true),
+    updateBoneNodes_(true),
+    usePoseBuffer_(false),
+    needBoneNodes_(false),
+    needBoneNodesDirty_(true),
+    dualQuaternionSkinning_(false),
+    boneNodesDirty_(false),
+    boneTransformsDirty_(true)
 {
 }
 
@@ -125,6 +152,10 @@ void AnimatedModel::RegisterObject(Context* context)
                                                             animationStatesStructureElementNames, AM_FILE);
     ATOMIC_ACCESSOR_ATTRIBUTE("Morphs", GetMorphsAttr, SetMorphsAttr, PODVector<unsigned char>, Variant::emptyBuffer,
         AM_DEFAULT | AM_NOEDIT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Update Bone Nodes", GetUpdateBoneNodes, SetUpdateBoneNodes, bool, true, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Dual Quaternion Skinning", GetDualQuaternionSkinning, SetDualQuaternionSkinning, bool, false,
+        AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("LOD Screen Size", GetLodScreenSize, SetLodScreenSize, bool, false, AM_DEFAULT);
 }
 
 bool AnimatedModel::Load(Deserializer& source, bool setInstanceDefault)
@@ -163,32 +194,7 @@ void AnimatedModel::ApplyAttributes()
 // ATOMIC BEGIN
 
         // initialize skinning matrices in batches
-
-        for (unsigned i = 0; i < batches_.Size(); ++i)
-        {
-            if (skinMatrices_.Size())
-            {
-                batches_[i].geometryType_ = GEOM_SKINNED;
-                // Check if model has per-geometry bone mappings
-                if (geometrySkinMatrices_.Size() && geometrySkinMatrices_[i].Size())
-                {
-                    batches_[i].worldTransform_ = &geometrySkinMatrices_[i][0];
-                    batches_[i].numWorldTransforms_ = geometrySkinMatrices_[i].Size();
-                }
-                // If not, use the global skin matrices
-                else
-                {
-                    batches_[i].worldTransform_ = &skinMatrices_[0];
-                    batches_[i].numWorldTransforms_ = skinMatrices_.Size();
-                }
-            }
-            else
-            {
-                batches_[i].geometryType_ = GEOM_STATIC;
-                batches_[i].worldTransform_ = &node_->GetWorldTransform();
-                batches_[i].numWorldTransforms_ = 1;
-            }
-        }
+        SetSkinningBatches();
 
 // ATOMIC END
 
@@ -215,6 +221,10 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
     const Vector<Bone>& bones = skeleton_.GetBones();
     Sphere boneSphere;
 
+    // Ray queries may run in worker threads, so only read the bone transforms
+    PODVector<Matrix3x4> tempTransforms;
+    const Matrix3x4* boneTransforms = GetBoneTransforms(tempTransforms);
+
     for (unsigned i = 0; i < bones.Size(); ++i)
     {
         const Bone& bone = bones[i];
@@ -228,7 +238,7 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
         {
             // Do an initial crude test using the bone's AABB
             const BoundingBox& box = bone.boundingBox_;
-            const Matrix3x4& transform = bone.node_->GetWorldTransform();
+            const Matrix3x4& transform = boneTransforms ? boneTransforms[i] : bone.node_->GetWorldTransform();
             distance = query.ray_.HitDistance(box.Transformed(transform));
             if (distance >= query.maxDistance_)
                 continue;
@@ -244,7 +254,7 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
         }
         else if (bone.collisionMask_ & BONECOLLISION_SPHERE)
         {
-            boneSphere.center_ = bone.node_->GetWorldPosition();
+            boneSphere.center_ = (boneTransforms ? boneTransforms[i] : bone.node_->GetWorldTransform()).Translation();
             boneSphere.radius_ = bone.radius_;
             distance = query.ray_.HitDistance(boneSphere);
             if (distance >= query.maxDistance_)
@@ -292,8 +302,17 @@ void AnimatedModel::Update(const FrameInfo& frame)
 
     if (animationDirty_ || animationOrderDirty_)
         UpdateAnimation(frame);
-    else if (boneBoundingBoxDirty_)
-        UpdateBoneBoundingBox();
+    else
+    {
+        // Bring the bone transforms calculated from the pose buffer up to date, so that ray queries only need to read them
+        UpdateBoneTransforms();
+        if (boneBoundingBoxDirty_)
+            UpdateBoneBoundingBox();
+    }
+
+    // Apply vertex morphs while still in the threaded update, so that only the upload remains for the main thread
+    if (morphsDirty_)
+        CalculateMorphs();
 }
 
 void AnimatedModel::UpdateBatches(const FrameInfo& frame)
@@ -316,7 +335,7 @@ void AnimatedModel::UpdateBatches(const FrameInfo& frame)
     // determination so that animation does not change the scale
     BoundingBox transformedBoundingBox = boundingBox_.Transformed(worldTransform);
     float scale = transformedBoundingBox.Size().DotProduct(DOT_SCALE);
-    float newLodDistance = frame.camera_->GetLodDistance(distance_, scale, lodBias_);
+    float newLodDistance = CalculateLodDistance(frame, scale);
 
     // If model is rendered from several views, use the minimum LOD distance for animation LOD
     if (frame.frameNumber_ != animationLodFrameNumber_)
@@ -352,7 +371,7 @@ void AnimatedModel::UpdateGeometry(const FrameInfo& frame)
         forceAnimationUpdate_ = false;
     }
 
-    if (morphsDirty_)
+    if (morphsDirty_ || morphsUploadPending_)
         UpdateMorphs();
 
     if (skinningDirty_)
@@ -361,9 +380,9 @@ void AnimatedModel::UpdateGeometry(const FrameInfo& frame)
 
 UpdateGeometryType AnimatedModel::GetUpdateGeometryType()
 {
-    if (morphsDirty_ || forceAnimationUpdate_)
+    if (morphsDirty_ || morphsUploadPending_ || (forceAnimationUpdate_ && !CanApplyAnimationThreaded()))
         return UPDATE_MAIN_THREAD;
-    else if (skinningDirty_)
+    else if (skinningDirty_ || forceAnimationUpdate_)
         return UPDATE_WORKER_THREAD;
     else
         return UPDATE_NONE;
@@ -373,6 +392,8 @@ void AnimatedModel::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
 {
     if (debug && IsEnabledEffective())
     {
+        // The skeleton is drawn from the bone nodes, so bring them up to date
+        UpdateBoneNodes();
         debug->AddBoundingBox(GetWorldBoundingBox(), Color::GREEN, depthTest);
         debug->AddSkeleton(skeleton_, Color(0.75f, 0.75f, 0.75f), depthTest);
     }
@@ -455,31 +476,7 @@ void AnimatedModel::SetModel(Model* model, bool createBones)
         SetGeometryBoneMappings();
 
         // Enable skinning in batches
-        for (unsigned i = 0; i < batches_.Size(); ++i)
-        {
-            if (skinMatrices_.Size())
-            {
-                batches_[i].geometryType_ = GEOM_SKINNED;
-                // Check if model has per-geometry bone mappings
-                if (geometrySkinMatrices_.Size() && geometrySkinMatrices_[i].Size())
-                {
-                    batches_[i].worldTransform_ = &geometrySkinMatrices_[i][0];
-                    batches_[i].numWorldTransforms_ = geometrySkinMatrices_[i].Size();
-                }
-                // If not, use the global skin matrices
-                else
-                {
-                    batches_[i].worldTransform_ = &skinMatrices_[0];
-                    batches_[i].numWorldTransforms_ = skinMatrices_.Size();
-                }
-            }
-            else
-            {
-                batches_[i].geometryType_ = GEOM_STATIC;
-                batches_[i].worldTransform_ = &node_->GetWorldTransform();
-                batches_[i].numWorldTransforms_ = 1;
-            }
-        }
+        SetSkinningBatches();
     }
     else
     {
@@ -604,6 +601,42 @@ void AnimatedModel::SetUpdateInvisible(bool enable)
     MarkNetworkUpdate();
 }
 
+void AnimatedModel::SetUpdateBoneNodes(bool enable)
+{
+    if (enable == updateBoneNodes_)
+        return;
+
+    updateBoneNodes_ = enable;
+    if (updateBoneNodes_)
+        UpdateBoneNodes();
+    UpdateBoneNodeSubscriptions();
+    MarkNetworkUpdate();
+}
+
+void AnimatedModel::SetDualQuaternionSkinning(bool enable)
+{
+    if (enable == dualQuaternionSkinning_)
+        return;
+
+    dualQuaternionSkinning_ = enable;
+    if (skinMatrices_.Size())
+    {
+        SetSkinningBatches();
+        skinningDirty_ = true;
+    }
+    MarkNetworkUpdate();
+}
+
+void AnimatedModel::UpdateBoneNodes()
+{
+    if (!boneNodesDirty_ || !node_)
+        return;
+
+    WritePose();
+    // The pose was written silently, so mark dirty now
+    node_->MarkDirty();
+}
+
 
 void AnimatedModel::SetMorphWeight(unsigned index, float weight)
 {
@@ -802,6 +835,10 @@ void AnimatedModel::SetSkeleton(const Skeleton& skeleton, bool createBones)
             RemoveRootBone();
 
         skeleton_.Define(skeleton);
+        // The pose buffer will be reinitialized from the new bone nodes
+        posePositions_.Clear();
+        boneNodesDirty_ = false;
+        needBoneNodesDirty_ = true;
 
         // Merge bounding boxes from non-master models
         FinalizeBoneBoundingBoxes();
@@ -991,20 +1028,23 @@ void AnimatedModel::UpdateBoneBoundingBox()
         // The bone bounding box is in local space, so need the node's inverse transform
         boneBoundingBox_.Clear();
         Matrix3x4 inverseNodeTransform = node_->GetWorldTransform().Inverse();
+        PODVector<Matrix3x4> tempTransforms;
+        const Matrix3x4* boneTransforms = GetBoneTransforms(tempTransforms);
 
         const Vector<Bone>& bones = skeleton_.GetBones();
-        for (Vector<Bone>::ConstIterator i = bones.Begin(); i != bones.End(); ++i)
+        for (unsigned i = 0; i < bones.Size(); ++i)
         {
-            Node* boneNode = i->node_;
-            if (!boneNode)
+            const Bone& bone = bones[i];
+            if (!bone.node_)
                 continue;
 
             // Use hitbox if available. If not, use only half of the sphere radius
             /// \todo The sphere radius should be multiplied with bone scale
-            if (i->collisionMask_ & BONECOLLISION_BOX)
-                boneBoundingBox_.Merge(i->boundingBox_.Transformed(inverseNodeTransform * boneNode->GetWorldTransform()));
-            else if (i->collisionMask_ & BONECOLLISION_SPHERE)
-                boneBoundingBox_.Merge(Sphere(inverseNodeTransform * boneNode->GetWorldPosition(), i->radius_ * 0.5f));
+            const Matrix3x4& transform = boneTransforms ? boneTransforms[i] : bone.node_->GetWorldTransform();
+            if (bone.collisionMask_ & BONECOLLISION_BOX)
+                boneBoundingBox_.Merge(bone.boundingBox_.Transformed(inverseNodeTransform * transform));
+            else if (bone.collisionMask_ & BONECOLLISION_SPHERE)
+                boneBoundingBox_.Merge(Sphere(inverseNodeTransform * transform.Translation(), bone.radius_ * 0.5f));
         }
     }
 
@@ -1023,6 +1063,13 @@ void AnimatedModel::OnNodeSet(Node* node)
     }
 }
 
+void AnimatedModel::OnSceneSet(Scene* scene)
+{
+    StaticModel::OnSceneSet(scene);
+
+    UpdateBoneNodeSubscriptions();
+}
+
 void AnimatedModel::OnMarkedDirty(Node* node)
 {
     Drawable::OnMarkedDirty(node);
@@ -1031,6 +1078,7 @@ void AnimatedModel::OnMarkedDirty(Node* node)
     if (skeleton_.GetNumBones())
     {
         skinningDirty_ = true;
+        boneTransformsDirty_ = true;
         // Bone bounding box doesn't need to be marked dirty when only the base scene node moves
         if (node != node_)
             boneBoundingBoxDirty_ = true;
@@ -1189,6 +1237,8 @@ void AnimatedModel::MarkAnimationOrderDirty()
 void AnimatedModel::MarkMorphsDirty()
 {
     morphsDirty_ = true;
+    // Request a threaded update to calculate the morphs
+    MarkForUpdate();
 }
 
 void AnimatedModel::CloneGeometries()
@@ -1341,6 +1391,56 @@ void AnimatedModel::SetGeometryBoneMappings()
     }
 }
 
+void AnimatedModel::SetSkinningBatches()
+{
+    skinDualQuaternions_.Clear();
+    geometrySkinDualQuaternions_.Clear();
+
+    // Reserve space for dual quaternions, with the model's world transform in front
+    if (dualQuaternionSkinning_ && skinMatrices_.Size())
+    {
+        skinDualQuaternions_.Resize(3 + 2 * skinMatrices_.Size());
+        if (geometrySkinMatrices_.Size())
+        {
+            geometrySkinDualQuaternions_.Resize(geometrySkinMatrices_.Size());
+            for (unsigned i = 0; i < geometrySkinMatrices_.Size(); ++i)
+            {
+                if (geometrySkinMatrices_[i].Size())
+                    geometrySkinDualQuaternions_[i].Resize(3 + 2 * geometrySkinMatrices_[i].Size());
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < batches_.Size(); ++i)
+    {
+        if (skinMatrices_.Size())
+        {
+            // Check if model has per-geometry bone mappings
+            bool mapped = geometrySkinMatrices_.Size() && geometrySkinMatrices_[i].Size();
+            batches_[i].numWorldTransforms_ = mapped ? geometrySkinMatrices_[i].Size() : skinMatrices_.Size();
+
+            if (dualQuaternionSkinning_)
+            {
+                // Batch::Prepare() uploads the data as floats, so the pointer type does not matter
+                batches_[i].geometryType_ = GEOM_SKINNED_DUALQUATERNION;
+                batches_[i].worldTransform_ = reinterpret_cast<const Matrix3x4*>(mapped ?
+                    &geometrySkinDualQuaternions_[i][0] : &skinDualQuaternions_[0]);
+            }
+            else
+            {
+                batches_[i].geometryType_ = GEOM_SKINNED;
+                batches_[i].worldTransform_ = mapped ? &geometrySkinMatrices_[i][0] : &skinMatrices_[0];
+            }
+        }
+        else
+        {
+            batches_[i].geometryType_ = GEOM_STATIC;
+            batches_[i].worldTransform_ = &node_->GetWorldTransform();
+            batches_[i].numWorldTransforms_ = 1;
+        }
+    }
+}
+
 void AnimatedModel::UpdateAnimation(const FrameInfo& frame)
 {
     // If using animation LOD, accumulate time and see if it is time to update
@@ -1382,11 +1482,33 @@ void AnimatedModel::ApplyAnimation()
         // skeleton_.ResetSilent();
         // ATOMIC END
 
-        for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
-            (*i)->Apply();
+        usePoseBuffer_ = !updateBoneNodes_ && !NeedBoneNodes();
+
+        if (usePoseBuffer_)
+        {
+            // Animations are blended in the local pose buffer, starting from the current pose. Skinning and the bone
+            // bounding box are calculated from the pose; the bone nodes are left untouched
+            ReadPose();
+            for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+                (*i)->Apply();
+
+            boneNodesDirty_ = true;
+            boneTransformsDirty_ = true;
+            skinningDirty_ = true;
+            UpdateBoneTransforms();
+        }
+        else
+        {
+            // The bone nodes own the pose, so first write back a pose left in the buffer
+            if (boneNodesDirty_)
+                WritePose();
+
+            for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+                (*i)->Apply();
 
-        // Skeleton reset and animations apply the node transforms "silently" to avoid repeated marking dirty. Mark dirty now
-        node_->MarkDirty();
+            // The bone transforms were applied "silently" to avoid repeated marking dirty. Mark dirty now
+            node_->MarkDirty();
+        }
 
         // Calculate new bone bounding box
         UpdateBoneBoundingBox();
@@ -1402,6 +1524,10 @@ void AnimatedModel::UpdateSkinning()
     // Use model's world transform in case a bone is missing
     const Matrix3x4& worldTransform = node_->GetWorldTransform();
 
+    UpdateBoneTransforms();
+    PODVector<Matrix3x4> tempTransforms;
+    const Matrix3x4* boneTransforms = GetBoneTransforms(tempTransforms);
+
     // Skinning with global matrices only
     if (!geometrySkinMatrices_.Size())
     {
@@ -1409,7 +1535,7 @@ void AnimatedModel::UpdateSkinning()
         {
             const Bone& bone = bones[i];
             if (bone.node_)
-                skinMatrices_[i] = bone.node_->GetWorldTransform() * bone.offsetMatrix_;
+                skinMatrices_[i] = (boneTransforms ? boneTransforms[i] : bone.node_->GetWorldTransform()) * bone.offsetMatrix_;
             else
                 skinMatrices_[i] = worldTransform;
         }
@@ -1421,7 +1547,7 @@ void AnimatedModel::UpdateSkinning()
         {
             const Bone& bone = bones[i];
             if (bone.node_)
-                skinMatrices_[i] = bone.node_->GetWorldTransform() * bone.offsetMatrix_;
+                skinMatrices_[i] = (boneTransforms ? boneTransforms[i] : bone.node_->GetWorldTransform()) * bone.offsetMatrix_;
             else
                 skinMatrices_[i] = worldTransform;
 
@@ -1431,46 +1557,264 @@ void AnimatedModel::UpdateSkinning()
         }
     }
 
+    if (dualQuaternionSkinning_)
+        UpdateSkinDualQuaternions();
+
     skinningDirty_ = false;
 }
 
+void AnimatedModel::UpdateSkinDualQuaternions()
+{
+    // The bones are converted to model space, so that the model's world transform may contain scaling
+    const Matrix3x4& worldTransform = node_->GetWorldTransform();
+    Matrix3x4 inverseWorldTransform = worldTransform.Inverse();
+
+    WriteModelTransform(&skinDualQuaternions_[0], worldTransform);
+    for (unsigned i = 0; i < skinMatrices_.Size(); ++i)
+        WriteDualQuaternion(&skinDualQuaternions_[3 + 2 * i], inverseWorldTransform * skinMatrices_[i]);
+
+    // Copy to per-geometry dual quaternions as needed
+    for (unsigned i = 0; i < geometrySkinDualQuaternions_.Size(); ++i)
+    {
+        PODVector<Vector4>& dest = geometrySkinDualQuaternions_[i];
+        if (dest.Empty())
+            continue;
+
+        const PODVector<unsigned>& boneMapping = geometryBoneMappings_[i];
+        dest[0] = skinDualQuaternions_[0];
+        dest[1] = skinDualQuaternions_[1];
+        dest[2] = skinDualQuaternions_[2];
+        for (unsigned j = 0; j < boneMapping.Size(); ++j)
+        {
+            dest[3 + 2 * j] = skinDualQuaternions_[3 + 2 * boneMapping[j]];
+            dest[4 + 2 * j] = skinDualQuaternions_[4 + 2 * boneMapping[j]];
+        }
+    }
+}
+
+void AnimatedModel::ReadPose()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    unsigned numBones = bones.Size();
+
+    // If the skeleton has changed, the pose buffer does not hold a valid pose for any bone
+    if (posePositions_.Size() != numBones)
+    {
+        posePositions_.Resize(numBones);
+        poseRotations_.Resize(numBones);
+        poseScales_.Resize(numBones);
+        boneNodesDirty_ = false;
+    }
+
+    for (unsigned i = 0; i < numBones; ++i)
+    {
+        const Bone& bone = bones[i];
+        // When the bone nodes are out of date, the pose buffer owns the animated bones. Bones with animation disabled
+        // are controlled through their nodes, for example by physics
+        if (boneNodesDirty_ && bone.animated_)
+            continue;
+
+        Node* boneNode = bone.node_;
+        if (boneNode)
+        {
+            posePositions_[i] = boneNode->GetPosition();
+            poseRotations_[i] = boneNode->GetRotation();
+            poseScales_[i] = boneNode->GetScale();
+        }
+        else
+        {
+            posePositions_[i] = bone.initialPosition_;
+            poseRotations_[i] = bone.initialRotation_;
+            poseScales_[i] = bone.initialScale_;
+        }
+    }
+}
+
+void AnimatedModel::WritePose()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    unsigned numBones = Min(bones.Size(), posePositions_.Size());
+
+    for (unsigned i = 0; i < numBones; ++i)
+    {
+        const Bone& bone = bones[i];
+        Node* boneNode = bone.node_;
+        if (!boneNode || !bone.animated_)
+            continue;
+
+        boneNode->SetPositionSilent(posePositions_[i]);
+        boneNode->SetRotationSilent(poseRotations_[i]);
+        boneNode->SetScaleSilent(poseScales_[i]);
+    }
+
+    boneNodesDirty_ = false;
+}
+
+bool AnimatedModel::NeedBoneNodes()
+{
+    if (!needBoneNodesDirty_)
+        return needBoneNodes_;
+
+    needBoneNodesDirty_ = false;
+    needBoneNodes_ = true;
+
+    // Non-master models in the same node skin from the bone nodes
+    const Vector<SharedPtr<Component> >& components = node_->GetComponents();
+    for (Vector<SharedPtr<Component> >::ConstIterator i = components.Begin(); i != components.End(); ++i)
+    {
+        if (*i != this && (*i)->GetType() == AnimatedModel::GetTypeStatic())
+            return true;
+    }
+
+    // Components or child nodes attached to the bones need up to date bone node transforms
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    unsigned numBoneChildren = 0;
+    unsigned numChildren = 0;
+
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        Node* boneNode = bones[i].node_;
+        if (!boneNode)
+            continue;
+        if (boneNode->GetNumComponents())
+            return true;
+
+        numChildren += boneNode->GetNumChildren();
+        if (bones[i].parentIndex_ != i)
+            ++numBoneChildren;
+    }
+
+    needBoneNodes_ = numChildren != numBoneChildren;
+    return needBoneNodes_;
+}
+
+void AnimatedModel::UpdateBoneNodeSubscriptions()
+{
+    // Attachments only need to be tracked when the bone nodes are not animated directly
+    Scene* scene = GetScene();
+    if (scene && !updateBoneNodes_)
+    {
+        SubscribeToEvent(scene, E_NODEADDED, ATOMIC_HANDLER(AnimatedModel, HandleSceneStructureChanged));
+        SubscribeToEvent(scene, E_NODEREMOVED, ATOMIC_HANDLER(AnimatedModel, HandleSceneStructureChanged));
+        SubscribeToEvent(scene, E_COMPONENTADDED, ATOMIC_HANDLER(AnimatedModel, HandleSceneStructureChanged));
+        SubscribeToEvent(scene, E_COMPONENTREMOVED, ATOMIC_HANDLER(AnimatedModel, HandleSceneStructureChanged));
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_NODEADDED);
+        UnsubscribeFromEvent(E_NODEREMOVED);
+        UnsubscribeFromEvent(E_COMPONENTADDED);
+        UnsubscribeFromEvent(E_COMPONENTREMOVED);
+    }
+
+    needBoneNodesDirty_ = true;
+}
+
+void AnimatedModel::UpdateBoneTransforms()
+{
+    if (!boneNodesDirty_ || !boneTransformsDirty_)
+        return;
+
+    CalculateBoneTransforms(boneTransforms_);
+    boneTransformsDirty_ = false;
+}
+
+void AnimatedModel::CalculateBoneTransforms(PODVector<Matrix3x4>& dest) const
+{
+    unsigned numBones = Min(skeleton_.GetNumBones(), posePositions_.Size());
+    dest.Resize(numBones);
+
+    // Child bones are normally stored after their parents, in which case the parent transforms are reused
+    for (unsigned i = 0; i < numBones; ++i)
+        dest[i] = CalculateBoneTransform(i, dest, i);
+}
+
+Matrix3x4 AnimatedModel::CalculateBoneTransform(unsigned index, const PODVector<Matrix3x4>& transforms,
+    unsigned numCalculated) const
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    const Bone& bone = bones[index];
+    Node* boneNode = bone.node_;
+    if (!boneNode)
+        return node_->GetWorldTransform();
+
+    // The pose buffer owns the animated bones. Bones with animation disabled are controlled through their nodes, for
+    // example by physics
+    Matrix3x4 localTransform = bone.animated_ ? Matrix3x4(posePositions_[index], poseRotations_[index], poseScales_[index]) :
+        boneNode->GetTransform();
+    unsigned parentIndex = bone.parentIndex_;
+
+    if (parentIndex != index && parentIndex < transforms.Size() && bones[parentIndex].node_)
+    {
+        if (parentIndex < numCalculated)
+            return transforms[parentIndex] * localTransform;
+        else
+            return CalculateBoneTransform(parentIndex, transforms, numCalculated) * localTransform;
+    }
+    else
+    {
+        Node* parent = boneNode->GetParent();
+        return parent ? parent->GetWorldTransform() * localTransform : localTransform;
+    }
+}
+
+const Matrix3x4* AnimatedModel::GetBoneTransforms(PODVector<Matrix3x4>& tempTransforms) const
+{
+    unsigned numBones = skeleton_.GetNumBones();
+    if (!boneNodesDirty_ || posePositions_.Size() != numBones)
+        return 0;
+
+    if (!boneTransformsDirty_ && boneTransforms_.Size() == numBones)
+        return boneTransforms_.Buffer();
+
+    CalculateBoneTransforms(tempTransforms);
+    return tempTransforms.Buffer();
+}
+
 void AnimatedModel::UpdateMorphs()
+{
+    if (morphsDirty_)
+        CalculateMorphs();
+
+    UploadMorphs();
+}
+
+void AnimatedModel::CalculateMorphs()
 {
     Graphics* graphics = GetSubsystem<Graphics>();
     if (!graphics)
         return;
 
-    if (morphs_.Size())
+    if (morphs_.Size() && model_)
     {
-        // Reset the morph data range from all morphable vertex buffers, then apply morphs
+        // Reset the morph data range from all morphable vertex buffers, then apply morphs. The morphable vertex buffers
+        // are shadowed, so this only writes CPU-side data
         for (unsigned i = 0; i < morphVertexBuffers_.Size(); ++i)
         {
             VertexBuffer* buffer = morphVertexBuffers_[i];
-            if (buffer)
+            if (buffer && buffer->GetShadowData())
             {
                 VertexBuffer* originalBuffer = model_->GetVertexBuffers()[i];
                 unsigned morphStart = model_->GetMorphRangeStart(i);
                 unsigned morphCount = model_->GetMorphRangeCount(i);
 
-                void* dest = buffer->Lock(morphStart, morphCount);
-                if (dest)
-                {
-                    // Reset morph range by copying data from the original vertex buffer
-                    CopyMorphVertices(dest, originalBuffer->GetShadowData() + morphStart * originalBuffer->GetVertexSize(),
-                        morphCount, buffer, originalBuffer);
+                void* dest = buffer->GetShadowData() + morphStart * buffer->GetVertexSize();
 
-                    for (unsigned j = 0; j < morphs_.Size(); ++j)
+                // Reset morph range by copying data from the original vertex buffer
+                CopyMorphVertices(dest, originalBuffer->GetShadowData() + morphStart * originalBuffer->GetVertexSize(),
+                    morphCount, buffer, originalBuffer);
+
+                for (unsigned j = 0; j < morphs_.Size(); ++j)
+                {
+                    if (morphs_[j].weight_ != 0.0f)
                     {
-                        if (morphs_[j].weight_ != 0.0f)
-                        {
-                            HashMap<unsigned, VertexBufferMorph>::Iterator k = morphs_[j].buffers_.Find(i);
-                            if (k != morphs_[j].buffers_.End())
-                                ApplyMorph(buffer, dest, morphStart, k->second_, morphs_[j].weight_);
-                        }
+                        HashMap<unsigned, VertexBufferMorph>::Iterator k = morphs_[j].buffers_.Find(i);
+                        if (k != morphs_[j].buffers_.End())
+                            ApplyMorph(buffer, dest, morphStart, k->second_, morphs_[j].weight_);
                     }
-
-                    buffer->Unlock();
                 }
+
+                morphsUploadPending_ = true;
             }
         }
     }
@@ -1478,6 +1822,32 @@ void AnimatedModel::UpdateMorphs()
     morphsDirty_ = false;
 }
 
+void AnimatedModel::UploadMorphs()
+{
+    if (morphsUploadPending_ && model_)
+    {
+        for (unsigned i = 0; i < morphVertexBuffers_.Size(); ++i)
+        {
+            VertexBuffer* buffer = morphVertexBuffers_[i];
+            if (buffer && buffer->GetShadowData())
+            {
+                unsigned morphStart = model_->GetMorphRangeStart(i);
+                unsigned morphCount = model_->GetMorphRangeCount(i);
+                buffer->SetDataRange(buffer->GetShadowData() + morphStart * buffer->GetVertexSize(), morphStart, morphCount);
+            }
+        }
+    }
+
+    morphsUploadPending_ = false;
+}
+
+bool AnimatedModel::CanApplyAnimationThreaded() const
+{
+    // Non-master models only need the master's bone nodes. The master can animate from a worker thread if it only writes
+    // to its pose buffer
+    return !isMaster_ || (!updateBoneNodes_ && !needBoneNodesDirty_ && !needBoneNodes_);
+}
+
 void AnimatedModel::ApplyMorph(VertexBuffer* buffer, void* destVertexData, unsigned morphRangeStart, const VertexBufferMorph& morph,
     float weight)
 {
@@ -1525,6 +1895,19 @@ void AnimatedModel::ApplyMorph(VertexBuffer* buffer, void* destVertexData, unsig
     }
 }
 
+void AnimatedModel::HandleSceneStructureChanged(StringHash eventType, VariantMap& eventData)
+{
+    // Only changes in the model's own node hierarchy can attach to the bones, or add and remove other models
+    Node* changed;
+    if (eventType == E_NODEADDED || eventType == E_NODEREMOVED)
+        changed = static_cast<Node*>(eventData[NodeAdded::P_PARENT].GetPtr());
+    else
+        changed = static_cast<Node*>(eventData[ComponentAdded::P_NODE].GetPtr());
+
+    if (node_ && changed && (changed == node_ || changed->IsChildOf(node_)))
+        needBoneNodesDirty_ = true;
+}
+
 void AnimatedModel::HandleModelReloadFinished(StringHash eventType, VariantMap& eventData)
 {
     Model* currentModel = model_;
@@ -96,8 +96,14 @@ public:
     void SetMorphWeight(StringHash nameHash, float weight);
     /// Reset all vertex morphs to zero.
     void ResetMorphWeights();
-    /// Apply all animation states to nodes.
+    /// Set whether to animate the bone scene nodes directly. Default true. When disabled, animation is blended in a local pose buffer, skinning is calculated directly from the pose and the bone nodes are only updated if they have attachments, or on request.
+    void SetUpdateBoneNodes(bool enable);
+    /// Set whether to use dual quaternion skinning, which avoids the volume loss of linear blending at twisting joints and uploads less data per bone. Bone scaling is not supported.
+    void SetDualQuaternionSkinning(bool enable);
+    /// Apply all animation states to the pose, and to the bone nodes if necessary.
     void ApplyAnimation();
+    /// Write the current animated pose to the bone scene nodes if they are out of date. Call before reading bone node transforms when bone node updates are disabled.
+    void UpdateBoneNodes();
 
     /// Return skeleton.
     Skeleton& GetSkeleton() { return skeleton_; }
@@ -123,6 +129,12 @@ public:
     /// Return whether to update animation when not visible.
     bool GetUpdateInvisible() const { return updateInvisible_; }
 
+    /// Return whether the bone scene nodes are animated directly.
+    bool GetUpdateBoneNodes() const { return updateBoneNodes_; }
+
+    /// Return whether dual quaternion skinning is used.
+    bool GetDualQuaternionSkinning() const { return dualQuaternionSkinning_; }
+
     /// Return all vertex morphs.
     const Vector<ModelMorph>& GetMorphs() const { return morphs_; }
 
@@ -165,6 +177,9 @@ public:
     /// Return per-geometry skin matrices. If empty, uses global skinning
     const Vector<PODVector<Matrix3x4> >& GetGeometrySkinMatrices() const { return geometrySkinMatrices_; }
 
+    /// Return skinning dual quaternions: the model's world transform as three rows, followed by the real and dual part of each bone in model space. Empty if dual quaternion skinning is not used.
+    const PODVector<Vector4>& GetSkinDualQuaternions() const { return skinDualQuaternions_; }
+
     /// Recalculate the bone bounding box. Normally called internally, but can also be manually called if up-to-date information before rendering is necessary.
     void UpdateBoneBoundingBox();
 
@@ -181,6 +196,8 @@ public:
 protected:
     /// Handle node being assigned.
     virtual void OnNodeSet(Node* node);
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
     /// Handle node transform being dirtied.
     virtual void OnMarkedDirty(Node* node);
     /// Recalculate the world-space bounding box.
@@ -203,6 +220,8 @@ private:
     void SetSkeleton(const Skeleton& skeleton, bool createBones);
     /// Set mapping of subgeometry bone indices.
     void SetGeometryBoneMappings();
+    /// Assign skinning matrices or dual quaternions to batches.
+    void SetSkinningBatches();
     /// Clone geometries for vertex morphing.
     void CloneGeometries();
     /// Copy morph vertices.
@@ -211,13 +230,39 @@ private:
     void UpdateAnimation(const FrameInfo& frame);
     /// Recalculate skinning.
     void UpdateSkinning();
-    /// Reapply all vertex morphs.
+    /// Convert the skinning matrices to dual quaternions.
+    void UpdateSkinDualQuaternions();
+    /// Read the local pose of bones not owned by the pose buffer from the bone nodes.
+    void ReadPose();
+    /// Write the local pose of animated bones to the bone nodes silently.
+    void WritePose();
+    /// Return whether the bone nodes must be kept up to date, because other components or nodes depend on them. The result is cached until the node hierarchy changes.
+    bool NeedBoneNodes();
+    /// Subscribe to the scene's node and component changes when the bone node attachments need to be tracked.
+    void UpdateBoneNodeSubscriptions();
+    /// Recalculate bone world transforms from the pose buffer if dirty.
+    void UpdateBoneTransforms();
+    /// Calculate bone world transforms from the pose buffer without modifying the model.
+    void CalculateBoneTransforms(PODVector<Matrix3x4>& dest) const;
+    /// Calculate one bone world transform from the pose buffer. The transforms below the calculated count are reused for the parents.
+    Matrix3x4 CalculateBoneTransform(unsigned index, const PODVector<Matrix3x4>& transforms, unsigned numCalculated) const;
+    /// Return bone world transforms when the bone nodes are out of date, calculating them into the temporary buffer if the cached ones are stale. Return null if the bone nodes are up to date.
+    const Matrix3x4* GetBoneTransforms(PODVector<Matrix3x4>& tempTransforms) const;
+    /// Reapply all vertex morphs and upload the morphed vertices.
     void UpdateMorphs();
+    /// Reapply all vertex morphs to the vertex buffers' CPU-side data. Safe to call from worker threads.
+    void CalculateMorphs();
+    /// Upload the morphed vertex range of the vertex buffers. Must be called from the main thread.
+    void UploadMorphs();
+    /// Return whether a late animation update can be applied from a worker thread, ie. the bone nodes will not be written.
+    bool CanApplyAnimationThreaded() const;
     /// Apply a vertex morph.
     void ApplyMorph
         (VertexBuffer* buffer, void* destVertexData, unsigned morphRangeStart, const VertexBufferMorph& morph, float weight);
     /// Handle model reload finished.
     void HandleModelReloadFinished(StringHash eventType, VariantMap& eventData);
+    /// Handle a node or component being added to or removed from the scene.
+    void HandleSceneStructureChanged(StringHash eventType, VariantMap& eventData);
 
     /// Skeleton.
     Skeleton skeleton_;
@@ -229,12 +274,24 @@ private:
     Vector<SharedPtr<AnimationState> > animationStates_;
     /// Skinning matrices.
     PODVector<Matrix3x4> skinMatrices_;
+    /// Local pose bone positions.
+    PODVector<Vector3> posePositions_;
+    /// Local pose bone rotations.
+    PODVector<Quaternion> poseRotations_;
+    /// Local pose bone scales.
+    PODVector<Vector3> poseScales_;
+    /// Bone world transforms calculated from the pose buffer, used when the bone nodes are out of date.
+    PODVector<Matrix3x4> boneTransforms_;
     /// Mapping of subgeometry bone indices, used if more bones than skinning shader can manage.
     Vector<PODVector<unsigned> > geometryBoneMappings_;
     /// Subgeometry skinning matrices, used if more bones than skinning shader can manage.
     Vector<PODVector<Matrix3x4> > geometrySkinMatrices_;
     /// Subgeometry skinning matrix pointers, if more bones than skinning shader can manage.
     Vector<PODVector<Matrix3x4*> > geometrySkinMatrixPtrs_;
+    /// Skinning dual quaternions, with the model's world transform in front.
+    PODVector<Vector4> skinDualQuaternions_;
+    /// Subgeometry skinning dual quaternions, used if more bones than skinning shader can manage.
+    Vector<PODVector<Vector4> > geometrySkinDualQuaternions_;
     /// Bounding box calculated from bones.
     BoundingBox boneBoundingBox_;
     /// Attribute buffer.
@@ -257,6 +314,8 @@ private:
     bool animationOrderDirty_;
     /// Vertex morphs dirty flag.
     bool morphsDirty_;
+    /// Morphed vertices calculated but not yet uploaded flag.
+    bool morphsUploadPending_;
     /// Skinning dirty flag.
     bool skinningDirty_;
     /// Bone bounding box dirty flag.
@@ -271,6 +330,20 @@ private:
     bool forceAnimationUpdate_;
     /// Override global bone creation flag, locally.
     bool boneCreationOverride_;
+    /// Write pose to bone nodes on every animation update flag.
+    bool updateBoneNodes_;
+    /// Animation applied to the pose buffer instead of the bone nodes flag.
+    bool usePoseBuffer_;
+    /// Bone nodes needed by attachments or other models flag.
+    bool needBoneNodes_;
+    /// Bone node attachments need to be checked again flag.
+    bool needBoneNodesDirty_;
+    /// Dual quaternion skinning flag.
+    bool dualQuaternionSkinning_;
+    /// Bone nodes out of date with the pose buffer flag.
+    bool boneNodesDirty_;
+    /// Bone world transforms dirty flag.
+    bool boneTransformsDirty_;
 };
 
 }
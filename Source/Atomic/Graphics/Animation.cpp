@@ -49,8 +49,106 @@ inline bool CompareKeyFrames(AnimationKeyFrame& lhs, AnimationKeyFrame& rhs)
     return lhs.time_ < rhs.time_;
 }
 
+static const float QUANTIZE_MAX = 65535.0f;
+static const float ROTATION_QUANTIZE_MAX = 32767.0f;
+static const float SQRT_HALF = 0.70710678f;
+
+static void QuantizeVector3(const Vector3& value, const Vector3& min, const Vector3& step, unsigned short* dest)
+{
+    dest[0] = (unsigned short)(step.x_ > 0.0f ? Clamp((int)((value.x_ - min.x_) / step.x_ + 0.5f), 0, 65535) : 0);
+    dest[1] = (unsigned short)(step.y_ > 0.0f ? Clamp((int)((value.y_ - min.y_) / step.y_ + 0.5f), 0, 65535) : 0);
+    dest[2] = (unsigned short)(step.z_ > 0.0f ? Clamp((int)((value.z_ - min.z_) / step.z_ + 0.5f), 0, 65535) : 0);
+}
+
+static inline Vector3 DequantizeVector3(const unsigned short* src, const Vector3& min, const Vector3& step)
+{
+    return Vector3(min.x_ + src[0] * step.x_, min.y_ + src[1] * step.y_, min.z_ + src[2] * step.z_);
+}
+
+static void QuantizeRotation(const Quaternion& rotation, unsigned short* dest)
+{
+    // Smallest three encoding: drop the largest component, which can be reconstructed from the unit length. Its index is
+    // stored in the high bits of the first two values
+    Quaternion normalized = rotation.Normalized();
+    float components[4] = { normalized.w_, normalized.x_, normalized.y_, normalized.z_ };
+
+    unsigned largest = 0;
+    for (unsigned i = 1; i < 4; ++i)
+    {
+        if (Abs(components[i]) > Abs(components[largest]))
+            largest = i;
+    }
+
+    // q and -q are the same rotation, so flip to make the dropped component positive
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+    unsigned j = 0;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float value = Clamp(components[i] * sign / SQRT_HALF, -1.0f, 1.0f);
+        dest[j++] = (unsigned short)((value * 0.5f + 0.5f) * ROTATION_QUANTIZE_MAX + 0.5f);
+    }
+
+    dest[0] |= (unsigned short)((largest >> 1) << 15);
+    dest[1] |= (unsigned short)((largest & 1) << 15);
+}
+
+static inline Quaternion DequantizeRotation(const unsigned short* src)
+{
+    unsigned largest = ((src[0] >> 15) << 1) | (src[1] >> 15);
+    float components[4];
+    float sumSquares = 0.0f;
+    unsigned j = 0;
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float value = ((src[j++] & 0x7fff) / ROTATION_QUANTIZE_MAX * 2.0f - 1.0f) * SQRT_HALF;
+        components[i] = value;
+        sumSquares += value * value;
+    }
+
+    components[largest] = sqrtf(Max(1.0f - sumSquares, 0.0f));
+    return Quaternion(components[0], components[1], components[2], components[3]);
+}
+
+static inline float RotationDifference(const Quaternion& lhs, const Quaternion& rhs)
+{
+    return 2.0f * Acos(Abs(lhs.DotProduct(rhs)));
+}
+
+/// Return whether keyframes between first and last can be replaced by interpolating between them within the error limits.
+static bool IsInterpolated(const Vector<AnimationKeyFrame>& keyFrames, unsigned char channelMask, unsigned first, unsigned last,
+    float positionError, float rotationError, float scaleError)
+{
+    const AnimationKeyFrame& start = keyFrames[first];
+    const AnimationKeyFrame& end = keyFrames[last];
+    float timeInterval = end.time_ - start.time_;
+
+    for (unsigned i = first + 1; i < last; ++i)
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames[i];
+        float t = timeInterval > 0.0f ? (keyFrame.time_ - start.time_) / timeInterval : 0.0f;
+
+        if ((channelMask & CHANNEL_POSITION) &&
+            (start.position_.Lerp(end.position_, t) - keyFrame.position_).Length() > positionError)
+            return false;
+        if ((channelMask & CHANNEL_ROTATION) &&
+            RotationDifference(start.rotation_.Slerp(end.rotation_, t), keyFrame.rotation_) > rotationError)
+            return false;
+        if ((channelMask & CHANNEL_SCALE) && (start.scale_.Lerp(end.scale_, t) - keyFrame.scale_).Length() > scaleError)
+            return false;
+    }
+
+    return true;
+}
+
 void AnimationTrack::SetKeyFrame(unsigned index, const AnimationKeyFrame& keyFrame)
 {
+    Decompress();
+
     if (index < keyFrames_.Size())
     {
         keyFrames_[index] = keyFrame;
@@ -62,6 +160,8 @@ void AnimationTrack::SetKeyFrame(unsigned index, const AnimationKeyFrame& keyFra
 
 void AnimationTrack::AddKeyFrame(const AnimationKeyFrame& keyFrame)
 {
+    Decompress();
+
     bool needSort = keyFrames_.Size() ? keyFrames_.Back().time_ > keyFrame.time_ : false;
     keyFrames_.Push(keyFrame);
     if (needSort)
@@ -70,39 +170,212 @@ void AnimationTrack::AddKeyFrame(const AnimationKeyFrame& keyFrame)
 
 void AnimationTrack::InsertKeyFrame(unsigned index, const AnimationKeyFrame& keyFrame)
 {
+    Decompress();
+
     keyFrames_.Insert(index, keyFrame);
     Atomic::Sort(keyFrames_.Begin(), keyFrames_.End(), CompareKeyFrames);
 }
 
 void AnimationTrack::RemoveKeyFrame(unsigned index)
 {
+    Decompress();
+
     keyFrames_.Erase(index);
 }
 
 void AnimationTrack::RemoveAllKeyFrames()
 {
     keyFrames_.Clear();
+    compressedTimes_.Clear();
+    compressedPositions_.Clear();
+    compressedRotations_.Clear();
+    compressedScales_.Clear();
+    compressed_ = false;
+}
+
+void AnimationTrack::Compress(float positionError, float rotationError, float scaleError)
+{
+    if (compressed_ || keyFrames_.Empty())
+        return;
+
+    positionError = Max(positionError, 0.0f);
+    rotationError = Max(rotationError, 0.0f);
+    scaleError = Max(scaleError, 0.0f);
+
+    // Find channels that stay constant within the error limits
+    const AnimationKeyFrame& firstKeyFrame = keyFrames_[0];
+    bool constantPosition = true;
+    bool constantRotation = true;
+    bool constantScale = true;
+    for (unsigned i = 1; i < keyFrames_.Size(); ++i)
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames_[i];
+        if ((keyFrame.position_ - firstKeyFrame.position_).Length() > positionError)
+            constantPosition = false;
+        if (RotationDifference(keyFrame.rotation_, firstKeyFrame.rotation_) > rotationError)
+            constantRotation = false;
+        if ((keyFrame.scale_ - firstKeyFrame.scale_).Length() > scaleError)
+            constantScale = false;
+    }
+
+    unsigned char varyingMask = channelMask_;
+    if (constantPosition)
+        varyingMask &= ~CHANNEL_POSITION;
+    if (constantRotation)
+        varyingMask &= ~CHANNEL_ROTATION;
+    if (constantScale)
+        varyingMask &= ~CHANNEL_SCALE;
+
+    // Reduce keys: extend each linear segment for as long as the keys it skips stay within the error limits
+    PODVector<unsigned> keys;
+    keys.Push(0);
+    if (varyingMask)
+    {
+        unsigned segmentStart = 0;
+        for (unsigned i = 2; i < keyFrames_.Size(); ++i)
+        {
+            if (!IsInterpolated(keyFrames_, varyingMask, segmentStart, i, positionError, rotationError, scaleError))
+            {
+                segmentStart = i - 1;
+                keys.Push(segmentStart);
+            }
+        }
+        if (keyFrames_.Size() > 1)
+            keys.Push(keyFrames_.Size() - 1);
+    }
+
+    unsigned numKeys = keys.Size();
+    compressedTimes_.Resize(numKeys);
+    for (unsigned i = 0; i < numKeys; ++i)
+        compressedTimes_[i] = keyFrames_[keys[i]].time_;
+
+    compressedPositions_.Clear();
+    positionMin_ = firstKeyFrame.position_;
+    positionStep_ = Vector3::ZERO;
+    if (varyingMask & CHANNEL_POSITION)
+    {
+        Vector3 positionMax = positionMin_;
+        for (unsigned i = 1; i < numKeys; ++i)
+        {
+            const Vector3& position = keyFrames_[keys[i]].position_;
+            positionMin_ = VectorMin(positionMin_, position);
+            positionMax = VectorMax(positionMax, position);
+        }
+        positionStep_ = (positionMax - positionMin_) / QUANTIZE_MAX;
+        compressedPositions_.Resize(numKeys * 3);
+        for (unsigned i = 0; i < numKeys; ++i)
+            QuantizeVector3(keyFrames_[keys[i]].position_, positionMin_, positionStep_, &compressedPositions_[i * 3]);
+    }
+
+    compressedRotations_.Clear();
+    rotationConstant_ = firstKeyFrame.rotation_;
+    if (varyingMask & CHANNEL_ROTATION)
+    {
+        compressedRotations_.Resize(numKeys * 3);
+        for (unsigned i = 0; i < numKeys; ++i)
+            QuantizeRotation(keyFrames_[keys[i]].rotation_, &compressedRotations_[i * 3]);
+    }
+
+    compressedScales_.Clear();
+    scaleMin_ = firstKeyFrame.scale_;
+    scaleStep_ = Vector3::ZERO;
+    if (varyingMask & CHANNEL_SCALE)
+    {
+        Vector3 scaleMax = scaleMin_;
+        for (unsigned i = 1; i < numKeys; ++i)
+        {
+            const Vector3& scale = keyFrames_[keys[i]].scale_;
+            scaleMin_ = VectorMin(scaleMin_, scale);
+            scaleMax = VectorMax(scaleMax, scale);
+        }
+        scaleStep_ = (scaleMax - scaleMin_) / QUANTIZE_MAX;
+        compressedScales_.Resize(numKeys * 3);
+        for (unsigned i = 0; i < numKeys; ++i)
+            QuantizeVector3(keyFrames_[keys[i]].scale_, scaleMin_, scaleStep_, &compressedScales_[i * 3]);
+    }
+
+    keyFrames_.Clear();
+    keyFrames_.Compact();
+    compressed_ = true;
+}
+
+void AnimationTrack::Decompress()
+{
+    if (!compressed_)
+        return;
+
+    unsigned numKeys = compressedTimes_.Size();
+    keyFrames_.Resize(numKeys);
+    for (unsigned i = 0; i < numKeys; ++i)
+        DecodeKeyFrame(i, keyFrames_[i]);
+
+    compressedTimes_.Clear();
+    compressedPositions_.Clear();
+    compressedRotations_.Clear();
+    compressedScales_.Clear();
+    compressed_ = false;
+}
+
+void AnimationTrack::DecodeKeyFrame(unsigned index, AnimationKeyFrame& keyFrame) const
+{
+    keyFrame.time_ = compressedTimes_[index];
+
+    if (channelMask_ & CHANNEL_POSITION)
+    {
+        keyFrame.position_ = compressedPositions_.Empty() ? positionMin_ :
+            DequantizeVector3(&compressedPositions_[index * 3], positionMin_, positionStep_);
+    }
+    if (channelMask_ & CHANNEL_ROTATION)
+        keyFrame.rotation_ = compressedRotations_.Empty() ? rotationConstant_ : DequantizeRotation(&compressedRotations_[index * 3]);
+    if (channelMask_ & CHANNEL_SCALE)
+        keyFrame.scale_ = compressedScales_.Empty() ? scaleMin_ : DequantizeVector3(&compressedScales_[index * 3], scaleMin_, scaleStep_);
+}
+
+unsigned AnimationTrack::GetKeyMemoryUse() const
+{
+    if (!compressed_)
+        return keyFrames_.Size() * sizeof(AnimationKeyFrame);
+
+    return compressedTimes_.Size() * sizeof(float) + (compressedPositions_.Size() + compressedRotations_.Size() +
+        compressedScales_.Size()) * sizeof(unsigned short);
 }
 
 AnimationKeyFrame* AnimationTrack::GetKeyFrame(unsigned index)
 {
+    // Decompressing here would modify a resource that worker threads may be sampling
+    if (compressed_)
+        return 0;
+
     return index < keyFrames_.Size() ? &keyFrames_[index] : (AnimationKeyFrame*)0;
 }
 
+bool AnimationTrack::GetKeyFrame(unsigned index, AnimationKeyFrame& dest) const
+{
+    if (index >= GetNumKeyFrames())
+        return false;
+
+    if (compressed_)
+        DecodeKeyFrame(index, dest);
+    else
+        dest = keyFrames_[index];
+    return true;
+}
+
 void AnimationTrack::GetKeyFrameIndex(float time, unsigned& index) const
 {
     if (time < 0.0f)
         time = 0.0f;
 
-    if (index >= keyFrames_.Size())
-        index = keyFrames_.Size() - 1;
+    unsigned numKeyFrames = GetNumKeyFrames();
+    if (index >= numKeyFrames)
+        index = numKeyFrames - 1;
 
     // Check for being too far ahead
-    while (index && time < keyFrames_[index].time_)
+    while (index && time < GetKeyFrameTime(index))
         --index;
 
     // Check for being too far behind
-    while (index < keyFrames_.Size() - 1 && time >= keyFrames_[index + 1].time_)
+    while (index < numKeyFrames - 1 && time >= GetKeyFrameTime(index + 1))
         ++index;
 }
 
@@ -125,8 +398,10 @@ bool Animation::BeginLoad(Deserializer& source)
 {
     unsigned memoryUse = sizeof(Animation);
 
-    // Check ID
-    if (source.ReadFileID() != "UANI")
+    // Check ID. UANC files may contain compressed tracks
+    String fileID = source.ReadFileID();
+    bool compressedFormat = fileID == "UANC";
+    if (fileID != "UANI" && !compressedFormat)
     {
         ATOMIC_LOGERROR(source.GetName() + " is not a valid animation file");
         return false;
@@ -147,6 +422,35 @@ bool Animation::BeginLoad(Deserializer& source)
         AnimationTrack* newTrack = CreateTrack(source.ReadString());
         newTrack->channelMask_ = source.ReadUByte();
 
+        if (compressedFormat && source.ReadBool())
+        {
+            unsigned numKeys = source.ReadUInt();
+            newTrack->compressedTimes_.Resize(numKeys);
+            if (numKeys)
+                source.Read(&newTrack->compressedTimes_[0], numKeys * sizeof(float));
+
+            newTrack->positionMin_ = source.ReadVector3();
+            newTrack->positionStep_ = source.ReadVector3();
+            newTrack->compressedPositions_.Resize(source.ReadUInt());
+            if (newTrack->compressedPositions_.Size())
+                source.Read(&newTrack->compressedPositions_[0], newTrack->compressedPositions_.Size() * sizeof(unsigned short));
+
+            newTrack->rotationConstant_ = source.ReadQuaternion();
+            newTrack->compressedRotations_.Resize(source.ReadUInt());
+            if (newTrack->compressedRotations_.Size())
+                source.Read(&newTrack->compressedRotations_[0], newTrack->compressedRotations_.Size() * sizeof(unsigned short));
+
+            newTrack->scaleMin_ = source.ReadVector3();
+            newTrack->scaleStep_ = source.ReadVector3();
+            newTrack->compressedScales_.Resize(source.ReadUInt());
+            if (newTrack->compressedScales_.Size())
+                source.Read(&newTrack->compressedScales_[0], newTrack->compressedScales_.Size() * sizeof(unsigned short));
+
+            newTrack->compressed_ = true;
+            memoryUse += newTrack->GetKeyMemoryUse();
+            continue;
+        }
+
         unsigned keyFrames = source.ReadUInt();
         newTrack->keyFrames_.Resize(keyFrames);
         memoryUse += keyFrames * sizeof(AnimationKeyFrame);
@@ -225,8 +529,18 @@ bool Animation::BeginLoad(Deserializer& source)
 
 bool Animation::Save(Serializer& dest) const
 {
+    bool compressedFormat = false;
+    for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        if (i->second_.IsCompressed())
+        {
+            compressedFormat = true;
+            break;
+        }
+    }
+
     // Write ID, name and length
-    dest.WriteFileID("UANI");
+    dest.WriteFileID(compressedFormat ? "UANC" : "UANI");
     dest.WriteString(animationName_);
     dest.WriteFloat(length_);
 
@@ -237,6 +551,36 @@ bool Animation::Save(Serializer& dest) const
         const AnimationTrack& track = i->second_;
         dest.WriteString(track.name_);
         dest.WriteUByte(track.channelMask_);
+
+        if (compressedFormat)
+        {
+            dest.WriteBool(track.compressed_);
+            if (track.compressed_)
+            {
+                dest.WriteUInt(track.compressedTimes_.Size());
+                if (track.compressedTimes_.Size())
+                    dest.Write(&track.compressedTimes_[0], track.compressedTimes_.Size() * sizeof(float));
+
+                dest.WriteVector3(track.positionMin_);
+                dest.WriteVector3(track.positionStep_);
+                dest.WriteUInt(track.compressedPositions_.Size());
+                if (track.compressedPositions_.Size())
+                    dest.Write(&track.compressedPositions_[0], track.compressedPositions_.Size() * sizeof(unsigned short));
+
+                dest.WriteQuaternion(track.rotationConstant_);
+                dest.WriteUInt(track.compressedRotations_.Size());
+                if (track.compressedRotations_.Size())
+                    dest.Write(&track.compressedRotations_[0], track.compressedRotations_.Size() * sizeof(unsigned short));
+
+                dest.WriteVector3(track.scaleMin_);
+                dest.WriteVector3(track.scaleStep_);
+                dest.WriteUInt(track.compressedScales_.Size());
+                if (track.compressedScales_.Size())
+                    dest.Write(&track.compressedScales_[0], track.compressedScales_.Size() * sizeof(unsigned short));
+                continue;
+            }
+        }
+
         dest.WriteUInt(track.keyFrames_.Size());
 
         // Write keyframes of the track
@@ -383,6 +727,30 @@ SharedPtr<Animation> Animation::Clone(const String& cloneName) const
     return ret;
 }
 
+void Animation::Compress(float positionError, float rotationError, float scaleError)
+{
+    unsigned memoryUse = GetMemoryUse();
+    for (HashMap<StringHash, AnimationTrack>::Iterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        memoryUse -= Min(memoryUse, i->second_.GetKeyMemoryUse());
+        i->second_.Compress(positionError, rotationError, scaleError);
+        memoryUse += i->second_.GetKeyMemoryUse();
+    }
+    SetMemoryUse(memoryUse);
+}
+
+void Animation::Decompress()
+{
+    unsigned memoryUse = GetMemoryUse();
+    for (HashMap<StringHash, AnimationTrack>::Iterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+    {
+        memoryUse -= Min(memoryUse, i->second_.GetKeyMemoryUse());
+        i->second_.Decompress();
+        memoryUse += i->second_.GetKeyMemoryUse();
+    }
+    SetMemoryUse(memoryUse);
+}
+
 AnimationTrack* Animation::GetTrack(unsigned index)
 {
     if (index >= GetNumTracks())
@@ -55,27 +55,48 @@ struct ATOMIC_API AnimationTrack
 {
     /// Construct.
     AnimationTrack() :
-        channelMask_(0)
+        channelMask_(0),
+        compressed_(false),
+        positionMin_(Vector3::ZERO),
+        positionStep_(Vector3::ZERO),
+        rotationConstant_(Quaternion::IDENTITY),
+        scaleMin_(Vector3::ONE),
+        scaleStep_(Vector3::ZERO)
     {
     }
 
-    /// Assign keyframe at index.
+    /// Assign keyframe at index. Decompresses the track, so must not be called while animation states are playing the animation.
     void SetKeyFrame(unsigned index, const AnimationKeyFrame& command);
-    /// Add a keyframe at the end.
+    /// Add a keyframe at the end. Decompresses the track, so must not be called while animation states are playing the animation.
     void AddKeyFrame(const AnimationKeyFrame& keyFrame);
-    /// Insert a keyframe at index.
+    /// Insert a keyframe at index. Decompresses the track, so must not be called while animation states are playing the animation.
     void InsertKeyFrame(unsigned index, const AnimationKeyFrame& keyFrame);
-    /// Remove a keyframe at index.
+    /// Remove a keyframe at index. Decompresses the track, so must not be called while animation states are playing the animation.
     void RemoveKeyFrame(unsigned index);
     /// Remove all keyframes.
     void RemoveAllKeyFrames();
 
-    /// Return keyframe at index, or null if not found.
+    /// Compress the keyframes. Keys that can be interpolated from their neighbours within the given errors are removed, constant channels are stored once and the remaining keys are quantized to 16 bits per component. Rotation error is in degrees.
+    void Compress(float positionError, float rotationError, float scaleError);
+    /// Expand compressed keys back to full precision keyframes for editing. Must not be called while animation states are playing the animation.
+    void Decompress();
+
+    /// Return keyframe at index for editing, or null if not found or the track is compressed.
     AnimationKeyFrame* GetKeyFrame(unsigned index);
+    /// Copy keyframe at index, decoding it if the track is compressed. Return false if not found.
+    bool GetKeyFrame(unsigned index, AnimationKeyFrame& dest) const;
     /// Return number of keyframes.
-    unsigned GetNumKeyFrames() const { return keyFrames_.Size(); }
+    unsigned GetNumKeyFrames() const { return compressed_ ? compressedTimes_.Size() : keyFrames_.Size(); }
     /// Return keyframe index based on time and previous index.
     void GetKeyFrameIndex(float time, unsigned& index) const;
+    /// Return keyframe time at index.
+    float GetKeyFrameTime(unsigned index) const { return compressed_ ? compressedTimes_[index] : keyFrames_[index].time_; }
+    /// Decode a keyframe of a compressed track.
+    void DecodeKeyFrame(unsigned index, AnimationKeyFrame& keyFrame) const;
+    /// Return whether the keys are stored compressed.
+    bool IsCompressed() const { return compressed_; }
+    /// Return memory use of the keys in bytes.
+    unsigned GetKeyMemoryUse() const;
 
     /// Bone or scene node name.
     String name_;
@@ -83,8 +104,28 @@ struct ATOMIC_API AnimationTrack
     StringHash nameHash_;
     /// Bitmask of included data (position, rotation, scale.)
     unsigned char channelMask_;
-    /// Keyframes.
+    /// Keyframes. Empty when compressed.
     Vector<AnimationKeyFrame> keyFrames_;
+    /// Compressed flag.
+    bool compressed_;
+    /// Compressed keyframe times.
+    PODVector<float> compressedTimes_;
+    /// Quantized positions, 3 values per key. Empty if the position is constant.
+    PODVector<unsigned short> compressedPositions_;
+    /// Quantized rotations in smallest three form, 3 values per key. Empty if the rotation is constant.
+    PODVector<unsigned short> compressedRotations_;
+    /// Quantized scales, 3 values per key. Empty if the scale is constant.
+    PODVector<unsigned short> compressedScales_;
+    /// Position range minimum, or the constant position.
+    Vector3 positionMin_;
+    /// Position quantization step.
+    Vector3 positionStep_;
+    /// Constant rotation.
+    Quaternion rotationConstant_;
+    /// Scale range minimum, or the constant scale.
+    Vector3 scaleMin_;
+    /// Scale quantization step.
+    Vector3 scaleStep_;
 };
 
 /// %Animation trigger point.
@@ -148,6 +189,10 @@ public:
     void SetNumTriggers(unsigned num);
     /// Clone the animation.
     SharedPtr<Animation> Clone(const String& cloneName = String::EMPTY) const;
+    /// Compress all tracks. Rotation error is in degrees. Compressed animations are saved in the compressed format. Must not be called while animation states are playing the animation.
+    void Compress(float positionError, float rotationError, float scaleError);
+    /// Decompress all tracks. Must not be called while animation states are playing the animation.
+    void Decompress();
 
     /// Return animation name.
     const String& GetAnimationName() const { return animationName_; }
@@ -36,6 +36,7 @@ namespace Atomic
 AnimationStateTrack::AnimationStateTrack() :
     track_(0),
     bone_(0),
+    boneIndex_(M_MAX_UNSIGNED),
     weight_(1.0f),
     keyFrame_(0)
 {
@@ -132,6 +133,8 @@ void AnimationState::SetStartBone(Bone* startBone)
     if (!startBone->node_)
         return;
 
+    const Bone* firstBone = &skeleton.GetModifiableBones()[0];
+
     for (HashMap<StringHash, AnimationTrack>::ConstIterator i = tracks.Begin(); i != tracks.End(); ++i)
     {
         AnimationStateTrack stateTrack;
@@ -153,6 +156,7 @@ void AnimationState::SetStartBone(Bone* startBone)
         if (trackBone && trackBone->node_)
         {
             stateTrack.bone_ = trackBone;
+            stateTrack.boneIndex_ = (unsigned)(trackBone - firstBone);
             stateTrack.node_ = trackBone->node_;
             stateTracks_.Push(stateTrack);
         }
@@ -458,16 +462,48 @@ void AnimationState::Apply()
 
 void AnimationState::ApplyToModel()
 {
+    // Unless the model uses its pose buffer, apply to the bone nodes silently. The model dirties its root node afterward
+    if (!model_->usePoseBuffer_)
+    {
+        for (Vector<AnimationStateTrack>::Iterator i = stateTracks_.Begin(); i != stateTracks_.End(); ++i)
+        {
+            AnimationStateTrack& stateTrack = *i;
+            float finalWeight = weight_ * stateTrack.weight_;
+
+            // Do not apply if zero effective weight or the bone has animation disabled
+            if (Equals(finalWeight, 0.0f) || !stateTrack.bone_->animated_)
+                continue;
+
+            ApplyTrack(stateTrack, finalWeight, true);
+        }
+        return;
+    }
+
+    Vector3* positions = model_->posePositions_.Buffer();
+    Quaternion* rotations = model_->poseRotations_.Buffer();
+    Vector3* scales = model_->poseScales_.Buffer();
+    unsigned numBones = model_->posePositions_.Size();
+
+    Vector3 newPosition;
+    Quaternion newRotation;
+    Vector3 newScale;
+
     for (Vector<AnimationStateTrack>::Iterator i = stateTracks_.Begin(); i != stateTracks_.End(); ++i)
     {
         AnimationStateTrack& stateTrack = *i;
         float finalWeight = weight_ * stateTrack.weight_;
+        unsigned index = stateTrack.boneIndex_;
 
         // Do not apply if zero effective weight or the bone has animation disabled
-        if (Equals(finalWeight, 0.0f) || !stateTrack.bone_->animated_)
+        if (Equals(finalWeight, 0.0f) || !stateTrack.bone_->animated_ || index >= numBones || !stateTrack.node_)
             continue;
-            
-        ApplyTrack(stateTrack, finalWeight, true);
+
+        unsigned char channelMask = SampleTrack(stateTrack, newPosition, newRotation, newScale);
+        if (channelMask)
+        {
+            BlendTrack(stateTrack, finalWeight, channelMask, newPosition, newRotation, newScale, positions[index],
+                rotations[index], scales[index]);
+        }
     }
 }
 
@@ -480,19 +516,58 @@ void AnimationState::ApplyToNodes()
 
 void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent)
 {
-    const AnimationTrack* track = stateTrack.track_;
     Node* node = stateTrack.node_;
+    if (!node)
+        return;
+
+    Vector3 newPosition;
+    Quaternion newRotation;
+    Vector3 newScale;
 
-    if (track->keyFrames_.Empty() || !node)
+    unsigned char channelMask = SampleTrack(stateTrack, newPosition, newRotation, newScale);
+    if (!channelMask)
         return;
 
+    Vector3 position = node->GetPosition();
+    Quaternion rotation = node->GetRotation();
+    Vector3 scale = node->GetScale();
+    BlendTrack(stateTrack, weight, channelMask, newPosition, newRotation, newScale, position, rotation, scale);
+
+    if (silent)
+    {
+        if (channelMask & CHANNEL_POSITION)
+            node->SetPositionSilent(position);
+        if (channelMask & CHANNEL_ROTATION)
+            node->SetRotationSilent(rotation);
+        if (channelMask & CHANNEL_SCALE)
+            node->SetScaleSilent(scale);
+    }
+    else
+    {
+        if (channelMask & CHANNEL_POSITION)
+            node->SetPosition(position);
+        if (channelMask & CHANNEL_ROTATION)
+            node->SetRotation(rotation);
+        if (channelMask & CHANNEL_SCALE)
+            node->SetScale(scale);
+    }
+}
+
+unsigned char AnimationState::SampleTrack(AnimationStateTrack& stateTrack, Vector3& newPosition, Quaternion& newRotation,
+    Vector3& newScale)
+{
+    const AnimationTrack* track = stateTrack.track_;
+    unsigned numKeyFrames = track->GetNumKeyFrames();
+    if (!numKeyFrames)
+        return 0;
+
     unsigned& frame = stateTrack.keyFrame_;
     track->GetKeyFrameIndex(time_, frame);
 
     // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
     unsigned nextFrame = frame + 1;
     bool interpolate = true;
-    if (nextFrame >= track->keyFrames_.Size())
+    if (nextFrame >= numKeyFrames)
     {
         if (!looped_)
         {
@@ -503,16 +578,29 @@ void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, b
             nextFrame = 0;
     }
 
-    const AnimationKeyFrame* keyFrame = &track->keyFrames_[frame];
+    // Compressed tracks are decoded at sample time
+    AnimationKeyFrame decodedKeyFrame;
+    AnimationKeyFrame decodedNextKeyFrame;
+    const AnimationKeyFrame* keyFrame;
+    if (track->IsCompressed())
+    {
+        track->DecodeKeyFrame(frame, decodedKeyFrame);
+        keyFrame = &decodedKeyFrame;
+    }
+    else
+        keyFrame = &track->keyFrames_[frame];
     unsigned char channelMask = track->channelMask_;
 
-    Vector3 newPosition;
-    Quaternion newRotation;
-    Vector3 newScale;
-
     if (interpolate)
     {
-        const AnimationKeyFrame* nextKeyFrame = &track->keyFrames_[nextFrame];
+        const AnimationKeyFrame* nextKeyFrame;
+        if (track->IsCompressed())
+        {
+            track->DecodeKeyFrame(nextFrame, decodedNextKeyFrame);
+            nextKeyFrame = &decodedNextKeyFrame;
+        }
+        else
+            nextKeyFrame = &track->keyFrames_[nextFrame];
         float timeInterval = nextKeyFrame->time_ - keyFrame->time_;
         if (timeInterval < 0.0f)
             timeInterval += animation_->GetLength();
@@ -534,57 +622,44 @@ void AnimationState::ApplyTrack(AnimationStateTrack& stateTrack, float weight, b
         if (channelMask & CHANNEL_SCALE)
             newScale = keyFrame->scale_;
     }
-    
+
+    return channelMask;
+}
+
+void AnimationState::BlendTrack(const AnimationStateTrack& stateTrack, float weight, unsigned char channelMask,
+    const Vector3& newPosition, const Quaternion& newRotation, const Vector3& newScale, Vector3& position, Quaternion& rotation,
+    Vector3& scale) const
+{
     if (blendingMode_ == ABM_ADDITIVE) // not ABM_LERP
     {
         if (channelMask & CHANNEL_POSITION)
-        {
-            Vector3 delta = newPosition - stateTrack.bone_->initialPosition_;
-            newPosition = node->GetPosition() + delta * weight;
-        }
+            position += (newPosition - stateTrack.bone_->initialPosition_) * weight;
         if (channelMask & CHANNEL_ROTATION)
         {
             Quaternion delta = newRotation * stateTrack.bone_->initialRotation_.Inverse();
-            newRotation = (delta * node->GetRotation()).Normalized();
-            if (!Equals(weight, 1.0f))
-                newRotation = node->GetRotation().Slerp(newRotation, weight);
+            Quaternion added = (delta * rotation).Normalized();
+            rotation = Equals(weight, 1.0f) ? added : rotation.Slerp(added, weight);
         }
         if (channelMask & CHANNEL_SCALE)
-        {
-            Vector3 delta = newScale - stateTrack.bone_->initialScale_;
-            newScale = node->GetScale() + delta * weight;
-        }
-    }
-    else
-    {
-        if (!Equals(weight, 1.0f)) // not full weight
-        {
-            if (channelMask & CHANNEL_POSITION)
-                newPosition = node->GetPosition().Lerp(newPosition, weight);
-            if (channelMask & CHANNEL_ROTATION)
-                newRotation = node->GetRotation().Slerp(newRotation, weight);
-            if (channelMask & CHANNEL_SCALE)
-                newScale = node->GetScale().Lerp(newScale, weight);
-        }
+            scale += (newScale - stateTrack.bone_->initialScale_) * weight;
     }
-    
-    if (silent)
+    else if (!Equals(weight, 1.0f)) // not full weight
     {
         if (channelMask & CHANNEL_POSITION)
-            node->SetPositionSilent(newPosition);
+            position = position.Lerp(newPosition, weight);
         if (channelMask & CHANNEL_ROTATION)
-            node->SetRotationSilent(newRotation);
+            rotation = rotation.Slerp(newRotation, weight);
         if (channelMask & CHANNEL_SCALE)
-            node->SetScaleSilent(newScale);
+            scale = scale.Lerp(newScale, weight);
     }
     else
     {
         if (channelMask & CHANNEL_POSITION)
-            node->SetPosition(newPosition);
+            position = newPosition;
         if (channelMask & CHANNEL_ROTATION)
-            node->SetRotation(newRotation);
+            rotation = newRotation;
         if (channelMask & CHANNEL_SCALE)
-            node->SetScale(newScale);
+            scale = newScale;
     }
 }
 
@@ -59,6 +59,8 @@ struct AnimationStateTrack
     Bone* bone_;
     /// Scene node pointer.
     WeakPtr<Node> node_;
+    /// Bone index in the model's skeleton and pose buffer. M_MAX_UNSIGNED in node hierarchy mode.
+    unsigned boneIndex_;
     /// Blending weight.
     float weight_;
     /// Last key frame.
@@ -148,12 +150,17 @@ public:
     void Apply();
 
 private:
-    /// Apply animation to a skeleton. Transform changes are applied silently, so the model needs to dirty its root model afterward.
+    /// Apply animation to the model's bone nodes, or to its local pose buffer if the model uses one. Transform changes are applied silently, so the model needs to dirty its root node afterward.
     void ApplyToModel();
     /// Apply animation to a scene node hierarchy.
     void ApplyToNodes();
-    /// Apply track.
+    /// Apply track to its scene node.
     void ApplyTrack(AnimationStateTrack& stateTrack, float weight, bool silent);
+    /// Sample track at the current time position using the track's cached key frame cursor. Return the channel mask, or zero if the track has no key frames.
+    unsigned char SampleTrack(AnimationStateTrack& stateTrack, Vector3& newPosition, Quaternion& newRotation, Vector3& newScale);
+    /// Blend sampled track values into a current local transform according to the blending mode and weight.
+    void BlendTrack(const AnimationStateTrack& stateTrack, float weight, unsigned char channelMask, const Vector3& newPosition,
+        const Quaternion& newRotation, const Vector3& newScale, Vector3& position, Quaternion& rotation, Vector3& scale) const;
 
     /// Animated model (model mode.)
     WeakPtr<AnimatedModel> model_;
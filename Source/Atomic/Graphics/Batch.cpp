@@ -175,7 +175,27 @@ void Batch::CalculateSortKey()
                (((unsigned long long)materialID) << 16) | geometryID;
 }
 
-void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite) const
+unsigned char Batch::GetStateChanges(const Batch* previous) const
+{
+    // When the shaders change, the shader parameters must be re-checked in any case
+    if (!previous || vertexShader_ != previous->vertexShader_ || pixelShader_ != previous->pixelShader_)
+        return BATCH_STATE_ALL;
+
+    unsigned char stateChanges = 0;
+    // Blend mode depends also on light negativity, and fog color on the blend mode
+    if (pass_ != previous->pass_ || material_ != previous->material_ || lightQueue_ != previous->lightQueue_)
+        stateChanges |= BATCH_STATE_RENDERSTATE;
+    if (zone_ != previous->zone_ || pass_ != previous->pass_ || lightQueue_ != previous->lightQueue_)
+        stateChanges |= BATCH_STATE_ZONE;
+    if (lightQueue_ != previous->lightQueue_)
+        stateChanges |= BATCH_STATE_LIGHT;
+    if (material_ != previous->material_)
+        stateChanges |= BATCH_STATE_MATERIAL;
+
+    return stateChanges;
+}
+
+void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite, unsigned char stateChanges) const
 {
     if (!vertexShader_ || !pixelShader_)
         return;
@@ -187,10 +207,12 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     Texture2D* shadowMap = lightQueue_ ? lightQueue_->shadowMap_ : 0;
 
     // Set shaders first. The available shader parameters and their register/uniform positions depend on the currently set shaders
-    graphics->SetShaders(vertexShader_, pixelShader_);
+    bool allChanged = (stateChanges & BATCH_STATE_SHADERS) != 0;
+    if (allChanged)
+        graphics->SetShaders(vertexShader_, pixelShader_);
 
     // Set pass / material-specific renderstates
-    if (pass_ && material_)
+    if (pass_ && material_ && (allChanged || (stateChanges & BATCH_STATE_RENDERSTATE)))
     {
         BlendMode blend = pass_->GetBlendMode();
         // Turn additive blending into subtract if the light is negative
@@ -223,20 +245,23 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
         graphics->SetDepthWrite(pass_->GetDepthWrite() && allowDepthWrite);
     }
 
-    // Set global (per-frame) shader parameters
-    if (graphics->NeedParameterUpdate(SP_FRAME, (void*)0))
-        view->SetGlobalShaderParameters();
-
-    // Set camera & viewport shader parameters
-    unsigned cameraHash = (unsigned)(size_t)camera;
-    IntRect viewport = graphics->GetViewport();
-    IntVector2 viewSize = IntVector2(viewport.Width(), viewport.Height());
-    unsigned viewportHash = (unsigned)(viewSize.x_ | (viewSize.y_ << 16));
-    if (graphics->NeedParameterUpdate(SP_CAMERA, reinterpret_cast<const void*>(cameraHash + viewportHash)))
+    // Set global (per-frame) shader parameters, and camera & viewport shader parameters. These stay the same during
+    // a batch queue, so only need to be checked when the shaders change
+    if (allChanged)
     {
-        view->SetCameraShaderParameters(camera);
-        // During renderpath commands the G-Buffer or viewport texture is assumed to always be viewport-sized
-        view->SetGBufferShaderParameters(viewSize, IntRect(0, 0, viewSize.x_, viewSize.y_));
+        if (graphics->NeedParameterUpdate(SP_FRAME, (void*)0))
+            view->SetGlobalShaderParameters();
+
+        unsigned cameraHash = (unsigned)(size_t)camera;
+        IntRect viewport = graphics->GetViewport();
+        IntVector2 viewSize = IntVector2(viewport.Width(), viewport.Height());
+        unsigned viewportHash = (unsigned)(viewSize.x_ | (viewSize.y_ << 16));
+        if (graphics->NeedParameterUpdate(SP_CAMERA, reinterpret_cast<const void*>(cameraHash + viewportHash)))
+        {
+            view->SetCameraShaderParameters(camera);
+            // During renderpath commands the G-Buffer or viewport texture is assumed to always be viewport-sized
+            view->SetGBufferShaderParameters(viewSize, IntRect(0, 0, viewSize.x_, viewSize.y_));
+        }
     }
 
     // Set model or skinning transforms
@@ -247,6 +272,12 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
             graphics->SetShaderParameter(VSP_SKINMATRICES, reinterpret_cast<const float*>(worldTransform_),
                 12 * numWorldTransforms_);
         }
+        else if (geometryType_ == GEOM_SKINNED_DUALQUATERNION)
+        {
+            // The model's world transform is stored in front of the per-bone real and dual parts
+            graphics->SetShaderParameter(VSP_SKINMATRICES, reinterpret_cast<const float*>(worldTransform_),
+                12 + 8 * numWorldTransforms_);
+        }
         else
             graphics->SetShaderParameter(VSP_MODEL, *worldTransform_);
 
@@ -267,7 +298,8 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     unsigned zoneHash = (unsigned)(size_t)zone_;
     if (overrideFogColorToBlack)
         zoneHash += 0x80000000;
-    if (zone_ && graphics->NeedParameterUpdate(SP_ZONE, reinterpret_cast<const void*>(zoneHash)))
+    if (zone_ && (allChanged || (stateChanges & BATCH_STATE_ZONE)) &&
+        graphics->NeedParameterUpdate(SP_ZONE, reinterpret_cast<const void*>(zoneHash)))
     {
         graphics->SetShaderParameter(VSP_AMBIENTSTARTCOLOR, zone_->GetAmbientStartColor());
         graphics->SetShaderParameter(VSP_AMBIENTENDCOLOR,
@@ -306,7 +338,7 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     }
 
     // Set light-related shader parameters
-    if (lightQueue_)
+    if (lightQueue_ && (allChanged || (stateChanges & BATCH_STATE_LIGHT)))
     {
         if (light && graphics->NeedParameterUpdate(SP_LIGHT, lightQueue_))
         {
@@ -584,17 +616,20 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     }
 
     // Set zone texture if necessary
+    if (zone_ && (allChanged || (stateChanges & BATCH_STATE_ZONE)))
+    {
 #ifndef GL_ES_VERSION_2_0
-    if (zone_ && graphics->HasTextureUnit(TU_ZONE))
-        graphics->SetTexture(TU_ZONE, zone_->GetZoneTexture());
+        if (graphics->HasTextureUnit(TU_ZONE))
+            graphics->SetTexture(TU_ZONE, zone_->GetZoneTexture());
 #else
-    // On OpenGL ES set the zone texture to the environment unit instead
-    if (zone_ && zone_->GetZoneTexture() && graphics->HasTextureUnit(TU_ENVIRONMENT))
-        graphics->SetTexture(TU_ENVIRONMENT, zone_->GetZoneTexture());
+        // On OpenGL ES set the zone texture to the environment unit instead
+        if (zone_->GetZoneTexture() && graphics->HasTextureUnit(TU_ENVIRONMENT))
+            graphics->SetTexture(TU_ENVIRONMENT, zone_->GetZoneTexture());
 #endif
+    }
 
     // Set material-specific shader parameters and textures
-    if (material_)
+    if (material_ && (allChanged || (stateChanges & BATCH_STATE_MATERIAL)))
     {
         if (graphics->NeedParameterUpdate(SP_MATERIAL, reinterpret_cast<const void*>(material_->GetShaderParameterHash())))
         {
@@ -612,7 +647,7 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     }
 
     // Set light-related textures
-    if (light)
+    if (light && (allChanged || (stateChanges & BATCH_STATE_LIGHT)))
     {
         if (shadowMap && graphics->HasTextureUnit(TU_SHADOWMAP))
             graphics->SetTexture(TU_SHADOWMAP, shadowMap);
@@ -633,13 +668,16 @@ void Batch::Prepare(View* view, Camera* camera, bool setModelTransform, bool all
     }
 }
 
-void Batch::Draw(View* view, Camera* camera, bool allowDepthWrite) const
+bool Batch::Draw(View* view, Camera* camera, bool allowDepthWrite, unsigned char stateChanges) const
 {
     if (!geometry_->IsEmpty())
     {
-        Prepare(view, camera, true, allowDepthWrite);
+        Prepare(view, camera, true, allowDepthWrite, stateChanges);
         geometry_->Draw(view->GetGraphics());
+        return vertexShader_ && pixelShader_;
     }
+    else
+        return false;
 }
 
 void BatchGroup::SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex)
@@ -665,18 +703,55 @@ void BatchGroup::SetInstancingData(void* lockedData, unsigned stride, unsigned&
     freeIndex += instances_.Size();
 }
 
-void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
+bool BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite, unsigned char stateChanges) const
 {
     Graphics* graphics = view->GetGraphics();
     Renderer* renderer = view->GetRenderer();
 
+    // Persistent static instances: draw each run of consecutive visible instances with one instanced draw call
+    if (instanceBuffer_)
+    {
+        if (!numVisibleInstances_ || geometry_->IsEmpty())
+            return false;
+
+        Batch::Prepare(view, camera, false, allowDepthWrite, stateChanges);
+
+        Vector<SharedPtr<VertexBuffer> >& vertexBuffers = const_cast<Vector<SharedPtr<VertexBuffer> >&>(
+            geometry_->GetVertexBuffers());
+        vertexBuffers.Push(SharedPtr<VertexBuffer>(instanceBuffer_));
+
+        graphics->SetIndexBuffer(geometry_->GetIndexBuffer());
+
+        unsigned numInstances = visibleInstances_.Size();
+        unsigned i = 0;
+        while (i < numInstances)
+        {
+            if (!visibleInstances_[i])
+            {
+                ++i;
+                continue;
+            }
+
+            unsigned runStart = i;
+            while (i < numInstances && visibleInstances_[i])
+                ++i;
+
+            graphics->SetVertexBuffers(vertexBuffers, startIndex_ + runStart);
+            graphics->DrawInstanced(geometry_->GetPrimitiveType(), geometry_->GetIndexStart(), geometry_->GetIndexCount(),
+                geometry_->GetVertexStart(), geometry_->GetVertexCount(), i - runStart);
+        }
+
+        vertexBuffers.Pop();
+        return vertexShader_ && pixelShader_;
+    }
+
     if (instances_.Size() && !geometry_->IsEmpty())
     {
         // Draw as individual objects if instancing not supported or could not fill the instancing buffer
         VertexBuffer* instanceBuffer = renderer->GetInstancingBuffer();
         if (!instanceBuffer || geometryType_ != GEOM_INSTANCED || startIndex_ == M_MAX_UNSIGNED)
         {
-            Batch::Prepare(view, camera, false, allowDepthWrite);
+            Batch::Prepare(view, camera, false, allowDepthWrite, stateChanges);
 
             graphics->SetIndexBuffer(geometry_->GetIndexBuffer());
             graphics->SetVertexBuffers(geometry_->GetVertexBuffers());
@@ -692,7 +767,7 @@ void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
         }
         else
         {
-            Batch::Prepare(view, camera, false, allowDepthWrite);
+            Batch::Prepare(view, camera, false, allowDepthWrite, stateChanges);
 
             // Get the geometry vertex buffers, then add the instancing stream buffer
             // Hack: use a const_cast to avoid dynamic allocation of new temp vectors
@@ -708,7 +783,11 @@ void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
             // Remove the instancing buffer & element mask now
             vertexBuffers.Pop();
         }
+
+        return vertexShader_ && pixelShader_;
     }
+    else
+        return false;
 }
 
 unsigned BatchGroupKey::ToHash() const
@@ -722,7 +801,23 @@ void BatchQueue::Clear(int maxSortedInstances)
     batches_.Clear();
     sortedBatches_.Clear();
     batchGroups_.Clear();
+    stateChanges_.Clear();
     maxSortedInstances_ = (unsigned)maxSortedInstances;
+
+    // Keep the persistent instance groups, but clear their visibility
+    if (numStaticInstances_)
+    {
+        for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = staticBatchGroups_.Begin(); i != staticBatchGroups_.End(); ++i)
+        {
+            BatchGroup& group = i->second_;
+            if (group.numVisibleInstances_)
+            {
+                memset(&group.visibleInstances_[0], 0, group.visibleInstances_.Size());
+                group.numVisibleInstances_ = 0;
+            }
+        }
+    }
+    numStaticInstances_ = 0;
 }
 
 void BatchQueue::SortBackToFront()
@@ -739,6 +834,7 @@ void BatchQueue::SortBackToFront()
     unsigned index = 0;
     for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
         sortedBatchGroups_[index++] = &i->second_;
+    AddStaticBatchGroups();
     
     Sort(sortedBatchGroups_.Begin(), sortedBatchGroups_.End(), CompareBatchGroupOrder);
 }
@@ -775,6 +871,7 @@ void BatchQueue::SortFrontToBack()
     unsigned index = 0;
     for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
         sortedBatchGroups_[index++] = &i->second_;
+    AddStaticBatchGroups();
 
     SortFrontToBack2Pass(reinterpret_cast<PODVector<Batch*>& >(sortedBatchGroups_));
 }
@@ -839,6 +936,37 @@ void BatchQueue::SortFrontToBack2Pass(PODVector<Batch*>& batches)
 #endif
 }
 
+void BatchQueue::AddStaticBatchGroups()
+{
+    if (!numStaticInstances_)
+        return;
+
+    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = staticBatchGroups_.Begin(); i != staticBatchGroups_.End(); ++i)
+    {
+        if (i->second_.numVisibleInstances_)
+            sortedBatchGroups_.Push(&i->second_);
+    }
+}
+
+void BatchQueue::RecordStateChanges()
+{
+    stateChanges_.Resize(sortedBatchGroups_.Size() + sortedBatches_.Size());
+
+    const Batch* previous = 0;
+    unsigned index = 0;
+
+    for (PODVector<BatchGroup*>::ConstIterator i = sortedBatchGroups_.Begin(); i != sortedBatchGroups_.End(); ++i)
+    {
+        stateChanges_[index++] = (*i)->GetStateChanges(previous);
+        previous = *i;
+    }
+    for (PODVector<Batch*>::ConstIterator i = sortedBatches_.Begin(); i != sortedBatches_.End(); ++i)
+    {
+        stateChanges_[index++] = (*i)->GetStateChanges(previous);
+        previous = *i;
+    }
+}
+
 void BatchQueue::SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex)
 {
     for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
@@ -860,17 +988,24 @@ void BatchQueue::Draw(View* view, Camera* camera, bool markToStencil, bool using
             graphics->SetStencilTest(false);
     }
 
+    // Use the recorded state changes if they are up to date. They are only valid relative to a batch that actually set
+    // its state, so after a skipped batch all state is set again
+    const unsigned char* stateChanges = stateChanges_.Size() == sortedBatchGroups_.Size() + sortedBatches_.Size() ?
+        stateChanges_.Buffer() : (const unsigned char*)0;
+    bool prepared = false;
+    unsigned index = 0;
+
     // Instanced
-    for (PODVector<BatchGroup*>::ConstIterator i = sortedBatchGroups_.Begin(); i != sortedBatchGroups_.End(); ++i)
+    for (PODVector<BatchGroup*>::ConstIterator i = sortedBatchGroups_.Begin(); i != sortedBatchGroups_.End(); ++i, ++index)
     {
         BatchGroup* group = *i;
         if (markToStencil)
             graphics->SetStencilTest(true, CMP_ALWAYS, OP_REF, OP_KEEP, OP_KEEP, group->lightMask_);
 
-        group->Draw(view, camera, allowDepthWrite);
+        prepared = group->Draw(view, camera, allowDepthWrite, stateChanges && prepared ? stateChanges[index] : BATCH_STATE_ALL);
     }
     // Non-instanced
-    for (PODVector<Batch*>::ConstIterator i = sortedBatches_.Begin(); i != sortedBatches_.End(); ++i)
+    for (PODVector<Batch*>::ConstIterator i = sortedBatches_.Begin(); i != sortedBatches_.End(); ++i, ++index)
     {
         Batch* batch = *i;
         if (markToStencil)
@@ -884,7 +1019,7 @@ void BatchQueue::Draw(View* view, Camera* camera, bool markToStencil, bool using
                 graphics->SetScissorTest(false);
         }
 
-        batch->Draw(view, camera, allowDepthWrite);
+        prepared = batch->Draw(view, camera, allowDepthWrite, stateChanges && prepared ? stateChanges[index] : BATCH_STATE_ALL);
     }
 }
 
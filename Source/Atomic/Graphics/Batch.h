@@ -44,8 +44,17 @@ class Texture2D;
 class VertexBuffer;
 class View;
 class Zone;
+struct CachedShadowMap;
 struct LightBatchQueue;
 
+/// Batch state change flags, recorded per draw call relative to the previous draw call in the same queue.
+static const unsigned char BATCH_STATE_SHADERS = 0x1;
+static const unsigned char BATCH_STATE_RENDERSTATE = 0x2;
+static const unsigned char BATCH_STATE_ZONE = 0x4;
+static const unsigned char BATCH_STATE_LIGHT = 0x8;
+static const unsigned char BATCH_STATE_MATERIAL = 0x10;
+static const unsigned char BATCH_STATE_ALL = 0x1f;
+
 /// Queued 3D geometry draw call.
 struct Batch
 {
@@ -73,10 +82,13 @@ struct Batch
 
     /// Calculate state sorting key, which consists of base pass flag, light, pass and geometry.
     void CalculateSortKey();
-    /// Prepare for rendering.
-    void Prepare(View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite) const;
-    /// Prepare and draw.
-    void Draw(View* view, Camera* camera, bool allowDepthWrite) const;
+    /// Return state change flags compared to a previously drawn batch, or BATCH_STATE_ALL if none.
+    unsigned char GetStateChanges(const Batch* previous) const;
+    /// Prepare for rendering. Only the state included in the state change flags is set, except for the object transform.
+    void Prepare(View* view, Camera* camera, bool setModelTransform, bool allowDepthWrite,
+        unsigned char stateChanges = BATCH_STATE_ALL) const;
+    /// Prepare and draw. Return true if was drawn.
+    bool Draw(View* view, Camera* camera, bool allowDepthWrite, unsigned char stateChanges = BATCH_STATE_ALL) const;
 
     /// State sorting key.
     unsigned long long sortKey_;
@@ -141,14 +153,18 @@ struct BatchGroup : public Batch
 {
     /// Construct with defaults.
     BatchGroup() :
-        startIndex_(M_MAX_UNSIGNED)
+        startIndex_(M_MAX_UNSIGNED),
+        instanceBuffer_(0),
+        numVisibleInstances_(0)
     {
     }
 
     /// Construct from a batch.
     BatchGroup(const Batch& batch) :
         Batch(batch),
-        startIndex_(M_MAX_UNSIGNED)
+        startIndex_(M_MAX_UNSIGNED),
+        instanceBuffer_(0),
+        numVisibleInstances_(0)
     {
     }
 
@@ -173,13 +189,19 @@ struct BatchGroup : public Batch
 
     /// Pre-set the instance data. Buffer must be big enough to hold all data.
     void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
-    /// Prepare and draw.
-    void Draw(View* view, Camera* camera, bool allowDepthWrite) const;
+    /// Prepare and draw. Return true if was drawn.
+    bool Draw(View* view, Camera* camera, bool allowDepthWrite, unsigned char stateChanges = BATCH_STATE_ALL) const;
 
     /// Instance data.
     PODVector<InstanceData> instances_;
     /// Instance stream start index, or M_MAX_UNSIGNED if transforms not pre-set.
     unsigned startIndex_;
+    /// Persistent instancing buffer of static instances, or null if using the renderer's dynamic instancing buffer.
+    VertexBuffer* instanceBuffer_;
+    /// Visibility flags of the persistent instances, starting from the instance stream start index.
+    PODVector<unsigned char> visibleInstances_;
+    /// Number of visible persistent instances.
+    unsigned numVisibleInstances_;
 };
 
 /// Instanced draw call grouping key.
@@ -244,6 +266,10 @@ public:
     void SortFrontToBack();
     /// Sort batches front to back while also maintaining state sorting.
     void SortFrontToBack2Pass(PODVector<Batch*>& batches);
+    /// Add persistent instance groups with visible instances to the sorted instanced draw calls.
+    void AddStaticBatchGroups();
+    /// Record state changes between the sorted draw calls. Called after sorting, possibly from a worker thread.
+    void RecordStateChanges();
     /// Pre-set instance data of all groups. The vertex buffer must be big enough to hold all data.
     void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
     /// Draw.
@@ -252,10 +278,12 @@ public:
     unsigned GetNumInstances() const;
 
     /// Return whether the batch group is empty.
-    bool IsEmpty() const { return batches_.Empty() && batchGroups_.Empty(); }
+    bool IsEmpty() const { return batches_.Empty() && batchGroups_.Empty() && !numStaticInstances_; }
 
     /// Instanced draw calls.
     HashMap<BatchGroupKey, BatchGroup> batchGroups_;
+    /// Instanced draw calls using persistent instance data. Kept over frames, only the instance visibility is cleared.
+    HashMap<BatchGroupKey, BatchGroup> staticBatchGroups_;
     /// Shader remapping table for 2-pass state and distance sort.
     HashMap<unsigned, unsigned> shaderRemapping_;
     /// Material remapping table for 2-pass state and distance sort.
@@ -269,8 +297,12 @@ public:
     PODVector<Batch*> sortedBatches_;
     /// Sorted instanced draw calls.
     PODVector<BatchGroup*> sortedBatchGroups_;
+    /// Recorded state changes of the sorted instanced draw calls followed by the sorted non-instanced draw calls.
+    PODVector<unsigned char> stateChanges_;
     /// Maximum sorted instances.
     unsigned maxSortedInstances_;
+    /// Number of visible persistent instances.
+    unsigned numStaticInstances_;
     /// Whether the pass command contains extra shader defines.
     bool hasExtraDefines_;
     /// Vertex shader extra defines.
@@ -290,12 +322,18 @@ struct ShadowBatchQueue
     Camera* shadowCamera_;
     /// Shadow map viewport.
     IntRect shadowViewport_;
-    /// Shadow caster draw calls.
+    /// Shadow caster draw calls. When the shadow map is cached, only the static casters of a changed split.
     BatchQueue shadowBatches_;
+    /// Dynamic shadow caster draw calls, rendered over the cached static casters every frame.
+    BatchQueue dynamicShadowBatches_;
     /// Directional light cascade near split distance.
     float nearSplit_;
     /// Directional light cascade far split distance.
     float farSplit_;
+    /// Content hash of the static shadow casters and shadow camera. Zero if the split can not be cached.
+    unsigned contentHash_;
+    /// Whether the static casters of the split are up to date in the cached shadow map and do not need rendering.
+    bool cached_;
 };
 
 /// Queue for light related draw calls.
@@ -307,6 +345,8 @@ struct LightBatchQueue
     bool negative_;
     /// Shadow map depth texture.
     Texture2D* shadowMap_;
+    /// Persistent shadow map of the light if shadow map caching is in use, or null.
+    CachedShadowMap* cachedShadowMap_;
     /// Lit geometry draw calls, base (replace blend mode)
     BatchQueue litBaseBatches_;
     /// Lit geometry draw calls, non-base (additive)
@@ -36,6 +36,10 @@
 #include "../Resource/ResourceCache.h"
 #include "../Scene/Node.h"
 
+#ifdef ATOMIC_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "../DebugNew.h"
 
 namespace Atomic
@@ -70,9 +74,32 @@ const char* billboardsStructureElementNames[] =
     0
 };
 
-inline bool CompareBillboards(Billboard* lhs, Billboard* rhs)
+/// Stable sort of values by their upper 16 bits, using two 8-bit radix passes. The result is in the values array.
+static void RadixSort16(unsigned* values, unsigned* temp, unsigned count)
 {
-    return lhs->sortDistance_ > rhs->sortDistance_;
+    unsigned* src = values;
+    unsigned* dest = temp;
+
+    for (unsigned shift = 16; shift < 32; shift += 8)
+    {
+        unsigned offsets[256];
+        memset(offsets, 0, sizeof offsets);
+        for (unsigned i = 0; i < count; ++i)
+            ++offsets[(src[i] >> shift) & 0xff];
+
+        unsigned total = 0;
+        for (unsigned i = 0; i < 256; ++i)
+        {
+            unsigned bucketCount = offsets[i];
+            offsets[i] = total;
+            total += bucketCount;
+        }
+
+        for (unsigned i = 0; i < count; ++i)
+            dest[offsets[(src[i] >> shift) & 0xff]++] = src[i];
+
+        Swap(src, dest);
+    }
 }
 
 // ATOMIC BEGIN
@@ -97,6 +124,7 @@ BillboardSet::BillboardSet(Context* context) :
     fixedScreenSize_(false),
     faceCameraMode_(FC_ROTATE_XYZ),
     minAngle_(0.0f),
+    sortThreshold_(0.0f),
     geometry_(new Geometry(context)),
     vertexBuffer_(new VertexBuffer(context_)),
     indexBuffer_(new IndexBuffer(context_)),
@@ -107,7 +135,10 @@ BillboardSet::BillboardSet(Context* context) :
     sortThisFrame_(false),
     hasOrthoCamera_(false),
     sortFrameNumber_(0),
-    previousOffset_(Vector3::ZERO)
+    previousOffset_(Vector3::ZERO),
+    numDrawnBillboards_(0),
+    dirtyStart_(M_MAX_UNSIGNED),
+    dirtyEnd_(0)
 {
     geometry_->SetVertexBuffer(0, vertexBuffer_);
     geometry_->SetIndexBuffer(indexBuffer_);
@@ -146,6 +177,7 @@ void BillboardSet::RegisterObject(Context* context)
                                                             billboardsStructureElementNames, AM_FILE);
     ATOMIC_ACCESSOR_ATTRIBUTE("Network Billboards", GetNetBillboardsAttr, SetNetBillboardsAttr, PODVector<unsigned char>,
         Variant::emptyBuffer, AM_NET | AM_NOEDIT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Sort Threshold", GetSortThreshold, SetSortThreshold, float, 0.0f, AM_DEFAULT);
 }
 
 void BillboardSet::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results)
@@ -205,10 +237,11 @@ void BillboardSet::UpdateBatches(const FrameInfo& frame)
 
     Vector3 worldPos = node_->GetWorldPosition();
     Vector3 offset = (worldPos - frame.camera_->GetNode()->GetWorldPosition());
-    // Sort if position relative to camera has changed
-    if (offset != previousOffset_ || frame.camera_->IsOrthographic() != hasOrthoCamera_)
+    bool orthoChanged = frame.camera_->IsOrthographic() != hasOrthoCamera_;
+    // Sort if position relative to camera has changed more than the threshold since the last sort
+    if (offset != previousOffset_ || orthoChanged)
     {
-        if (sorted_)
+        if (sorted_ && (orthoChanged || (offset - previousOffset_).LengthSquared() > sortThreshold_ * sortThreshold_))
             sortThisFrame_ = true;
         if (faceCameraMode_ == FC_DIRECTION)
             bufferDirty_ = true;
@@ -257,13 +290,18 @@ void BillboardSet::UpdateGeometry(const FrameInfo& frame)
 
     if (bufferDirty_ || sortThisFrame_ || vertexBuffer_->IsDataLost())
         UpdateVertexBuffer(frame);
+    else if (dirtyStart_ < dirtyEnd_ && !UpdateVertexRange())
+    {
+        bufferDirty_ = true;
+        UpdateVertexBuffer(frame);
+    }
 }
 
 UpdateGeometryType BillboardSet::GetUpdateGeometryType()
 {
     // If using camera facing, always need some kind of geometry update, in case the billboard set is rendered from several views
     if (bufferDirty_ || bufferSizeDirty_ || vertexBuffer_->IsDataLost() || indexBuffer_->IsDataLost() || sortThisFrame_ ||
-        faceCameraMode_ != FC_NONE || fixedScreenSize_)
+        dirtyStart_ < dirtyEnd_ || faceCameraMode_ != FC_NONE || fixedScreenSize_)
         return UPDATE_MAIN_THREAD;
     else
         return UPDATE_NONE;
@@ -327,6 +365,12 @@ void BillboardSet::SetSorted(bool enable)
     Commit();
 }
 
+void BillboardSet::SetSortThreshold(float distance)
+{
+    sortThreshold_ = Max(distance, 0.0f);
+    MarkNetworkUpdate();
+}
+
 void BillboardSet::SetFixedScreenSize(bool enable)
 {
     fixedScreenSize_ = enable;
@@ -371,6 +415,26 @@ void BillboardSet::Commit()
     MarkNetworkUpdate();
 }
 
+void BillboardSet::CommitRange(unsigned start, unsigned count)
+{
+    if (!count)
+        return;
+
+    // Rewriting in place needs a CPU-side copy of the vertices, which is only kept once ranges are committed. The first
+    // time, fall back to a full rewrite to fill it
+    if (!vertexBuffer_->IsShadowed())
+    {
+        vertexBuffer_->SetShadowed(true);
+        Commit();
+        return;
+    }
+
+    Drawable::OnMarkedDirty(node_);
+    dirtyStart_ = Min(dirtyStart_, start);
+    dirtyEnd_ = Max(dirtyEnd_, start + count);
+    MarkNetworkUpdate();
+}
+
 Material* BillboardSet::GetMaterial() const
 {
     return batches_[0].material_;
@@ -633,174 +697,259 @@ void BillboardSet::UpdateVertexBuffer(const FrameInfo& frame)
     const Matrix3x4& worldTransform = node_->GetWorldTransform();
     Matrix3x4 billboardTransform = relative_ ? worldTransform : Matrix3x4::IDENTITY;
     Vector3 billboardScale = scaled_ ? worldTransform.Scale() : Vector3::ONE;
+    float minDistance = M_INFINITY;
+    float maxDistance = 0.0f;
 
     // ATOMIC billboards_[i] . to ->
-    // First check number of enabled billboards
-    for (unsigned i = 0; i < numBillboards; ++i)
-    {
-        if (billboards_[i]->enabled_)
-            ++enabledBillboards;
-    }
-
-    sortedBillboards_.Resize(enabledBillboards);
-    unsigned index = 0;
-
-    // Then set initial sort order and distances
+    // Collect enabled billboards and set sort distances
+    sortedBillboards_.Resize(numBillboards);
     for (unsigned i = 0; i < numBillboards; ++i)
     {
         Billboard* billboard = billboards_[i];
         if (billboard->enabled_)
         {
-            sortedBillboards_[index++] = billboard;
+            sortedBillboards_[enabledBillboards++] = i;
             if (sorted_)
-                billboard->sortDistance_ = frame.camera_->GetDistanceSquared(billboardTransform * billboards_[i]->position_);
+            {
+                billboard->sortDistance_ = frame.camera_->GetDistanceSquared(billboardTransform * billboard->position_);
+                minDistance = Min(minDistance, billboard->sortDistance_);
+                maxDistance = Max(maxDistance, billboard->sortDistance_);
+            }
         }
     }
+    sortedBillboards_.Resize(enabledBillboards);
 
     batches_[0].geometry_->SetDrawRange(TRIANGLE_LIST, 0, enabledBillboards * 6, false);
 
     bufferDirty_ = false;
     forceUpdate_ = false;
+    numDrawnBillboards_ = enabledBillboards;
+    dirtyStart_ = M_MAX_UNSIGNED;
+    dirtyEnd_ = 0;
     if (!enabledBillboards)
         return;
 
     if (sorted_)
     {
-        Sort(sortedBillboards_.Begin(), sortedBillboards_.End(), CompareBillboards);
+        SortBillboards(minDistance, maxDistance);
         Vector3 worldPos = node_->GetWorldPosition();
         // Store the "last sorted position" now
         previousOffset_ = (worldPos - frame.camera_->GetNode()->GetWorldPosition());
     }
 
-    float* dest = (float*)vertexBuffer_->Lock(0, enabledBillboards * 4, true);
+    // If committed ranges are in use, write to the shadow data and upload it with discard, as unlocking a shadowed buffer
+    // would upload without discard. Remember where each billboard was written, so that the ranges can be rewritten in place
+    float* shadowData = 0;
+    if (vertexBuffer_->IsShadowed())
+    {
+        shadowData = (float*)vertexBuffer_->GetShadowData();
+        vertexSlots_.Resize(numBillboards);
+        for (unsigned i = 0; i < numBillboards; ++i)
+            vertexSlots_[i] = M_MAX_UNSIGNED;
+        for (unsigned i = 0; i < enabledBillboards; ++i)
+            vertexSlots_[sortedBillboards_[i]] = i;
+    }
+
+    float* dest = shadowData ? shadowData : (float*)vertexBuffer_->Lock(0, enabledBillboards * 4, true);
     if (!dest)
         return;
 
-    if (faceCameraMode_ != FC_DIRECTION)
+    unsigned floatsPerBillboard = vertexBuffer_->GetVertexSize() * 4 / sizeof(float);
+    for (unsigned i = 0; i < enabledBillboards; ++i)
     {
-        for (unsigned i = 0; i < enabledBillboards; ++i)
-        {
-            Billboard& billboard = *sortedBillboards_[i];
-
-            Vector2 size(billboard.size_.x_ * billboardScale.x_, billboard.size_.y_ * billboardScale.y_);
-            unsigned color = billboard.color_.ToUInt();
-            if (fixedScreenSize_)
-                size *= billboard.screenScaleFactor_;
-
-            float rotationMatrix[2][2];
-            SinCos(billboard.rotation_, rotationMatrix[0][1], rotationMatrix[0][0]);
-            rotationMatrix[1][0] = -rotationMatrix[0][1];
-            rotationMatrix[1][1] = rotationMatrix[0][0];
-
-            dest[0] = billboard.position_.x_;
-            dest[1] = billboard.position_.y_;
-            dest[2] = billboard.position_.z_;
-            ((unsigned&)dest[3]) = color;
-            dest[4] = billboard.uv_.min_.x_;
-            dest[5] = billboard.uv_.min_.y_;
-            dest[6] = -size.x_ * rotationMatrix[0][0] + size.y_ * rotationMatrix[0][1];
-            dest[7] = -size.x_ * rotationMatrix[1][0] + size.y_ * rotationMatrix[1][1];
-
-            dest[8] = billboard.position_.x_;
-            dest[9] = billboard.position_.y_;
-            dest[10] = billboard.position_.z_;
-            ((unsigned&)dest[11]) = color;
-            dest[12] = billboard.uv_.max_.x_;
-            dest[13] = billboard.uv_.min_.y_;
-            dest[14] = size.x_ * rotationMatrix[0][0] + size.y_ * rotationMatrix[0][1];
-            dest[15] = size.x_ * rotationMatrix[1][0] + size.y_ * rotationMatrix[1][1];
-
-            dest[16] = billboard.position_.x_;
-            dest[17] = billboard.position_.y_;
-            dest[18] = billboard.position_.z_;
-            ((unsigned&)dest[19]) = color;
-            dest[20] = billboard.uv_.max_.x_;
-            dest[21] = billboard.uv_.max_.y_;
-            dest[22] = size.x_ * rotationMatrix[0][0] - size.y_ * rotationMatrix[0][1];
-            dest[23] = size.x_ * rotationMatrix[1][0] - size.y_ * rotationMatrix[1][1];
-
-            dest[24] = billboard.position_.x_;
-            dest[25] = billboard.position_.y_;
-            dest[26] = billboard.position_.z_;
-            ((unsigned&)dest[27]) = color;
-            dest[28] = billboard.uv_.min_.x_;
-            dest[29] = billboard.uv_.max_.y_;
-            dest[30] = -size.x_ * rotationMatrix[0][0] - size.y_ * rotationMatrix[0][1];
-            dest[31] = -size.x_ * rotationMatrix[1][0] - size.y_ * rotationMatrix[1][1];
-
-            dest += 32;
-        }
+        WriteVertices(dest, *billboards_[sortedBillboards_[i]], billboardScale);
+        dest += floatsPerBillboard;
     }
+
+    if (shadowData)
+        vertexBuffer_->SetDataRange(shadowData, 0, enabledBillboards * 4, true);
     else
+        vertexBuffer_->Unlock();
+    vertexBuffer_->ClearDataLost();
+}
+
+bool BillboardSet::UpdateVertexRange()
+{
+    unsigned start = dirtyStart_;
+    unsigned end = Min(dirtyEnd_, billboards_.Size());
+    dirtyStart_ = M_MAX_UNSIGNED;
+    dirtyEnd_ = 0;
+
+    float* shadowData = (float*)vertexBuffer_->GetShadowData();
+    if (!shadowData || vertexSlots_.Size() != billboards_.Size())
+        return false;
+
+    const Matrix3x4& worldTransform = node_->GetWorldTransform();
+    Vector3 billboardScale = scaled_ ? worldTransform.Scale() : Vector3::ONE;
+    unsigned floatsPerBillboard = vertexBuffer_->GetVertexSize() * 4 / sizeof(float);
+
+    // If sorted, the previous drawing order is reused until the next full rewrite
+    for (unsigned i = start; i < end; ++i)
     {
-        for (unsigned i = 0; i < enabledBillboards; ++i)
-        {
-            Billboard& billboard = *sortedBillboards_[i];
-
-            Vector2 size(billboard.size_.x_ * billboardScale.x_, billboard.size_.y_ * billboardScale.y_);
-            unsigned color = billboard.color_.ToUInt();
-            if (fixedScreenSize_)
-                size *= billboard.screenScaleFactor_;
-
-            float rot2D[2][2];
-            SinCos(billboard.rotation_, rot2D[0][1], rot2D[0][0]);
-            rot2D[1][0] = -rot2D[0][1];
-            rot2D[1][1] = rot2D[0][0];
-
-            dest[0] = billboard.position_.x_;
-            dest[1] = billboard.position_.y_;
-            dest[2] = billboard.position_.z_;
-            dest[3] = billboard.direction_.x_;
-            dest[4] = billboard.direction_.y_;
-            dest[5] = billboard.direction_.z_;
-            ((unsigned&)dest[6]) = color;
-            dest[7] = billboard.uv_.min_.x_;
-            dest[8] = billboard.uv_.min_.y_;
-            dest[9] = -size.x_ * rot2D[0][0] + size.y_ * rot2D[0][1];
-            dest[10] = -size.x_ * rot2D[1][0] + size.y_ * rot2D[1][1];
-
-            dest[11] = billboard.position_.x_;
-            dest[12] = billboard.position_.y_;
-            dest[13] = billboard.position_.z_;
-            dest[14] = billboard.direction_.x_;
-            dest[15] = billboard.direction_.y_;
-            dest[16] = billboard.direction_.z_;
-            ((unsigned&)dest[17]) = color;
-            dest[18] = billboard.uv_.max_.x_;
-            dest[19] = billboard.uv_.min_.y_;
-            dest[20] = size.x_ * rot2D[0][0] + size.y_ * rot2D[0][1];
-            dest[21] = size.x_ * rot2D[1][0] + size.y_ * rot2D[1][1];
-
-            dest[22] = billboard.position_.x_;
-            dest[23] = billboard.position_.y_;
-            dest[24] = billboard.position_.z_;
-            dest[25] = billboard.direction_.x_;
-            dest[26] = billboard.direction_.y_;
-            dest[27] = billboard.direction_.z_;
-            ((unsigned&)dest[28]) = color;
-            dest[29] = billboard.uv_.max_.x_;
-            dest[30] = billboard.uv_.max_.y_;
-            dest[31] = size.x_ * rot2D[0][0] - size.y_ * rot2D[0][1];
-            dest[32] = size.x_ * rot2D[1][0] - size.y_ * rot2D[1][1];
-
-            dest[33] = billboard.position_.x_;
-            dest[34] = billboard.position_.y_;
-            dest[35] = billboard.position_.z_;
-            dest[36] = billboard.direction_.x_;
-            dest[37] = billboard.direction_.y_;
-            dest[38] = billboard.direction_.z_;
-            ((unsigned&)dest[39]) = color;
-            dest[40] = billboard.uv_.min_.x_;
-            dest[41] = billboard.uv_.max_.y_;
-            dest[42] = -size.x_ * rot2D[0][0] - size.y_ * rot2D[0][1];
-            dest[43] = -size.x_ * rot2D[1][0] - size.y_ * rot2D[1][1];
-
-            dest += 44;
-        }
+        const Billboard& billboard = *billboards_[i];
+        unsigned slot = vertexSlots_[i];
+        if (billboard.enabled_ != (slot != M_MAX_UNSIGNED))
+            return false;
+        if (slot != M_MAX_UNSIGNED)
+            WriteVertices(shadowData + slot * floatsPerBillboard, billboard, billboardScale);
     }
 
-    vertexBuffer_->Unlock();
-    vertexBuffer_->ClearDataLost();
+    if (numDrawnBillboards_)
+        vertexBuffer_->SetDataRange(shadowData, 0, numDrawnBillboards_ * 4, true);
+    return true;
+}
+
+void BillboardSet::SortBillboards(float minDistance, float maxDistance)
+{
+    // Quantize the view distance to 16 bits, inverted so that the farthest billboard comes first. The billboard index fits
+    // in the lower 16 bits, as the billboard count is limited to MAX_BILLBOARDS
+    unsigned numSorted = sortedBillboards_.Size();
+    float minViewDistance = sqrtf(minDistance);
+    float maxViewDistance = sqrtf(maxDistance);
+    float scale = maxViewDistance > minViewDistance ? 65535.0f / (maxViewDistance - minViewDistance) : 0.0f;
+
+    sortKeys_.Resize(numSorted);
+    sortTemp_.Resize(numSorted);
+    for (unsigned i = 0; i < numSorted; ++i)
+    {
+        unsigned index = sortedBillboards_[i];
+        float key = (maxViewDistance - sqrtf(billboards_[index]->sortDistance_)) * scale;
+        sortKeys_[i] = ((unsigned)Clamp(key, 0.0f, 65535.0f) << 16) | index;
+    }
+
+    RadixSort16(&sortKeys_[0], &sortTemp_[0], numSorted);
+
+    for (unsigned i = 0; i < numSorted; ++i)
+        sortedBillboards_[i] = sortKeys_[i] & 0xffff;
+}
+
+void BillboardSet::WriteVertices(float* dest, const Billboard& billboard, const Vector3& billboardScale) const
+{
+    Vector2 size(billboard.size_.x_ * billboardScale.x_, billboard.size_.y_ * billboardScale.y_);
+    unsigned color = billboard.color_.ToUInt();
+    if (fixedScreenSize_)
+        size *= billboard.screenScaleFactor_;
+
+    float rotationMatrix[2][2];
+    SinCos(billboard.rotation_, rotationMatrix[0][1], rotationMatrix[0][0]);
+    rotationMatrix[1][0] = -rotationMatrix[0][1];
+    rotationMatrix[1][1] = rotationMatrix[0][0];
+
+    if (faceCameraMode_ != FC_DIRECTION)
+    {
+#ifdef ATOMIC_SSE
+        // Each vertex is position & color followed by UV & corner offset. The corner offsets are combinations of the
+        // rotated size axes a and b: -a + b, a + b, a - b and -a - b
+        float posColor[4] = { billboard.position_.x_, billboard.position_.y_, billboard.position_.z_, 0.0f };
+        ((unsigned&)posColor[3]) = color;
+        __m128 positionColor = _mm_loadu_ps(posColor);
+        float ax = size.x_ * rotationMatrix[0][0];
+        float ay = size.x_ * rotationMatrix[1][0];
+        float bx = size.y_ * rotationMatrix[0][1];
+        float by = size.y_ * rotationMatrix[1][1];
+        __m128 a = _mm_setr_ps(ax, ay, ax, ay);
+        __m128 b = _mm_setr_ps(bx, by, bx, by);
+        __m128 offsets01 = _mm_add_ps(_mm_mul_ps(a, _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f)), b);
+        __m128 offsets23 = _mm_sub_ps(_mm_mul_ps(a, _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f)), b);
+        __m128 uv01 = _mm_setr_ps(billboard.uv_.min_.x_, billboard.uv_.min_.y_, billboard.uv_.max_.x_, billboard.uv_.min_.y_);
+        __m128 uv23 = _mm_setr_ps(billboard.uv_.max_.x_, billboard.uv_.max_.y_, billboard.uv_.min_.x_, billboard.uv_.max_.y_);
+
+        _mm_storeu_ps(dest, positionColor);
+        _mm_storeu_ps(dest + 4, _mm_movelh_ps(uv01, offsets01));
+        _mm_storeu_ps(dest + 8, positionColor);
+        _mm_storeu_ps(dest + 12, _mm_movehl_ps(offsets01, uv01));
+        _mm_storeu_ps(dest + 16, positionColor);
+        _mm_storeu_ps(dest + 20, _mm_movelh_ps(uv23, offsets23));
+        _mm_storeu_ps(dest + 24, positionColor);
+        _mm_storeu_ps(dest + 28, _mm_movehl_ps(offsets23, uv23));
+#else
+        dest[0] = billboard.position_.x_;
+        dest[1] = billboard.position_.y_;
+        dest[2] = billboard.position_.z_;
+        ((unsigned&)dest[3]) = color;
+        dest[4] = billboard.uv_.min_.x_;
+        dest[5] = billboard.uv_.min_.y_;
+        dest[6] = -size.x_ * rotationMatrix[0][0] + size.y_ * rotationMatrix[0][1];
+        dest[7] = -size.x_ * rotationMatrix[1][0] + size.y_ * rotationMatrix[1][1];
+
+        dest[8] = billboard.position_.x_;
+        dest[9] = billboard.position_.y_;
+        dest[10] = billboard.position_.z_;
+        ((unsigned&)dest[11]) = color;
+        dest[12] = billboard.uv_.max_.x_;
+        dest[13] = billboard.uv_.min_.y_;
+        dest[14] = size.x_ * rotationMatrix[0][0] + size.y_ * rotationMatrix[0][1];
+        dest[15] = size.x_ * rotationMatrix[1][0] + size.y_ * rotationMatrix[1][1];
+
+        dest[16] = billboard.position_.x_;
+        dest[17] = billboard.position_.y_;
+        dest[18] = billboard.position_.z_;
+        ((unsigned&)dest[19]) = color;
+        dest[20] = billboard.uv_.max_.x_;
+        dest[21] = billboard.uv_.max_.y_;
+        dest[22] = size.x_ * rotationMatrix[0][0] - size.y_ * rotationMatrix[0][1];
+        dest[23] = size.x_ * rotationMatrix[1][0] - size.y_ * rotationMatrix[1][1];
+
+        dest[24] = billboard.position_.x_;
+        dest[25] = billboard.position_.y_;
+        dest[26] = billboard.position_.z_;
+        ((unsigned&)dest[27]) = color;
+        dest[28] = billboard.uv_.min_.x_;
+        dest[29] = billboard.uv_.max_.y_;
+        dest[30] = -size.x_ * rotationMatrix[0][0] - size.y_ * rotationMatrix[0][1];
+        dest[31] = -size.x_ * rotationMatrix[1][0] - size.y_ * rotationMatrix[1][1];
+#endif
+    }
+    else
+    {
+        dest[0] = billboard.position_.x_;
+        dest[1] = billboard.position_.y_;
+        dest[2] = billboard.position_.z_;
+        dest[3] = billboard.direction_.x_;
+        dest[4] = billboard.direction_.y_;
+        dest[5] = billboard.direction_.z_;
+        ((unsigned&)dest[6]) = color;
+        dest[7] = billboard.uv_.min_.x_;
+        dest[8] = billboard.uv_.min_.y_;
+        dest[9] = -size.x_ * rotationMatrix[0][0] + size.y_ * rotationMatrix[0][1];
+        dest[10] = -size.x_ * rotationMatrix[1][0] + size.y_ * rotationMatrix[1][1];
+
+        dest[11] = billboard.position_.x_;
+        dest[12] = billboard.position_.y_;
+        dest[13] = billboard.position_.z_;
+        dest[14] = billboard.direction_.x_;
+        dest[15] = billboard.direction_.y_;
+        dest[16] = billboard.direction_.z_;
+        ((unsigned&)dest[17]) = color;
+        dest[18] = billboard.uv_.max_.x_;
+        dest[19] = billboard.uv_.min_.y_;
+        dest[20] = size.x_ * rotationMatrix[0][0] + size.y_ * rotationMatrix[0][1];
+        dest[21] = size.x_ * rotationMatrix[1][0] + size.y_ * rotationMatrix[1][1];
+
+        dest[22] = billboard.position_.x_;
+        dest[23] = billboard.position_.y_;
+        dest[24] = billboard.position_.z_;
+        dest[25] = billboard.direction_.x_;
+        dest[26] = billboard.direction_.y_;
+        dest[27] = billboard.direction_.z_;
+        ((unsigned&)dest[28]) = color;
+        dest[29] = billboard.uv_.max_.x_;
+        dest[30] = billboard.uv_.max_.y_;
+        dest[31] = size.x_ * rotationMatrix[0][0] - size.y_ * rotationMatrix[0][1];
+        dest[32] = size.x_ * rotationMatrix[1][0] - size.y_ * rotationMatrix[1][1];
+
+        dest[33] = billboard.position_.x_;
+        dest[34] = billboard.position_.y_;
+        dest[35] = billboard.position_.z_;
+        dest[36] = billboard.direction_.x_;
+        dest[37] = billboard.direction_.y_;
+        dest[38] = billboard.direction_.z_;
+        ((unsigned&)dest[39]) = color;
+        dest[40] = billboard.uv_.min_.x_;
+        dest[41] = billboard.uv_.max_.y_;
+        dest[42] = -size.x_ * rotationMatrix[0][0] - size.y_ * rotationMatrix[0][1];
+        dest[43] = -size.x_ * rotationMatrix[1][0] - size.y_ * rotationMatrix[1][1];
+    }
 }
 
 void BillboardSet::MarkPositionsDirty()
@@ -128,6 +128,8 @@ public:
     void SetScaled(bool enable);
     /// Set whether billboards are sorted by distance. Default false.
     void SetSorted(bool enable);
+    /// Set how far the camera may move relative to the billboard set before the billboards are sorted again. Default 0 sorts on any movement.
+    void SetSortThreshold(float distance);
     /// Set whether billboards have fixed size on screen (measured in pixels) regardless of distance to camera. Default false.
     void SetFixedScreenSize(bool enable);
     /// Set how the billboards should rotate in relation to the camera. Default is to follow camera rotation on all axes (FC_ROTATE_XYZ.)
@@ -138,6 +140,8 @@ public:
     void SetAnimationLodBias(float bias);
     /// Mark for bounding box and vertex buffer update. Call after modifying the billboards.
     void Commit();
+    /// Mark a range of billboards for bounding box and vertex buffer update. Only the vertices of those billboards are rewritten, unless their enabled state changed. The first call enables vertex buffer shadowing.
+    void CommitRange(unsigned start, unsigned count);
 
     /// Return material.
     Material* GetMaterial() const;
@@ -162,6 +166,9 @@ public:
     /// Return whether billboards are sorted.
     bool IsSorted() const { return sorted_; }
 
+    /// Return camera movement threshold for sorting the billboards again.
+    float GetSortThreshold() const { return sortThreshold_; }
+
     /// Return whether billboards are fixed screen size.
     bool IsFixedScreenSize() const { return fixedScreenSize_; }
 
@@ -213,12 +220,20 @@ protected:
     FaceCameraMode faceCameraMode_;
     /// Minimal angle between billboard normal and look-at direction.
     float minAngle_;
+    /// Camera movement threshold for sorting the billboards again.
+    float sortThreshold_;
 
 private:
     /// Resize billboard vertex and index buffers.
     void UpdateBufferSize();
     /// Rewrite billboard vertex buffer.
     void UpdateVertexBuffer(const FrameInfo& frame);
+    /// Rewrite the vertices of the committed billboard range in place. Return false if the enabled billboards changed and a full rewrite is needed.
+    bool UpdateVertexRange();
+    /// Sort the enabled billboards back to front by quantized view distance.
+    void SortBillboards(float minDistance, float maxDistance);
+    /// Write the four vertices of a billboard.
+    void WriteVertices(float* dest, const Billboard& billboard, const Vector3& billboardScale) const;
     /// Calculate billboard scale factors in fixed screen size mode.
     void CalculateFixedScreenSize(const FrameInfo& frame);
 
@@ -246,8 +261,20 @@ private:
     unsigned sortFrameNumber_;
     /// Previous offset to camera for determining whether sorting is necessary.
     Vector3 previousOffset_;
-    /// Billboard pointers for sorting.
-    Vector<Billboard*> sortedBillboards_;
+    /// Indices of the enabled billboards in drawing order.
+    PODVector<unsigned> sortedBillboards_;
+    /// Sort keys combined with billboard indices.
+    PODVector<unsigned> sortKeys_;
+    /// Temporary buffer for sorting.
+    PODVector<unsigned> sortTemp_;
+    /// Position of each billboard in the vertex buffer, or M_MAX_UNSIGNED if not drawn.
+    PODVector<unsigned> vertexSlots_;
+    /// Number of billboards written to the vertex buffer.
+    unsigned numDrawnBillboards_;
+    /// First billboard of the committed range.
+    unsigned dirtyStart_;
+    /// Last billboard of the committed range, exclusive.
+    unsigned dirtyEnd_;
     /// Attribute buffer for network replication.
     mutable VectorBuffer attrBuffer_;
 };
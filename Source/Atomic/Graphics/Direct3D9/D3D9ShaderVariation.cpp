@@ -76,34 +76,19 @@ void ShaderVariation::OnDeviceLost()
 
 bool ShaderVariation::Create()
 {
-    Release();
+    MutexLock lock(byteCodeMutex_);
 
-    if (!graphics_)
-        return false;
-
-    if (!owner_)
+    // Use bytecode from Precompile() if available
+    if (!byteCodePrepared_)
     {
-        compilerOutput_ = "Owner shader has expired";
-        return false;
-    }
+        Release();
 
-    // Check for up-to-date bytecode on disk
-    String path, name, extension;
-    SplitPath(owner_->GetName(), path, name, extension);
-    extension = type_ == VS ? ".vs3" : ".ps3";
-
-    String binaryShaderName = graphics_->GetShaderCacheDir() + name + "_" + StringHash(defines_).ToString() + extension;
-
-    if (!LoadByteCode(binaryShaderName))
-    {
-        // Compile shader if don't have valid bytecode
-        if (!Compile())
+        if (!PrepareByteCode())
             return false;
-        // Save the bytecode after successful compile, but not if the source is from a package
-        if (owner_->GetTimeStamp())
-            SaveByteCode(binaryShaderName);
     }
 
+    byteCodePrepared_ = false;
+
     // Then create shader from the bytecode
     IDirect3DDevice9* device = graphics_->GetImpl()->GetDevice();
     if (type_ == VS)
@@ -136,6 +121,47 @@ bool ShaderVariation::Create()
     return object_.ptr_ != 0;
 }
 
+bool ShaderVariation::Precompile()
+{
+    MutexLock lock(byteCodeMutex_);
+
+    if (object_.ptr_ || byteCodePrepared_)
+        return true;
+
+    byteCodePrepared_ = PrepareByteCode();
+    return byteCodePrepared_;
+}
+
+bool ShaderVariation::PrepareByteCode()
+{
+    if (!graphics_)
+        return false;
+
+    if (!owner_)
+    {
+        compilerOutput_ = "Owner shader has expired";
+        return false;
+    }
+
+    // Check for bytecode on disk. The name includes the source code hash, so cached bytecode can not be out of date
+    String path, name, extension;
+    SplitPath(owner_->GetName(), path, name, extension);
+    extension = type_ == VS ? ".vs3" : ".ps3";
+
+    String binaryShaderName = graphics_->GetShaderCacheDir() + name + "_" + StringHash(defines_).ToString() + "_" +
+        StringHash(owner_->GetSourceHash()).ToString() + extension;
+
+    if (!LoadByteCode(binaryShaderName))
+    {
+        // Compile shader if don't have valid bytecode
+        if (!Compile())
+            return false;
+        SaveByteCode(binaryShaderName);
+    }
+
+    return true;
+}
+
 void ShaderVariation::Release()
 {
     if (object_.ptr_ && graphics_)
@@ -174,13 +200,6 @@ bool ShaderVariation::LoadByteCode(const String& binaryShaderName)
     if (!cache->Exists(binaryShaderName))
         return false;
 
-    FileSystem* fileSystem = owner_->GetSubsystem<FileSystem>();
-    unsigned sourceTimeStamp = owner_->GetTimeStamp();
-    // If source code is loaded from a package, its timestamp will be zero. Else check that binary is not older
-    // than source
-    if (sourceTimeStamp && fileSystem->GetLastModifiedTime(cache->GetResourceFileName(binaryShaderName)) < sourceTimeStamp)
-        return false;
-
     SharedPtr<File> file = cache->GetFile(binaryShaderName);
     if (!file || file->ReadFileID() != "USHD")
     {
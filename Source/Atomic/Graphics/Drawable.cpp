@@ -94,6 +94,7 @@ Drawable::Drawable(Context* context, unsigned char drawableFlags) :
     occludee_(true),
     updateQueued_(false),
     zoneDirty_(false),
+    lodScreenSize_(false),
     octant_(0),
     zone_(0),
     viewMask_(DEFAULT_VIEWMASK),
@@ -174,7 +175,7 @@ void Drawable::UpdateBatches(const FrameInfo& frame)
     }
 
     float scale = worldBoundingBox.Size().DotProduct(DOT_SCALE);
-    float newLodDistance = frame.camera_->GetLodDistance(distance_, scale, lodBias_);
+    float newLodDistance = CalculateLodDistance(frame, scale);
 
     if (newLodDistance != lodDistance_)
         lodDistance_ = newLodDistance;
@@ -200,6 +201,21 @@ void Drawable::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
         debug->AddBoundingBox(GetWorldBoundingBox(), Color::GREEN, depthTest);
 }
 
+float Drawable::CalculateLodDistance(const FrameInfo& frame, float scale) const
+{
+    float lodDistance = frame.camera_->GetLodDistance(distance_, scale, lodBias_);
+
+    // Projected size is inversely proportional to the view's tangent of half field of view and proportional to its height,
+    // so scale the distance to what gives the same projected size in the reference view
+    if (lodScreenSize_ && !frame.camera_->IsOrthographic() && frame.viewSize_.y_ > 0)
+    {
+        lodDistance *= tanf(frame.camera_->GetFov() * M_DEGTORAD_2) / LOD_REFERENCE_TAN_HALF_FOV *
+            LOD_REFERENCE_VIEW_HEIGHT / (float)frame.viewSize_.y_;
+    }
+
+    return lodDistance;
+}
+
 void Drawable::SetDrawDistance(float distance)
 {
     drawDistance_ = distance;
@@ -218,9 +234,18 @@ void Drawable::SetLodBias(float bias)
     MarkNetworkUpdate();
 }
 
+void Drawable::SetLodScreenSize(bool enable)
+{
+    lodScreenSize_ = enable;
+    MarkNetworkUpdate();
+}
+
 void Drawable::SetViewMask(unsigned mask)
 {
     viewMask_ = mask;
+    // Cached octree query results filter by view mask
+    if (octant_)
+        octant_->MarkModified();
     MarkNetworkUpdate();
 }
 
@@ -253,6 +278,9 @@ void Drawable::SetMaxLights(unsigned num)
 void Drawable::SetCastShadows(bool enable)
 {
     castShadows_ = enable;
+    // Cached shadow caster query results filter by the shadow casting flag
+    if (octant_)
+        octant_->MarkModified();
     MarkNetworkUpdate();
 }
 
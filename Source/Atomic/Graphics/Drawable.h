@@ -43,6 +43,8 @@ static const unsigned DEFAULT_SHADOWMASK = M_MAX_UNSIGNED;
 static const unsigned DEFAULT_ZONEMASK = M_MAX_UNSIGNED;
 static const int MAX_VERTEX_LIGHTS = 4;
 static const float ANIMATION_LOD_BASESCALE = 2500.0f;
+static const float LOD_REFERENCE_VIEW_HEIGHT = 1080.0f;
+static const float LOD_REFERENCE_TAN_HALF_FOV = 0.57735f;
 
 class Camera;
 class File;
@@ -156,6 +158,8 @@ public:
     void SetShadowDistance(float distance);
     /// Set LOD bias.
     void SetLodBias(float bias);
+    /// Set whether to choose LOD levels by projected screen size instead of distance. LOD distances are then used as if rendering at 1080 pixels high with 60 degree field of view.
+    void SetLodScreenSize(bool enable);
     /// Set view mask. Is and'ed with camera's view mask to see if the object should be rendered.
     void SetViewMask(unsigned mask);
     /// Set light mask. Is and'ed with light's and zone's light mask to see if the object should be lit.
@@ -193,6 +197,9 @@ public:
     /// Return LOD bias.
     float GetLodBias() const { return lodBias_; }
 
+    /// Return whether chooses LOD levels by projected screen size.
+    bool GetLodScreenSize() const { return lodScreenSize_; }
+
     /// Return view mask.
     unsigned GetViewMask() const { return viewMask_; }
 
@@ -326,6 +333,8 @@ protected:
 
     /// Move into another octree octant.
     void SetOctant(Octant* octant) { octant_ = octant; }
+    /// Return LOD distance for the current view and a LOD scale, adjusted for field of view and resolution when choosing LOD levels by screen size.
+    float CalculateLodDistance(const FrameInfo& frame, float scale) const;
 
     /// World-space bounding box.
     BoundingBox worldBoundingBox_;
@@ -347,6 +356,8 @@ protected:
     bool updateQueued_;
     /// Zone inconclusive or dirtied flag.
     bool zoneDirty_;
+    /// LOD by projected screen size flag.
+    bool lodScreenSize_;
     /// Octree octant.
     Octant* octant_;
     /// Current zone.
@@ -44,6 +44,7 @@
 #include "../Graphics/Technique.h"
 #include "../Graphics/Terrain.h"
 #include "../Graphics/TerrainPatch.h"
+#include "../Graphics/TerrainStreamer.h"
 #include "../Graphics/Texture2D.h"
 #include "../Graphics/Texture2DArray.h"
 #include "../Graphics/Texture3D.h"
@@ -256,11 +257,25 @@ void Graphics::EndDumpShaders()
     shaderPrecache_.Reset();
 }
 
-void Graphics::PrecacheShaders(Deserializer& source)
+void Graphics::PrecacheShaders(Deserializer& source, int maxMsPerFrame, unsigned maxThreads)
 {
     ATOMIC_PROFILE(PrecacheShaders);
 
-    ShaderPrecache::LoadShaders(this, source);
+    if (!maxMsPerFrame)
+    {
+        ShaderPrecache::LoadShaders(this, source, maxThreads);
+        return;
+    }
+
+    shaderPrecompiler_ = new ShaderPrecompiler(context_);
+    shaderPrecompiler_->SetMaxThreads(maxThreads);
+    shaderPrecompiler_->Load(source);
+    shaderPrecompiler_->StartBackground(maxMsPerFrame);
+}
+
+bool Graphics::IsPrecachingShaders() const
+{
+    return shaderPrecompiler_ && !shaderPrecompiler_->IsFinished();
 }
 
 void Graphics::SetShaderCacheDir(const String& path)
@@ -401,6 +416,7 @@ void RegisterGraphicsLibrary(Context* context)
     DecalSet::RegisterObject(context);
     Terrain::RegisterObject(context);
     TerrainPatch::RegisterObject(context);
+    TerrainStreamer::RegisterObject(context);
     DebugRenderer::RegisterObject(context);
     Octree::RegisterObject(context);
     Zone::RegisterObject(context);
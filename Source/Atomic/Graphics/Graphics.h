@@ -47,6 +47,7 @@ class GraphicsImpl;
 class RenderSurface;
 class Shader;
 class ShaderPrecache;
+class ShaderPrecompiler;
 class ShaderProgram;
 class ShaderVariation;
 class Texture;
@@ -247,9 +248,9 @@ public:
     void BeginDumpShaders(const String& fileName);
     /// End dumping shader variations names.
     void EndDumpShaders();
-    /// Precache shader variations from an XML file generated with BeginDumpShaders().
-    void PrecacheShaders(Deserializer& source);
-    /// Set shader cache directory, Direct3D only. This can either be an absolute path or a path within the resource system.
+    /// Precache shader variations from an XML file generated with BeginDumpShaders(). Bytecode is compiled in at most maxThreads worker threads, zero for all. With a nonzero time budget, returns immediately and creates the shaders within the budget over the following frames.
+    void PrecacheShaders(Deserializer& source, int maxMsPerFrame = 0, unsigned maxThreads = 0);
+    /// Set shader cache directory for Direct3D bytecode and OpenGL program binaries. This can either be an absolute path or a path within the resource system.
     void SetShaderCacheDir(const String& path);
 
     /// Return whether rendering initialized.
@@ -480,9 +481,12 @@ public:
     /// Return whether a custom clipping plane is in use.
     bool GetUseClipPlane() const { return useClipPlane_; }
 
-    /// Return shader cache directory, Direct3D only.
+    /// Return shader cache directory.
     const String& GetShaderCacheDir() const { return shaderCacheDir_; }
 
+    /// Return whether shaders are being precached in the background.
+    bool IsPrecachingShaders() const;
+
     /// Return current rendertarget width and height.
     IntVector2 GetRenderTargetDimensions() const;
 
@@ -803,6 +807,8 @@ private:
     mutable String lastShaderName_;
     /// Shader precache utility.
     SharedPtr<ShaderPrecache> shaderPrecache_;
+    /// Background shader precompiler.
+    SharedPtr<ShaderPrecompiler> shaderPrecompiler_;
     /// Allowed screen orientations.
     String orientations_;
     /// Graphics API name.
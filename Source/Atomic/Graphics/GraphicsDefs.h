@@ -58,9 +58,10 @@ enum GeometryType
     GEOM_DIRBILLBOARD = 4,
     GEOM_TRAIL_FACE_CAMERA = 5,
     GEOM_TRAIL_BONE = 6,
-    MAX_GEOMETRYTYPES = 7,
+    GEOM_SKINNED_DUALQUATERNION = 7,
+    MAX_GEOMETRYTYPES = 8,
     // This is not a real geometry type for VS, but used to mark objects that do not desire to be instanced
-    GEOM_STATIC_NOINSTANCING = 7,
+    GEOM_STATIC_NOINSTANCING = 8,
 };
 
 /// Blending mode.
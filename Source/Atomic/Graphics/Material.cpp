@@ -209,11 +209,13 @@ Material::Material(Context* context) :
     Resource(context),
     auxViewFrameNumber_(0),
     shaderParameterHash_(0),
+    stateHash_(0),
     alphaToCoverage_(false),
     lineAntiAlias_(false),
     occlusion_(true),
     specular_(false),
     subscribed_(false),
+    stateHashDirty_(true),
     batchedParameterUpdate_(false)
 {
     ResetToDefaults();
@@ -292,6 +294,11 @@ bool Material::EndLoad()
 
     loadXMLFile_.Reset();
     loadJSONFile_.Reset();
+
+    // Deduplicate the render state now, so that identical materials batch together from the first frame
+    if (success)
+        GetSharedState();
+
     return success;
 }
 
@@ -946,6 +953,7 @@ void Material::SetNumTechniques(unsigned num)
         return;
 
     techniques_.Resize(num);
+    stateHashDirty_ = true;
     RefreshMemoryUse();
 }
 
@@ -1063,6 +1071,7 @@ void Material::SetTexture(TextureUnit unit, Texture* texture)
             textures_[unit] = texture;
         else
             textures_.Erase(unit);
+        stateHashDirty_ = true;
     }
 }
 
@@ -1100,42 +1109,50 @@ void Material::SetUVTransform(const Vector2& offset, float rotation, float repea
 void Material::SetCullMode(CullMode mode)
 {
     cullMode_ = mode;
+    stateHashDirty_ = true;
 }
 
 void Material::SetShadowCullMode(CullMode mode)
 {
     shadowCullMode_ = mode;
+    stateHashDirty_ = true;
 }
 
 void Material::SetFillMode(FillMode mode)
 {
     fillMode_ = mode;
+    stateHashDirty_ = true;
 }
 
 void Material::SetDepthBias(const BiasParameters& parameters)
 {
     depthBias_ = parameters;
     depthBias_.Validate();
+    stateHashDirty_ = true;
 }
 
 void Material::SetAlphaToCoverage(bool enable)
 {
     alphaToCoverage_ = enable;
+    stateHashDirty_ = true;
 }
 
 void Material::SetLineAntiAlias(bool enable)
 {
     lineAntiAlias_ = enable;
+    stateHashDirty_ = true;
 }
 
 void Material::SetRenderOrder(unsigned char order)
 {
     renderOrder_ = order;
+    stateHashDirty_ = true;
 }
 
 void Material::SetOcclusion(bool enable)
 {
     occlusion_ = enable;
+    stateHashDirty_ = true;
 }
 
 void Material::SetScene(Scene* scene)
@@ -1197,6 +1214,7 @@ SharedPtr<Material> Material::Clone(const String& cloneName) const
 void Material::SortTechniques()
 {
     Sort(techniques_.Begin(), techniques_.End(), CompareTechniqueEntries);
+    stateHashDirty_ = true;
 }
 
 void Material::MarkForAuxView(unsigned frameNumber)
@@ -1255,6 +1273,77 @@ Scene* Material::GetScene() const
     return scene_;
 }
 
+unsigned Material::GetStateHash() const
+{
+    if (stateHashDirty_)
+        RefreshStateHash();
+
+    return stateHash_;
+}
+
+bool Material::HasSameState(const Material* rhs) const
+{
+    if (!rhs)
+        return false;
+    if (rhs == this)
+        return true;
+
+    if (techniques_.Size() != rhs->techniques_.Size() || textures_.Size() != rhs->textures_.Size() ||
+        shaderParameters_.Size() != rhs->shaderParameters_.Size() || shaderParameterHash_ != rhs->shaderParameterHash_)
+        return false;
+
+    if (cullMode_ != rhs->cullMode_ || shadowCullMode_ != rhs->shadowCullMode_ || fillMode_ != rhs->fillMode_ ||
+        depthBias_.constantBias_ != rhs->depthBias_.constantBias_ ||
+        depthBias_.slopeScaledBias_ != rhs->depthBias_.slopeScaledBias_ ||
+        depthBias_.normalOffset_ != rhs->depthBias_.normalOffset_ || renderOrder_ != rhs->renderOrder_ ||
+        alphaToCoverage_ != rhs->alphaToCoverage_ || lineAntiAlias_ != rhs->lineAntiAlias_ || occlusion_ != rhs->occlusion_)
+        return false;
+
+    if (vertexShaderDefines_ != rhs->vertexShaderDefines_ || pixelShaderDefines_ != rhs->pixelShaderDefines_)
+        return false;
+
+    for (unsigned i = 0; i < techniques_.Size(); ++i)
+    {
+        const TechniqueEntry& entry = techniques_[i];
+        const TechniqueEntry& rhsEntry = rhs->techniques_[i];
+        if (entry.technique_ != rhsEntry.technique_ || entry.qualityLevel_ != rhsEntry.qualityLevel_ ||
+            entry.lodDistance_ != rhsEntry.lodDistance_)
+            return false;
+    }
+
+    for (HashMap<TextureUnit, SharedPtr<Texture> >::ConstIterator i = textures_.Begin(); i != textures_.End(); ++i)
+    {
+        HashMap<TextureUnit, SharedPtr<Texture> >::ConstIterator j = rhs->textures_.Find(i->first_);
+        if (j == rhs->textures_.End() || j->second_ != i->second_)
+            return false;
+    }
+
+    for (HashMap<StringHash, MaterialShaderParameter>::ConstIterator i = shaderParameters_.Begin();
+         i != shaderParameters_.End(); ++i)
+    {
+        HashMap<StringHash, MaterialShaderParameter>::ConstIterator j = rhs->shaderParameters_.Find(i->first_);
+        if (j == rhs->shaderParameters_.End() || j->second_.value_ != i->second_.value_)
+            return false;
+    }
+
+    return true;
+}
+
+Material* Material::GetSharedState()
+{
+    // Animated shader parameters change every frame, so such materials are never shared
+    if (shaderParameterAnimationInfos_.Size())
+        return this;
+
+    unsigned hash = GetStateHash();
+    if (sharedState_ && sharedState_->GetStateHash() == hash)
+        return sharedState_;
+
+    Renderer* renderer = GetSubsystem<Renderer>();
+    sharedState_ = renderer ? renderer->GetSharedMaterial(this) : this;
+    return sharedState_;
+}
+
 String Material::GetTextureUnitName(TextureUnit unit)
 {
     return textureUnitNames[unit];
@@ -1323,6 +1412,45 @@ void Material::RefreshShaderParameterHash()
     unsigned dataSize = temp.GetSize();
     for (unsigned i = 0; i < dataSize; ++i)
         shaderParameterHash_ = SDBMHash(shaderParameterHash_, data[i]);
+
+    stateHashDirty_ = true;
+}
+
+void Material::RefreshStateHash() const
+{
+    VectorBuffer temp;
+    for (unsigned i = 0; i < techniques_.Size(); ++i)
+    {
+        const TechniqueEntry& entry = techniques_[i];
+        temp.WriteUInt((unsigned)(size_t)entry.technique_.Get());
+        temp.WriteInt(entry.qualityLevel_);
+        temp.WriteFloat(entry.lodDistance_);
+    }
+    for (HashMap<TextureUnit, SharedPtr<Texture> >::ConstIterator i = textures_.Begin(); i != textures_.End(); ++i)
+    {
+        temp.WriteUByte((unsigned char)i->first_);
+        temp.WriteUInt((unsigned)(size_t)i->second_.Get());
+    }
+    temp.WriteUInt(shaderParameterHash_);
+    temp.WriteUByte((unsigned char)cullMode_);
+    temp.WriteUByte((unsigned char)shadowCullMode_);
+    temp.WriteUByte((unsigned char)fillMode_);
+    temp.WriteFloat(depthBias_.constantBias_);
+    temp.WriteFloat(depthBias_.slopeScaledBias_);
+    temp.WriteFloat(depthBias_.normalOffset_);
+    temp.WriteUByte(renderOrder_);
+    temp.WriteBool(alphaToCoverage_);
+    temp.WriteBool(lineAntiAlias_);
+    temp.WriteBool(occlusion_);
+
+    // Techniques are cloned with the shader defines, so the defines are covered by the technique pointers
+    stateHash_ = 0;
+    const unsigned char* data = temp.GetData();
+    unsigned dataSize = temp.GetSize();
+    for (unsigned i = 0; i < dataSize; ++i)
+        stateHash_ = SDBMHash(stateHash_, data[i]);
+
+    stateHashDirty_ = false;
 }
 
 void Material::RefreshMemoryUse()
@@ -1401,6 +1529,8 @@ void Material::ApplyShaderDefines(unsigned index)
     if (index >= techniques_.Size() || !techniques_[index].original_)
         return;
 
+    stateHashDirty_ = true;
+
     if (vertexShaderDefines_.Empty() && pixelShaderDefines_.Empty())
         techniques_[index].technique_ = techniques_[index].original_;
     else
@@ -254,6 +254,12 @@ public:
 
     /// Return shader parameter hash value. Used as an optimization to avoid setting shader parameters unnecessarily.
     unsigned GetShaderParameterHash() const { return shaderParameterHash_; }
+    /// Return hash of the render state: techniques, shader defines, textures, shader parameters and render modes.
+    unsigned GetStateHash() const;
+    /// Return whether has the same render state as another material.
+    bool HasSameState(const Material* rhs) const;
+    /// Return the material which is shared by all materials with the same render state, used for batching. Returns self if none or if shader parameters are animated.
+    Material* GetSharedState();
 
     /// Return name for texture unit.
     static String GetTextureUnitName(TextureUnit unit);
@@ -277,6 +283,8 @@ private:
     void RefreshShaderParameterHash();
     /// Recalculate the memory used by the material.
     void RefreshMemoryUse();
+    /// Recalculate render state hash.
+    void RefreshStateHash() const;
     /// Reapply shader defines to technique index. By default reapply all.
     void ApplyShaderDefines(unsigned index = M_MAX_UNSIGNED);
     /// Return shader parameter animation info.
@@ -312,6 +320,10 @@ private:
     unsigned auxViewFrameNumber_;
     /// Shader parameter hash value.
     unsigned shaderParameterHash_;
+    /// Render state hash value.
+    mutable unsigned stateHash_;
+    /// Material with the same render state used for batching.
+    WeakPtr<Material> sharedState_;
     /// Alpha-to-coverage flag.
     bool alphaToCoverage_;
     /// Line antialiasing flag.
@@ -322,6 +334,8 @@ private:
     bool specular_;
     /// Flag for whether is subscribed to animation updates.
     bool subscribed_;
+    /// Render state hash needs update flag.
+    mutable bool stateHashDirty_;
     /// Flag to suppress parameter hash and memory use recalculation when setting multiple shader parameters (loading or resetting the material.)
     bool batchedParameterUpdate_;
     /// XML file used while loading.
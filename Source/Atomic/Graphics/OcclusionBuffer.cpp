@@ -28,6 +28,10 @@
 #include "../Graphics/OcclusionBuffer.h"
 #include "../IO/Log.h"
 
+#ifdef ATOMIC_SSE
+#include <emmintrin.h>
+#endif
+
 #include "../DebugNew.h"
 
 namespace Atomic
@@ -345,58 +349,204 @@ bool OcclusionBuffer::IsVisible(const BoundingBox& worldSpaceBox) const
     if (buffers_.Empty())
         return true;
 
-    // Transform corners to projection space
-    Vector4 vertices[8];
-    vertices[0] = ModelTransform(viewProj_, worldSpaceBox.min_);
-    vertices[1] = ModelTransform(viewProj_, Vector3(worldSpaceBox.max_.x_, worldSpaceBox.min_.y_, worldSpaceBox.min_.z_));
-    vertices[2] = ModelTransform(viewProj_, Vector3(worldSpaceBox.min_.x_, worldSpaceBox.max_.y_, worldSpaceBox.min_.z_));
-    vertices[3] = ModelTransform(viewProj_, Vector3(worldSpaceBox.max_.x_, worldSpaceBox.max_.y_, worldSpaceBox.min_.z_));
-    vertices[4] = ModelTransform(viewProj_, Vector3(worldSpaceBox.min_.x_, worldSpaceBox.min_.y_, worldSpaceBox.max_.z_));
-    vertices[5] = ModelTransform(viewProj_, Vector3(worldSpaceBox.max_.x_, worldSpaceBox.min_.y_, worldSpaceBox.max_.z_));
-    vertices[6] = ModelTransform(viewProj_, Vector3(worldSpaceBox.min_.x_, worldSpaceBox.max_.y_, worldSpaceBox.max_.z_));
-    vertices[7] = ModelTransform(viewProj_, worldSpaceBox.max_);
-
-    // Apply a far clip relative bias
-    for (unsigned i = 0; i < 8; ++i)
-        vertices[i].z_ -= OCCLUSION_RELATIVE_BIAS;
+    IntRect rect;
+    int z;
+    if (!ProjectBox(worldSpaceBox, rect, z))
+        return true;
 
-    // Transform to screen space. If any of the corners cross the near plane, assume visible
-    float minX, maxX, minY, maxY, minZ;
+    return IsRectVisible(rect, z);
+}
 
-    if (vertices[0].z_ <= 0.0f)
-        return true;
+unsigned OcclusionBuffer::IsVisible(const BoundingBox* worldSpaceBoxes, bool* results, unsigned count) const
+{
+    if (buffers_.Empty())
+    {
+        for (unsigned i = 0; i < count; ++i)
+            results[i] = true;
+        return count;
+    }
 
-    Vector3 projected = ViewportTransform(vertices[0]);
-    minX = maxX = projected.x_;
-    minY = maxY = projected.y_;
-    minZ = projected.z_;
+    unsigned numVisible = 0;
+    IntRect rect;
+    int z;
+    unsigned i = 0;
+
+#ifdef ATOMIC_SSE
+    // Project 4 boxes at a time. The depth hierarchy test is branchy, so it stays per box
+    IntRect rects[4];
+    int depths[4];
+    bool projected[4];
+    for (; i + 4 <= count; i += 4)
+    {
+        ProjectBoxes(worldSpaceBoxes + i, rects, depths, projected);
+        for (unsigned j = 0; j < 4; ++j)
+        {
+            results[i + j] = !projected[j] || IsRectVisible(rects[j], depths[j]);
+            if (results[i + j])
+                ++numVisible;
+        }
+    }
+#endif
 
-    // Project the rest
-    for (unsigned i = 1; i < 8; ++i)
+    for (; i < count; ++i)
     {
+        results[i] = !ProjectBox(worldSpaceBoxes[i], rect, z) || IsRectVisible(rect, z);
+        if (results[i])
+            ++numVisible;
+    }
+
+    return numVisible;
+}
+
+bool OcclusionBuffer::ProjectBox(const BoundingBox& worldSpaceBox, IntRect& rect, int& z) const
+{
+    // Transform the center and the half-size axes to projection space, then build the corners from them. This needs
+    // only one full matrix transform instead of eight
+    Vector3 center = worldSpaceBox.Center();
+    Vector3 halfSize = worldSpaceBox.HalfSize();
+    Vector4 projCenter = ModelTransform(viewProj_, center);
+    Vector4 axisX(viewProj_.m00_ * halfSize.x_, viewProj_.m10_ * halfSize.x_, viewProj_.m20_ * halfSize.x_,
+        viewProj_.m30_ * halfSize.x_);
+    Vector4 axisY(viewProj_.m01_ * halfSize.y_, viewProj_.m11_ * halfSize.y_, viewProj_.m21_ * halfSize.y_,
+        viewProj_.m31_ * halfSize.y_);
+    Vector4 axisZ(viewProj_.m02_ * halfSize.z_, viewProj_.m12_ * halfSize.z_, viewProj_.m22_ * halfSize.z_,
+        viewProj_.m32_ * halfSize.z_);
+
+    Vector4 vertices[8];
+    Vector4 minZ = projCenter - axisZ;
+    Vector4 maxZ = projCenter + axisZ;
+    vertices[0] = minZ - axisX - axisY;
+    vertices[1] = minZ + axisX - axisY;
+    vertices[2] = minZ - axisX + axisY;
+    vertices[3] = minZ + axisX + axisY;
+    vertices[4] = maxZ - axisX - axisY;
+    vertices[5] = maxZ + axisX - axisY;
+    vertices[6] = maxZ - axisX + axisY;
+    vertices[7] = maxZ + axisX + axisY;
+
+    // Transform to screen space with a far clip relative bias. If any of the corners cross the near plane, assume visible
+    float minX = M_INFINITY, maxX = -M_INFINITY, minY = M_INFINITY, maxY = -M_INFINITY, minDepth = M_INFINITY;
+
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        vertices[i].z_ -= OCCLUSION_RELATIVE_BIAS;
         if (vertices[i].z_ <= 0.0f)
-            return true;
+            return false;
 
-        projected = ViewportTransform(vertices[i]);
+        Vector3 projected = ViewportTransform(vertices[i]);
 
         if (projected.x_ < minX) minX = projected.x_;
         if (projected.x_ > maxX) maxX = projected.x_;
         if (projected.y_ < minY) minY = projected.y_;
         if (projected.y_ > maxY) maxY = projected.y_;
-        if (projected.z_ < minZ) minZ = projected.z_;
+        if (projected.z_ < minDepth) minDepth = projected.z_;
+    }
+
+    return ClipScreenRect(minX, minY, maxX, maxY, minDepth, rect, z);
+}
+
+#ifdef ATOMIC_SSE
+void OcclusionBuffer::ProjectBoxes(const BoundingBox* worldSpaceBoxes, IntRect* rects, int* z, bool* projected) const
+{
+    // Load the centers and half sizes so that each lane holds one box, then follow the same steps as ProjectBox()
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 center[3];
+    __m128 halfSize[3];
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        __m128 min = _mm_setr_ps(worldSpaceBoxes[0].min_.Data()[i], worldSpaceBoxes[1].min_.Data()[i],
+            worldSpaceBoxes[2].min_.Data()[i], worldSpaceBoxes[3].min_.Data()[i]);
+        __m128 max = _mm_setr_ps(worldSpaceBoxes[0].max_.Data()[i], worldSpaceBoxes[1].max_.Data()[i],
+            worldSpaceBoxes[2].max_.Data()[i], worldSpaceBoxes[3].max_.Data()[i]);
+        center[i] = _mm_mul_ps(_mm_add_ps(max, min), half);
+        halfSize[i] = _mm_mul_ps(_mm_sub_ps(max, min), half);
+    }
+
+    const float* m = viewProj_.Data();
+    __m128 projCenter[4];
+    __m128 axisX[4];
+    __m128 axisY[4];
+    __m128 axisZ[4];
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const float* row = m + i * 4;
+        axisX[i] = _mm_mul_ps(_mm_set1_ps(row[0]), halfSize[0]);
+        axisY[i] = _mm_mul_ps(_mm_set1_ps(row[1]), halfSize[1]);
+        axisZ[i] = _mm_mul_ps(_mm_set1_ps(row[2]), halfSize[2]);
+        projCenter[i] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0]), center[0]),
+            _mm_mul_ps(_mm_set1_ps(row[1]), center[1])), _mm_mul_ps(_mm_set1_ps(row[2]), center[2])), _mm_set1_ps(row[3]));
     }
 
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 bias = _mm_set1_ps(OCCLUSION_RELATIVE_BIAS);
+    __m128 scaleX = _mm_set1_ps(scaleX_);
+    __m128 scaleY = _mm_set1_ps(scaleY_);
+    __m128 offsetX = _mm_set1_ps(offsetX_);
+    __m128 offsetY = _mm_set1_ps(offsetY_);
+    __m128 scaleZ = _mm_set1_ps(OCCLUSION_Z_SCALE);
+    __m128 minX = _mm_set1_ps(M_INFINITY);
+    __m128 maxX = _mm_set1_ps(-M_INFINITY);
+    __m128 minY = minX;
+    __m128 maxY = maxX;
+    __m128 minDepth = minX;
+    __m128 nearClipped = zero;
+
+    // Corner bits select the sign of the X, Y and Z axes in the same order as the vertices of ProjectBox()
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        __m128 vertex[4];
+        for (unsigned j = 0; j < 4; ++j)
+        {
+            __m128 v = (i & 4) ? _mm_add_ps(projCenter[j], axisZ[j]) : _mm_sub_ps(projCenter[j], axisZ[j]);
+            v = (i & 1) ? _mm_add_ps(v, axisX[j]) : _mm_sub_ps(v, axisX[j]);
+            vertex[j] = (i & 2) ? _mm_add_ps(v, axisY[j]) : _mm_sub_ps(v, axisY[j]);
+        }
+
+        // Lanes with a corner crossing the near plane get garbage values, but are discarded below
+        vertex[2] = _mm_sub_ps(vertex[2], bias);
+        nearClipped = _mm_or_ps(nearClipped, _mm_cmple_ps(vertex[2], zero));
+
+        __m128 invW = _mm_div_ps(one, vertex[3]);
+        __m128 x = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(invW, vertex[0]), scaleX), offsetX);
+        __m128 y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(invW, vertex[1]), scaleY), offsetY);
+        __m128 depth = _mm_mul_ps(_mm_mul_ps(invW, vertex[2]), scaleZ);
+        minX = _mm_min_ps(minX, x);
+        maxX = _mm_max_ps(maxX, x);
+        minY = _mm_min_ps(minY, y);
+        maxY = _mm_max_ps(maxY, y);
+        minDepth = _mm_min_ps(minDepth, depth);
+    }
+
+    float minXs[4], maxXs[4], minYs[4], maxYs[4], minDepths[4];
+    _mm_storeu_ps(minXs, minX);
+    _mm_storeu_ps(maxXs, maxX);
+    _mm_storeu_ps(minYs, minY);
+    _mm_storeu_ps(maxYs, maxY);
+    _mm_storeu_ps(minDepths, minDepth);
+    int nearClippedMask = _mm_movemask_ps(nearClipped);
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        projected[i] = !(nearClippedMask & (1 << i)) &&
+            ClipScreenRect(minXs[i], minYs[i], maxXs[i], maxYs[i], minDepths[i], rects[i], z[i]);
+    }
+}
+#endif
+
+bool OcclusionBuffer::ClipScreenRect(float minX, float minY, float maxX, float maxY, float minDepth, IntRect& rect, int& z) const
+{
     // Expand the bounding box 1 pixel in each direction to be conservative and correct rasterization offset
-    IntRect rect(
+    rect = IntRect(
         (int)(minX - 1.5f), (int)(minY - 1.5f),
         (int)(maxX + 0.5f), (int)(maxY + 0.5f)
     );
 
     // If the rect is outside, let frustum culling handle
     if (rect.right_ < 0 || rect.bottom_ < 0)
-        return true;
+        return false;
     if (rect.left_ >= width_ || rect.top_ >= height_)
-        return true;
+        return false;
 
     // Clipping of rect
     if (rect.left_ < 0)
@@ -409,44 +559,35 @@ bool OcclusionBuffer::IsVisible(const BoundingBox& worldSpaceBox) const
         rect.bottom_ = height_ - 1;
 
     // Convert depth to integer and apply final bias
-    int z = (int)(minZ + 0.5f) - OCCLUSION_FIXED_BIAS;
+    z = (int)(minDepth + 0.5f) - OCCLUSION_FIXED_BIAS;
+    return true;
+}
 
-    if (!depthHierarchyDirty_)
+bool OcclusionBuffer::IsRectVisible(const IntRect& rect, int z) const
+{
+    if (!depthHierarchyDirty_ && mipBuffers_.Size())
     {
-        // Start from lowest mip level and check if a conclusive result can be found
-        for (int i = mipBuffers_.Size() - 1; i >= 0; --i)
+        // Start from the lowest mip level and only descend into the parts that are inconclusive. The result is exact
+        // with respect to the pixel-level data, but large unoccluded or fully occluded areas are resolved at coarse levels
+        int level = mipBuffers_.Size() - 1;
+        int shift = level + 1;
+        int left = rect.left_ >> shift;
+        int right = rect.right_ >> shift;
+        int bottom = rect.bottom_ >> shift;
+
+        for (int y = rect.top_ >> shift; y <= bottom; ++y)
         {
-            int shift = i + 1;
-            int width = width_ >> shift;
-            int left = rect.left_ >> shift;
-            int right = rect.right_ >> shift;
-
-            DepthValue* buffer = mipBuffers_[i].Get();
-            DepthValue* row = buffer + (rect.top_ >> shift) * width;
-            DepthValue* endRow = buffer + (rect.bottom_ >> shift) * width;
-            bool allOccluded = true;
-
-            while (row <= endRow)
+            for (int x = left; x <= right; ++x)
             {
-                DepthValue* src = row + left;
-                DepthValue* end = row + right;
-                while (src <= end)
-                {
-                    if (z <= src->min_)
-                        return true;
-                    if (z <= src->max_)
-                        allOccluded = false;
-                    ++src;
-                }
-                row += width;
+                if (IsMipVisible(level, x, y, rect, z))
+                    return true;
             }
-
-            if (allOccluded)
-                return false;
         }
+
+        return false;
     }
 
-    // If no conclusive result, finally check the pixel-level data
+    // If no depth hierarchy, check the pixel-level data
     int* row = buffers_[0].data_ + rect.top_ * width_;
     int* endRow = buffers_[0].data_ + rect.bottom_ * width_;
     while (row <= endRow)
@@ -465,6 +606,47 @@ bool OcclusionBuffer::IsVisible(const BoundingBox& worldSpaceBox) const
     return false;
 }
 
+bool OcclusionBuffer::IsMipVisible(int level, int x, int y, const IntRect& rect, int z) const
+{
+    const DepthValue& value = mipBuffers_[level][y * (width_ >> (level + 1)) + x];
+    if (z <= value.min_)
+        return true;
+    if (z > value.max_)
+        return false;
+
+    // Inconclusive, so refine into the covered part of the next finer level
+    int left = Max(x * 2, rect.left_ >> level);
+    int right = Min(x * 2 + 1, rect.right_ >> level);
+    int top = Max(y * 2, rect.top_ >> level);
+    int bottom = Min(y * 2 + 1, rect.bottom_ >> level);
+
+    if (level > 0)
+    {
+        for (int childY = top; childY <= bottom; ++childY)
+        {
+            for (int childX = left; childX <= right; ++childX)
+            {
+                if (IsMipVisible(level - 1, childX, childY, rect, z))
+                    return true;
+            }
+        }
+    }
+    else
+    {
+        for (int childY = top; childY <= bottom; ++childY)
+        {
+            const int* row = buffers_[0].data_ + childY * width_;
+            for (int childX = left; childX <= right; ++childX)
+            {
+                if (z <= row[childX])
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 unsigned OcclusionBuffer::GetUseTimer()
 {
     return useTimer_.GetMSec(false);
@@ -822,6 +1004,38 @@ struct Edge
     int invZStep_;
 };
 
+/// Draw a horizontal span of interpolated depth values, keeping the closer value of each pixel.
+static inline void DrawSpan(int* dest, int* end, int invZ, int dInvZdX)
+{
+#ifdef ATOMIC_SSE
+    // Process 4 pixels at a time. SSE2 has no signed integer min, so select the closer values with a compare mask
+    if (end - dest >= 4)
+    {
+        __m128i depth = _mm_set_epi32(invZ + 3 * dInvZdX, invZ + 2 * dInvZdX, invZ + dInvZdX, invZ);
+        __m128i step = _mm_set1_epi32(4 * dInvZdX);
+        int* simdEnd = dest + ((end - dest) & ~3);
+        invZ += (int)(simdEnd - dest) * dInvZdX;
+
+        while (dest < simdEnd)
+        {
+            __m128i old = _mm_loadu_si128((__m128i*)dest);
+            __m128i closer = _mm_cmplt_epi32(depth, old);
+            _mm_storeu_si128((__m128i*)dest, _mm_or_si128(_mm_and_si128(closer, depth), _mm_andnot_si128(closer, old)));
+            depth = _mm_add_epi32(depth, step);
+            dest += 4;
+        }
+    }
+#endif
+
+    while (dest < end)
+    {
+        if (invZ < *dest)
+            *dest = invZ;
+        invZ += dInvZdX;
+        ++dest;
+    }
+}
+
 void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, unsigned threadIndex)
 {
     int top, middle, bottom;
@@ -907,16 +1121,7 @@ void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, un
         int* endRow = bufferData + middleY * width_;
         while (row < endRow)
         {
-            int invZ = topToBottom.invZ_;
-            int* dest = row + (topToBottom.x_ >> 16);
-            int* end = row + (topToMiddle.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
+            DrawSpan(row + (topToBottom.x_ >> 16), row + (topToMiddle.x_ >> 16), topToBottom.invZ_, gradients.dInvZdXInt_);
 
             topToBottom.x_ += topToBottom.xStep_;
             topToBottom.invZ_ += topToBottom.invZStep_;
@@ -929,16 +1134,7 @@ void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, un
         endRow = bufferData + bottomY * width_;
         while (row < endRow)
         {
-            int invZ = topToBottom.invZ_;
-            int* dest = row + (topToBottom.x_ >> 16);
-            int* end = row + (middleToBottom.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
+            DrawSpan(row + (topToBottom.x_ >> 16), row + (middleToBottom.x_ >> 16), topToBottom.invZ_, gradients.dInvZdXInt_);
 
             topToBottom.x_ += topToBottom.xStep_;
             topToBottom.invZ_ += topToBottom.invZStep_;
@@ -953,16 +1149,7 @@ void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, un
         int* endRow = bufferData + middleY * width_;
         while (row < endRow)
         {
-            int invZ = topToMiddle.invZ_;
-            int* dest = row + (topToMiddle.x_ >> 16);
-            int* end = row + (topToBottom.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
+            DrawSpan(row + (topToMiddle.x_ >> 16), row + (topToBottom.x_ >> 16), topToMiddle.invZ_, gradients.dInvZdXInt_);
 
             topToMiddle.x_ += topToMiddle.xStep_;
             topToMiddle.invZ_ += topToMiddle.invZStep_;
@@ -975,16 +1162,7 @@ void OcclusionBuffer::DrawTriangle2D(const Vector3* vertices, bool clockwise, un
         endRow = bufferData + bottomY * width_;
         while (row < endRow)
         {
-            int invZ = middleToBottom.invZ_;
-            int* dest = row + (middleToBottom.x_ >> 16);
-            int* end = row + (topToBottom.x_ >> 16);
-            while (dest < end)
-            {
-                if (invZ < *dest)
-                    *dest = invZ;
-                invZ += gradients.dInvZdXInt_;
-                ++dest;
-            }
+            DrawSpan(row + (middleToBottom.x_ >> 16), row + (topToBottom.x_ >> 16), middleToBottom.invZ_, gradients.dInvZdXInt_);
 
             middleToBottom.x_ += middleToBottom.xStep_;
             middleToBottom.invZ_ += middleToBottom.invZStep_;
@@ -1007,6 +1185,21 @@ void OcclusionBuffer::MergeBuffers()
         int* dest = buffers_[0].data_;
         int count = width_ * height_;
 
+#ifdef ATOMIC_SSE
+        // The buffer width is a power of two, so process 4 values at a time and leave the remainder to the scalar loop
+        while (count >= 4)
+        {
+            __m128i srcValue = _mm_loadu_si128((__m128i*)src);
+            __m128i destValue = _mm_loadu_si128((__m128i*)dest);
+            __m128i closer = _mm_cmplt_epi32(srcValue, destValue);
+            _mm_storeu_si128((__m128i*)dest, _mm_or_si128(_mm_and_si128(closer, srcValue),
+                _mm_andnot_si128(closer, destValue)));
+            src += 4;
+            dest += 4;
+            count -= 4;
+        }
+#endif
+
         while (count--)
         {
             // If thread buffer's depth value is closer, overwrite the original
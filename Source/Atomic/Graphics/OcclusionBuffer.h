@@ -149,6 +149,8 @@ public:
 
     /// Test a bounding box for visibility. For best performance, build depth hierarchy first.
     bool IsVisible(const BoundingBox& worldSpaceBox) const;
+    /// Test several bounding boxes for visibility and write the results. Return number of visible boxes.
+    unsigned IsVisible(const BoundingBox* worldSpaceBoxes, bool* results, unsigned count) const;
     /// Return time since last use in milliseconds.
     unsigned GetUseTimer();
 
@@ -166,6 +168,18 @@ private:
     inline float SignedArea(const Vector3& v0, const Vector3& v1, const Vector3& v2) const;
     /// Calculate viewport transform.
     void CalculateViewport();
+    /// Project a bounding box to a clipped screen rect and integer depth. Return false if the box should be assumed visible.
+    bool ProjectBox(const BoundingBox& worldSpaceBox, IntRect& rect, int& z) const;
+#ifdef ATOMIC_SSE
+    /// Project four bounding boxes at once, one per SIMD lane. Write false to projected for the boxes that should be assumed visible.
+    void ProjectBoxes(const BoundingBox* worldSpaceBoxes, IntRect* rects, int* z, bool* projected) const;
+#endif
+    /// Convert screen space bounds to a clipped rect and integer depth. Return false if the rect is outside the buffer.
+    bool ClipScreenRect(float minX, float minY, float maxX, float maxY, float minDepth, IntRect& rect, int& z) const;
+    /// Test a projected screen rect against the depth buffer, using the depth hierarchy if available.
+    bool IsRectVisible(const IntRect& rect, int z) const;
+    /// Test a depth hierarchy value and refine into the next level if inconclusive.
+    bool IsMipVisible(int level, int x, int y, const IntRect& rect, int z) const;
     /// Draw a triangle.
     void DrawTriangle(Vector4* vertices, unsigned threadIndex);
     /// Clip vertices against a plane.
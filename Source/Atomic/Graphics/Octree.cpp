@@ -30,6 +30,8 @@
 #include "../Graphics/DebugRenderer.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/Octree.h"
+#include "../Graphics/Renderer.h"
+#include "../Graphics/StaticInstancingCache.h"
 #include "../IO/Log.h"
 #include "../Scene/Scene.h"
 #include "../Scene/SceneEvents.h"
@@ -73,7 +75,8 @@ Octant::Octant(const BoundingBox& box, unsigned level, Octant* parent, Octree* r
     numDrawables_(0),
     parent_(parent),
     root_(root),
-    index_(index)
+    index_(index),
+    version_(0)
 {
     Initialize(box);
 
@@ -125,14 +128,20 @@ Octant* Octant::GetOrCreateChild(unsigned index)
         newMax.z_ = oldCenter.z_;
 
     children_[index] = new Octant(BoundingBox(newMin, newMax), level_ + 1, this, root_, index);
+    // Give the new octant a fresh version, so that results cached for a deleted octant at the same address are not reused
+    children_[index]->MarkModified();
     return children_[index];
 }
 
 void Octant::DeleteChild(unsigned index)
 {
     assert(index < NUM_OCTANTS);
-    delete children_[index];
-    children_[index] = 0;
+    if (children_[index])
+    {
+        delete children_[index];
+        children_[index] = 0;
+        MarkModified();
+    }
 }
 
 void Octant::InsertDrawable(Drawable* drawable)
@@ -193,6 +202,16 @@ bool Octant::CheckDrawableFit(const BoundingBox& box) const
     return false;
 }
 
+void Octant::MarkModified()
+{
+    if (!root_)
+        return;
+
+    unsigned version = static_cast<Octant*>(root_)->version_ + 1;
+    for (Octant* octant = this; octant; octant = octant->parent_)
+        octant->version_ = version;
+}
+
 void Octant::ResetRoot()
 {
     root_ = 0;
@@ -258,6 +277,80 @@ void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
     }
 }
 
+bool Octant::GetDrawablesInternal(OctreeQuery& query, bool inside, OctreeQueryCache& cache) const
+{
+    unsigned resultStart = query.result_.Size();
+    bool record = false;
+
+    if (this != root_)
+    {
+        Intersection res = query.TestOctant(cullingBox_, inside);
+        if (res == OUTSIDE)
+            return false;
+        else if (res == INSIDE && !inside)
+        {
+            inside = true;
+
+            // If the octant was fully inside on the previous query too and its drawables have not changed, the result is
+            // the same, so skip testing the whole subtree
+            HashMap<const Octant*, Pair<unsigned, unsigned> >::ConstIterator i = cache.octants_.Find(this);
+            if (i != cache.octants_.End() && version_ <= cache.version_)
+            {
+                const Pair<unsigned, unsigned>& range = i->second_;
+                if (range.second_ > range.first_)
+                {
+                    Drawable** cached = &cache.drawables_[range.first_];
+                    query.result_.Insert(query.result_.End(), cached, cached + (range.second_ - range.first_));
+                }
+                record = true;
+            }
+            else
+            {
+                if (drawables_.Size())
+                {
+                    Drawable** start = const_cast<Drawable**>(&drawables_[0]);
+                    Drawable** end = start + drawables_.Size();
+                    query.TestDrawables(start, end, inside);
+                }
+
+                // Record only if no octant of the subtree was culled, as otherwise the result depends on more than the
+                // octant staying inside
+                record = true;
+                for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+                {
+                    if (children_[i] && !children_[i]->GetDrawablesInternal(query, inside, cache))
+                        record = false;
+                }
+            }
+
+            if (record)
+            {
+                unsigned newStart = cache.newDrawables_.Size();
+                for (unsigned i = resultStart; i < query.result_.Size(); ++i)
+                    cache.newDrawables_.Push(query.result_[i]);
+                cache.newOctants_[this] = MakePair(newStart, cache.newDrawables_.Size());
+            }
+            return record;
+        }
+    }
+
+    if (drawables_.Size())
+    {
+        Drawable** start = const_cast<Drawable**>(&drawables_[0]);
+        Drawable** end = start + drawables_.Size();
+        query.TestDrawables(start, end, inside);
+    }
+
+    bool complete = true;
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+    {
+        if (children_[i] && !children_[i]->GetDrawablesInternal(query, inside, cache))
+            complete = false;
+    }
+
+    return complete;
+}
+
 void Octant::GetDrawablesInternal(RayOctreeQuery& query) const
 {
     float octantDist = query.ray_.HitDistance(cullingBox_);
@@ -380,6 +473,11 @@ void Octree::Update(const FrameInfo& frame)
         return;
     }
 
+    // Apply batched transforms first, so that the moved drawables are queued for reinsertion
+    Scene* scene = GetScene();
+    if (scene)
+        scene->UpdateTransforms();
+
     // Let drawables update themselves before reinsertion. This can be used for animation
     if (!drawableUpdates_.Empty())
     {
@@ -387,7 +485,6 @@ void Octree::Update(const FrameInfo& frame)
 
         // Perform updates in worker threads. Notify the scene that a threaded update is going on and components
         // (for example physics objects) should not perform non-threadsafe work when marked dirty
-        Scene* scene = GetScene();
         WorkQueue* queue = GetSubsystem<WorkQueue>();
         scene->BeginThreadedUpdate();
 
@@ -437,7 +534,6 @@ void Octree::Update(const FrameInfo& frame)
     }
 
     // Notify drawable update being finished. Custom animation (eg. IK) can be done at this point
-    Scene* scene = GetScene();
     if (scene)
     {
         using namespace SceneDrawableUpdateFinished;
@@ -446,6 +542,9 @@ void Octree::Update(const FrameInfo& frame)
         eventData[P_SCENE] = scene;
         eventData[P_TIMESTEP] = frame.timeStep_;
         scene->SendEvent(E_SCENEDRAWABLEUPDATEFINISHED, eventData);
+
+        // Apply the batched transforms of the custom animation as well
+        scene->UpdateTransforms();
     }
 
     // Reinsert drawables that have been moved or resized, or that have been newly added to the octree and do not sit inside
@@ -454,6 +553,9 @@ void Octree::Update(const FrameInfo& frame)
     {
         ATOMIC_PROFILE(ReinsertToOctree);
 
+        Renderer* renderer = GetSubsystem<Renderer>();
+        bool trackShadowCasters = renderer && renderer->GetShadowMapCaching();
+
         for (PODVector<Drawable*>::Iterator i = drawableUpdates_.Begin(); i != drawableUpdates_.End(); ++i)
         {
             Drawable* drawable = *i;
@@ -461,6 +563,13 @@ void Octree::Update(const FrameInfo& frame)
             Octant* octant = drawable->GetOctant();
             const BoundingBox& box = drawable->GetWorldBoundingBox();
 
+            // Moved static models need their persistent instance transforms rewritten
+            if (staticInstancingCache_)
+                staticInstancingCache_->MarkTransformDirty(drawable);
+            // Moved shadow casters invalidate cached shadow maps they appear in
+            if (trackShadowCasters && drawable->GetCastShadows())
+                renderer->MarkShadowCasterMoved(drawable);
+
             // Skip if no octant or does not belong to this octree anymore
             if (!octant || octant->GetRoot() != this)
                 continue;
@@ -483,6 +592,17 @@ void Octree::Update(const FrameInfo& frame)
     }
 
     drawableUpdates_.Clear();
+
+    if (staticInstancingCache_)
+        staticInstancingCache_->Update();
+}
+
+StaticInstancingCache* Octree::GetOrCreateStaticInstancingCache()
+{
+    if (!staticInstancingCache_)
+        staticInstancingCache_ = new StaticInstancingCache(context_);
+
+    return staticInstancingCache_;
 }
 
 void Octree::AddManualDrawable(Drawable* drawable)
@@ -509,6 +629,27 @@ void Octree::GetDrawables(OctreeQuery& query) const
     GetDrawablesInternal(query, false);
 }
 
+void Octree::GetDrawables(OctreeQuery& query, OctreeQueryCache& cache) const
+{
+    query.result_.Clear();
+
+    if (cache.octree_ != this || cache.drawableFlags_ != query.drawableFlags_ || cache.viewMask_ != query.viewMask_)
+    {
+        cache.Clear();
+        cache.octree_ = this;
+        cache.drawableFlags_ = query.drawableFlags_;
+        cache.viewMask_ = query.viewMask_;
+    }
+
+    cache.newDrawables_.Clear();
+    cache.newOctants_.Clear();
+    GetDrawablesInternal(query, false, cache);
+
+    cache.drawables_.Swap(cache.newDrawables_);
+    cache.octants_.Swap(cache.newOctants_);
+    cache.version_ = version_;
+}
+
 void Octree::Raycast(RayOctreeQuery& query) const
 {
     ATOMIC_PROFILE(Raycast);
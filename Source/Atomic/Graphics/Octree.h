@@ -31,6 +31,8 @@ namespace Atomic
 {
 
 class Octree;
+class StaticInstancingCache;
+struct OctreeQueryCache;
 
 static const int NUM_OCTANTS = 8;
 static const unsigned ROOT_INDEX = M_MAX_UNSIGNED;
@@ -52,12 +54,15 @@ public:
     void InsertDrawable(Drawable* drawable);
     /// Check if a drawable object fits.
     bool CheckDrawableFit(const BoundingBox& box) const;
+    /// Mark this octant and its parents as having changed drawable contents, invalidating cached query results.
+    void MarkModified();
 
     /// Add a drawable object to this octant.
     void AddDrawable(Drawable* drawable)
     {
         drawable->SetOctant(this);
         drawables_.Push(drawable);
+        MarkModified();
         IncDrawableCount();
     }
 
@@ -68,6 +73,7 @@ public:
         {
             if (resetOctant)
                 drawable->SetOctant(0);
+            MarkModified();
             DecDrawableCount();
         }
     }
@@ -90,6 +96,9 @@ public:
     /// Return number of drawables.
     unsigned GetNumDrawables() const { return numDrawables_; }
 
+    /// Return version of the last change to the drawables in this octant or its children. The root octant holds the latest version.
+    unsigned GetVersion() const { return version_; }
+
     /// Return true if there are no drawable objects in this octant and child octants.
     bool IsEmpty() { return numDrawables_ == 0; }
 
@@ -103,6 +112,8 @@ protected:
     void Initialize(const BoundingBox& box);
     /// Return drawable objects by a query, called internally.
     void GetDrawablesInternal(OctreeQuery& query, bool inside) const;
+    /// Return drawable objects by a query using cached results, called internally. Return false if any octant was culled.
+    bool GetDrawablesInternal(OctreeQuery& query, bool inside, OctreeQueryCache& cache) const;
     /// Return drawable objects by a ray query, called internally.
     void GetDrawablesInternal(RayOctreeQuery& query) const;
     /// Return drawable objects only for a threaded ray query, called internally.
@@ -154,6 +165,8 @@ protected:
     Octree* root_;
     /// Octant index relative to its siblings or ROOT_INDEX for root octant
     unsigned index_;
+    /// Version of the last change to the drawables in this octant or its children.
+    unsigned version_;
 };
 
 /// %Octree component. Should be added only to the root scene node
@@ -187,6 +200,10 @@ public:
 
     /// Return drawable objects by a query.
     void GetDrawables(OctreeQuery& query) const;
+    /// Return drawable objects by a query, reusing the previous results of octants that were fully inside the query volume
+    /// then and now, and whose drawables have not changed since. Only octants that cross the volume boundary or have
+    /// changed are tested again. The cache must only be used with one kind of query.
+    void GetDrawables(OctreeQuery& query, OctreeQueryCache& cache) const;
     /// Return drawable objects by a ray query.
     void Raycast(RayOctreeQuery& query) const;
     /// Return the closest drawable object by a ray query.
@@ -194,6 +211,10 @@ public:
 
     /// Return subdivision levels.
     unsigned GetNumLevels() const { return numLevels_; }
+    /// Return persistent instancing cache of static models, or null if no static model has opted into static instancing.
+    StaticInstancingCache* GetStaticInstancingCache() const { return staticInstancingCache_; }
+    /// Return persistent instancing cache of static models, creating it if necessary.
+    StaticInstancingCache* GetOrCreateStaticInstancingCache();
 
     /// Mark drawable object as requiring an update and a reinsertion.
     void QueueUpdate(Drawable* drawable);
@@ -214,8 +235,48 @@ private:
     Mutex octreeMutex_;
     /// Ray query temporary list of drawables.
     mutable PODVector<Drawable*> rayQueryDrawables_;
+    /// Persistent instancing cache of static models.
+    SharedPtr<StaticInstancingCache> staticInstancingCache_;
     /// Subdivision level.
     unsigned numLevels_;
 };
 
+/// Per-octant results of an octree query, reused by the next query of the same kind.
+struct ATOMIC_API OctreeQueryCache
+{
+    /// Construct.
+    OctreeQueryCache() :
+        octree_(0),
+        drawableFlags_(0),
+        viewMask_(0),
+        version_(0)
+    {
+    }
+
+    /// Clear the cached results.
+    void Clear()
+    {
+        octree_ = 0;
+        drawables_.Clear();
+        octants_.Clear();
+    }
+
+    /// Octree the results were queried from.
+    const Octree* octree_;
+    /// Drawable flags of the query.
+    unsigned char drawableFlags_;
+    /// View mask of the query.
+    unsigned viewMask_;
+    /// Octree version when the results were queried.
+    unsigned version_;
+    /// Drawables of the cached octants.
+    PODVector<Drawable*> drawables_;
+    /// Ranges in the drawables of octants that were fully inside the query volume and not culled further.
+    HashMap<const Octant*, Pair<unsigned, unsigned> > octants_;
+    /// Drawables being collected by the current query.
+    PODVector<Drawable*> newDrawables_;
+    /// Octant ranges being collected by the current query.
+    HashMap<const Octant*, Pair<unsigned, unsigned> > newOctants_;
+};
+
 }
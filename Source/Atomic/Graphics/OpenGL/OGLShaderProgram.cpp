@@ -25,8 +25,11 @@
 #include "../../Graphics/ConstantBuffer.h"
 #include "../../Graphics/Graphics.h"
 #include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/Shader.h"
 #include "../../Graphics/ShaderProgram.h"
 #include "../../Graphics/ShaderVariation.h"
+#include "../../IO/File.h"
+#include "../../IO/FileSystem.h"
 #include "../../IO/Log.h"
 
 #include "../../DebugNew.h"
@@ -128,9 +131,24 @@ bool ShaderProgram::Link()
         return false;
     }
 
-    glAttachShader(object_.name_, vertexShader_->GetGPUObjectName());
-    glAttachShader(object_.name_, pixelShader_->GetGPUObjectName());
-    glLinkProgram(object_.name_);
+    // Try the program binary cache first, as linking is often the slowest part of creating a shader program
+    bool linkedFromCache = false;
+#ifndef GL_ES_VERSION_2_0
+    String binaryFileName = GetBinaryFileName();
+    if (!binaryFileName.Empty())
+        linkedFromCache = LoadBinary(binaryFileName);
+#endif
+
+    if (!linkedFromCache)
+    {
+        glAttachShader(object_.name_, vertexShader_->GetGPUObjectName());
+        glAttachShader(object_.name_, pixelShader_->GetGPUObjectName());
+#ifndef GL_ES_VERSION_2_0
+        if (!binaryFileName.Empty())
+            glProgramParameteri(object_.name_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(object_.name_);
+    }
 
     int linked, length;
     glGetProgramiv(object_.name_, GL_LINK_STATUS, &linked);
@@ -149,6 +167,11 @@ bool ShaderProgram::Link()
     if (!object_.name_)
         return false;
 
+#ifndef GL_ES_VERSION_2_0
+    if (!linkedFromCache && !binaryFileName.Empty())
+        SaveBinary(binaryFileName);
+#endif
+
     const int MAX_NAME_LENGTH = 256;
     char nameBuffer[MAX_NAME_LENGTH];
     int attributeCount, uniformCount, elementCount, nameLength;
@@ -421,4 +444,79 @@ void ShaderProgram::ClearGlobalParameterSource(ShaderParameterGroup group)
     globalParameterSources[group] = (const void*)M_MAX_UNSIGNED;
 }
 
+#ifndef GL_ES_VERSION_2_0
+String ShaderProgram::GetBinaryFileName() const
+{
+    Shader* vsOwner = vertexShader_->GetOwner();
+    Shader* psOwner = pixelShader_->GetOwner();
+    if (!GLEW_ARB_get_program_binary || graphics_->GetShaderCacheDir().Empty() || !vsOwner || !psOwner)
+        return String::EMPTY;
+
+    // Key by the source code and defines of both shaders, plus the engine defines added when compiling. A binary from
+    // another driver version is rejected by the driver, in which case the program is linked from source again
+    String key = String(vsOwner->GetSourceHash()) + " " + vertexShader_->GetDefines() + " " + String(psOwner->GetSourceHash()) +
+        " " + pixelShader_->GetDefines() + " " + String(Graphics::GetMaxBones()) + " " + String(Graphics::GetGL3Support());
+
+    return graphics_->GetShaderCacheDir() + vertexShader_->GetName() + "_" + pixelShader_->GetName() + "_" +
+        StringHash(key).ToString() + ".glb";
+}
+
+bool ShaderProgram::LoadBinary(const String& fileName)
+{
+    if (!graphics_->GetSubsystem<FileSystem>()->FileExists(fileName))
+        return false;
+
+    File file(graphics_->GetContext(), fileName);
+    if (!file.IsOpen() || file.ReadFileID() != "UGLB")
+        return false;
+
+    unsigned format = file.ReadUInt();
+    unsigned size = file.ReadUInt();
+    if (!size || size > file.GetSize() - file.GetPosition())
+        return false;
+
+    PODVector<unsigned char> binary(size);
+    file.Read(&binary[0], size);
+
+    glProgramBinary(object_.name_, format, &binary[0], size);
+
+    int linked;
+    glGetProgramiv(object_.name_, GL_LINK_STATUS, &linked);
+    if (!linked)
+        return false;
+
+    ATOMIC_LOGDEBUG("Loaded cached shader program " + vertexShader_->GetFullName() + " " + pixelShader_->GetFullName());
+    return true;
+}
+
+void ShaderProgram::SaveBinary(const String& fileName)
+{
+    int length = 0;
+    glGetProgramiv(object_.name_, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    PODVector<unsigned char> binary((unsigned)length);
+    GLenum format = 0;
+    int outLength = 0;
+    glGetProgramBinary(object_.name_, length, &outLength, &format, &binary[0]);
+    if (outLength <= 0)
+        return;
+
+    FileSystem* fileSystem = graphics_->GetSubsystem<FileSystem>();
+    String path = GetPath(fileName);
+    if (!fileSystem->DirExists(path))
+        fileSystem->CreateDir(path);
+
+    File file(graphics_->GetContext(), fileName, FILE_WRITE);
+    if (!file.IsOpen())
+        return;
+
+    file.WriteFileID("UGLB");
+    file.WriteUInt(format);
+    file.WriteUInt((unsigned)outLength);
+    file.Write(&binary[0], (unsigned)outLength);
+}
+#endif
+
 }
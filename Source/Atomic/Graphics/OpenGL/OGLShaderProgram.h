@@ -89,6 +89,13 @@ public:
     static void ClearGlobalParameterSource(ShaderParameterGroup group);
 
 private:
+    /// Return the program binary cache file name, or empty if program binaries are not supported.
+    String GetBinaryFileName() const;
+    /// Load the program from a cached binary. Return true if successful.
+    bool LoadBinary(const String& fileName);
+    /// Save the linked program binary to the cache.
+    void SaveBinary(const String& fileName);
+
     /// Vertex shader.
     WeakPtr<ShaderVariation> vertexShader_;
     /// Pixel shader.
@@ -84,6 +84,12 @@ void ShaderVariation::Release()
     compilerOutput_.Clear();
 }
 
+bool ShaderVariation::Precompile()
+{
+    // Compiling requires the rendering context, so there is nothing to do ahead of Create()
+    return true;
+}
+
 bool ShaderVariation::Create()
 {
     Release();
@@ -32,6 +32,10 @@
 #include "../Scene/Scene.h"
 #include "../Scene/SceneEvents.h"
 
+#ifdef ATOMIC_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "../DebugNew.h"
 
 namespace Atomic
@@ -43,6 +47,86 @@ static const unsigned MAX_PARTICLES_IN_FRAME = 100;
 
 extern const char* autoRemoveModeNames[];
 
+static void IntegrateVelocities(Vector3* velocities, unsigned count, const Vector3& force, float damping, float timeStep)
+{
+    // Equivalent to applying the force first, then damping the result
+    float velocityScale = 1.0f - timeStep * damping;
+    Vector3 forceStep = force * timeStep * velocityScale;
+    float* data = &velocities->x_;
+    unsigned numFloats = count * 3;
+    unsigned i = 0;
+
+#ifdef ATOMIC_SSE
+    // The force components repeat every four velocities, ie. every three SSE vectors
+    __m128 scale = _mm_set1_ps(velocityScale);
+    __m128 force0 = _mm_setr_ps(forceStep.x_, forceStep.y_, forceStep.z_, forceStep.x_);
+    __m128 force1 = _mm_setr_ps(forceStep.y_, forceStep.z_, forceStep.x_, forceStep.y_);
+    __m128 force2 = _mm_setr_ps(forceStep.z_, forceStep.x_, forceStep.y_, forceStep.z_);
+    for (; i + 12 <= numFloats; i += 12)
+    {
+        _mm_storeu_ps(data + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(data + i), scale), force0));
+        _mm_storeu_ps(data + i + 4, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(data + i + 4), scale), force1));
+        _mm_storeu_ps(data + i + 8, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(data + i + 8), scale), force2));
+    }
+#endif
+
+    for (; i < numFloats; i += 3)
+    {
+        data[i] = data[i] * velocityScale + forceStep.x_;
+        data[i + 1] = data[i + 1] * velocityScale + forceStep.y_;
+        data[i + 2] = data[i + 2] * velocityScale + forceStep.z_;
+    }
+}
+
+static void AdvanceTimers(float* timers, unsigned count, float timeStep)
+{
+    unsigned i = 0;
+
+#ifdef ATOMIC_SSE
+    __m128 step = _mm_set1_ps(timeStep);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(timers + i, _mm_add_ps(_mm_loadu_ps(timers + i), step));
+#endif
+
+    for (; i < count; ++i)
+        timers[i] += timeStep;
+}
+
+static void IntegrateScales(float* scales, unsigned count, float add, float mul)
+{
+    unsigned i = 0;
+
+#ifdef ATOMIC_SSE
+    __m128 addVec = _mm_set1_ps(add);
+    __m128 mulVec = _mm_set1_ps(mul);
+    __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(scales + i, _mm_mul_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(scales + i), addVec), zero), mulVec));
+#endif
+
+    for (; i < count; ++i)
+        scales[i] = Max(scales[i] + add, 0.0f) * mul;
+}
+
+static inline void InterpolateColor(const ColorFrame& frame, const ColorFrame& next, float time, Color& dest)
+{
+#ifdef ATOMIC_SSE
+    // Lerp all four channels at once, in the same order as Color::Lerp()
+    float timeInterval = next.time_ - frame.time_;
+    if (timeInterval > 0.0f)
+    {
+        __m128 t = _mm_set1_ps((time - frame.time_) / timeInterval);
+        __m128 invT = _mm_sub_ps(_mm_set1_ps(1.0f), t);
+        __m128 start = _mm_loadu_ps(frame.color_.Data());
+        __m128 end = _mm_loadu_ps(next.color_.Data());
+        _mm_storeu_ps(&dest.r_, _mm_add_ps(_mm_mul_ps(start, invT), _mm_mul_ps(end, t)));
+        return;
+    }
+#endif
+
+    dest = frame.Interpolate(next, time);
+}
+
 ParticleEmitter::ParticleEmitter(Context* context) :
     BillboardSet(context),
     periodTimer_(0.0f),
@@ -110,10 +194,11 @@ void ParticleEmitter::Update(const FrameInfo& frame)
         return;
 
     // If there is an amount mismatch between particles and billboards, correct it
-    if (particles_.Size() != billboards_.Size())
-        SetNumBillboards(particles_.Size());
+    if (timers_.Size() != billboards_.Size())
+        SetNumBillboards(timers_.Size());
 
     bool needCommit = false;
+    bool enabledChanged = false;
 
     // Check active/inactive period switching
     periodTimer_ += lastTimeStep_;
@@ -161,102 +246,117 @@ void ParticleEmitter::Update(const FrameInfo& frame)
             {
                 --counter;
                 needCommit = true;
+                enabledChanged = true;
             }
             else
                 break;
         }
     }
 
-    // Update existing particles
-    Vector3 relativeConstantForce = node_->GetWorldRotation().Inverse() * effect_->GetConstantForce();
-    // If billboards are not relative, apply scaling to the position update
-    Vector3 scaleVector = Vector3::ONE;
-    if (scaled_ && !relative_)
-        scaleVector = node_->GetWorldScale();
-
-    for (unsigned i = 0; i < particles_.Size(); ++i)
+    // Update existing particles. The particle data is stored as separate arrays, so that the parts of the update
+    // which are uniform for all particles can be calculated in one go. Dead particles are integrated too, as their
+    // values are reset on emission
+    unsigned numParticles = timers_.Size();
+    for (unsigned i = 0; i < numParticles; ++i)
     {
-        Particle& particle = particles_[i];
         Billboard& billboard = *billboards_[i];
-
         if (billboard.enabled_)
         {
             needCommit = true;
 
             // Time to live
-            if (particle.timer_ >= particle.timeToLive_)
+            if (timers_[i] >= timesToLive_[i])
             {
                 billboard.enabled_ = false;
-                continue;
+                enabledChanged = true;
             }
-            particle.timer_ += lastTimeStep_;
+        }
+    }
 
-            // Velocity & position
-            const Vector3& constantForce = effect_->GetConstantForce();
-            if (constantForce != Vector3::ZERO)
-            {
-                if (relative_)
-                    particle.velocity_ += lastTimeStep_ * relativeConstantForce;
-                else
-                    particle.velocity_ += lastTimeStep_ * constantForce;
-            }
+    if (!needCommit)
+    {
+        needUpdate_ = false;
+        return;
+    }
 
-            float dampingForce = effect_->GetDampingForce();
-            if (dampingForce != 0.0f)
-            {
-                Vector3 force = -dampingForce * particle.velocity_;
-                particle.velocity_ += lastTimeStep_ * force;
-            }
-            billboard.position_ += lastTimeStep_ * particle.velocity_ * scaleVector;
-            billboard.direction_ = particle.velocity_.Normalized();
+    AdvanceTimers(&timers_[0], numParticles, lastTimeStep_);
 
-            // Rotation
-            billboard.rotation_ += lastTimeStep_ * particle.rotationSpeed_;
+    // Velocity
+    const Vector3& constantForce = effect_->GetConstantForce();
+    float dampingForce = effect_->GetDampingForce();
+    if (constantForce != Vector3::ZERO || dampingForce != 0.0f)
+    {
+        IntegrateVelocities(&velocities_[0], numParticles, relative_ ? node_->GetWorldRotation().Inverse() * constantForce :
+            constantForce, dampingForce, lastTimeStep_);
+    }
 
-            // Scaling
-            float sizeAdd = effect_->GetSizeAdd();
-            float sizeMul = effect_->GetSizeMul();
-            if (sizeAdd != 0.0f || sizeMul != 1.0f)
-            {
-                particle.scale_ += lastTimeStep_ * sizeAdd;
-                if (particle.scale_ < 0.0f)
-                    particle.scale_ = 0.0f;
-                if (sizeMul != 1.0f)
-                    particle.scale_ *= (lastTimeStep_ * (sizeMul - 1.0f)) + 1.0f;
-                billboard.size_ = particle.size_ * particle.scale_;
-            }
+    // Scaling
+    float sizeAdd = effect_->GetSizeAdd();
+    float sizeMul = effect_->GetSizeMul();
+    bool scaling = sizeAdd != 0.0f || sizeMul != 1.0f;
+    if (scaling)
+        IntegrateScales(&scales_[0], numParticles, lastTimeStep_ * sizeAdd, (lastTimeStep_ * (sizeMul - 1.0f)) + 1.0f);
 
-            // Color interpolation
-            unsigned& index = particle.colorIndex_;
-            const Vector<ColorFrame>& colorFrames_ = effect_->GetColorFrames();
-            if (index < colorFrames_.Size())
+    // If billboards are not relative, apply scaling to the position update
+    Vector3 positionStep(lastTimeStep_, lastTimeStep_, lastTimeStep_);
+    if (scaled_ && !relative_)
+        positionStep = positionStep * node_->GetWorldScale();
+
+    const Vector<ColorFrame>& colorFrames_ = effect_->GetColorFrames();
+    const Vector<TextureFrame>& textureFrames_ = effect_->GetTextureFrames();
+    unsigned firstLive = M_MAX_UNSIGNED;
+    unsigned lastLive = 0;
+
+    for (unsigned i = 0; i < numParticles; ++i)
+    {
+        Billboard& billboard = *billboards_[i];
+        if (!billboard.enabled_)
+            continue;
+
+        firstLive = Min(firstLive, i);
+        lastLive = i;
+
+        // Position & rotation
+        const Vector3& velocity = velocities_[i];
+        billboard.position_ += velocity * positionStep;
+        billboard.direction_ = velocity.Normalized();
+        billboard.rotation_ += lastTimeStep_ * rotationSpeeds_[i];
+        if (scaling)
+            billboard.size_ = sizes_[i] * scales_[i];
+
+        // Color interpolation
+        float timer = timers_[i];
+        unsigned& index = colorIndices_[i];
+        if (index < colorFrames_.Size())
+        {
+            if (index < colorFrames_.Size() - 1)
             {
-                if (index < colorFrames_.Size() - 1)
-                {
-                    if (particle.timer_ >= colorFrames_[index + 1].time_)
-                        ++index;
-                }
-                if (index < colorFrames_.Size() - 1)
-                    billboard.color_ = colorFrames_[index].Interpolate(colorFrames_[index + 1], particle.timer_);
-                else
-                    billboard.color_ = colorFrames_[index].color_;
+                if (timer >= colorFrames_[index + 1].time_)
+                    ++index;
             }
+            if (index < colorFrames_.Size() - 1)
+                InterpolateColor(colorFrames_[index], colorFrames_[index + 1], timer, billboard.color_);
+            else
+                billboard.color_ = colorFrames_[index].color_;
+        }
 
-            // Texture animation
-            unsigned& texIndex = particle.texIndex_;
-            const Vector<TextureFrame>& textureFrames_ = effect_->GetTextureFrames();
-            if (textureFrames_.Size() && texIndex < textureFrames_.Size() - 1)
+        // Texture animation
+        unsigned& texIndex = texIndices_[i];
+        if (textureFrames_.Size() && texIndex < textureFrames_.Size() - 1)
+        {
+            if (timer >= textureFrames_[texIndex + 1].time_)
             {
-                if (particle.timer_ >= textureFrames_[texIndex + 1].time_)
-                {
-                    billboard.uv_ = textureFrames_[texIndex + 1].uv_;
-                    ++texIndex;
-                }
+                billboard.uv_ = textureFrames_[texIndex + 1].uv_;
+                ++texIndex;
             }
         }
     }
 
-    if (needCommit)
+    // If no particle was emitted or expired, rewrite only the vertices of the live particles. Sorted emitters need the
+    // full update to sort the moved particles again
+    if (!enabledChanged && !sorted_ && firstLive <= lastLive)
+        CommitRange(firstLive, lastLive - firstLive + 1);
+    else
         Commit();
 
     needUpdate_ = false;
@@ -288,7 +388,14 @@ void ParticleEmitter::SetNumParticles(unsigned num)
     if (num > M_MAX_INT)
         num = 0;
 
-    particles_.Resize(num);
+    velocities_.Resize(num);
+    sizes_.Resize(num);
+    timers_.Resize(num);
+    timesToLive_.Resize(num);
+    scales_.Resize(num);
+    rotationSpeeds_.Resize(num);
+    colorIndices_.Resize(num);
+    texIndices_.Resize(num);
     SetNumBillboards(num);
 }
 
@@ -373,16 +480,16 @@ void ParticleEmitter::SetParticlesAttr(const VariantVector& value)
     unsigned index = 0;
     SetNumParticles(index < value.Size() ? value[index++].GetUInt() : 0);
 
-    for (PODVector<Particle>::Iterator i = particles_.Begin(); i != particles_.End() && index < value.Size(); ++i)
+    for (unsigned i = 0; i < timers_.Size() && index < value.Size(); ++i)
     {
-        i->velocity_ = value[index++].GetVector3();
-        i->size_ = value[index++].GetVector2();
-        i->timer_ = value[index++].GetFloat();
-        i->timeToLive_ = value[index++].GetFloat();
-        i->scale_ = value[index++].GetFloat();
-        i->rotationSpeed_ = value[index++].GetFloat();
-        i->colorIndex_ = (unsigned)value[index++].GetInt();
-        i->texIndex_ = (unsigned)value[index++].GetInt();
+        velocities_[i] = value[index++].GetVector3();
+        sizes_[i] = value[index++].GetVector2();
+        timers_[i] = value[index++].GetFloat();
+        timesToLive_[i] = value[index++].GetFloat();
+        scales_[i] = value[index++].GetFloat();
+        rotationSpeeds_[i] = value[index++].GetFloat();
+        colorIndices_[i] = (unsigned)value[index++].GetInt();
+        texIndices_[i] = (unsigned)value[index++].GetInt();
     }
 }
 
@@ -391,22 +498,22 @@ VariantVector ParticleEmitter::GetParticlesAttr() const
     VariantVector ret;
     if (!serializeParticles_)
     {
-        ret.Push(particles_.Size());
+        ret.Push(timers_.Size());
         return ret;
     }
 
-    ret.Reserve(particles_.Size() * 8 + 1);
-    ret.Push(particles_.Size());
-    for (PODVector<Particle>::ConstIterator i = particles_.Begin(); i != particles_.End(); ++i)
+    ret.Reserve(timers_.Size() * 8 + 1);
+    ret.Push(timers_.Size());
+    for (unsigned i = 0; i < timers_.Size(); ++i)
     {
-        ret.Push(i->velocity_);
-        ret.Push(i->size_);
-        ret.Push(i->timer_);
-        ret.Push(i->timeToLive_);
-        ret.Push(i->scale_);
-        ret.Push(i->rotationSpeed_);
-        ret.Push(i->colorIndex_);
-        ret.Push(i->texIndex_);
+        ret.Push(velocities_[i]);
+        ret.Push(sizes_[i]);
+        ret.Push(timers_[i]);
+        ret.Push(timesToLive_[i]);
+        ret.Push(scales_[i]);
+        ret.Push(rotationSpeeds_[i]);
+        ret.Push(colorIndices_[i]);
+        ret.Push(texIndices_[i]);
     }
     return ret;
 }
@@ -452,8 +559,7 @@ bool ParticleEmitter::EmitNewParticle()
     unsigned index = GetFreeParticle();
     if (index == M_MAX_UNSIGNED)
         return false;
-    assert(index < particles_.Size());
-    Particle& particle = particles_[index];
+    assert(index < timers_.Size());
     Billboard* billboard = billboards_[index];
 
     Vector3 startDir;
@@ -488,17 +594,17 @@ bool ParticleEmitter::EmitNewParticle()
         break;
     }
 
-    particle.size_ = effect_->GetRandomSize();
-    particle.timer_ = 0.0f;
-    particle.timeToLive_ = effect_->GetRandomTimeToLive();
-    particle.scale_ = 1.0f;
-    particle.rotationSpeed_ = effect_->GetRandomRotationSpeed();
-    particle.colorIndex_ = 0;
-    particle.texIndex_ = 0;
+    sizes_[index] = effect_->GetRandomSize();
+    timers_[index] = 0.0f;
+    timesToLive_[index] = effect_->GetRandomTimeToLive();
+    scales_[index] = 1.0f;
+    rotationSpeeds_[index] = effect_->GetRandomRotationSpeed();
+    colorIndices_[index] = 0;
+    texIndices_[index] = 0;
 
     if (faceCameraMode_ == FC_DIRECTION)
     {
-        startPos += startDir * particle.size_.y_;
+        startPos += startDir * sizes_[index].y_;
     }
 
     if (!relative_)
@@ -507,10 +613,10 @@ bool ParticleEmitter::EmitNewParticle()
         startDir = node_->GetWorldRotation() * startDir;
     };
 
-    particle.velocity_ = effect_->GetRandomVelocity() * startDir;
+    velocities_[index] = effect_->GetRandomVelocity() * startDir;
 
     billboard->position_ = startPos;
-    billboard->size_ = particles_[index].size_;
+    billboard->size_ = sizes_[index];
     const Vector<TextureFrame>& textureFrames_ = effect_->GetTextureFrames();
     billboard->uv_ = textureFrames_.Size() ? textureFrames_[0].uv_ : Rect::POSITIVE;
     billboard->rotation_ = effect_->GetRandomRotation();
@@ -29,27 +29,6 @@ namespace Atomic
 
 class ParticleEffect;
 
-/// One particle in the particle system.
-struct Particle
-{
-    /// Velocity.
-    Vector3 velocity_;
-    /// Original billboard size.
-    Vector2 size_;
-    /// Time elapsed from creation.
-    float timer_;
-    /// Lifetime.
-    float timeToLive_;
-    /// Size scaling value.
-    float scale_;
-    /// Rotation speed.
-    float rotationSpeed_;
-    /// Current color animation index.
-    unsigned colorIndex_;
-    /// Current texture animation index.
-    unsigned texIndex_;
-};
-
 /// %Particle emitter component.
 class ATOMIC_API ParticleEmitter : public BillboardSet
 {
@@ -91,7 +70,7 @@ public:
     ParticleEffect* GetEffect() const;
 
     /// Return maximum number of particles.
-    unsigned GetNumParticles() const { return particles_.Size(); }
+    unsigned GetNumParticles() const { return timers_.Size(); }
 
     /// Return whether is currently emitting.
     bool IsEmitting() const { return emitting_; }
@@ -132,8 +111,22 @@ private:
 
     /// Particle effect.
     SharedPtr<ParticleEffect> effect_;
-    /// Particles.
-    PODVector<Particle> particles_;
+    /// Particle velocities.
+    PODVector<Vector3> velocities_;
+    /// Particle original billboard sizes.
+    PODVector<Vector2> sizes_;
+    /// Particle times elapsed from creation.
+    PODVector<float> timers_;
+    /// Particle lifetimes.
+    PODVector<float> timesToLive_;
+    /// Particle size scaling values.
+    PODVector<float> scales_;
+    /// Particle rotation speeds.
+    PODVector<float> rotationSpeeds_;
+    /// Particle current color animation indices.
+    PODVector<unsigned> colorIndices_;
+    /// Particle current texture animation indices.
+    PODVector<unsigned> texIndices_;
     /// Active/inactive period timer.
     float periodTimer_;
     /// New particle emission timer.
@@ -183,7 +183,8 @@ static const char* geometryVSVariations[] =
     "BILLBOARD ",
     "DIRBILLBOARD ",
     "TRAILFACECAM ",
-    "TRAILBONE "
+    "TRAILBONE ",
+    "SKINNED DUALQUATERNION "
 };
 
 static const char* lightVSVariations[] =
@@ -265,6 +266,69 @@ inline PODVector<VertexElement> CreateInstancingBufferElements(unsigned numExtra
     return elements;
 }
 
+void ShaderCombinationUsage::AddLight(LightType type, bool shapeTexture, bool specular, bool shadowed, bool normalOffset)
+{
+    // Select the variations the same way as Renderer::SetBatchShaders()
+    unsigned vsi = 0;
+    unsigned psi = 0;
+    if (shadowed)
+    {
+        vsi += normalOffset ? LVS_SHADOWNORMALOFFSET : LVS_SHADOW;
+        psi += LPS_SHADOW;
+    }
+
+    switch (type)
+    {
+    case LIGHT_DIRECTIONAL:
+        vsi += LVS_DIR;
+        break;
+
+    case LIGHT_SPOT:
+        psi += LPS_SPOT;
+        vsi += LVS_SPOT;
+        break;
+
+    case LIGHT_POINT:
+        psi += shapeTexture ? LPS_POINTMASK : LPS_POINT;
+        vsi += LVS_POINT;
+        break;
+    }
+
+    // Materials without specular use the non-specular variation also with a specular light
+    Pair<unsigned, unsigned> variation(vsi, psi);
+    if (!lightVariations_.Contains(variation))
+        lightVariations_.Push(variation);
+
+    if (specular)
+    {
+        Pair<unsigned, unsigned> specularVariation(vsi, psi + LPS_SPEC);
+        if (!lightVariations_.Contains(specularVariation))
+            lightVariations_.Push(specularVariation);
+    }
+}
+
+void ShaderCombinationUsage::AddAll()
+{
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        bool shadowed = (i & 1) != 0;
+        bool normalOffset = (i & 2) != 0;
+        bool shapeTexture = (i & 4) != 0;
+        if (normalOffset && !shadowed)
+            continue;
+
+        if (!shapeTexture)
+        {
+            AddLight(LIGHT_DIRECTIONAL, false, true, shadowed, normalOffset);
+            AddLight(LIGHT_SPOT, false, true, shadowed, normalOffset);
+        }
+        AddLight(LIGHT_POINT, shapeTexture, true, shadowed, normalOffset);
+    }
+
+    geometryTypes_ = (1 << MAX_GEOMETRYTYPES) - 1;
+    heightFog_ = true;
+}
+
 Renderer::Renderer(Context* context) :
     Object(context),
     defaultZone_(new Zone(context)),
@@ -285,6 +349,9 @@ Renderer::Renderer(Context* context) :
     maxOccluderTriangles_(5000),
     occlusionBufferSize_(256),
     occluderSizeThreshold_(0.025f),
+    temporalVisibilityMaxMove_(1.0f),
+    temporalVisibilityMaxRotation_(5.0f),
+    temporalVisibilityInterval_(8),
     mobileShadowBiasMul_(1.0f),
     mobileShadowBiasAdd_(0.0f),
     mobileNormalOffsetMul_(1.0f),
@@ -298,6 +365,8 @@ Renderer::Renderer(Context* context) :
     dynamicInstancing_(true),
     numExtraInstancingBufferElements_(0),
     threadedOcclusion_(false),
+    temporalVisibility_(false),
+    shadowMapCaching_(false),
     shadersDirty_(true),
     initialized_(false),
     resetViews_(false)
@@ -558,11 +627,60 @@ void Renderer::SetThreadedOcclusion(bool enable)
     }
 }
 
+void Renderer::SetTemporalVisibility(bool enable)
+{
+    temporalVisibility_ = enable;
+}
+
+void Renderer::SetTemporalVisibilityMaxMove(float distance)
+{
+    temporalVisibilityMaxMove_ = Max(distance, 0.0f);
+}
+
+void Renderer::SetTemporalVisibilityMaxRotation(float angle)
+{
+    temporalVisibilityMaxRotation_ = Clamp(angle, 0.0f, 180.0f);
+}
+
+void Renderer::SetTemporalVisibilityInterval(int frames)
+{
+    temporalVisibilityInterval_ = Max(frames, 1);
+}
+
+void Renderer::SetShadowMapCaching(bool enable)
+{
+    if (enable != shadowMapCaching_)
+    {
+        shadowMapCaching_ = enable;
+        cachedShadowMaps_.Clear();
+        movedShadowCasters_.Clear();
+    }
+}
+
 void Renderer::ReloadShaders()
 {
     shadersDirty_ = true;
 }
 
+Material* Renderer::GetSharedMaterial(Material* material)
+{
+    if (!material)
+        return 0;
+
+    unsigned hash = material->GetStateHash();
+    HashMap<unsigned, WeakPtr<Material> >::Iterator i = sharedMaterials_.Find(hash);
+    if (i != sharedMaterials_.End() && i->second_)
+    {
+        Material* shared = i->second_;
+        if (shared->GetStateHash() == hash)
+            return material->HasSameState(shared) ? shared : material;
+    }
+
+    // First material with this state, or the previous one has been destroyed or modified
+    sharedMaterials_[hash] = material;
+    return material;
+}
+
 void Renderer::ApplyShadowMapFilter(View* view, Texture2D* shadowMap, float blurScale)
 {
     if (shadowMapFilterInstance_ && shadowMapFilter_)
@@ -682,6 +800,16 @@ void Renderer::Update(float timeStep)
     numOcclusionBuffers_ = 0;
     updatedOctrees_.Clear();
 
+    // Moved shadow casters are only tracked for one frame, so cached shadow maps that were not used on the previous frame
+    // can not be trusted anymore
+    movedShadowCasters_.Clear();
+    for (HashMap<Pair<Light*, Camera*>, CachedShadowMap>::Iterator i = cachedShadowMaps_.Begin(); i != cachedShadowMaps_.End();)
+    {
+        HashMap<Pair<Light*, Camera*>, CachedShadowMap>::Iterator current = i++;
+        if (current->second_.frameNumber_ + 1 != frame_.frameNumber_)
+            cachedShadowMaps_.Erase(current);
+    }
+
     // Reload shaders now if needed
     if (shadersDirty_)
         LoadShaders();
@@ -852,6 +980,79 @@ Geometry* Renderer::GetQuadGeometry()
 }
 
 Texture2D* Renderer::GetShadowMap(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight)
+{
+    IntVector2 size = CalculateShadowMapSize(light, camera, viewWidth, viewHeight);
+    int width = size.x_;
+    int height = size.y_;
+
+    int searchKey = (width << 16) | height;
+    if (shadowMaps_.Contains(searchKey))
+    {
+        // If shadow maps are reused, always return the first
+        if (reuseShadowMaps_)
+            return shadowMaps_[searchKey][0];
+        else
+        {
+            // If not reused, check allocation count and return existing shadow map if possible
+            unsigned allocated = shadowMapAllocations_[searchKey].Size();
+            if (allocated < shadowMaps_[searchKey].Size())
+            {
+                shadowMapAllocations_[searchKey].Push(light);
+                return shadowMaps_[searchKey][allocated];
+            }
+            else if ((int)allocated >= maxShadowMaps_)
+                return 0;
+        }
+    }
+
+    SharedPtr<Texture2D> newShadowMap = CreateShadowMap(width, height);
+    // If failed, store a null pointer so that we will not retry
+    shadowMaps_[searchKey].Push(newShadowMap);
+    if (!reuseShadowMaps_)
+        shadowMapAllocations_[searchKey].Push(light);
+
+    return newShadowMap;
+}
+
+CachedShadowMap* Renderer::GetCachedShadowMap(Light* light, Camera* camera, Texture2D* shadowMap)
+{
+    // The static layer is copied to the shadow map by a shader writing depth from a raw depth texture read. Direct3D9 hardware
+    // shadow maps and OpenGL ES 2 can not do that. VSM shadow maps are color rendertargets, whose depth could not be restored
+#if defined(GL_ES_VERSION_2_0) || (!defined(ATOMIC_OPENGL) && !defined(ATOMIC_D3D11))
+    bool supported = false;
+#else
+    bool supported = shadowQuality_ != SHADOWQUALITY_VSM && shadowQuality_ != SHADOWQUALITY_BLUR_VSM;
+#endif
+    if (!shadowMapCaching_ || !supported || !shadowMap)
+        return 0;
+
+    int width = shadowMap->GetWidth();
+    int height = shadowMap->GetHeight();
+    Pair<Light*, Camera*> key(light, camera);
+    CachedShadowMap& entry = cachedShadowMaps_[key];
+
+    // Create a new static layer if first use or the shadow map size changed
+    if (!entry.shadowMap_ || entry.shadowMap_->GetWidth() != width || entry.shadowMap_->GetHeight() != height)
+    {
+        entry.shadowMap_ = CreateShadowMap(width, height);
+        entry.splitHashes_.Clear();
+
+        if (!entry.shadowMap_ || entry.shadowMap_->GetWidth() != width)
+        {
+            cachedShadowMaps_.Erase(key);
+            return 0;
+        }
+
+        // The static layer is only read back as raw depth texel by texel
+        entry.shadowMap_->SetShadowCompare(false);
+        entry.shadowMap_->SetFilterMode(FILTER_NEAREST);
+    }
+
+    entry.frameNumber_ = frame_.frameNumber_;
+    return &entry;
+}
+
+IntVector2 Renderer::CalculateShadowMapSize(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight) const
 {
     LightType type = light->GetLightType();
     const FocusParameters& parameters = light->GetShadowFocus();
@@ -907,25 +1108,18 @@ Texture2D* Renderer::GetShadowMap(Light* light, Camera* camera, unsigned viewWid
         height *= 3;
     }
 
+    return IntVector2(width, height);
+}
+
+void Renderer::MarkShadowCasterMoved(Drawable* drawable)
+{
+    if (shadowMapCaching_)
+        movedShadowCasters_.Insert(drawable);
+}
+
+SharedPtr<Texture2D> Renderer::CreateShadowMap(int width, int height)
+{
     int searchKey = (width << 16) | height;
-    if (shadowMaps_.Contains(searchKey))
-    {
-        // If shadow maps are reused, always return the first
-        if (reuseShadowMaps_)
-            return shadowMaps_[searchKey][0];
-        else
-        {
-            // If not reused, check allocation count and return existing shadow map if possible
-            unsigned allocated = shadowMapAllocations_[searchKey].Size();
-            if (allocated < shadowMaps_[searchKey].Size())
-            {
-                shadowMapAllocations_[searchKey].Push(light);
-                return shadowMaps_[searchKey][allocated];
-            }
-            else if ((int)allocated >= maxShadowMaps_)
-                return 0;
-        }
-    }
 
     // Find format and usage of the shadow map
     unsigned shadowMapFormat = 0;
@@ -953,7 +1147,7 @@ Texture2D* Renderer::GetShadowMap(Light* light, Camera* camera, unsigned viewWid
     }
 
     if (!shadowMapFormat)
-        return 0;
+        return SharedPtr<Texture2D>();
 
     SharedPtr<Texture2D> newShadowMap(new Texture2D(context_));
     int retries = 3;
@@ -1000,14 +1194,9 @@ Texture2D* Renderer::GetShadowMap(Light* light, Camera* camera, unsigned viewWid
         }
     }
 
-    // If failed to set size, store a null pointer so that we will not retry
     if (!retries)
         newShadowMap.Reset();
 
-    shadowMaps_[searchKey].Push(newShadowMap);
-    if (!reuseShadowMaps_)
-        shadowMapAllocations_[searchKey].Push(light);
-
     return newShadowMap;
 }
 
@@ -1177,6 +1366,56 @@ View* Renderer::GetActualView(View* view)
         return view;
 }
 
+void Renderer::GetPassShaderCombinations(Pass* pass, const String& shadowVariations, const ShaderCombinationUsage& usage,
+    Vector<Pair<String, String> >& dest)
+{
+    String vsDefines = pass->GetEffectiveVertexShaderDefines();
+    String psDefines = pass->GetEffectivePixelShaderDefines();
+
+    if (vsDefines.Length() && !vsDefines.EndsWith(" "))
+        vsDefines += ' ';
+    if (psDefines.Length() && !psDefines.EndsWith(" "))
+        psDefines += ' ';
+
+    unsigned numFogVariations = usage.heightFog_ ? 2 : 1;
+
+    for (unsigned g = 0; g < MAX_GEOMETRYTYPES; ++g)
+    {
+        if (!(usage.geometryTypes_ & (1 << g)))
+            continue;
+
+        if (pass->GetLightingMode() == LIGHTING_PERPIXEL)
+        {
+            for (unsigned l = 0; l < usage.lightVariations_.Size(); ++l)
+            {
+                unsigned vsi = usage.lightVariations_[l].first_;
+                unsigned psi = usage.lightVariations_[l].second_;
+                String vs = vsDefines + lightVSVariations[vsi] + geometryVSVariations[g];
+                String ps = psDefines + lightPSVariations[psi];
+                if (psi & LPS_SHADOW)
+                    ps += shadowVariations;
+
+                for (unsigned h = 0; h < numFogVariations; ++h)
+                    dest.Push(MakePair(vs, ps + heightFogVariations[h]));
+            }
+        }
+        else if (pass->GetLightingMode() == LIGHTING_PERVERTEX)
+        {
+            for (unsigned l = 0; l < MAX_VERTEXLIGHT_VS_VARIATIONS; ++l)
+            {
+                for (unsigned h = 0; h < numFogVariations; ++h)
+                    dest.Push(MakePair(vsDefines + vertexLightVSVariations[l] + geometryVSVariations[g], psDefines +
+                        heightFogVariations[h]));
+            }
+        }
+        else
+        {
+            for (unsigned h = 0; h < numFogVariations; ++h)
+                dest.Push(MakePair(vsDefines + geometryVSVariations[g], psDefines + heightFogVariations[h]));
+        }
+    }
+}
+
 void Renderer::SetBatchShaders(Batch& batch, Technique* tech, bool allowShadows, const BatchQueue& queue)
 {
     Pass* pass = batch.pass_;
@@ -1919,6 +2158,7 @@ void Renderer::ResetShadowMaps()
     shadowMaps_.Clear();
     shadowMapAllocations_.Clear();
     colorShadowMaps_.Clear();
+    cachedShadowMaps_.Clear();
 }
 
 void Renderer::ResetBuffers()
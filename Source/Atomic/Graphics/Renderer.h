@@ -26,6 +26,7 @@
 #include "../Core/Mutex.h"
 #include "../Graphics/Batch.h"
 #include "../Graphics/Drawable.h"
+#include "../Graphics/Light.h"
 #include "../Graphics/Viewport.h"
 #include "../Math/Color.h"
 
@@ -168,6 +169,42 @@ enum DeferredLightPSVariation
     MAX_DEFERRED_LIGHT_PS_VARIATIONS
 };
 
+/// Lights, geometry types and fog used by a project's scenes. Limits the shader combinations enumerated for offline precaching.
+struct ATOMIC_API ShaderCombinationUsage
+{
+    /// Construct with nothing used.
+    ShaderCombinationUsage() :
+        geometryTypes_(0),
+        heightFog_(false)
+    {
+    }
+
+    /// Add a per-pixel light.
+    void AddLight(LightType type, bool shapeTexture, bool specular, bool shadowed, bool normalOffset);
+    /// Add a geometry type.
+    void AddGeometryType(GeometryType type) { geometryTypes_ |= 1 << type; }
+    /// Add every light, geometry type and fog variation the forward renderer supports.
+    void AddAll();
+
+    /// Light vertex and pixel shader variation pairs.
+    PODVector<Pair<unsigned, unsigned> > lightVariations_;
+    /// Geometry types as a bitmask of 1 << GeometryType.
+    unsigned geometryTypes_;
+    /// Height fog flag.
+    bool heightFog_;
+};
+
+/// Persistent static shadow caster layer of a light, reused while its static shadow casters and shadow cameras are unchanged.
+struct CachedShadowMap
+{
+    /// Static shadow caster depth texture. Copied to the light's shadow map each frame before the dynamic casters.
+    SharedPtr<Texture2D> shadowMap_;
+    /// Content hash of each split as last rendered. Zero if the split is not valid.
+    PODVector<unsigned> splitHashes_;
+    /// Frame number on which last used.
+    unsigned frameNumber_;
+};
+
 /// High-level rendering subsystem. Manages drawing of 3D views.
 class ATOMIC_API Renderer : public Object
 {
@@ -237,6 +274,16 @@ public:
     void SetOccluderSizeThreshold(float screenSize);
     /// Set whether to thread occluder rendering. Default false.
     void SetThreadedOcclusion(bool enable);
+    /// Set whether to cache the static, unmoved shadow casters of lights and render only the dynamic casters every frame. Needs Direct3D11 or desktop OpenGL and a non-VSM shadow quality. Default false.
+    void SetShadowMapCaching(bool enable);
+    /// Set whether views reuse the previous frame's visibility results: octree query results of unchanged octants that stay inside the camera, light and shadow camera volumes, and occlusion results of drawables and octants that were visible. Default false.
+    void SetTemporalVisibility(bool enable);
+    /// Set maximum camera movement per frame for reusing occlusion results. Larger jumps force a full visibility test.
+    void SetTemporalVisibilityMaxMove(float distance);
+    /// Set maximum camera rotation in degrees per frame for reusing occlusion results. Larger jumps force a full visibility test.
+    void SetTemporalVisibilityMaxRotation(float angle);
+    /// Set number of frames between forced full visibility tests when reusing occlusion results.
+    void SetTemporalVisibilityInterval(int frames);
     /// Set shadow depth bias multiplier for mobile platforms to counteract possible worse shadow map precision. Default 1.0 (no effect.)
     void SetMobileShadowBiasMul(float mul);
     /// Set shadow depth bias addition for mobile platforms to counteract possible worse shadow map precision. Default 0.0 (no effect.)
@@ -325,6 +372,21 @@ public:
     /// Return whether occlusion rendering is threaded.
     bool GetThreadedOcclusion() const { return threadedOcclusion_; }
 
+    /// Return whether shadow maps of static shadow casters are cached.
+    bool GetShadowMapCaching() const { return shadowMapCaching_; }
+
+    /// Return whether views reuse the previous frame's occlusion results.
+    bool GetTemporalVisibility() const { return temporalVisibility_; }
+
+    /// Return maximum camera movement per frame for reusing occlusion results.
+    float GetTemporalVisibilityMaxMove() const { return temporalVisibilityMaxMove_; }
+
+    /// Return maximum camera rotation in degrees per frame for reusing occlusion results.
+    float GetTemporalVisibilityMaxRotation() const { return temporalVisibilityMaxRotation_; }
+
+    /// Return number of frames between forced full visibility tests.
+    int GetTemporalVisibilityInterval() const { return temporalVisibilityInterval_; }
+
     /// Return shadow depth bias multiplier for mobile platforms.
     float GetMobileShadowBiasMul() const { return mobileShadowBiasMul_; }
 
@@ -357,6 +419,8 @@ public:
 
     /// Return the default material.
     Material* GetDefaultMaterial() const { return defaultMaterial_; }
+    /// Return the material shared by all materials with the same render state as the given material. Registers the material if it is the first with its state.
+    Material* GetSharedMaterial(Material* material);
 
     /// Return the default range attenuation texture.
     Texture2D* GetDefaultLightRamp() const { return defaultLightRamp_; }
@@ -393,6 +457,12 @@ public:
     Geometry* GetQuadGeometry();
     /// Allocate a shadow map. If shadow map reuse is disabled, a different map is returned each time.
     Texture2D* GetShadowMap(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight);
+    /// Return a persistent static caster layer matching a light's shadow map, seen from a camera. Return null if shadow map caching is disabled or not possible. Called by View.
+    CachedShadowMap* GetCachedShadowMap(Light* light, Camera* camera, Texture2D* shadowMap);
+    /// Notify that a shadow caster has moved, so that cached shadow maps are not reused for it on this frame. Called by Octree.
+    void MarkShadowCasterMoved(Drawable* drawable);
+    /// Return whether a shadow caster has moved on this frame.
+    bool IsShadowCasterMoved(Drawable* drawable) const { return movedShadowCasters_.Contains(drawable); }
     /// Allocate a rendertarget or depth-stencil texture for deferred rendering or postprocessing. Should only be called during actual rendering, not before.
     Texture* GetScreenBuffer
         (int width, int height, unsigned format, int multiSample, bool autoResolve, bool cubemap, bool filtered, bool srgb, unsigned persistentKey = 0);
@@ -424,6 +494,9 @@ public:
 
     /// Return a view or its source view if it uses one. Used internally for render statistics.
     static View* GetActualView(View* view);
+    /// Return the vertex and pixel shader define combinations a material pass can use in the forward renderer with the given lights and geometry, for offline shader precaching. Shadow variations are appended to shadowed pixel shaders.
+    static void GetPassShaderCombinations(Pass* pass, const String& shadowVariations, const ShaderCombinationUsage& usage,
+        Vector<Pair<String, String> >& dest);
 
 // ATOMIC BEGIN (public)
     /// Reload textures.
@@ -455,6 +528,10 @@ private:
     void ResetShadowMapAllocations();
     /// Reset screem buffer allocation counts.
     void ResetScreenBufferAllocations();
+    /// Calculate shadow map size for a light.
+    IntVector2 CalculateShadowMapSize(Light* light, Camera* camera, unsigned viewWidth, unsigned viewHeight) const;
+    /// Create a shadow map texture with the current shadow quality. Size is halved on failure up to three times.
+    SharedPtr<Texture2D> CreateShadowMap(int width, int height);
     /// Remove all shadow maps. Called when global shadow map resolution or format is changed.
     void ResetShadowMaps();
     /// Remove all occlusion and screen buffers.
@@ -486,6 +563,8 @@ private:
     SharedPtr<VertexBuffer> instancingBuffer_;
     /// Default material.
     SharedPtr<Material> defaultMaterial_;
+    /// Materials shared for batching by render state hash.
+    HashMap<unsigned, WeakPtr<Material> > sharedMaterials_;
     /// Default range attenuation texture.
     SharedPtr<Texture2D> defaultLightRamp_;
     /// Default spotlight attenuation texture.
@@ -504,6 +583,10 @@ private:
     HashMap<int, SharedPtr<Texture2D> > colorShadowMaps_;
     /// Shadow map allocations by resolution.
     HashMap<int, PODVector<Light*> > shadowMapAllocations_;
+    /// Persistent shadow maps by light and camera.
+    HashMap<Pair<Light*, Camera*>, CachedShadowMap> cachedShadowMaps_;
+    /// Shadow casters that have moved on this frame.
+    HashSet<Drawable*> movedShadowCasters_;
     /// Instance of shadow map filter
     Object* shadowMapFilterInstance_;
     /// Function pointer of shadow map filter
@@ -564,6 +647,12 @@ private:
     int occlusionBufferSize_;
     /// Occluder screen size threshold.
     float occluderSizeThreshold_;
+    /// Maximum camera movement per frame for reusing occlusion results.
+    float temporalVisibilityMaxMove_;
+    /// Maximum camera rotation per frame for reusing occlusion results.
+    float temporalVisibilityMaxRotation_;
+    /// Frames between forced full visibility tests.
+    int temporalVisibilityInterval_;
     /// Mobile platform shadow depth bias multiplier.
     float mobileShadowBiasMul_;
     /// Mobile platform shadow depth bias addition.
@@ -596,6 +685,10 @@ private:
     int numExtraInstancingBufferElements_;
     /// Threaded occlusion rendering flag.
     bool threadedOcclusion_;
+    /// Temporal visibility reuse flag.
+    bool temporalVisibility_;
+    /// Shadow map caching flag.
+    bool shadowMapCaching_;
     /// Shaders need reloading flag.
     bool shadersDirty_;
     /// Initialized flag.
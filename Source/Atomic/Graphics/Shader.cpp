@@ -64,6 +64,7 @@ void CommentOutFunction(String& code, const String& signature)
 Shader::Shader(Context* context) :
     Resource(context),
     timeStamp_(0),
+    sourceHash_(0),
     numVariations_(0)
 {
     RefreshMemoryUse();
@@ -93,6 +94,8 @@ bool Shader::BeginLoad(Deserializer& source)
     if (!ProcessSource(shaderCode, source))
         return false;
 
+    sourceHash_ = StringHash(shaderCode).Value();
+
     // Comment out the unneeded shader function
     vsSourceCode_ = shaderCode;
     psSourceCode_ = shaderCode;
@@ -59,6 +59,9 @@ public:
     /// Return the latest timestamp of the shader code and its includes.
     unsigned GetTimeStamp() const { return timeStamp_; }
 
+    /// Return hash of the shader code with includes resolved. Used to key the on-disk shader cache.
+    unsigned GetSourceHash() const { return sourceHash_; }
+
 private:
     /// Process source code and include files. Return true if successful.
     bool ProcessSource(String& code, Deserializer& file);
@@ -77,6 +80,8 @@ private:
     HashMap<StringHash, SharedPtr<ShaderVariation> > psVariations_;
     /// Source code timestamp.
     unsigned timeStamp_;
+    /// Source code hash.
+    unsigned sourceHash_;
     /// Number of unique variations so far.
     unsigned numVariations_;
 };
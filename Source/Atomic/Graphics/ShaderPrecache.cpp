@@ -22,6 +22,9 @@
 
 #include "../Precompiled.h"
 
+#include "../Core/CoreEvents.h"
+#include "../Core/Profiler.h"
+#include "../Core/Timer.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/GraphicsImpl.h"
 #include "../Graphics/ShaderPrecache.h"
@@ -35,6 +38,12 @@
 namespace Atomic
 {
 
+void PrecompileShaderWork(const WorkItem* item, unsigned threadIndex)
+{
+    ShaderVariation* variation = reinterpret_cast<ShaderVariation*>(item->start_);
+    variation->Precompile();
+}
+
 ShaderPrecache::ShaderPrecache(Context* context, const String& fileName) :
     Object(context),
     fileName_(fileName),
@@ -104,11 +113,56 @@ void ShaderPrecache::StoreShaders(ShaderVariation* vs, ShaderVariation* ps)
     shaderElem.SetAttribute("psdefines", psDefines);
 }
 
-void ShaderPrecache::LoadShaders(Graphics* graphics, Deserializer& source)
+void ShaderPrecache::LoadShaders(Graphics* graphics, Deserializer& source, unsigned maxThreads)
 {
     ATOMIC_LOGDEBUG("Begin precaching shaders");
 
-    XMLFile xmlFile(graphics->GetContext());
+    // Prepare the bytecode in worker threads with the main thread helping, then create the shaders
+    ShaderPrecompiler precompiler(graphics->GetContext());
+    precompiler.SetMaxThreads(maxThreads);
+    precompiler.Load(source, M_MAX_UNSIGNED);
+    precompiler.Update(0);
+
+    ATOMIC_LOGDEBUG("End precaching shaders");
+}
+
+ShaderPrecompiler::ShaderPrecompiler(Context* context) :
+    Object(context),
+    numQueued_(0),
+    maxThreads_(0),
+    priority_(0),
+    numCreated_(0),
+    maxMsPerFrame_(0)
+{
+}
+
+ShaderPrecompiler::~ShaderPrecompiler()
+{
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+
+    // Work items that have already started must finish before the shader variations can be released
+    for (HashMap<ShaderVariation*, SharedPtr<WorkItem> >::Iterator i = workItems_.Begin(); i != workItems_.End(); ++i)
+    {
+        if (!i->second_)
+            continue;
+
+        if (!queue || !queue->RemoveWorkItem(i->second_))
+        {
+            while (!i->second_->completed_)
+                Time::Sleep(1);
+        }
+    }
+}
+
+void ShaderPrecompiler::Load(Deserializer& source, unsigned priority)
+{
+    Graphics* graphics = GetSubsystem<Graphics>();
+    if (!graphics)
+        return;
+
+    priority_ = priority;
+
+    XMLFile xmlFile(context_);
     xmlFile.Load(source);
 
     XMLElement shader = xmlFile.GetRoot().GetChild("shader");
@@ -132,13 +186,131 @@ void ShaderPrecache::LoadShaders(Graphics* graphics, Deserializer& source)
 
         ShaderVariation* vs = graphics->GetShader(VS, shader.GetAttribute("vs"), vsDefines);
         ShaderVariation* ps = graphics->GetShader(PS, shader.GetAttribute("ps"), psDefines);
-        // Set the shaders active to actually compile them
-        graphics->SetShaders(vs, ps);
+        if (vs && ps)
+        {
+            combinations_.Push(MakePair(SharedPtr<ShaderVariation>(vs), SharedPtr<ShaderVariation>(ps)));
+            AddVariation(vs);
+            AddVariation(ps);
+        }
 
         shader = shader.GetNext("shader");
     }
 
-    ATOMIC_LOGDEBUG("End precaching shaders");
+    QueuePending();
+}
+
+void ShaderPrecompiler::StartBackground(int maxMsPerFrame)
+{
+    maxMsPerFrame_ = Max(maxMsPerFrame, 1);
+
+    if (!IsFinished())
+        SubscribeToEvent(E_BEGINFRAME, ATOMIC_HANDLER(ShaderPrecompiler, HandleBeginFrame));
+}
+
+bool ShaderPrecompiler::Update(int maxMs)
+{
+    ATOMIC_PROFILE(PrecompileShaders);
+
+    Graphics* graphics = GetSubsystem<Graphics>();
+    if (!graphics)
+        return true;
+
+    if (!maxMs)
+    {
+        // Help the worker threads before creating everything, queueing more bytecode as the thread limit allows
+        WorkQueue* queue = GetSubsystem<WorkQueue>();
+        if (queue)
+        {
+            for (;;)
+            {
+                queue->Complete(0);
+                if (numQueued_ >= pendingVariations_.Size())
+                    break;
+                QueuePending();
+            }
+        }
+    }
+    else
+        QueuePending();
+
+    HiresTimer timer;
+    long long maxUsec = (long long)maxMs * 1000;
+
+    while (numCreated_ < combinations_.Size())
+    {
+        ShaderVariation* vs = combinations_[numCreated_].first_;
+        ShaderVariation* ps = combinations_[numCreated_].second_;
+
+        // Creating the shaders waits for the bytecode, so in background mode only continue when it is ready
+        if (maxMs && (!IsPrepared(vs) || !IsPrepared(ps)))
+            break;
+
+        // Set the shaders active to actually create them, and to link the program on OpenGL
+        graphics->SetShaders(vs, ps);
+        ++numCreated_;
+
+        if (maxMs && timer.GetUSec(false) >= maxUsec)
+            break;
+    }
+
+    return IsFinished();
+}
+
+void ShaderPrecompiler::AddVariation(ShaderVariation* variation)
+{
+#ifndef ATOMIC_OPENGL
+    if (variation->GetGPUObject() || workItems_.Contains(variation) || !GetSubsystem<WorkQueue>())
+        return;
+
+    workItems_[variation] = SharedPtr<WorkItem>();
+    pendingVariations_.Push(variation);
+#endif
+}
+
+void ShaderPrecompiler::QueuePending()
+{
+    if (numQueued_ >= pendingVariations_.Size())
+        return;
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (!queue)
+        return;
+
+    for (unsigned i = activeItems_.Size() - 1; i < activeItems_.Size(); --i)
+    {
+        if (activeItems_[i]->completed_)
+            activeItems_.EraseSwap(i);
+    }
+
+    while (numQueued_ < pendingVariations_.Size() && (!maxThreads_ || activeItems_.Size() < maxThreads_))
+    {
+        ShaderVariation* variation = pendingVariations_[numQueued_++];
+
+        // Not taken from the work queue's pool, as the items are held on to until the precompiler is destroyed
+        SharedPtr<WorkItem> item(new WorkItem());
+        item->priority_ = priority_;
+        item->workFunction_ = PrecompileShaderWork;
+        item->start_ = variation;
+        queue->AddWorkItem(item);
+
+        workItems_[variation] = item;
+        activeItems_.Push(item);
+    }
+}
+
+bool ShaderPrecompiler::IsPrepared(ShaderVariation* variation) const
+{
+    HashMap<ShaderVariation*, SharedPtr<WorkItem> >::ConstIterator i = workItems_.Find(variation);
+    return i == workItems_.End() || (i->second_ && i->second_->completed_);
+}
+
+void ShaderPrecompiler::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (Update(maxMsPerFrame_))
+    {
+        UnsubscribeFromEvent(E_BEGINFRAME);
+        ATOMIC_LOGDEBUG("Finished precaching " + String(combinations_.Size()) + " shader combinations in the background");
+    }
 }
 
 }
@@ -24,6 +24,7 @@
 
 #include "../Container/HashSet.h"
 #include "../Core/Object.h"
+#include "../Core/WorkQueue.h"
 #include "../Resource/XMLFile.h"
 
 namespace Atomic
@@ -46,8 +47,8 @@ public:
     /// Collect a shader combination. Called by Graphics when shaders have been set.
     void StoreShaders(ShaderVariation* vs, ShaderVariation* ps);
 
-    /// Load shaders from an XML file.
-    static void LoadShaders(Graphics* graphics, Deserializer& source);
+    /// Load shaders from an XML file. Bytecode is compiled in at most maxThreads worker threads, zero for all.
+    static void LoadShaders(Graphics* graphics, Deserializer& source, unsigned maxThreads = 0);
 
 private:
     /// XML file name.
@@ -60,4 +61,63 @@ private:
     HashSet<String> usedCombinations_;
 };
 
+/// Utility class for compiling the shader combinations of a precache file. Bytecode is loaded from the shader cache or
+/// compiled in worker threads, while the GPU shaders are created on the main thread, either all at once or within a
+/// time budget each frame, for example during a loading screen.
+class ATOMIC_API ShaderPrecompiler : public Object
+{
+    ATOMIC_OBJECT(ShaderPrecompiler, Object);
+
+public:
+    /// Construct.
+    ShaderPrecompiler(Context* context);
+    /// Destruct. Wait for bytecode that is being compiled in worker threads.
+    ~ShaderPrecompiler();
+
+    /// Set maximum number of worker threads preparing bytecode at once, so that the rest stay free for other work. Zero (default) uses all. Call before Load().
+    void SetMaxThreads(unsigned num) { maxThreads_ = num; }
+    /// Read shader combinations from an XML file and queue their bytecode for worker threads with the given priority.
+    void Load(Deserializer& source, unsigned priority = 0);
+    /// Create the GPU shaders at the beginning of each frame using at most the given time in milliseconds.
+    void StartBackground(int maxMsPerFrame);
+    /// Create the GPU shaders of combinations whose bytecode is ready, until the time budget is used. Zero budget creates all, waiting for the worker threads as necessary. Return true when finished.
+    bool Update(int maxMs);
+
+    /// Return number of shader combinations.
+    unsigned GetNumCombinations() const { return combinations_.Size(); }
+    /// Return number of shader combinations created so far.
+    unsigned GetNumCreated() const { return numCreated_; }
+    /// Return whether all combinations have been created.
+    bool IsFinished() const { return numCreated_ >= combinations_.Size(); }
+
+private:
+    /// Add a shader variation for bytecode preparation.
+    void AddVariation(ShaderVariation* variation);
+    /// Queue pending bytecode preparation up to the thread limit.
+    void QueuePending();
+    /// Return whether the bytecode of a shader variation is ready.
+    bool IsPrepared(ShaderVariation* variation) const;
+    /// Handle frame begin event.
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+
+    /// Shader combinations.
+    Vector<Pair<SharedPtr<ShaderVariation>, SharedPtr<ShaderVariation> > > combinations_;
+    /// Bytecode work items by shader variation. Null until queued.
+    HashMap<ShaderVariation*, SharedPtr<WorkItem> > workItems_;
+    /// Shader variations in bytecode preparation order.
+    PODVector<ShaderVariation*> pendingVariations_;
+    /// Work items queued and not yet completed.
+    PODVector<WorkItem*> activeItems_;
+    /// Number of pending variations queued so far.
+    unsigned numQueued_;
+    /// Maximum number of work items queued at once. Zero for no limit.
+    unsigned maxThreads_;
+    /// Work item priority.
+    unsigned priority_;
+    /// Number of combinations created.
+    unsigned numCreated_;
+    /// Time budget per frame in background mode.
+    int maxMsPerFrame_;
+};
+
 }
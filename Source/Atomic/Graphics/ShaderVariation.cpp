@@ -35,7 +35,8 @@ ShaderVariation::ShaderVariation(Shader* owner, ShaderType type) :
     GPUObject(owner->GetSubsystem<Graphics>()),
     owner_(owner),
     type_(type),
-    elementHash_(0)
+    elementHash_(0),
+    byteCodePrepared_(false)
 {
     for (unsigned i = 0; i < MAX_TEXTURE_UNITS; ++i)
         useTextureUnit_[i] = false;
@@ -25,6 +25,7 @@
 #include "../Container/HashMap.h"
 #include "../Container/RefCounted.h"
 #include "../Container/ArrayPtr.h"
+#include "../Core/Mutex.h"
 #include "../Graphics/GPUObject.h"
 #include "../Graphics/GraphicsDefs.h"
 
@@ -92,6 +93,8 @@ public:
 
     /// Compile the shader. Return true if successful.
     bool Create();
+    /// Load the bytecode from the shader cache or compile it, without creating the GPU object, so that Create() only needs to create it. Can be called from worker threads. Return true if successful. No-op on OpenGL.
+    bool Precompile();
     /// Set name.
     void SetName(const String& name);
     /// Set defines.
@@ -140,6 +143,8 @@ public:
     static const char* elementSemanticNames[];
 
 private:
+    /// Load bytecode from the shader cache or compile it. Return true if successful.
+    bool PrepareByteCode();
     /// Load bytecode from a file. Return true if successful.
     bool LoadByteCode(const String& binaryShaderName);
     /// Compile from source. Return true if successful.
@@ -173,6 +178,10 @@ private:
     String definesClipPlane_;
     /// Shader compile error string.
     String compilerOutput_;
+    /// Mutex for preparing the bytecode in a worker thread while the main thread may need the shader. Not used on OpenGL.
+    Mutex byteCodeMutex_;
+    /// Bytecode prepared by Precompile() flag. Not used on OpenGL.
+    bool byteCodePrepared_;
 };
 
 }
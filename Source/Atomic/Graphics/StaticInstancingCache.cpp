@@ -0,0 +1,280 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Graphics/Geometry.h"
+#include "../Graphics/Graphics.h"
+#include "../Graphics/Material.h"
+#include "../Graphics/Renderer.h"
+#include "../Graphics/StaticInstancingCache.h"
+#include "../Graphics/StaticModel.h"
+#include "../Graphics/VertexBuffer.h"
+#include "../IO/Log.h"
+#include "../Scene/Node.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+StaticInstancingCache::StaticInstancingCache(Context* context) :
+    Object(context),
+    dirtyStart_(M_MAX_UNSIGNED),
+    dirtyEnd_(0),
+    vertexSize_(0),
+    version_(0),
+    layoutDirty_(false)
+{
+}
+
+StaticInstancingCache::~StaticInstancingCache()
+{
+}
+
+void StaticInstancingCache::AddDrawable(StaticModel* drawable)
+{
+    if (!drawable || drawables_.Contains(drawable))
+        return;
+
+    drawables_.Insert(MakePair(static_cast<Drawable*>(drawable), PODVector<StaticInstanceSlot>()));
+    layoutDirty_ = true;
+}
+
+void StaticInstancingCache::RemoveDrawable(StaticModel* drawable)
+{
+    if (drawables_.Erase(drawable))
+    {
+        dirtyTransforms_.Erase(drawable);
+        layoutDirty_ = true;
+    }
+}
+
+void StaticInstancingCache::MarkTransformDirty(Drawable* drawable)
+{
+    // A pending layout rebuild rewrites all transforms in any case
+    if (!layoutDirty_ && drawables_.Contains(drawable))
+        dirtyTransforms_.Insert(drawable);
+}
+
+void StaticInstancingCache::Update()
+{
+    // If the renderer's instancing buffer layout changed or instancing was toggled, the instance data must be rebuilt
+    if (GetInstanceVertexSize() != vertexSize_)
+        layoutDirty_ = true;
+
+    if (layoutDirty_)
+    {
+        RebuildLayout();
+        return;
+    }
+
+    if (dirtyTransforms_.Empty() || !vertexBuffer_)
+        return;
+
+    ATOMIC_PROFILE(UpdateStaticInstances);
+
+    for (HashSet<Drawable*>::ConstIterator i = dirtyTransforms_.Begin(); i != dirtyTransforms_.End(); ++i)
+    {
+        HashMap<Drawable*, PODVector<StaticInstanceSlot> >::ConstIterator j = drawables_.Find(*i);
+        if (j != drawables_.End())
+            WriteTransforms(static_cast<StaticModel*>(j->first_), j->second_);
+    }
+    dirtyTransforms_.Clear();
+
+    if (dirtyStart_ < dirtyEnd_)
+    {
+        unsigned char* data = vertexBuffer_->GetShadowData();
+        unsigned stride = vertexBuffer_->GetVertexSize();
+        vertexBuffer_->SetDataRange(data + dirtyStart_ * stride, dirtyStart_, dirtyEnd_ - dirtyStart_);
+    }
+
+    dirtyStart_ = M_MAX_UNSIGNED;
+    dirtyEnd_ = 0;
+}
+
+const PODVector<StaticInstanceSlot>* StaticInstancingCache::GetSlots(Drawable* drawable) const
+{
+    if (layoutDirty_)
+        return 0;
+
+    HashMap<Drawable*, PODVector<StaticInstanceSlot> >::ConstIterator i = drawables_.Find(drawable);
+    return i != drawables_.End() && i->second_.Size() ? &i->second_ : (const PODVector<StaticInstanceSlot>*)0;
+}
+
+VertexBuffer* StaticInstancingCache::GetVertexBuffer() const
+{
+    return vertexBuffer_;
+}
+
+unsigned StaticInstancingCache::GetInstanceVertexSize() const
+{
+    Renderer* renderer = GetSubsystem<Renderer>();
+    VertexBuffer* dynamicBuffer = renderer ? renderer->GetInstancingBuffer() : 0;
+    return dynamicBuffer && renderer->GetDynamicInstancing() ? dynamicBuffer->GetVertexSize() : 0;
+}
+
+void StaticInstancingCache::RebuildLayout()
+{
+    ATOMIC_PROFILE(RebuildStaticInstances);
+
+    layoutDirty_ = false;
+    dirtyTransforms_.Clear();
+    groups_.Clear();
+    instanceGroups_.Clear();
+    ++version_;
+
+    // Instance data must have the same layout as the renderer's dynamic instancing buffer, as the same instancing shaders
+    // are used to draw both
+    vertexSize_ = GetInstanceVertexSize();
+    if (!vertexSize_)
+    {
+        for (HashMap<Drawable*, PODVector<StaticInstanceSlot> >::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+            i->second_.Clear();
+        vertexBuffer_.Reset();
+        return;
+    }
+
+    // First pass: assign each instance to a group, and count the group sizes
+    HashMap<Pair<Geometry*, Material*>, unsigned> groupIndices;
+
+    for (HashMap<Drawable*, PODVector<StaticInstanceSlot> >::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+    {
+        StaticModel* drawable = static_cast<StaticModel*>(i->first_);
+        PODVector<StaticInstanceSlot>& slots = i->second_;
+        slots.Clear();
+
+        const Vector<SourceBatch>& batches = drawable->GetBatches();
+        for (unsigned j = 0; j < batches.Size(); ++j)
+        {
+            const SourceBatch& batch = batches[j];
+            // Only plain single-transform static batches can use persistent instance data
+            if (batch.geometryType_ != GEOM_STATIC || batch.numWorldTransforms_ != 1 || batch.instancingData_)
+                continue;
+
+            unsigned numLevels = drawable->GetNumLodLevels(j);
+            for (unsigned k = 0; k < numLevels; ++k)
+            {
+                Geometry* geometry = drawable->GetLodGeometry(j, k);
+                if (!geometry || !geometry->GetIndexBuffer())
+                    continue;
+
+                // Group by the shared render state, as views batch identical materials together
+                Material* material = batch.material_ ? batch.material_->GetSharedState() : (Material*)0;
+                Pair<Geometry*, Material*> key(geometry, material);
+                HashMap<Pair<Geometry*, Material*>, unsigned>::Iterator l = groupIndices.Find(key);
+                if (l == groupIndices.End())
+                {
+                    StaticInstanceGroup newGroup;
+                    newGroup.geometry_ = geometry;
+                    newGroup.material_ = material;
+                    newGroup.start_ = 0;
+                    newGroup.count_ = 0;
+                    l = groupIndices.Insert(MakePair(key, groups_.Size()));
+                    groups_.Push(newGroup);
+                }
+
+                ++groups_[l->second_].count_;
+                // Store the group index for now, the final instance index is assigned in the second pass
+                slots.Push(StaticInstanceSlot(j, geometry, l->second_));
+            }
+        }
+    }
+
+    unsigned numInstances = 0;
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        groups_[i].start_ = numInstances;
+        numInstances += groups_[i].count_;
+    }
+
+    if (!numInstances)
+    {
+        vertexBuffer_.Reset();
+        return;
+    }
+
+    // Second pass: assign instance indices contiguously within each group
+    PODVector<unsigned> groupFill(groups_.Size());
+    for (unsigned i = 0; i < groupFill.Size(); ++i)
+        groupFill[i] = 0;
+    instanceGroups_.Resize(numInstances);
+
+    for (HashMap<Drawable*, PODVector<StaticInstanceSlot> >::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+    {
+        PODVector<StaticInstanceSlot>& slots = i->second_;
+        for (unsigned j = 0; j < slots.Size(); ++j)
+        {
+            unsigned groupIndex = slots[j].index_;
+            slots[j].index_ = groups_[groupIndex].start_ + groupFill[groupIndex]++;
+            instanceGroups_[slots[j].index_] = groupIndex;
+        }
+    }
+
+    if (!vertexBuffer_)
+    {
+        vertexBuffer_ = new VertexBuffer(context_);
+        vertexBuffer_->SetShadowed(true);
+    }
+
+    if (!vertexBuffer_->SetSize(numInstances, GetSubsystem<Renderer>()->GetInstancingBuffer()->GetElements(), false))
+    {
+        ATOMIC_LOGERROR("Failed to create static instancing buffer with " + String(numInstances) + " instances");
+        for (HashMap<Drawable*, PODVector<StaticInstanceSlot> >::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+            i->second_.Clear();
+        groups_.Clear();
+        instanceGroups_.Clear();
+        vertexBuffer_.Reset();
+        return;
+    }
+
+    // Extra instancing elements are not used by static models, so leave them zeroed
+    memset(vertexBuffer_->GetShadowData(), 0, numInstances * vertexBuffer_->GetVertexSize());
+    for (HashMap<Drawable*, PODVector<StaticInstanceSlot> >::ConstIterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+        WriteTransforms(static_cast<StaticModel*>(i->first_), i->second_);
+
+    vertexBuffer_->SetData(vertexBuffer_->GetShadowData());
+    dirtyStart_ = M_MAX_UNSIGNED;
+    dirtyEnd_ = 0;
+}
+
+void StaticInstancingCache::WriteTransforms(StaticModel* drawable, const PODVector<StaticInstanceSlot>& slots)
+{
+    Node* node = drawable->GetNode();
+    if (!node || slots.Empty())
+        return;
+
+    const Matrix3x4& worldTransform = node->GetWorldTransform();
+    unsigned char* data = vertexBuffer_->GetShadowData();
+    unsigned stride = vertexBuffer_->GetVertexSize();
+
+    for (PODVector<StaticInstanceSlot>::ConstIterator i = slots.Begin(); i != slots.End(); ++i)
+    {
+        memcpy(data + i->index_ * stride, &worldTransform, sizeof(Matrix3x4));
+        dirtyStart_ = Min(dirtyStart_, i->index_);
+        dirtyEnd_ = Max(dirtyEnd_, i->index_ + 1);
+    }
+}
+
+}
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/HashSet.h"
+#include "../Core/Object.h"
+
+namespace Atomic
+{
+
+class Drawable;
+class Geometry;
+class Material;
+class StaticModel;
+class VertexBuffer;
+
+/// Persistent instance of one static model batch at one LOD level.
+struct StaticInstanceSlot
+{
+    /// Construct undefined.
+    StaticInstanceSlot()
+    {
+    }
+
+    /// Construct with values.
+    StaticInstanceSlot(unsigned batchIndex, Geometry* geometry, unsigned index) :
+        batchIndex_(batchIndex),
+        geometry_(geometry),
+        index_(index)
+    {
+    }
+
+    /// Source batch index.
+    unsigned batchIndex_;
+    /// LOD geometry.
+    Geometry* geometry_;
+    /// Index in the persistent instancing buffer.
+    unsigned index_;
+};
+
+/// Contiguous range of persistent instances that share geometry and material.
+struct StaticInstanceGroup
+{
+    /// Geometry.
+    Geometry* geometry_;
+    /// Material. Null means the renderer's default material.
+    Material* material_;
+    /// First index in the persistent instancing buffer.
+    unsigned start_;
+    /// Number of instances.
+    unsigned count_;
+};
+
+/// %Octree-owned persistent instancing buffer for static models that opt into static instancing. Instances are laid out
+/// contiguously by geometry and material, so that views only need to update a visibility mask per frame. The layout is
+/// rebuilt when a model is added, removed or changes its model or materials; moving a model only rewrites its own instances.
+class ATOMIC_API StaticInstancingCache : public Object
+{
+    ATOMIC_OBJECT(StaticInstancingCache, Object);
+
+public:
+    /// Construct.
+    StaticInstancingCache(Context* context);
+    /// Destruct.
+    virtual ~StaticInstancingCache();
+
+    /// Add a static model.
+    void AddDrawable(StaticModel* drawable);
+    /// Remove a static model.
+    void RemoveDrawable(StaticModel* drawable);
+    /// Mark the instance layout dirty, for example after a model or material change.
+    void MarkLayoutDirty() { layoutDirty_ = true; }
+    /// Mark a drawable's instance transforms dirty. No-op if the drawable is not in the cache.
+    void MarkTransformDirty(Drawable* drawable);
+    /// Rebuild the layout and upload changed instance data if necessary. Called by the octree from the main thread.
+    void Update();
+
+    /// Return persistent instance slots of a drawable, or null if not in the cache or the layout has not been built yet.
+    const PODVector<StaticInstanceSlot>* GetSlots(Drawable* drawable) const;
+    /// Return the group that a persistent instance belongs to.
+    const StaticInstanceGroup& GetGroup(unsigned index) const { return groups_[instanceGroups_[index]]; }
+    /// Return the persistent instancing buffer, or null if no instances.
+    VertexBuffer* GetVertexBuffer() const;
+    /// Return number of persistent instances.
+    unsigned GetNumInstances() const { return instanceGroups_.Size(); }
+    /// Return number of static models in the cache.
+    unsigned GetNumDrawables() const { return drawables_.Size(); }
+    /// Return layout version. Changes whenever the instance layout is rebuilt.
+    unsigned GetVersion() const { return version_; }
+
+private:
+    /// Return the renderer's instancing buffer vertex size, or zero if instancing is not available.
+    unsigned GetInstanceVertexSize() const;
+    /// Rebuild instance layout and the instancing buffer.
+    void RebuildLayout();
+    /// Write a drawable's instance transforms to the instancing buffer shadow data and expand the dirty range.
+    void WriteTransforms(StaticModel* drawable, const PODVector<StaticInstanceSlot>& slots);
+
+    /// Static models and their persistent instance slots.
+    HashMap<Drawable*, PODVector<StaticInstanceSlot> > drawables_;
+    /// Static models whose transforms need to be rewritten.
+    HashSet<Drawable*> dirtyTransforms_;
+    /// Instance groups.
+    PODVector<StaticInstanceGroup> groups_;
+    /// Group index of each persistent instance.
+    PODVector<unsigned> instanceGroups_;
+    /// Persistent instancing buffer.
+    SharedPtr<VertexBuffer> vertexBuffer_;
+    /// First dirty instance in the instancing buffer.
+    unsigned dirtyStart_;
+    /// Last dirty instance in the instancing buffer, exclusive.
+    unsigned dirtyEnd_;
+    /// Instance vertex size the layout was built with, or zero if instancing was not available.
+    unsigned vertexSize_;
+    /// Layout version.
+    unsigned version_;
+    /// Layout dirty flag.
+    bool layoutDirty_;
+};
+
+}
@@ -30,7 +30,9 @@
 #include "../Graphics/Geometry.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/OcclusionBuffer.h"
+#include "../Graphics/Octree.h"
 #include "../Graphics/OctreeQuery.h"
+#include "../Graphics/StaticInstancingCache.h"
 #include "../Graphics/VertexBuffer.h"
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
@@ -47,12 +49,16 @@ extern const char* GEOMETRY_CATEGORY;
 StaticModel::StaticModel(Context* context) :
     Drawable(context, DRAWABLE_GEOMETRY),
     occlusionLodLevel_(M_MAX_UNSIGNED),
-    materialsAttr_(Material::GetTypeStatic())
+    materialsAttr_(Material::GetTypeStatic()),
+    staticInstancing_(false)
 {
 }
 
 StaticModel::~StaticModel()
 {
+    // The base class destructor can no longer call our OnRemoveFromOctree(), so leave the instancing cache here
+    if (staticInstancingCache_)
+        staticInstancingCache_->RemoveDrawable(this);
 }
 
 void StaticModel::RegisterObject(Context* context)
@@ -71,6 +77,7 @@ void StaticModel::RegisterObject(Context* context)
     ATOMIC_ACCESSOR_ATTRIBUTE("LOD Bias", GetLodBias, SetLodBias, float, 1.0f, AM_DEFAULT);
     ATOMIC_COPY_BASE_ATTRIBUTES(Drawable);
     ATOMIC_ATTRIBUTE("Occlusion LOD Level", int, occlusionLodLevel_, M_MAX_UNSIGNED, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Static Instancing", GetStaticInstancing, SetStaticInstancing, bool, false, AM_DEFAULT);
 
     // ATOMIC BEGIN
 
@@ -79,6 +86,13 @@ void StaticModel::RegisterObject(Context* context)
 
     // ATOMIC END
 
+    ATOMIC_ACCESSOR_ATTRIBUTE("LOD Screen Size", GetLodScreenSize, SetLodScreenSize, bool, false, AM_DEFAULT);
+}
+
+void StaticModel::OnSetEnabled()
+{
+    Drawable::OnSetEnabled();
+    UpdateStaticInstancing();
 }
 
 void StaticModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results)
@@ -154,7 +168,7 @@ void StaticModel::UpdateBatches(const FrameInfo& frame)
     }
 
     float scale = worldBoundingBox.Size().DotProduct(DOT_SCALE);
-    float newLodDistance = frame.camera_->GetLodDistance(distance_, scale, lodBias_);
+    float newLodDistance = CalculateLodDistance(frame, scale);
 
     if (newLodDistance != lodDistance_)
     {
@@ -302,6 +316,7 @@ void StaticModel::SetModel(Model* model)
         SetBoundingBox(BoundingBox());
     }
 
+    MarkStaticInstancesDirty();
     MarkNetworkUpdate();
 }
 
@@ -310,6 +325,7 @@ void StaticModel::SetMaterial(Material* material)
     for (unsigned i = 0; i < batches_.Size(); ++i)
         batches_[i].material_ = material;
 
+    MarkStaticInstancesDirty();
     MarkNetworkUpdate();
 }
 
@@ -322,6 +338,7 @@ bool StaticModel::SetMaterial(unsigned index, Material* material)
     }
 
     batches_[index].material_ = material;
+    MarkStaticInstancesDirty();
     MarkNetworkUpdate();
     return true;
 }
@@ -332,6 +349,16 @@ void StaticModel::SetOcclusionLodLevel(unsigned level)
     MarkNetworkUpdate();
 }
 
+void StaticModel::SetStaticInstancing(bool enable)
+{
+    if (enable != staticInstancing_)
+    {
+        staticInstancing_ = enable;
+        UpdateStaticInstancing();
+        MarkNetworkUpdate();
+    }
+}
+
 void StaticModel::ApplyMaterialList(const String& fileName)
 {
     String useFileName = fileName;
@@ -430,11 +457,26 @@ const ResourceRefList& StaticModel::GetMaterialsAttr() const
     return materialsAttr_;
 }
 
+void StaticModel::OnSceneSet(Scene* scene)
+{
+    Drawable::OnSceneSet(scene);
+    UpdateStaticInstancing();
+}
+
 void StaticModel::OnWorldBoundingBoxUpdate()
 {
     worldBoundingBox_ = boundingBox_.Transformed(node_->GetWorldTransform());
 }
 
+void StaticModel::OnRemoveFromOctree()
+{
+    if (staticInstancingCache_)
+    {
+        staticInstancingCache_->RemoveDrawable(this);
+        staticInstancingCache_.Reset();
+    }
+}
+
 void StaticModel::ResetLodLevels()
 {
     // Ensure that each subgeometry has at least one LOD level, and reset the current LOD level
@@ -476,6 +518,26 @@ void StaticModel::CalculateLodLevels()
     }
 }
 
+void StaticModel::UpdateStaticInstancing()
+{
+    StaticInstancingCache* cache = staticInstancing_ && octant_ ? octant_->GetRoot()->GetOrCreateStaticInstancingCache() :
+        (StaticInstancingCache*)0;
+    if (cache == staticInstancingCache_)
+        return;
+
+    if (staticInstancingCache_)
+        staticInstancingCache_->RemoveDrawable(this);
+    staticInstancingCache_ = cache;
+    if (cache)
+        cache->AddDrawable(this);
+}
+
+void StaticModel::MarkStaticInstancesDirty()
+{
+    if (staticInstancingCache_)
+        staticInstancingCache_->MarkLayoutDirty();
+}
+
 void StaticModel::HandleModelReloadFinished(StringHash eventType, VariantMap& eventData)
 {
     Model* currentModel = model_;
@@ -28,6 +28,7 @@ namespace Atomic
 {
 
 class Model;
+class StaticInstancingCache;
 
 /// Static model per-geometry extra data.
 struct StaticModelGeometryData
@@ -59,6 +60,8 @@ public:
     /// Register object factory. Drawable must be registered first.
     static void RegisterObject(Context* context);
 
+    /// Handle enabled/disabled state change.
+    virtual void OnSetEnabled();
     /// Process octree raycast. May be called from a worker thread.
     virtual void ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results);
     /// Calculate distance and prepare batches for rendering. May be called from worker thread(s), possibly re-entrantly.
@@ -78,6 +81,8 @@ public:
     virtual bool SetMaterial(unsigned index, Material* material);
     /// Set occlusion LOD level. By default (M_MAX_UNSIGNED) same as visible.
     void SetOcclusionLodLevel(unsigned level);
+    /// Set static instancing. When enabled, instance transforms are kept in a persistent instancing buffer owned by the octree, and are only rewritten when the model moves.
+    void SetStaticInstancing(bool enable);
     /// Apply default materials from a material list file. If filename is empty (default), the model's resource name with extension .txt will be used.
     void ApplyMaterialList(const String& fileName = String::EMPTY);
 
@@ -93,6 +98,12 @@ public:
     /// Return occlusion LOD level.
     unsigned GetOcclusionLodLevel() const { return occlusionLodLevel_; }
 
+    /// Return whether static instancing is enabled.
+    bool GetStaticInstancing() const { return staticInstancing_; }
+
+    /// Return number of LOD levels of a geometry.
+    unsigned GetNumLodLevels(unsigned batchIndex) const { return batchIndex < geometries_.Size() ? geometries_[batchIndex].Size() : 0; }
+
     /// Determines if the given world space point is within the model geometry.
     bool IsInside(const Vector3& point) const;
     /// Determines if the given local space point is within the model geometry.
@@ -125,8 +136,12 @@ public:
     // ATOMIC END
 
 protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
     /// Recalculate the world-space bounding box.
     virtual void OnWorldBoundingBoxUpdate();
+    /// Handle removal from octree.
+    virtual void OnRemoveFromOctree();
     /// Set local-space bounding box.
     void SetBoundingBox(const BoundingBox& box);
     /// Set number of geometries.
@@ -146,6 +161,10 @@ protected:
     unsigned occlusionLodLevel_;
     /// Material list attribute.
     mutable ResourceRefList materialsAttr_;
+    /// Persistent instancing cache the model has been added to.
+    WeakPtr<StaticInstancingCache> staticInstancingCache_;
+    /// Static instancing flag.
+    bool staticInstancing_;
 
     // ATOMIC BEGIN
 
@@ -158,6 +177,10 @@ protected:
     // ATOMIC END
 
 private:
+    /// Add to or remove from the octree's persistent instancing cache according to the static instancing flag.
+    void UpdateStaticInstancing();
+    /// Mark the persistent instance layout dirty after a model or material change.
+    void MarkStaticInstancesDirty();
     /// Handle model reload finished.
     void HandleModelReloadFinished(StringHash eventType, VariantMap& eventData);
 };
@@ -195,7 +195,7 @@ void StaticModelGroup::UpdateBatches(const FrameInfo& frame)
     }
 
     float scale = worldBoundingBox.Size().DotProduct(DOT_SCALE);
-    float newLodDistance = frame.camera_->GetLodDistance(distance_, scale, lodBias_);
+    float newLodDistance = CalculateLodDistance(frame, scale);
 
     if (newLodDistance != lodDistance_)
     {
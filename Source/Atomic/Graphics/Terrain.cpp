@@ -24,6 +24,7 @@
 
 #include "../Core/Context.h"
 #include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
 #include "../Graphics/DrawableEvents.h"
 #include "../Graphics/Geometry.h"
 #include "../Graphics/IndexBuffer.h"
@@ -56,6 +57,36 @@ static const unsigned STITCH_NORTH = 1;
 static const unsigned STITCH_SOUTH = 2;
 static const unsigned STITCH_WEST = 4;
 static const unsigned STITCH_EAST = 8;
+static const unsigned TERRAIN_VERTEX_FLOATS = 12;
+
+/// Patch vertex data calculated in a worker thread.
+struct PatchGeometryData
+{
+    /// Patch.
+    TerrainPatch* patch_;
+    /// Vertex buffer data.
+    SharedArrayPtr<float> vertexData_;
+    /// CPU-side position data for raycasts.
+    SharedArrayPtr<unsigned char> cpuVertexData_;
+    /// CPU-side position data for occlusion.
+    SharedArrayPtr<unsigned char> occlusionCpuVertexData_;
+    /// Bounding box.
+    BoundingBox box_;
+};
+
+void CalculatePatchDataWork(const WorkItem* item, unsigned threadIndex)
+{
+    Terrain* terrain = reinterpret_cast<Terrain*>(item->aux_);
+    PatchGeometryData* start = reinterpret_cast<PatchGeometryData*>(item->start_);
+    PatchGeometryData* end = reinterpret_cast<PatchGeometryData*>(item->end_);
+
+    while (start != end)
+    {
+        terrain->CalculatePatchData(start->patch_, start->vertexData_.Get(), (float*)start->cpuVertexData_.Get(),
+            (float*)start->occlusionCpuVertexData_.Get(), start->box_);
+        ++start;
+    }
+}
 
 inline void GrowUpdateRegion(IntRect& updateRegion, int x, int y)
 {
@@ -670,9 +701,6 @@ void Terrain::CreatePatchGeometry(TerrainPatch* patch)
 
     unsigned row = (unsigned)(patchSize_ + 1);
     VertexBuffer* vertexBuffer = patch->GetVertexBuffer();
-    Geometry* geometry = patch->GetGeometry();
-    Geometry* maxLodGeometry = patch->GetMaxLodGeometry();
-    Geometry* occlusionGeometry = patch->GetOcclusionGeometry();
 
     if (vertexBuffer->GetVertexCount() != row * row)
         vertexBuffer->SetSize(row * row, MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1 | MASK_TANGENT);
@@ -681,99 +709,24 @@ void Terrain::CreatePatchGeometry(TerrainPatch* patch)
     SharedArrayPtr<unsigned char> occlusionCpuVertexData(new unsigned char[row * row * sizeof(Vector3)]);
 
     float* vertexData = (float*)vertexBuffer->Lock(0, vertexBuffer->GetVertexCount());
-    float* positionData = (float*)cpuVertexData.Get();
-    float* occlusionData = (float*)occlusionCpuVertexData.Get();
     BoundingBox box;
 
-    unsigned occlusionLevel = occlusionLodLevel_;
-    if (occlusionLevel > numLodLevels_ - 1)
-        occlusionLevel = numLodLevels_ - 1;
-
     if (vertexData)
     {
-        const IntVector2& coords = patch->GetCoordinates();
-        int lodExpand = (1 << (occlusionLevel)) - 1;
-        int halfLodExpand = (1 << (occlusionLevel)) / 2;
-
-        for (int z = 0; z <= patchSize_; ++z)
-        {
-            for (int x = 0; x <= patchSize_; ++x)
-            {
-                int xPos = coords.x_ * patchSize_ + x;
-                int zPos = coords.y_ * patchSize_ + z;
-
-                // Position
-                Vector3 position((float)x * spacing_.x_, GetRawHeight(xPos, zPos), (float)z * spacing_.z_);
-                *vertexData++ = position.x_;
-                *vertexData++ = position.y_;
-                *vertexData++ = position.z_;
-                *positionData++ = position.x_;
-                *positionData++ = position.y_;
-                *positionData++ = position.z_;
-
-                box.Merge(position);
-
-                // For vertices that are part of the occlusion LOD, calculate the minimum height in the neighborhood
-                // to prevent false positive occlusion due to inaccuracy between occlusion LOD & visible LOD
-                float minHeight = position.y_;
-                if (halfLodExpand > 0 && (x & lodExpand) == 0 && (z & lodExpand) == 0)
-                {
-                    int minX = Max(xPos - halfLodExpand, 0);
-                    int maxX = Min(xPos + halfLodExpand, numVertices_.x_ - 1);
-                    int minZ = Max(zPos - halfLodExpand, 0);
-                    int maxZ = Min(zPos + halfLodExpand, numVertices_.y_ - 1);
-                    for (int nZ = minZ; nZ <= maxZ; ++nZ)
-                    {
-                        for (int nX = minX; nX <= maxX; ++nX)
-                            minHeight = Min(minHeight, GetRawHeight(nX, nZ));
-                    }
-                }
-                *occlusionData++ = position.x_;
-                *occlusionData++ = minHeight;
-                *occlusionData++ = position.z_;
-
-                // Normal
-                Vector3 normal = GetRawNormal(xPos, zPos);
-                *vertexData++ = normal.x_;
-                *vertexData++ = normal.y_;
-                *vertexData++ = normal.z_;
-
-                // Texture coordinate
-                Vector2 texCoord((float)xPos / (float)(numVertices_.x_ - 1), 1.0f - (float)zPos / (float)(numVertices_.y_ - 1));
-                *vertexData++ = texCoord.x_;
-                *vertexData++ = texCoord.y_;
-
-                // Tangent
-                Vector3 xyz = (Vector3::RIGHT - normal * normal.DotProduct(Vector3::RIGHT)).Normalized();
-                *vertexData++ = xyz.x_;
-                *vertexData++ = xyz.y_;
-                *vertexData++ = xyz.z_;
-                *vertexData++ = 1.0f;
-            }
-        }
+        CalculatePatchVertices(patch, vertexData, (float*)cpuVertexData.Get(), (float*)occlusionCpuVertexData.Get(), box);
 
         vertexBuffer->Unlock();
         vertexBuffer->ClearDataLost();
     }
 
-    patch->SetBoundingBox(box);
-
-    if (drawRanges_.Size())
-    {
-        unsigned occlusionDrawRange = occlusionLevel << 4;
-
-        geometry->SetIndexBuffer(indexBuffer_);
-        geometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[0].first_, drawRanges_[0].second_, false);
-        geometry->SetRawVertexData(cpuVertexData, MASK_POSITION);
-        maxLodGeometry->SetIndexBuffer(indexBuffer_);
-        maxLodGeometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[0].first_, drawRanges_[0].second_, false);
-        maxLodGeometry->SetRawVertexData(cpuVertexData, MASK_POSITION);
-        occlusionGeometry->SetIndexBuffer(indexBuffer_);
-        occlusionGeometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[occlusionDrawRange].first_, drawRanges_[occlusionDrawRange].second_, false);
-        occlusionGeometry->SetRawVertexData(occlusionCpuVertexData, MASK_POSITION);
-    }
+    SetPatchGeometry(patch, cpuVertexData, occlusionCpuVertexData, box);
+}
 
-    patch->ResetLod();
+void Terrain::CalculatePatchData(TerrainPatch* patch, float* vertexData, float* positionData, float* occlusionData,
+    BoundingBox& box)
+{
+    CalculatePatchVertices(patch, vertexData, positionData, occlusionData, box);
+    CalculateLodErrors(patch);
 }
 
 void Terrain::UpdatePatchLod(TerrainPatch* patch)
@@ -1125,18 +1078,78 @@ void Terrain::CreateGeometry()
             }
         }
 
+        Vector<PatchGeometryData> patchData;
         for (unsigned i = 0; i < patches_.Size(); ++i)
         {
-            TerrainPatch* patch = patches_[i];
-
             if (dirtyPatches[i])
             {
-                CreatePatchGeometry(patch);
-                CalculateLodErrors(patch);
+                patchData.Resize(patchData.Size() + 1);
+                patchData.Back().patch_ = patches_[i];
+            }
+        }
+
+        WorkQueue* queue = GetSubsystem<WorkQueue>();
+        if (queue->GetNumThreads() && patchData.Size() > 1)
+        {
+            ATOMIC_PROFILE(CalculatePatchData);
+
+            // Calculate the patches' vertex data and LOD errors in worker threads, then upload on the main thread
+            unsigned row = (unsigned)(patchSize_ + 1);
+            for (Vector<PatchGeometryData>::Iterator i = patchData.Begin(); i != patchData.End(); ++i)
+            {
+                i->vertexData_ = new float[row * row * TERRAIN_VERTEX_FLOATS];
+                i->cpuVertexData_ = new unsigned char[row * row * sizeof(Vector3)];
+                i->occlusionCpuVertexData_ = new unsigned char[row * row * sizeof(Vector3)];
             }
 
-            SetPatchNeighbors(patch);
+            int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
+            int patchesPerItem = Max((int)(patchData.Size() / numWorkItems), 1);
+
+            Vector<PatchGeometryData>::Iterator start = patchData.Begin();
+            for (int i = 0; i < numWorkItems; ++i)
+            {
+                SharedPtr<WorkItem> item = queue->GetFreeItem();
+                item->priority_ = M_MAX_UNSIGNED;
+                item->workFunction_ = CalculatePatchDataWork;
+                item->aux_ = this;
+
+                Vector<PatchGeometryData>::Iterator end = patchData.End();
+                if (i < numWorkItems - 1 && end - start > patchesPerItem)
+                    end = start + patchesPerItem;
+
+                item->start_ = &(*start);
+                item->end_ = &(*end);
+                queue->AddWorkItem(item);
+
+                start = end;
+                if (start == patchData.End())
+                    break;
+            }
+
+            queue->Complete(M_MAX_UNSIGNED);
+
+            for (Vector<PatchGeometryData>::Iterator i = patchData.Begin(); i != patchData.End(); ++i)
+            {
+                VertexBuffer* vertexBuffer = i->patch_->GetVertexBuffer();
+                if (vertexBuffer->GetVertexCount() != row * row)
+                    vertexBuffer->SetSize(row * row, MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1 | MASK_TANGENT);
+                vertexBuffer->SetData(i->vertexData_.Get());
+                vertexBuffer->ClearDataLost();
+
+                SetPatchGeometry(i->patch_, i->cpuVertexData_, i->occlusionCpuVertexData_, i->box_);
+            }
+        }
+        else
+        {
+            for (Vector<PatchGeometryData>::Iterator i = patchData.Begin(); i != patchData.End(); ++i)
+            {
+                CreatePatchGeometry(i->patch_);
+                CalculateLodErrors(i->patch_);
+            }
         }
+
+        for (unsigned i = 0; i < patches_.Size(); ++i)
+            SetPatchNeighbors(patches_[i]);
     }
 
     // Send event only if new geometry was generated, or the old was cleared
@@ -1420,6 +1433,106 @@ void Terrain::CalculateLodErrors(TerrainPatch* patch)
     }
 }
 
+void Terrain::CalculatePatchVertices(TerrainPatch* patch, float* vertexData, float* positionData, float* occlusionData,
+    BoundingBox& box) const
+{
+    unsigned occlusionLevel = occlusionLodLevel_;
+    if (occlusionLevel > numLodLevels_ - 1)
+        occlusionLevel = numLodLevels_ - 1;
+
+    const IntVector2& coords = patch->GetCoordinates();
+    int lodExpand = (1 << (occlusionLevel)) - 1;
+    int halfLodExpand = (1 << (occlusionLevel)) / 2;
+
+    for (int z = 0; z <= patchSize_; ++z)
+    {
+        for (int x = 0; x <= patchSize_; ++x)
+        {
+            int xPos = coords.x_ * patchSize_ + x;
+            int zPos = coords.y_ * patchSize_ + z;
+
+            // Position
+            Vector3 position((float)x * spacing_.x_, GetRawHeight(xPos, zPos), (float)z * spacing_.z_);
+            *vertexData++ = position.x_;
+            *vertexData++ = position.y_;
+            *vertexData++ = position.z_;
+            *positionData++ = position.x_;
+            *positionData++ = position.y_;
+            *positionData++ = position.z_;
+
+            box.Merge(position);
+
+            // For vertices that are part of the occlusion LOD, calculate the minimum height in the neighborhood
+            // to prevent false positive occlusion due to inaccuracy between occlusion LOD & visible LOD
+            float minHeight = position.y_;
+            if (halfLodExpand > 0 && (x & lodExpand) == 0 && (z & lodExpand) == 0)
+            {
+                int minX = Max(xPos - halfLodExpand, 0);
+                int maxX = Min(xPos + halfLodExpand, numVertices_.x_ - 1);
+                int minZ = Max(zPos - halfLodExpand, 0);
+                int maxZ = Min(zPos + halfLodExpand, numVertices_.y_ - 1);
+                for (int nZ = minZ; nZ <= maxZ; ++nZ)
+                {
+                    for (int nX = minX; nX <= maxX; ++nX)
+                        minHeight = Min(minHeight, GetRawHeight(nX, nZ));
+                }
+            }
+            *occlusionData++ = position.x_;
+            *occlusionData++ = minHeight;
+            *occlusionData++ = position.z_;
+
+            // Normal
+            Vector3 normal = GetRawNormal(xPos, zPos);
+            *vertexData++ = normal.x_;
+            *vertexData++ = normal.y_;
+            *vertexData++ = normal.z_;
+
+            // Texture coordinate
+            Vector2 texCoord((float)xPos / (float)(numVertices_.x_ - 1), 1.0f - (float)zPos / (float)(numVertices_.y_ - 1));
+            *vertexData++ = texCoord.x_;
+            *vertexData++ = texCoord.y_;
+
+            // Tangent
+            Vector3 xyz = (Vector3::RIGHT - normal * normal.DotProduct(Vector3::RIGHT)).Normalized();
+            *vertexData++ = xyz.x_;
+            *vertexData++ = xyz.y_;
+            *vertexData++ = xyz.z_;
+            *vertexData++ = 1.0f;
+        }
+    }
+}
+
+void Terrain::SetPatchGeometry(TerrainPatch* patch, SharedArrayPtr<unsigned char> cpuVertexData,
+    SharedArrayPtr<unsigned char> occlusionCpuVertexData, const BoundingBox& box)
+{
+    Geometry* geometry = patch->GetGeometry();
+    Geometry* maxLodGeometry = patch->GetMaxLodGeometry();
+    Geometry* occlusionGeometry = patch->GetOcclusionGeometry();
+
+    unsigned occlusionLevel = occlusionLodLevel_;
+    if (occlusionLevel > numLodLevels_ - 1)
+        occlusionLevel = numLodLevels_ - 1;
+
+    patch->SetBoundingBox(box);
+
+    if (drawRanges_.Size())
+    {
+        unsigned occlusionDrawRange = occlusionLevel << 4;
+
+        geometry->SetIndexBuffer(indexBuffer_);
+        geometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[0].first_, drawRanges_[0].second_, false);
+        geometry->SetRawVertexData(cpuVertexData, MASK_POSITION);
+        maxLodGeometry->SetIndexBuffer(indexBuffer_);
+        maxLodGeometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[0].first_, drawRanges_[0].second_, false);
+        maxLodGeometry->SetRawVertexData(cpuVertexData, MASK_POSITION);
+        occlusionGeometry->SetIndexBuffer(indexBuffer_);
+        occlusionGeometry->SetDrawRange(TRIANGLE_LIST, drawRanges_[occlusionDrawRange].first_, drawRanges_[occlusionDrawRange].second_, false);
+        occlusionGeometry->SetRawVertexData(occlusionCpuVertexData, MASK_POSITION);
+    }
+
+    patch->ResetLod();
+}
+
 void Terrain::SetPatchNeighbors(TerrainPatch* patch)
 {
     if (!patch)
@@ -28,6 +28,7 @@
 namespace Atomic
 {
 
+class BoundingBox;
 class Image;
 class IndexBuffer;
 class Material;
@@ -196,6 +197,8 @@ public:
 
     /// Regenerate patch geometry.
     void CreatePatchGeometry(TerrainPatch* patch);
+    /// Calculate patch vertex data and LOD errors without touching GPU resources. Called from worker threads.
+    void CalculatePatchData(TerrainPatch* patch, float* vertexData, float* positionData, float* occlusionData, BoundingBox& box);
     /// Update patch based on LOD and neighbor LOD.
     void UpdatePatchLod(TerrainPatch* patch);
     /// Set heightmap attribute.
@@ -226,6 +229,12 @@ private:
     float GetLodHeight(int x, int z, unsigned lodLevel) const;
     /// Get slope-based terrain normal at position.
     Vector3 GetRawNormal(int x, int z) const;
+    /// Calculate vertex buffer, CPU-side position and occlusion position data for a patch, and merge its bounding box.
+    void CalculatePatchVertices(TerrainPatch* patch, float* vertexData, float* positionData, float* occlusionData,
+        BoundingBox& box) const;
+    /// Set patch bounding box, draw ranges and CPU-side vertex data after the vertex buffer has been updated.
+    void SetPatchGeometry(TerrainPatch* patch, SharedArrayPtr<unsigned char> cpuVertexData,
+        SharedArrayPtr<unsigned char> occlusionCpuVertexData, const BoundingBox& box);
     /// Calculate LOD errors for a patch.
     void CalculateLodErrors(TerrainPatch* patch);
     /// Set neighbors for a patch.
@@ -0,0 +1,584 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Graphics/Camera.h"
+#include "../Graphics/Material.h"
+#include "../Graphics/Renderer.h"
+#include "../Graphics/Terrain.h"
+#include "../Graphics/TerrainStreamer.h"
+#include "../Graphics/Viewport.h"
+#include "../IO/FileSystem.h"
+#include "../IO/Log.h"
+#include "../Resource/Image.h"
+#include "../Resource/ResourceCache.h"
+#include "../Resource/ResourceEvents.h"
+#include "../Resource/XMLFile.h"
+#include "../Scene/Node.h"
+#include "../Scene/Scene.h"
+#include "../Scene/SceneEvents.h"
+#ifdef ATOMIC_PHYSICS
+#include "../Physics/CollisionShape.h"
+#include "../Physics/RigidBody.h"
+#endif
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+extern const char* GEOMETRY_CATEGORY;
+
+static const Vector3 DEFAULT_SPACING(1.0f, 0.25f, 1.0f);
+static const int DEFAULT_PATCH_SIZE = 32;
+static const unsigned DEFAULT_MAX_LOD_LEVELS = 4;
+static const float DEFAULT_LOAD_DISTANCE = 500.0f;
+static const float DEFAULT_UNLOAD_DISTANCE = 600.0f;
+static const float DEFAULT_COLLISION_DISTANCE = 100.0f;
+static const unsigned DEFAULT_MAX_TILES_PER_FRAME = 1;
+
+TerrainStreamer::TerrainStreamer(Context* context) :
+    Component(context),
+    numTiles_(IntVector2::ZERO),
+    tileSize_(0),
+    spacing_(DEFAULT_SPACING),
+    patchSize_(DEFAULT_PATCH_SIZE),
+    maxLodLevels_(DEFAULT_MAX_LOD_LEVELS),
+    loadDistance_(DEFAULT_LOAD_DISTANCE),
+    unloadDistance_(DEFAULT_UNLOAD_DISTANCE),
+    collisionDistance_(DEFAULT_COLLISION_DISTANCE),
+    maxTilesPerFrame_(DEFAULT_MAX_TILES_PER_FRAME),
+    focusNodeID_(0),
+    smoothing_(false),
+    focusNodeDirty_(false)
+{
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+}
+
+void TerrainStreamer::RegisterObject(Context* context)
+{
+    context->RegisterFactory<TerrainStreamer>(GEOMETRY_CATEGORY);
+
+    ATOMIC_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    ATOMIC_MIXED_ACCESSOR_ATTRIBUTE("Tile Set", GetTileSetAttr, SetTileSetAttr, ResourceRef, ResourceRef(XMLFile::GetTypeStatic()),
+        AM_DEFAULT);
+    ATOMIC_MIXED_ACCESSOR_ATTRIBUTE("Material", GetMaterialAttr, SetMaterialAttr, ResourceRef, ResourceRef(Material::GetTypeStatic()),
+        AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Vertex Spacing", GetSpacing, SetSpacing, Vector3, DEFAULT_SPACING, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Patch Size", GetPatchSize, SetPatchSize, int, DEFAULT_PATCH_SIZE, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Max LOD Levels", GetMaxLodLevels, SetMaxLodLevels, unsigned, DEFAULT_MAX_LOD_LEVELS, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Smooth Height Map", GetSmoothing, SetSmoothing, bool, false, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Load Distance", GetLoadDistance, SetLoadDistance, float, DEFAULT_LOAD_DISTANCE, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Unload Distance", GetUnloadDistance, SetUnloadDistance, float, DEFAULT_UNLOAD_DISTANCE, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Collision Distance", GetCollisionDistance, SetCollisionDistance, float, DEFAULT_COLLISION_DISTANCE,
+        AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Max Tiles Per Frame", GetMaxTilesPerFrame, SetMaxTilesPerFrame, unsigned, DEFAULT_MAX_TILES_PER_FRAME,
+        AM_DEFAULT);
+    ATOMIC_ATTRIBUTE("Focus NodeID", unsigned, focusNodeID_, 0, AM_DEFAULT | AM_NODEID);
+}
+
+void TerrainStreamer::OnSetAttribute(const AttributeInfo& attr, const Variant& src)
+{
+    Serializable::OnSetAttribute(attr, src);
+
+    if (attr.mode_ & AM_NODEID)
+        focusNodeDirty_ = true;
+}
+
+void TerrainStreamer::ApplyAttributes()
+{
+    if (focusNodeDirty_)
+    {
+        Scene* scene = GetScene();
+        focusNode_ = scene ? scene->GetNode(focusNodeID_) : (Node*)0;
+        focusNodeDirty_ = false;
+    }
+}
+
+void TerrainStreamer::OnSetEnabled()
+{
+    bool enabled = IsEnabledEffective();
+
+    for (HashMap<IntVector2, TerrainStreamerTile>::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+    {
+        Terrain* terrain = i->second_.node_ ? i->second_.node_->GetComponent<Terrain>() : (Terrain*)0;
+        if (terrain)
+            terrain->SetEnabled(enabled);
+    }
+}
+
+void TerrainStreamer::SetTileSet(XMLFile* file)
+{
+    if (file == tileSet_)
+        return;
+
+    ClearTiles();
+    tileSet_ = file;
+    ReadTileSet();
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetMaterial(Material* material)
+{
+    material_ = material;
+
+    for (HashMap<IntVector2, TerrainStreamerTile>::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+    {
+        Terrain* terrain = i->second_.node_ ? i->second_.node_->GetComponent<Terrain>() : (Terrain*)0;
+        if (terrain)
+            terrain->SetMaterial(material);
+    }
+
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetSpacing(const Vector3& spacing)
+{
+    if (spacing == spacing_)
+        return;
+
+    ClearTiles();
+    spacing_ = spacing;
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetPatchSize(int size)
+{
+    if (size == patchSize_)
+        return;
+
+    ClearTiles();
+    patchSize_ = size;
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetMaxLodLevels(unsigned levels)
+{
+    if (levels == maxLodLevels_)
+        return;
+
+    ClearTiles();
+    maxLodLevels_ = levels;
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetSmoothing(bool enable)
+{
+    if (enable == smoothing_)
+        return;
+
+    ClearTiles();
+    smoothing_ = enable;
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetLoadDistance(float distance)
+{
+    loadDistance_ = Max(distance, 0.0f);
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetUnloadDistance(float distance)
+{
+    unloadDistance_ = Max(distance, 0.0f);
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetCollisionDistance(float distance)
+{
+    collisionDistance_ = Max(distance, 0.0f);
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetMaxTilesPerFrame(unsigned num)
+{
+    maxTilesPerFrame_ = Max(num, 1U);
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::SetFocusNode(Node* node)
+{
+    focusNode_ = node;
+    focusNodeID_ = node ? node->GetID() : 0;
+    MarkNetworkUpdate();
+}
+
+void TerrainStreamer::ClearTiles()
+{
+    for (HashMap<IntVector2, TerrainStreamerTile>::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+        RemoveTile(i->first_, i->second_);
+
+    tiles_.Clear();
+}
+
+unsigned TerrainStreamer::GetNumLoadedTiles() const
+{
+    unsigned num = 0;
+
+    for (HashMap<IntVector2, TerrainStreamerTile>::ConstIterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+    {
+        if (i->second_.node_)
+            ++num;
+    }
+
+    return num;
+}
+
+Terrain* TerrainStreamer::GetTileTerrain(const IntVector2& coords) const
+{
+    HashMap<IntVector2, TerrainStreamerTile>::ConstIterator i = tiles_.Find(coords);
+    if (i == tiles_.End() || !i->second_.node_)
+        return 0;
+
+    return i->second_.node_->GetComponent<Terrain>();
+}
+
+IntVector2 TerrainStreamer::WorldToTile(const Vector3& worldPosition) const
+{
+    if (!node_ || !tileSize_)
+        return IntVector2::ZERO;
+
+    Vector3 position = node_->GetWorldTransform().Inverse() * worldPosition;
+    return IntVector2(FloorToInt(position.x_ / (spacing_.x_ * (float)tileSize_) + 0.5f * (float)numTiles_.x_),
+        FloorToInt(position.z_ / (spacing_.z_ * (float)tileSize_) + 0.5f * (float)numTiles_.y_));
+}
+
+float TerrainStreamer::GetHeight(const Vector3& worldPosition) const
+{
+    Terrain* terrain = GetTileTerrain(WorldToTile(worldPosition));
+    return terrain ? terrain->GetHeight(worldPosition) : 0.0f;
+}
+
+void TerrainStreamer::SetTileSetAttr(const ResourceRef& value)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SetTileSet(cache->GetResource<XMLFile>(value.name_));
+}
+
+ResourceRef TerrainStreamer::GetTileSetAttr() const
+{
+    return GetResourceRef(tileSet_, XMLFile::GetTypeStatic());
+}
+
+void TerrainStreamer::SetMaterialAttr(const ResourceRef& value)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SetMaterial(cache->GetResource<Material>(value.name_));
+}
+
+ResourceRef TerrainStreamer::GetMaterialAttr() const
+{
+    return GetResourceRef(material_, Material::GetTypeStatic());
+}
+
+void TerrainStreamer::OnSceneSet(Scene* scene)
+{
+    if (scene)
+    {
+        SubscribeToEvent(scene, E_SCENEUPDATE, ATOMIC_HANDLER(TerrainStreamer, HandleSceneUpdate));
+        SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, ATOMIC_HANDLER(TerrainStreamer, HandleBackgroundLoaded));
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_SCENEUPDATE);
+        UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+        ClearTiles();
+    }
+}
+
+void TerrainStreamer::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (!IsEnabledEffective() || !tileSize_)
+        return;
+
+    Vector3 position;
+    if (GetFocusPosition(position))
+        UpdateTiles(position);
+}
+
+void TerrainStreamer::HandleBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    const String& name = eventData[P_RESOURCENAME].GetString();
+    bool success = eventData[P_SUCCESS].GetBool();
+
+    for (HashMap<IntVector2, TerrainStreamerTile>::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+    {
+        TerrainStreamerTile& tile = i->second_;
+        if (tile.loading_ && tile.name_ == name)
+        {
+            tile.loading_ = false;
+            if (success)
+                tile.image_ = static_cast<Image*>(eventData[P_RESOURCE].GetPtr());
+            else
+                tile.failed_ = true;
+            return;
+        }
+    }
+
+    // The tile may have been evicted while its heightmap was loading
+    if (success && !tilePrefix_.Empty() && name.StartsWith(tilePrefix_))
+        GetSubsystem<ResourceCache>()->ReleaseResource<Image>(name);
+}
+
+void TerrainStreamer::UpdateTiles(const Vector3& position)
+{
+    ATOMIC_PROFILE(UpdateTerrainTiles);
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    // Evict tiles beyond the unload distance and update collision of the rest
+    for (HashMap<IntVector2, TerrainStreamerTile>::Iterator i = tiles_.Begin(); i != tiles_.End();)
+    {
+        float distance = GetTileDistance(i->first_, position);
+        if (distance > unloadDistance_)
+        {
+            RemoveTile(i->first_, i->second_);
+            i = tiles_.Erase(i);
+        }
+        else
+        {
+            if (i->second_.node_)
+                SetTileCollision(i->second_, collisionDistance_ > 0.0f && distance <= collisionDistance_);
+            ++i;
+        }
+    }
+
+    // Request heightmaps of the tiles within the load distance
+    Vector2 tileWorldSize(spacing_.x_ * (float)tileSize_, spacing_.z_ * (float)tileSize_);
+    Vector2 origin(-0.5f * (float)numTiles_.x_ * tileWorldSize.x_, -0.5f * (float)numTiles_.y_ * tileWorldSize.y_);
+    int minX = Max(FloorToInt((position.x_ - loadDistance_ - origin.x_) / tileWorldSize.x_), 0);
+    int maxX = Min(FloorToInt((position.x_ + loadDistance_ - origin.x_) / tileWorldSize.x_), numTiles_.x_ - 1);
+    int minZ = Max(FloorToInt((position.z_ - loadDistance_ - origin.y_) / tileWorldSize.y_), 0);
+    int maxZ = Min(FloorToInt((position.z_ + loadDistance_ - origin.y_) / tileWorldSize.y_), numTiles_.y_ - 1);
+
+    for (int z = minZ; z <= maxZ; ++z)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            IntVector2 coords(x, z);
+            if (tiles_.Contains(coords) || GetTileDistance(coords, position) > loadDistance_)
+                continue;
+
+            TerrainStreamerTile& tile = tiles_[coords];
+            tile.name_ = tilePrefix_ + String(x) + "_" + String(z) + tileExtension_;
+            if (!cache->GetExistingResource<Image>(tile.name_))
+                cache->BackgroundLoadResource<Image>(tile.name_);
+
+            // Without threading the load is synchronous, so check for the image again
+            tile.image_ = cache->GetExistingResource<Image>(tile.name_);
+            tile.loading_ = tile.image_.Null();
+        }
+    }
+
+    // Create terrains for the nearest loaded heightmaps. Each terrain builds its patches in worker threads, but the
+    // number of terrains per frame is still limited to avoid frame time spikes
+    for (unsigned i = 0; i < maxTilesPerFrame_; ++i)
+    {
+        HashMap<IntVector2, TerrainStreamerTile>::Iterator nearest = tiles_.End();
+        float nearestDistance = M_INFINITY;
+
+        for (HashMap<IntVector2, TerrainStreamerTile>::Iterator j = tiles_.Begin(); j != tiles_.End(); ++j)
+        {
+            if (j->second_.image_ && !j->second_.node_)
+            {
+                float distance = GetTileDistance(j->first_, position);
+                if (distance < nearestDistance)
+                {
+                    nearest = j;
+                    nearestDistance = distance;
+                }
+            }
+        }
+
+        if (nearest == tiles_.End())
+            break;
+
+        CreateTileTerrain(nearest->first_, nearest->second_);
+        if (nearest->second_.node_)
+            SetTileCollision(nearest->second_, collisionDistance_ > 0.0f && nearestDistance <= collisionDistance_);
+    }
+}
+
+void TerrainStreamer::CreateTileTerrain(const IntVector2& coords, TerrainStreamerTile& tile)
+{
+    ATOMIC_PROFILE(CreateTerrainTile);
+
+    // Create the tile scene node as local and temporary, as every client streams the tiles on its own
+    Node* tileNode = node_->CreateTemporaryChild("Tile_" + String(coords.x_) + "_" + String(coords.y_), LOCAL);
+    tileNode->SetPosition(GetTileCenter(coords));
+
+    Terrain* terrain = tileNode->CreateComponent<Terrain>(LOCAL);
+    terrain->SetEnabled(IsEnabledEffective());
+    terrain->SetPatchSize(patchSize_);
+    terrain->SetSpacing(spacing_);
+    terrain->SetMaxLodLevels(maxLodLevels_);
+    terrain->SetSmoothing(smoothing_);
+    terrain->SetMaterial(material_);
+
+    // The terrain holds on to the heightmap from now on
+    bool success = terrain->SetHeightMap(tile.image_);
+    tile.image_.Reset();
+
+    if (!success)
+    {
+        ATOMIC_LOGERROR("Failed to create terrain tile from " + tile.name_);
+        tileNode->Remove();
+        tile.failed_ = true;
+        return;
+    }
+
+    tile.node_ = tileNode;
+    ConnectNeighbors(coords, terrain);
+}
+
+void TerrainStreamer::RemoveTile(const IntVector2& coords, TerrainStreamerTile& tile)
+{
+    if (tile.node_)
+    {
+        Terrain* north = GetTileTerrain(IntVector2(coords.x_, coords.y_ + 1));
+        Terrain* south = GetTileTerrain(IntVector2(coords.x_, coords.y_ - 1));
+        Terrain* west = GetTileTerrain(IntVector2(coords.x_ - 1, coords.y_));
+        Terrain* east = GetTileTerrain(IntVector2(coords.x_ + 1, coords.y_));
+        if (north)
+            north->SetSouthNeighbor(0);
+        if (south)
+            south->SetNorthNeighbor(0);
+        if (west)
+            west->SetEastNeighbor(0);
+        if (east)
+            east->SetWestNeighbor(0);
+
+        tile.node_->Remove();
+        tile.node_.Reset();
+    }
+
+    tile.image_.Reset();
+
+    // Free the heightmap unless it is still loading; in that case it is released once the load finishes
+    if (!tile.loading_ && !tile.name_.Empty())
+        GetSubsystem<ResourceCache>()->ReleaseResource<Image>(tile.name_);
+}
+
+void TerrainStreamer::SetTileCollision(TerrainStreamerTile& tile, bool enable)
+{
+#ifdef ATOMIC_PHYSICS
+    Node* tileNode = tile.node_;
+    CollisionShape* shape = tileNode->GetComponent<CollisionShape>();
+
+    if (enable && !shape)
+    {
+        tileNode->CreateComponent<RigidBody>(LOCAL);
+        shape = tileNode->CreateComponent<CollisionShape>(LOCAL);
+        shape->SetTerrain();
+    }
+    else if (!enable && shape)
+    {
+        tileNode->RemoveComponent<CollisionShape>();
+        tileNode->RemoveComponent<RigidBody>();
+    }
+#endif
+}
+
+void TerrainStreamer::ConnectNeighbors(const IntVector2& coords, Terrain* terrain)
+{
+    Terrain* north = GetTileTerrain(IntVector2(coords.x_, coords.y_ + 1));
+    Terrain* south = GetTileTerrain(IntVector2(coords.x_, coords.y_ - 1));
+    Terrain* west = GetTileTerrain(IntVector2(coords.x_ - 1, coords.y_));
+    Terrain* east = GetTileTerrain(IntVector2(coords.x_ + 1, coords.y_));
+
+    terrain->SetNeighbors(north, south, west, east);
+    if (north)
+        north->SetSouthNeighbor(terrain);
+    if (south)
+        south->SetNorthNeighbor(terrain);
+    if (west)
+        west->SetEastNeighbor(terrain);
+    if (east)
+        east->SetWestNeighbor(terrain);
+}
+
+bool TerrainStreamer::GetFocusPosition(Vector3& position) const
+{
+    Node* focus = focusNode_;
+
+    if (!focus)
+    {
+        Renderer* renderer = GetSubsystem<Renderer>();
+        Viewport* viewport = renderer ? renderer->GetViewport(0) : (Viewport*)0;
+        Camera* camera = viewport ? viewport->GetCamera() : (Camera*)0;
+        if (camera)
+            focus = camera->GetNode();
+    }
+
+    if (!focus || focus->GetScene() != GetScene())
+        return false;
+
+    position = node_->GetWorldTransform().Inverse() * focus->GetWorldPosition();
+    return true;
+}
+
+float TerrainStreamer::GetTileDistance(const IntVector2& coords, const Vector3& position) const
+{
+    Vector3 center = GetTileCenter(coords);
+    float dx = Max(Abs(position.x_ - center.x_) - 0.5f * spacing_.x_ * (float)tileSize_, 0.0f);
+    float dz = Max(Abs(position.z_ - center.z_) - 0.5f * spacing_.z_ * (float)tileSize_, 0.0f);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+Vector3 TerrainStreamer::GetTileCenter(const IntVector2& coords) const
+{
+    return Vector3(((float)coords.x_ + 0.5f - 0.5f * (float)numTiles_.x_) * spacing_.x_ * (float)tileSize_, 0.0f,
+        ((float)coords.y_ + 0.5f - 0.5f * (float)numTiles_.y_) * spacing_.z_ * (float)tileSize_);
+}
+
+void TerrainStreamer::ReadTileSet()
+{
+    numTiles_ = IntVector2::ZERO;
+    tileSize_ = 0;
+    tilePrefix_.Clear();
+    tileExtension_.Clear();
+
+    if (!tileSet_)
+        return;
+
+    XMLElement rootElem = tileSet_->GetRoot("terraintiles");
+    if (!rootElem)
+    {
+        ATOMIC_LOGERROR("Tile set file " + tileSet_->GetName() + " does not have a terraintiles root element");
+        return;
+    }
+
+    tileSize_ = Max(rootElem.GetInt("tileSize"), 0);
+    numTiles_ = IntVector2(Max(rootElem.GetInt("tilesX"), 0), Max(rootElem.GetInt("tilesZ"), 0));
+    tilePrefix_ = GetPath(tileSet_->GetName()) + (rootElem.HasAttribute("prefix") ? rootElem.GetAttribute("prefix") : String("Tile_"));
+    tileExtension_ = rootElem.HasAttribute("extension") ? rootElem.GetAttribute("extension") : String(".png");
+}
+
+}
@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Scene/Component.h"
+
+namespace Atomic
+{
+
+class Image;
+class Material;
+class Terrain;
+class XMLFile;
+
+/// Streamed terrain tile.
+struct TerrainStreamerTile
+{
+    /// Construct.
+    TerrainStreamerTile() :
+        loading_(false),
+        failed_(false)
+    {
+    }
+
+    /// Heightmap image resource name.
+    String name_;
+    /// Heightmap image, held until the tile's terrain has been created.
+    SharedPtr<Image> image_;
+    /// Tile scene node.
+    WeakPtr<Node> node_;
+    /// Background load in progress flag.
+    bool loading_;
+    /// Load failed flag.
+    bool failed_;
+};
+
+/// %Terrain streaming component for heightfields that are too large to keep in memory. The heightmap is split into tiles
+/// offline, described by a tile set XML file. Tiles near the focus node are background loaded and turned into child
+/// terrains, distant tiles are evicted, and collision is created only for tiles near the focus node.
+class ATOMIC_API TerrainStreamer : public Component
+{
+    ATOMIC_OBJECT(TerrainStreamer, Component);
+
+public:
+    /// Construct.
+    TerrainStreamer(Context* context);
+    /// Destruct.
+    virtual ~TerrainStreamer();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Handle attribute write access.
+    virtual void OnSetAttribute(const AttributeInfo& attr, const Variant& src);
+    /// Apply attribute changes that can not be applied immediately.
+    virtual void ApplyAttributes();
+    /// Handle enabled/disabled state change.
+    virtual void OnSetEnabled();
+
+    /// Set tile set description file. Evicts all tiles.
+    void SetTileSet(XMLFile* file);
+    /// Set material of the tile terrains.
+    void SetMaterial(Material* material);
+    /// Set vertex (XZ) and height (Y) spacing. Evicts all tiles.
+    void SetSpacing(const Vector3& spacing);
+    /// Set patch quads per side of the tile terrains. Must be a power of two. Evicts all tiles.
+    void SetPatchSize(int size);
+    /// Set maximum number of LOD levels of the tile terrains. Evicts all tiles.
+    void SetMaxLodLevels(unsigned levels);
+    /// Set heightmap smoothing of the tile terrains. Evicts all tiles.
+    void SetSmoothing(bool enable);
+    /// Set distance from the focus node within which tiles are loaded.
+    void SetLoadDistance(float distance);
+    /// Set distance from the focus node beyond which tiles are evicted. Should be larger than the load distance.
+    void SetUnloadDistance(float distance);
+    /// Set distance from the focus node within which tiles get collision. Zero disables collision.
+    void SetCollisionDistance(float distance);
+    /// Set maximum number of tile terrains to create per frame.
+    void SetMaxTilesPerFrame(unsigned num);
+    /// Set the node whose position determines which tiles are loaded. If null, the first viewport's camera is used.
+    void SetFocusNode(Node* node);
+    /// Evict all tiles.
+    void ClearTiles();
+
+    /// Return tile set description file.
+    XMLFile* GetTileSet() const { return tileSet_; }
+    /// Return material.
+    Material* GetMaterial() const { return material_; }
+    /// Return vertex and height spacing.
+    const Vector3& GetSpacing() const { return spacing_; }
+    /// Return patch quads per side.
+    int GetPatchSize() const { return patchSize_; }
+    /// Return maximum number of LOD levels.
+    unsigned GetMaxLodLevels() const { return maxLodLevels_; }
+    /// Return heightmap smoothing.
+    bool GetSmoothing() const { return smoothing_; }
+    /// Return load distance.
+    float GetLoadDistance() const { return loadDistance_; }
+    /// Return unload distance.
+    float GetUnloadDistance() const { return unloadDistance_; }
+    /// Return collision distance.
+    float GetCollisionDistance() const { return collisionDistance_; }
+    /// Return maximum number of tile terrains to create per frame.
+    unsigned GetMaxTilesPerFrame() const { return maxTilesPerFrame_; }
+    /// Return focus node.
+    Node* GetFocusNode() const { return focusNode_; }
+    /// Return number of tiles in the tile set.
+    const IntVector2& GetNumTiles() const { return numTiles_; }
+    /// Return heightmap quads per tile side.
+    int GetTileSize() const { return tileSize_; }
+    /// Return number of tiles with a created terrain.
+    unsigned GetNumLoadedTiles() const;
+    /// Return tile terrain by tile coordinates, or null if not loaded.
+    Terrain* GetTileTerrain(const IntVector2& coords) const;
+    /// Return tile coordinates at world position.
+    IntVector2 WorldToTile(const Vector3& worldPosition) const;
+    /// Return height at world position from the loaded tile, or zero if the tile is not loaded.
+    float GetHeight(const Vector3& worldPosition) const;
+
+    /// Set tile set attribute.
+    void SetTileSetAttr(const ResourceRef& value);
+    /// Return tile set attribute.
+    ResourceRef GetTileSetAttr() const;
+    /// Set material attribute.
+    void SetMaterialAttr(const ResourceRef& value);
+    /// Return material attribute.
+    ResourceRef GetMaterialAttr() const;
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Handle scene update.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle a tile heightmap background load finishing.
+    void HandleBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+    /// Request, create, evict and update collision of tiles around a position in local space.
+    void UpdateTiles(const Vector3& position);
+    /// Create the terrain of a tile whose heightmap has been loaded.
+    void CreateTileTerrain(const IntVector2& coords, TerrainStreamerTile& tile);
+    /// Evict a tile.
+    void RemoveTile(const IntVector2& coords, TerrainStreamerTile& tile);
+    /// Create or remove collision of a tile.
+    void SetTileCollision(TerrainStreamerTile& tile, bool enable);
+    /// Set a tile terrain's neighbors and hook it up as the neighbor of adjacent loaded tiles.
+    void ConnectNeighbors(const IntVector2& coords, Terrain* terrain);
+    /// Return the focus position in local space. Return false if there is no focus node or camera.
+    bool GetFocusPosition(Vector3& position) const;
+    /// Return horizontal distance from a local space position to the nearest point of a tile.
+    float GetTileDistance(const IntVector2& coords, const Vector3& position) const;
+    /// Return local space center of a tile.
+    Vector3 GetTileCenter(const IntVector2& coords) const;
+    /// Read the tile set description.
+    void ReadTileSet();
+
+    /// Tile set description file.
+    SharedPtr<XMLFile> tileSet_;
+    /// Material.
+    SharedPtr<Material> material_;
+    /// Focus node.
+    WeakPtr<Node> focusNode_;
+    /// Tiles that are loading or loaded.
+    HashMap<IntVector2, TerrainStreamerTile> tiles_;
+    /// Tile heightmap name prefix, including the path of the tile set.
+    String tilePrefix_;
+    /// Tile heightmap name extension.
+    String tileExtension_;
+    /// Number of tiles.
+    IntVector2 numTiles_;
+    /// Heightmap quads per tile side.
+    int tileSize_;
+    /// Vertex and height spacing.
+    Vector3 spacing_;
+    /// Patch quads per side.
+    int patchSize_;
+    /// Maximum number of LOD levels.
+    unsigned maxLodLevels_;
+    /// Load distance.
+    float loadDistance_;
+    /// Unload distance.
+    float unloadDistance_;
+    /// Collision distance.
+    float collisionDistance_;
+    /// Maximum number of tile terrains to create per frame.
+    unsigned maxTilesPerFrame_;
+    /// Focus node ID for serialization.
+    unsigned focusNodeID_;
+    /// Heightmap smoothing.
+    bool smoothing_;
+    /// Focus node needs to be resolved flag.
+    bool focusNodeDirty_;
+};
+
+}
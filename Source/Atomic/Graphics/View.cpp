@@ -37,6 +37,7 @@
 #include "../Graphics/RenderPath.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../Graphics/Skybox.h"
+#include "../Graphics/StaticInstancingCache.h"
 #include "../Graphics/Technique.h"
 #include "../Graphics/Texture2D.h"
 #include "../Graphics/Texture2DArray.h"
@@ -167,6 +168,27 @@ public:
     OcclusionBuffer* buffer_;
 };
 
+/// Combine raw data into a shadow map split content hash.
+static inline unsigned HashShadowData(unsigned hash, const void* data, unsigned size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (unsigned i = 0; i < size; ++i)
+        hash = SDBMHash(hash, bytes[i]);
+    return hash;
+}
+
+/// Return drawable objects by an octree query, reusing the previous results if a cache is given.
+static inline void GetOctreeDrawables(const Octree* octree, OctreeQuery& query, OctreeQueryCache* cache)
+{
+    if (cache)
+        octree->GetDrawables(query, *cache);
+    else
+        octree->GetDrawables(query);
+}
+
+/// Number of occludees to test against the occlusion buffer at once.
+static const unsigned OCCLUDEE_BATCH_SIZE = 64;
+
 void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex)
 {
     View* view = reinterpret_cast<View*>(item->aux_);
@@ -179,12 +201,53 @@ void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex)
     unsigned cameraViewMask = view->cullCamera_->GetViewMask();
     bool cameraZoneOverride = view->cameraZoneOverride_;
     PerThreadSceneResult& result = view->sceneResults_[threadIndex];
+    const HashMap<Drawable*, WeakPtr<Drawable> >* temporalVisible = view->useTemporalVisibility_ ? &view->temporalVisible_ : 0;
+    BoundingBox occludeeBoxes[OCCLUDEE_BATCH_SIZE];
+    bool occludeeVisible[OCCLUDEE_BATCH_SIZE];
+    unsigned occludeeIndices[OCCLUDEE_BATCH_SIZE];
+    bool drawableVisible[OCCLUDEE_BATCH_SIZE];
+    Drawable** batchStart = start;
+    Drawable** batchEnd = start;
 
     while (start != end)
     {
-        Drawable* drawable = *start++;
+        // Test the occludees against the occlusion buffer in bulk, one batch of drawables at a time. Drawables that were
+        // visible on the previous frame are assumed to still be visible when temporal reuse is active
+        if (start == batchEnd)
+        {
+            batchStart = start;
+            batchEnd = start + Min((unsigned)(end - start), OCCLUDEE_BATCH_SIZE);
+            unsigned numOccludees = 0;
+            for (unsigned i = 0; i < (unsigned)(batchEnd - batchStart); ++i)
+            {
+                Drawable* drawable = batchStart[i];
+                drawableVisible[i] = true;
+                if (!buffer || !drawable->IsOccludee())
+                    continue;
+                if (temporalVisible)
+                {
+                    HashMap<Drawable*, WeakPtr<Drawable> >::ConstIterator j = temporalVisible->Find(drawable);
+                    if (j != temporalVisible->End() && j->second_.Get() == drawable)
+                        continue;
+                }
+
+                occludeeBoxes[numOccludees] = drawable->GetWorldBoundingBox();
+                occludeeIndices[numOccludees++] = i;
+            }
+
+            if (numOccludees)
+            {
+                buffer->IsVisible(occludeeBoxes, occludeeVisible, numOccludees);
+                for (unsigned i = 0; i < numOccludees; ++i)
+                    drawableVisible[occludeeIndices[i]] = occludeeVisible[i];
+            }
+        }
+
+        Drawable* drawable = *start;
+        bool visible = drawableVisible[start - batchStart];
+        ++start;
 
-        if (!buffer || !drawable->IsOccludee() || buffer->IsVisible(drawable->GetWorldBoundingBox()))
+        if (visible)
         {
             drawable->UpdateBatches(view->frame_);
             // If draw distance non-zero, update and check it
@@ -264,6 +327,7 @@ void SortBatchQueueFrontToBackWork(const WorkItem* item, unsigned threadIndex)
     BatchQueue* queue = reinterpret_cast<BatchQueue*>(item->start_);
 
     queue->SortFrontToBack();
+    queue->RecordStateChanges();
 }
 
 void SortBatchQueueBackToFrontWork(const WorkItem* item, unsigned threadIndex)
@@ -271,20 +335,28 @@ void SortBatchQueueBackToFrontWork(const WorkItem* item, unsigned threadIndex)
     BatchQueue* queue = reinterpret_cast<BatchQueue*>(item->start_);
 
     queue->SortBackToFront();
+    queue->RecordStateChanges();
 }
 
 void SortLightQueueWork(const WorkItem* item, unsigned threadIndex)
 {
     LightBatchQueue* start = reinterpret_cast<LightBatchQueue*>(item->start_);
     start->litBaseBatches_.SortFrontToBack();
+    start->litBaseBatches_.RecordStateChanges();
     start->litBatches_.SortFrontToBack();
+    start->litBatches_.RecordStateChanges();
 }
 
 void SortShadowQueueWork(const WorkItem* item, unsigned threadIndex)
 {
     LightBatchQueue* start = reinterpret_cast<LightBatchQueue*>(item->start_);
     for (unsigned i = 0; i < start->shadowSplits_.Size(); ++i)
+    {
         start->shadowSplits_[i].shadowBatches_.SortFrontToBack();
+        start->shadowSplits_[i].shadowBatches_.RecordStateChanges();
+        start->shadowSplits_[i].dynamicShadowBatches_.SortFrontToBack();
+        start->shadowSplits_[i].dynamicShadowBatches_.RecordStateChanges();
+    }
 }
 
 StringHash ParseTextureTypeXml(ResourceCache* cache, String filename);
@@ -297,6 +369,9 @@ View::View(Context* context) :
     octree_(0),
     cullCamera_(0),
     camera_(0),
+    staticInstancingVersion_(0),
+    temporalFrames_(0),
+    useTemporalVisibility_(false),
     cameraZone_(0),
     farClipZone_(0),
     occlusionBuffer_(0),
@@ -886,17 +961,21 @@ void View::GetDrawables()
     else
         occluders_.Clear();
 
-    // Get lights and geometries. Coarse occlusion for octants is used at this point
+    UpdateTemporalVisibility();
+
+    // Get lights and geometries. Coarse occlusion for octants is used at this point. With temporal reuse, octants that stay
+    // inside the frustum and have not changed reuse their previous results, skipping the occlusion test of their children
+    OctreeQueryCache* queryCache = renderer_->GetTemporalVisibility() ? &temporalQueryCache_ : 0;
     if (occlusionBuffer_)
     {
         OccludedFrustumOctreeQuery query
             (tempDrawables, cullCamera_->GetFrustum(), occlusionBuffer_, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, cullCamera_->GetViewMask());
-        octree_->GetDrawables(query);
+        GetOctreeDrawables(octree_, query, queryCache);
     }
     else
     {
         FrustumOctreeQuery query(tempDrawables, cullCamera_->GetFrustum(), DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, cullCamera_->GetViewMask());
-        octree_->GetDrawables(query);
+        GetOctreeDrawables(octree_, query, queryCache);
     }
 
     // Check drawable occlusion, find zones for moved drawables and collect geometries & lights in worker threads
@@ -967,6 +1046,8 @@ void View::GetDrawables()
     if (minZ_ == M_INFINITY)
         minZ_ = 0.0f;
 
+    StoreTemporalVisibility();
+
     // Sort the lights to brightest/closest first, and per-vertex lights first so that per-vertex base pass can be evaluated first
     for (unsigned i = 0; i < lights_.Size(); ++i)
     {
@@ -1008,6 +1089,7 @@ void View::ProcessLights()
 
         LightQueryResult& query = lightQueryResults_[i];
         query.light_ = lights_[i];
+        query.queryCache_ = GetLightQueryCache(lights_[i]);
 
         item->start_ = &query;
         queue->AddWorkItem(item);
@@ -1015,6 +1097,15 @@ void View::ProcessLights()
 
     // Ensure all lights have been processed before proceeding
     queue->Complete(M_MAX_UNSIGNED);
+
+    // Forget the query results of lights that are no longer visible
+    for (HashMap<Light*, LightQueryCache>::Iterator i = temporalLightCaches_.Begin(); i != temporalLightCaches_.End();)
+    {
+        if (i->second_.frameNumber_ != frame_.frameNumber_)
+            i = temporalLightCaches_.Erase(i);
+        else
+            ++i;
+    }
 }
 
 void View::GetLightBatches()
@@ -1059,6 +1150,7 @@ void View::GetLightBatches()
                 lightQueue.light_ = light;
                 lightQueue.negative_ = light->IsNegative();
                 lightQueue.shadowMap_ = 0;
+                lightQueue.cachedShadowMap_ = 0;
                 lightQueue.litBaseBatches_.Clear(maxSortedInstances);
                 lightQueue.litBatches_.Clear(maxSortedInstances);
                 if (forwardLightsCommand_)
@@ -1077,9 +1169,26 @@ void View::GetLightBatches()
                 if (shadowSplits > 0)
                 {
                     lightQueue.shadowMap_ = renderer_->GetShadowMap(light, cullCamera_, (unsigned)viewSize_.x_, (unsigned)viewSize_.y_);
+
                     // If did not manage to get a shadow map, convert the light to unshadowed
                     if (!lightQueue.shadowMap_)
                         shadowSplits = 0;
+                    else
+                    {
+                        // If shadow map caching is in use, the static shadow casters are kept in a persistent layer, which
+                        // is only re-rendered for the splits whose static casters have changed
+                        lightQueue.cachedShadowMap_ = renderer_->GetCachedShadowMap(light, cullCamera_, lightQueue.shadowMap_);
+                        if (lightQueue.cachedShadowMap_)
+                        {
+                            PODVector<unsigned>& splitHashes = lightQueue.cachedShadowMap_->splitHashes_;
+                            if (splitHashes.Size() != shadowSplits)
+                            {
+                                splitHashes.Resize(shadowSplits);
+                                for (unsigned j = 0; j < shadowSplits; ++j)
+                                    splitHashes[j] = 0;
+                            }
+                        }
+                    }
                 }
 
                 // Setup shadow batch queues
@@ -1092,11 +1201,26 @@ void View::GetLightBatches()
                     shadowQueue.nearSplit_ = query.shadowNearSplits_[j];
                     shadowQueue.farSplit_ = query.shadowFarSplits_[j];
                     shadowQueue.shadowBatches_.Clear(maxSortedInstances);
+                    shadowQueue.dynamicShadowBatches_.Clear(maxSortedInstances);
 
                     // Setup the shadow split viewport and finalize shadow camera parameters
                     shadowQueue.shadowViewport_ = GetShadowMapViewport(light, j, lightQueue.shadowMap_);
                     FinalizeShadowCamera(shadowCamera, light, shadowQueue.shadowViewport_, query.shadowCasterBox_[j]);
 
+                    // When caching, hash everything that affects the static layer of the split. Casters that moved this
+                    // frame or update their geometry are dynamic and go to the per-frame queue instead
+                    bool caching = lightQueue.cachedShadowMap_ != 0;
+                    unsigned contentHash = 0;
+                    staticShadowCasters_.Clear();
+                    if (caching)
+                    {
+                        Matrix4 projection = shadowCamera->GetProjection();
+                        contentHash = HashShadowData(contentHash, &shadowCamera->GetView(), sizeof(Matrix3x4));
+                        contentHash = HashShadowData(contentHash, &projection, sizeof(Matrix4));
+                        contentHash = HashShadowData(contentHash, &shadowQueue.shadowViewport_, sizeof(IntRect));
+                        contentHash = HashShadowData(contentHash, &light->GetShadowBias(), sizeof(BiasParameters));
+                    }
+
                     // Loop through shadow casters
                     for (PODVector<Drawable*>::ConstIterator k = query.shadowCasters_.Begin() + query.shadowCasterBegin_[j];
                          k < query.shadowCasters_.Begin() + query.shadowCasterEnd_[j]; ++k)
@@ -1113,28 +1237,40 @@ void View::GetLightBatches()
                                 threadedGeometries_.Push(drawable);
                         }
 
-                        const Vector<SourceBatch>& batches = drawable->GetBatches();
-
-                        for (unsigned l = 0; l < batches.Size(); ++l)
+                        if (!caching)
                         {
-                            const SourceBatch& srcBatch = batches[l];
-
-                            Technique* tech = GetTechnique(drawable, srcBatch.material_);
-                            if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
-                                continue;
-
-                            Pass* pass = tech->GetSupportedPass(Technique::shadowPassIndex);
-                            // Skip if material has no shadow pass
-                            if (!pass)
-                                continue;
+                            AddShadowBatches(drawable, shadowQueue.shadowBatches_);
+                            continue;
+                        }
 
-                            Batch destBatch(srcBatch);
-                            destBatch.pass_ = pass;
-                            destBatch.zone_ = 0;
+                        // Hash the static casters now, but build their batches only if the split needs rendering
+                        unsigned drawableHash = contentHash;
+                        if (HashStaticShadowCaster(drawable, drawableHash))
+                        {
+                            contentHash = drawableHash;
+                            staticShadowCasters_.Push(drawable);
+                        }
+                        else
+                            AddShadowBatches(drawable, shadowQueue.dynamicShadowBatches_);
+                    }
 
-                            AddBatchToQueue(shadowQueue.shadowBatches_, destBatch, tech);
+                    if (caching)
+                    {
+                        // Zero is reserved for an invalid split
+                        shadowQueue.contentHash_ = Max(contentHash, 1U);
+                        shadowQueue.cached_ = lightQueue.cachedShadowMap_->splitHashes_[j] == shadowQueue.contentHash_;
+                        if (!shadowQueue.cached_)
+                        {
+                            for (PODVector<Drawable*>::ConstIterator k = staticShadowCasters_.Begin(); k != staticShadowCasters_.End();
+                                 ++k)
+                                AddShadowBatches(*k, shadowQueue.shadowBatches_);
                         }
                     }
+                    else
+                    {
+                        shadowQueue.contentHash_ = 0;
+                        shadowQueue.cached_ = false;
+                    }
                 }
 
                 // Process lit geometries
@@ -1206,13 +1342,76 @@ void View::GetLightBatches()
     }
 }
 
+void View::AddShadowBatches(Drawable* drawable, BatchQueue& queue)
+{
+    const Vector<SourceBatch>& batches = drawable->GetBatches();
+
+    for (unsigned i = 0; i < batches.Size(); ++i)
+    {
+        const SourceBatch& srcBatch = batches[i];
+
+        Technique* tech = GetTechnique(drawable, srcBatch.material_);
+        if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
+            continue;
+
+        Pass* pass = tech->GetSupportedPass(Technique::shadowPassIndex);
+        // Skip if material has no shadow pass
+        if (!pass)
+            continue;
+
+        Batch destBatch(srcBatch);
+        destBatch.pass_ = pass;
+        destBatch.zone_ = 0;
+
+        AddBatchToQueue(queue, destBatch, tech);
+    }
+}
+
+bool View::HashStaticShadowCaster(Drawable* drawable, unsigned& hash)
+{
+    if (drawable->GetUpdateGeometryType() != UPDATE_NONE || renderer_->IsShadowCasterMoved(drawable))
+        return false;
+
+    const Vector<SourceBatch>& batches = drawable->GetBatches();
+
+    for (unsigned i = 0; i < batches.Size(); ++i)
+    {
+        const SourceBatch& srcBatch = batches[i];
+
+        Technique* tech = GetTechnique(drawable, srcBatch.material_);
+        if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
+            continue;
+
+        Pass* pass = tech->GetSupportedPass(Technique::shadowPassIndex);
+        if (!pass)
+            continue;
+
+        // Skinned, billboard and other non-static geometry changes without the drawable moving
+        if (srcBatch.geometryType_ != GEOM_STATIC || srcBatch.instancingData_)
+            return false;
+
+        hash = HashShadowData(hash, &srcBatch.geometry_, sizeof(Geometry*));
+        hash = HashShadowData(hash, &srcBatch.material_, sizeof(Material*));
+        hash = HashShadowData(hash, srcBatch.worldTransform_, srcBatch.numWorldTransforms_ * sizeof(Matrix3x4));
+        hash = HashShadowData(hash, &srcBatch.numWorldTransforms_, sizeof(unsigned));
+        hash = HashShadowData(hash, &pass, sizeof(Pass*));
+    }
+
+    return true;
+}
+
 void View::GetBaseBatches()
 {
     ATOMIC_PROFILE(GetBaseBatches);
 
+    CheckStaticInstancingCache();
+    StaticInstancingCache* instancingCache = staticInstancingCache_;
+
     for (PODVector<Drawable*>::ConstIterator i = geometries_.Begin(); i != geometries_.End(); ++i)
     {
         Drawable* drawable = *i;
+        const PODVector<StaticInstanceSlot>* instanceSlots = instancingCache ? instancingCache->GetSlots(drawable) :
+            (const PODVector<StaticInstanceSlot>*)0;
         UpdateGeometryType type = drawable->GetUpdateGeometryType();
         if (type == UPDATE_MAIN_THREAD)
             nonThreadedGeometries_.Push(drawable);
@@ -1275,6 +1474,7 @@ void View::GetBaseBatches()
                             i = vertexLightQueues_.Insert(MakePair(hash, LightBatchQueue()));
                             i->second_.light_ = 0;
                             i->second_.shadowMap_ = 0;
+                            i->second_.cachedShadowMap_ = 0;
                             i->second_.vertexLights_ = drawableVertexLights;
                         }
 
@@ -1288,6 +1488,12 @@ void View::GetBaseBatches()
                 if (allowInstancing && info.markToStencil_ && destBatch.lightMask_ != (destBatch.zone_->GetLightMask() & 0xff))
                     allowInstancing = false;
 
+                // Static models with persistent instance data only need to be marked visible. Batches with vertex lights
+                // use a per-frame light queue, so they go through the normal path
+                if (instanceSlots && allowInstancing && !destBatch.lightQueue_ &&
+                    AddStaticBatchToQueue(*info.batchQueue_, destBatch, tech, *instanceSlots, j))
+                    continue;
+
                 AddBatchToQueue(*info.batchQueue_, destBatch, tech, allowInstancing);
             }
         }
@@ -2333,7 +2539,7 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
         {
             FrustumOctreeQuery octreeQuery(tempDrawables, light->GetFrustum(), DRAWABLE_GEOMETRY,
                 cullCamera_->GetViewMask());
-            octree_->GetDrawables(octreeQuery);
+            GetOctreeDrawables(octree_, octreeQuery, query.queryCache_ ? &query.queryCache_->queries_[0] : 0);
             for (unsigned i = 0; i < tempDrawables.Size(); ++i)
             {
                 if (tempDrawables[i]->IsInView(frame_) && (GetLightMask(tempDrawables[i]) & lightMask))
@@ -2346,7 +2552,7 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
         {
             SphereOctreeQuery octreeQuery(tempDrawables, Sphere(light->GetNode()->GetWorldPosition(), light->GetRange()),
                 DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
-            octree_->GetDrawables(octreeQuery);
+            GetOctreeDrawables(octree_, octreeQuery, query.queryCache_ ? &query.queryCache_->queries_[0] : 0);
             for (unsigned i = 0; i < tempDrawables.Size(); ++i)
             {
                 if (tempDrawables[i]->IsInView(frame_) && (GetLightMask(tempDrawables[i]) & lightMask))
@@ -2387,8 +2593,8 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
                 continue;
 
             // Reuse lit geometry query for all except directional lights
-            ShadowCasterOctreeQuery query(tempDrawables, shadowCameraFrustum, DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
-            octree_->GetDrawables(query);
+            ShadowCasterOctreeQuery octreeQuery(tempDrawables, shadowCameraFrustum, DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
+            GetOctreeDrawables(octree_, octreeQuery, query.queryCache_ ? &query.queryCache_->queries_[i] : 0);
         }
 
         // Check which shadow casters actually contribute to the shadowing
@@ -2911,8 +3117,11 @@ void View::SetQueueShaderDefines(BatchQueue& queue, const RenderPathCommand& com
 
 void View::AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, bool allowInstancing, bool allowShadows)
 {
+    // Use the material shared by all materials with identical render state, so that they can sort and instance together
     if (!batch.material_)
         batch.material_ = renderer_->GetDefaultMaterial();
+    else
+        batch.material_ = batch.material_->GetSharedState();
 
     // Convert to instanced if possible
     if (allowInstancing && batch.geometryType_ == GEOM_STATIC && batch.geometry_->GetIndexBuffer())
@@ -2966,6 +3175,92 @@ void View::AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, boo
     }
 }
 
+bool View::AddStaticBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, const PODVector<StaticInstanceSlot>& slots,
+    unsigned batchIndex)
+{
+    if (batch.geometryType_ != GEOM_STATIC)
+        return false;
+
+    // Find the persistent instance of the current LOD geometry
+    unsigned index = M_MAX_UNSIGNED;
+    for (PODVector<StaticInstanceSlot>::ConstIterator i = slots.Begin(); i != slots.End(); ++i)
+    {
+        if (i->batchIndex_ == batchIndex && i->geometry_ == batch.geometry_)
+        {
+            index = i->index_;
+            break;
+        }
+    }
+    if (index == M_MAX_UNSIGNED)
+        return false;
+
+    if (!batch.material_)
+        batch.material_ = renderer_->GetDefaultMaterial();
+    else
+        batch.material_ = batch.material_->GetSharedState();
+    batch.geometryType_ = GEOM_INSTANCED;
+
+    BatchGroupKey key(batch);
+
+    HashMap<BatchGroupKey, BatchGroup>::Iterator i = queue.staticBatchGroups_.Find(key);
+    if (i == queue.staticBatchGroups_.End())
+    {
+        const StaticInstanceGroup& instanceGroup = staticInstancingCache_->GetGroup(index);
+
+        BatchGroup newGroup(batch);
+        newGroup.instanceBuffer_ = staticInstancingCache_->GetVertexBuffer();
+        newGroup.startIndex_ = instanceGroup.start_;
+        newGroup.visibleInstances_.Resize(instanceGroup.count_);
+        memset(&newGroup.visibleInstances_[0], 0, instanceGroup.count_);
+        i = queue.staticBatchGroups_.Insert(MakePair(key, newGroup));
+    }
+
+    BatchGroup& group = i->second_;
+    // The material may have changed without the layout being rebuilt yet, in which case the instance is in another group
+    unsigned offset = index - group.startIndex_;
+    if (offset >= group.visibleInstances_.Size())
+    {
+        batch.geometryType_ = GEOM_STATIC;
+        return false;
+    }
+
+    if (!group.numVisibleInstances_)
+    {
+        // First visible instance this frame. Choose shaders now, as the technique or the shaders may have changed
+        renderer_->SetBatchShaders(group, tech, true, queue);
+        group.CalculateSortKey();
+        group.distance_ = batch.distance_;
+    }
+    else
+        group.distance_ = Min(group.distance_, batch.distance_);
+
+    if (!group.visibleInstances_[offset])
+    {
+        group.visibleInstances_[offset] = 1;
+        ++group.numVisibleInstances_;
+        ++queue.numStaticInstances_;
+    }
+
+    return true;
+}
+
+void View::CheckStaticInstancingCache()
+{
+    StaticInstancingCache* cache = octree_ ? octree_->GetStaticInstancingCache() : (StaticInstancingCache*)0;
+    if (cache && !cache->GetVertexBuffer())
+        cache = 0;
+
+    if (cache == staticInstancingCache_ && (!cache || cache->GetVersion() == staticInstancingVersion_))
+        return;
+
+    // Persistent instance groups refer to instance ranges of the old layout, so they must be recreated
+    for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
+        i->second_.staticBatchGroups_.Clear();
+
+    staticInstancingCache_ = cache;
+    staticInstancingVersion_ = cache ? cache->GetVersion() : 0;
+}
+
 void View::PrepareInstancingBuffer()
 {
     // Prepare instancing buffer from the source view
@@ -2986,7 +3281,10 @@ void View::PrepareInstancingBuffer()
     for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
     {
         for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
+        {
             totalInstances += i->shadowSplits_[j].shadowBatches_.GetNumInstances();
+            totalInstances += i->shadowSplits_[j].dynamicShadowBatches_.GetNumInstances();
+        }
         totalInstances += i->litBaseBatches_.GetNumInstances();
         totalInstances += i->litBatches_.GetNumInstances();
     }
@@ -3007,7 +3305,10 @@ void View::PrepareInstancingBuffer()
     for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
     {
         for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
+        {
             i->shadowSplits_[j].shadowBatches_.SetInstancingData(dest, stride, freeIndex);
+            i->shadowSplits_[j].dynamicShadowBatches_.SetInstancingData(dest, stride, freeIndex);
+        }
         i->litBaseBatches_.SetInstancingData(dest, stride, freeIndex);
         i->litBatches_.SetInstancingData(dest, stride, freeIndex);
     }
@@ -3084,7 +3385,88 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
 
     // Set shadow depth bias
     BiasParameters parameters = queue.light_->GetShadowBias();
+    // Color rendertarget shadow maps (VSM) do not use depth bias
+    if (shadowMap->GetUsage() != TEXTURE_DEPTHSTENCIL)
+        parameters = BiasParameters(0.0f, 0.0f);
+
+    if (queue.cachedShadowMap_)
+    {
+        Texture2D* staticLayer = queue.cachedShadowMap_->shadowMap_;
+
+        // Re-render the static casters of the changed splits into the persistent layer. Clear each of them separately
+        // unless all have changed
+        unsigned numChanged = 0;
+        for (unsigned i = 0; i < queue.shadowSplits_.Size(); ++i)
+        {
+            if (!queue.shadowSplits_[i].cached_)
+                ++numChanged;
+        }
+
+        if (numChanged)
+        {
+            SetShadowMapRenderTarget(staticLayer);
+            if (numChanged == queue.shadowSplits_.Size())
+                graphics_->Clear(CLEAR_DEPTH);
+
+            for (unsigned i = 0; i < queue.shadowSplits_.Size(); ++i)
+            {
+                const ShadowBatchQueue& shadowQueue = queue.shadowSplits_[i];
+                if (shadowQueue.cached_)
+                    continue;
+
+                queue.cachedShadowMap_->splitHashes_[i] = shadowQueue.contentHash_;
+                if (numChanged < queue.shadowSplits_.Size())
+                {
+                    graphics_->SetViewport(shadowQueue.shadowViewport_);
+                    graphics_->Clear(CLEAR_DEPTH);
+                }
+
+                RenderShadowSplit(queue, i, shadowQueue.shadowBatches_, parameters);
+            }
+        }
+
+        // Copy the static layer to the shadow map, then render the dynamic casters over it
+        SetShadowMapRenderTarget(shadowMap);
+        graphics_->SetDepthBias(0.0f, 0.0f);
+        graphics_->SetBlendMode(BLEND_REPLACE);
+        graphics_->SetDepthTest(CMP_ALWAYS);
+        graphics_->SetDepthWrite(true);
+
+        static const String shaderName("CopyDepth");
+        graphics_->SetShaders(graphics_->GetShader(VS, shaderName), graphics_->GetShader(PS, shaderName));
+        IntVector2 size(shadowMap->GetWidth(), shadowMap->GetHeight());
+        SetGBufferShaderParameters(size, IntRect(0, 0, size.x_, size.y_));
+        graphics_->SetTexture(TU_DIFFUSE, staticLayer);
+        DrawFullscreenQuad(true);
+        graphics_->SetTexture(TU_DIFFUSE, 0);
+
+        for (unsigned i = 0; i < queue.shadowSplits_.Size(); ++i)
+            RenderShadowSplit(queue, i, queue.shadowSplits_[i].dynamicShadowBatches_, parameters);
+    }
+    else
+    {
+        SetShadowMapRenderTarget(shadowMap);
+        if (shadowMap->GetUsage() == TEXTURE_DEPTHSTENCIL)
+            graphics_->Clear(CLEAR_DEPTH);
+        else
+            graphics_->Clear(CLEAR_DEPTH | CLEAR_COLOR, Color::WHITE);
+
+        // Render each of the splits
+        for (unsigned i = 0; i < queue.shadowSplits_.Size(); ++i)
+            RenderShadowSplit(queue, i, queue.shadowSplits_[i].shadowBatches_, parameters);
+    }
 
+    // Scale filter blur amount to shadow map viewport size so that different shadow map resolutions don't behave differently
+    float blurScale = queue.shadowSplits_[0].shadowViewport_.Width() / 1024.0f;
+    renderer_->ApplyShadowMapFilter(this, shadowMap, blurScale);
+
+    // reset some parameters
+    graphics_->SetColorWrite(true);
+    graphics_->SetDepthBias(0.0f, 0.0f);
+}
+
+void View::SetShadowMapRenderTarget(Texture2D* shadowMap)
+{
     // The shadow map is a depth stencil texture
     if (shadowMap->GetUsage() == TEXTURE_DEPTHSTENCIL)
     {
@@ -3094,8 +3476,6 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
         // Disable other render targets
         for (unsigned i = 1; i < MAX_RENDERTARGETS; ++i)
             graphics_->SetRenderTarget(i, (RenderSurface*) 0);
-        graphics_->SetViewport(IntRect(0, 0, shadowMap->GetWidth(), shadowMap->GetHeight()));
-        graphics_->Clear(CLEAR_DEPTH);
     }
     else // if the shadow map is a color rendertarget
     {
@@ -3106,56 +3486,45 @@ void View::RenderShadowMap(const LightBatchQueue& queue)
             graphics_->SetRenderTarget(i, (RenderSurface*) 0);
         graphics_->SetDepthStencil(renderer_->GetDepthStencil(shadowMap->GetWidth(), shadowMap->GetHeight(),
             shadowMap->GetMultiSample(), shadowMap->GetAutoResolve()));
-        graphics_->SetViewport(IntRect(0, 0, shadowMap->GetWidth(), shadowMap->GetHeight()));
-        graphics_->Clear(CLEAR_DEPTH | CLEAR_COLOR, Color::WHITE);
-
-        parameters = BiasParameters(0.0f, 0.0f);
     }
 
-    // Render each of the splits
-    for (unsigned i = 0; i < queue.shadowSplits_.Size(); ++i)
-    {
-        const ShadowBatchQueue& shadowQueue = queue.shadowSplits_[i];
+    graphics_->SetViewport(IntRect(0, 0, shadowMap->GetWidth(), shadowMap->GetHeight()));
+}
 
-        float multiplier = 1.0f;
-        // For directional light cascade splits, adjust depth bias according to the far clip ratio of the splits
-        if (i > 0 && queue.light_->GetLightType() == LIGHT_DIRECTIONAL)
-        {
-            multiplier =
-                Max(shadowQueue.shadowCamera_->GetFarClip() / queue.shadowSplits_[0].shadowCamera_->GetFarClip(), 1.0f);
-            multiplier = 1.0f + (multiplier - 1.0f) * queue.light_->GetShadowCascade().biasAutoAdjust_;
-            // Quantize multiplier to prevent creation of too many rasterizer states on D3D11
-            multiplier = (int)(multiplier * 10.0f) / 10.0f;
-        }
+void View::RenderShadowSplit(const LightBatchQueue& queue, unsigned index, const BatchQueue& batches,
+    const BiasParameters& parameters)
+{
+    if (batches.IsEmpty())
+        return;
 
-        // Perform further modification of depth bias on OpenGL ES, as shadow calculations' precision is limited
-        float addition = 0.0f;
+    const ShadowBatchQueue& shadowQueue = queue.shadowSplits_[index];
+
+    float multiplier = 1.0f;
+    // For directional light cascade splits, adjust depth bias according to the far clip ratio of the splits
+    if (index > 0 && queue.light_->GetLightType() == LIGHT_DIRECTIONAL)
+    {
+        multiplier =
+            Max(shadowQueue.shadowCamera_->GetFarClip() / queue.shadowSplits_[0].shadowCamera_->GetFarClip(), 1.0f);
+        multiplier = 1.0f + (multiplier - 1.0f) * queue.light_->GetShadowCascade().biasAutoAdjust_;
+        // Quantize multiplier to prevent creation of too many rasterizer states on D3D11
+        multiplier = (int)(multiplier * 10.0f) / 10.0f;
+    }
+
+    // Perform further modification of depth bias on OpenGL ES, as shadow calculations' precision is limited
+    float addition = 0.0f;
 #ifdef GL_ES_VERSION_2_0
-        multiplier *= renderer_->GetMobileShadowBiasMul();
-        addition = renderer_->GetMobileShadowBiasAdd();
+    multiplier *= renderer_->GetMobileShadowBiasMul();
+    addition = renderer_->GetMobileShadowBiasAdd();
 #endif
 
-        graphics_->SetDepthBias(multiplier * parameters.constantBias_ + addition, multiplier * parameters.slopeScaledBias_);
+    graphics_->SetDepthBias(multiplier * parameters.constantBias_ + addition, multiplier * parameters.slopeScaledBias_);
 
-        if (!shadowQueue.shadowBatches_.IsEmpty())
-        {
-            graphics_->SetViewport(shadowQueue.shadowViewport_);
-            shadowQueue.shadowBatches_.Draw(this, shadowQueue.shadowCamera_, false, false, true);
+    graphics_->SetViewport(shadowQueue.shadowViewport_);
+    batches.Draw(this, shadowQueue.shadowCamera_, false, false, true);
 
 // ATOMIC BEGIN
-            graphics_->SetNumPasses(graphics_->GetNumPasses() + 1);
+    graphics_->SetNumPasses(graphics_->GetNumPasses() + 1);
 // ATOMIC END
-
-        }
-    }
-
-    // Scale filter blur amount to shadow map viewport size so that different shadow map resolutions don't behave differently
-    float blurScale = queue.shadowSplits_[0].shadowViewport_.Width() / 1024.0f;
-    renderer_->ApplyShadowMapFilter(this, shadowMap, blurScale);
-
-    // reset some parameters
-    graphics_->SetColorWrite(true);
-    graphics_->SetDepthBias(0.0f, 0.0f);
 }
 
 RenderSurface* View::GetDepthStencil(RenderSurface* renderTarget)
@@ -3249,4 +3618,97 @@ Texture* View::FindNamedTexture(const String& name, bool isRenderTarget, bool is
     return 0;
 }
 
+void View::UpdateTemporalVisibility()
+{
+    useTemporalVisibility_ = false;
+
+    if (!renderer_->GetTemporalVisibility())
+    {
+        temporalVisible_.Clear();
+        temporalQueryCache_.Clear();
+        temporalLightCaches_.Clear();
+        temporalCamera_.Reset();
+        temporalOctree_.Reset();
+        return;
+    }
+
+    // The cached octree query results hold octant and drawable pointers, so they are only valid for the same octree. The
+    // query results themselves stay exact as long as the octants have not changed, so they need no jump check
+    if (temporalOctree_ != octree_)
+    {
+        temporalVisible_.Clear();
+        temporalQueryCache_.Clear();
+        temporalLightCaches_.Clear();
+        temporalCamera_.Reset();
+        temporalOctree_ = octree_;
+    }
+
+    // Occlusion results can only be reused when there is an occlusion buffer
+    if (!occlusionBuffer_)
+    {
+        temporalVisible_.Clear();
+        temporalCamera_.Reset();
+        return;
+    }
+
+    Node* cameraNode = cullCamera_->GetNode();
+    Vector3 position = cameraNode->GetWorldPosition();
+    Quaternion rotation = cameraNode->GetWorldRotation();
+    const Matrix4& projection = cullCamera_->GetProjection();
+
+    // Fall back to a full visibility test if the camera or scene changed, the camera jumped, or the refresh interval has
+    // elapsed. The periodic full test is what allows drawables that have become occluded to be culled again
+    float maxMove = renderer_->GetTemporalVisibilityMaxMove();
+    float minRotationDot = Cos(renderer_->GetTemporalVisibilityMaxRotation() * 0.5f);
+    if (temporalCamera_ == cullCamera_ && !temporalVisible_.Empty() &&
+        temporalFrames_ < renderer_->GetTemporalVisibilityInterval() &&
+        (position - temporalCameraPosition_).LengthSquared() <= maxMove * maxMove &&
+        Abs(rotation.DotProduct(temporalCameraRotation_)) >= minRotationDot && projection.Equals(temporalProjection_))
+    {
+        useTemporalVisibility_ = true;
+        ++temporalFrames_;
+    }
+    else
+    {
+        // Reused octants skip the occlusion test of their children, so start over to let occluded children be culled again
+        temporalFrames_ = 0;
+        temporalQueryCache_.Clear();
+    }
+
+    temporalCamera_ = cullCamera_;
+    temporalCameraPosition_ = position;
+    temporalCameraRotation_ = rotation;
+    temporalProjection_ = projection;
+}
+
+void View::StoreTemporalVisibility()
+{
+    if (!temporalCamera_)
+        return;
+
+    temporalVisible_.Clear();
+    for (PODVector<Drawable*>::ConstIterator i = geometries_.Begin(); i != geometries_.End(); ++i)
+        temporalVisible_[*i] = *i;
+    for (PODVector<Light*>::ConstIterator i = lights_.Begin(); i != lights_.End(); ++i)
+        temporalVisible_[*i] = *i;
+}
+
+LightQueryCache* View::GetLightQueryCache(Light* light)
+{
+    if (!renderer_->GetTemporalVisibility())
+        return 0;
+
+    // The light may have been destroyed and a new one created at the same address
+    LightQueryCache& cache = temporalLightCaches_[light];
+    if (cache.light_ != light)
+    {
+        for (unsigned i = 0; i < MAX_LIGHT_SPLITS; ++i)
+            cache.queries_[i].Clear();
+        cache.light_ = light;
+    }
+
+    cache.frameNumber_ = frame_.frameNumber_;
+    return &cache;
+}
+
 }
@@ -27,6 +27,7 @@
 #include "../Core/Object.h"
 #include "../Graphics/Batch.h"
 #include "../Graphics/Light.h"
+#include "../Graphics/Octree.h"
 #include "../Graphics/Zone.h"
 #include "../Math/Polyhedron.h"
 
@@ -43,19 +44,41 @@ class Octree;
 class Renderer;
 class RenderPath;
 class RenderSurface;
+class StaticInstancingCache;
 class Technique;
 class Texture;
 class Texture2D;
 class Viewport;
 class Zone;
+struct BiasParameters;
 struct RenderPathCommand;
+struct StaticInstanceSlot;
 struct WorkItem;
 
+/// Octree query results of a light from the previous frame, for temporal visibility reuse.
+struct LightQueryCache
+{
+    /// Construct.
+    LightQueryCache() :
+        frameNumber_(0)
+    {
+    }
+
+    /// Light the results belong to.
+    WeakPtr<Light> light_;
+    /// Lit geometry query results of point and spot lights, or shadow caster query results by split of directional lights.
+    OctreeQueryCache queries_[MAX_LIGHT_SPLITS];
+    /// Frame number on which the results were last used.
+    unsigned frameNumber_;
+};
+
 /// Intermediate light processing result.
 struct LightQueryResult
 {
     /// Light.
     Light* light_;
+    /// Octree query results from the previous frame. Null if temporal visibility reuse is disabled.
+    LightQueryCache* queryCache_;
     /// Lit geometries.
     PODVector<Drawable*> litGeometries_;
     /// Shadow casters.
@@ -253,6 +276,10 @@ private:
         const Frustum& lightViewFrustum, const BoundingBox& lightViewFrustumBox);
     /// Return the viewport for a shadow map split.
     IntRect GetShadowMapViewport(Light* light, unsigned splitIndex, Texture2D* shadowMap);
+    /// Add a shadow caster's shadow pass batches to a queue.
+    void AddShadowBatches(Drawable* drawable, BatchQueue& queue);
+    /// Combine a shadow caster's batches into a cached split content hash. Return false if the caster is dynamic.
+    bool HashStaticShadowCaster(Drawable* drawable, unsigned& hash);
     /// Find and set a new zone for a drawable when it has moved.
     void FindZone(Drawable* drawable);
     /// Return material technique, considering the drawable's LOD distance.
@@ -263,6 +290,17 @@ private:
     void SetQueueShaderDefines(BatchQueue& queue, const RenderPathCommand& command);
     /// Choose shaders for a batch and add it to queue.
     void AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, bool allowInstancing = true, bool allowShadows = true);
+    /// Mark a static model batch visible in its persistent instance group. Return false if it must be added as a normal batch instead.
+    bool AddStaticBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, const PODVector<StaticInstanceSlot>& slots,
+        unsigned batchIndex);
+    /// Clear persistent instance groups if the octree's static instancing cache or its layout has changed.
+    void CheckStaticInstancingCache();
+    /// Decide whether the previous frame's occlusion results can be reused, and fall back to a full test if the camera jumped.
+    void UpdateTemporalVisibility();
+    /// Return the octree query results of a light from the previous frame, or null if temporal visibility reuse is disabled.
+    LightQueryCache* GetLightQueryCache(Light* light);
+    /// Store the current frame's visible drawables for reuse on the next frame.
+    void StoreTemporalVisibility();
     /// Prepare instancing buffer by filling it with all instance transforms.
     void PrepareInstancingBuffer();
     /// Set up a light volume rendering batch.
@@ -271,6 +309,10 @@ private:
     bool NeedRenderShadowMap(const LightBatchQueue& queue);
     /// Render a shadow map.
     void RenderShadowMap(const LightBatchQueue& queue);
+    /// Set a shadow map as the rendertarget, with the full shadow map as the viewport.
+    void SetShadowMapRenderTarget(Texture2D* shadowMap);
+    /// Render the shadow casters of a shadow map split.
+    void RenderShadowSplit(const LightBatchQueue& queue, unsigned index, const BatchQueue& batches, const BiasParameters& parameters);
     /// Return the proper depth-stencil surface to use for a rendertarget.
     RenderSurface* GetDepthStencil(RenderSurface* renderTarget);
     /// Helper function to get the render surface from a texture. 2D textures will always return the first face only.
@@ -322,6 +364,31 @@ private:
     Camera* cullCamera_;
     /// Shared source view. Null if this view is using its own culling.
     WeakPtr<View> sourceView_;
+    /// Static instancing cache the persistent instance groups were built from.
+    WeakPtr<StaticInstancingCache> staticInstancingCache_;
+    /// Static instancing cache layout version the persistent instance groups were built from.
+    unsigned staticInstancingVersion_;
+    /// Camera the previous frame's visible set was gathered with.
+    WeakPtr<Camera> temporalCamera_;
+    /// Octree the previous frame's visible set was gathered from.
+    WeakPtr<Octree> temporalOctree_;
+    /// Camera world position on the previous frame.
+    Vector3 temporalCameraPosition_;
+    /// Camera world rotation on the previous frame.
+    Quaternion temporalCameraRotation_;
+    /// Camera projection on the previous frame.
+    Matrix4 temporalProjection_;
+    /// Frames since the last full visibility test.
+    int temporalFrames_;
+    /// Drawables that were visible on the previous frame. Not occlusion tested again while temporal reuse is active. The
+    /// weak pointers detect drawables destroyed since, in case a new drawable reuses the address.
+    HashMap<Drawable*, WeakPtr<Drawable> > temporalVisible_;
+    /// Octree query results of the culling camera from the previous frame.
+    OctreeQueryCache temporalQueryCache_;
+    /// Octree query results of lights from the previous frame.
+    HashMap<Light*, LightQueryCache> temporalLightCaches_;
+    /// Temporal reuse active flag for the current frame.
+    bool useTemporalVisibility_;
     /// Zone the camera is inside, or default zone if not assigned.
     Zone* cameraZone_;
     /// Zone at far clip plane.
@@ -398,6 +465,8 @@ private:
     PODVector<Drawable*> threadedGeometries_;
     /// Occluder objects.
     PODVector<Drawable*> occluders_;
+    /// Static shadow casters of the shadow split being processed, when shadow map caching is in use.
+    PODVector<Drawable*> staticShadowCasters_;
     /// Lights.
     PODVector<Light*> lights_;
     /// Number of active occluders.
@@ -0,0 +1,185 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../IO/BitStream.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+static const unsigned VLE_GROUP_BITS = 4;
+static const unsigned VLE_GROUP_MASK = (1 << VLE_GROUP_BITS) - 1;
+static const unsigned VLE_CONTINUE_BIT = 1 << VLE_GROUP_BITS;
+
+static inline unsigned ZigZagEncode(int value)
+{
+    return ((unsigned)value << 1) ^ (unsigned)(value >> 31);
+}
+
+static inline int ZigZagDecode(unsigned value)
+{
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+BitWriter::BitWriter(Serializer& dest) :
+    dest_(dest),
+    current_(0),
+    pendingBits_(0),
+    numBits_(0)
+{
+}
+
+BitWriter::~BitWriter()
+{
+    Flush();
+}
+
+void BitWriter::WriteBits(unsigned value, unsigned numBits)
+{
+    numBits_ += numBits;
+
+    while (numBits)
+    {
+        unsigned count = Min(8 - pendingBits_, numBits);
+        current_ |= (value & ((1u << count) - 1)) << pendingBits_;
+        value >>= count;
+        numBits -= count;
+        pendingBits_ += count;
+
+        if (pendingBits_ == 8)
+        {
+            dest_.WriteUByte((unsigned char)current_);
+            current_ = 0;
+            pendingBits_ = 0;
+        }
+    }
+}
+
+void BitWriter::WriteBool(bool value)
+{
+    WriteBits(value ? 1 : 0, 1);
+}
+
+void BitWriter::WriteVLE(unsigned value)
+{
+    do
+    {
+        unsigned group = value & VLE_GROUP_MASK;
+        value >>= VLE_GROUP_BITS;
+        WriteBits(value ? group | VLE_CONTINUE_BIT : group, VLE_GROUP_BITS + 1);
+    }
+    while (value);
+}
+
+void BitWriter::WriteSignedVLE(int value)
+{
+    WriteVLE(ZigZagEncode(value));
+}
+
+void BitWriter::Flush()
+{
+    if (pendingBits_)
+    {
+        dest_.WriteUByte((unsigned char)current_);
+        numBits_ += 8 - pendingBits_;
+        current_ = 0;
+        pendingBits_ = 0;
+    }
+}
+
+unsigned BitWriter::GetVLESize(unsigned value)
+{
+    unsigned size = VLE_GROUP_BITS + 1;
+    while (value >>= VLE_GROUP_BITS)
+        size += VLE_GROUP_BITS + 1;
+    return size;
+}
+
+unsigned BitWriter::GetSignedVLESize(int value)
+{
+    return GetVLESize(ZigZagEncode(value));
+}
+
+BitReader::BitReader(Deserializer& source) :
+    source_(source),
+    current_(0),
+    availableBits_(0)
+{
+}
+
+unsigned BitReader::ReadBits(unsigned numBits)
+{
+    unsigned value = 0;
+    unsigned shift = 0;
+
+    while (numBits)
+    {
+        if (!availableBits_)
+        {
+            current_ = source_.ReadUByte();
+            availableBits_ = 8;
+        }
+
+        unsigned count = Min(availableBits_, numBits);
+        value |= (current_ & ((1u << count) - 1)) << shift;
+        current_ >>= count;
+        availableBits_ -= count;
+        numBits -= count;
+        shift += count;
+    }
+
+    return value;
+}
+
+bool BitReader::ReadBool()
+{
+    return ReadBits(1) != 0;
+}
+
+unsigned BitReader::ReadVLE()
+{
+    unsigned value = 0;
+    unsigned shift = 0;
+
+    for (;;)
+    {
+        unsigned group = ReadBits(VLE_GROUP_BITS + 1);
+        if (shift < 32)
+            value |= (group & VLE_GROUP_MASK) << shift;
+        shift += VLE_GROUP_BITS;
+        if (!(group & VLE_CONTINUE_BIT) || (source_.IsEof() && !availableBits_))
+            break;
+    }
+
+    return value;
+}
+
+int BitReader::ReadSignedVLE()
+{
+    return ZigZagDecode(ReadVLE());
+}
+
+}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../IO/Deserializer.h"
+#include "../IO/Serializer.h"
+
+namespace Atomic
+{
+
+/// Bit-packed writer on top of a serializer. Bits are written least significant first. The last partial byte is written on Flush() or destruction.
+class ATOMIC_API BitWriter
+{
+public:
+    /// Construct with destination serializer.
+    BitWriter(Serializer& dest);
+    /// Destruct. Write the last partial byte.
+    ~BitWriter();
+
+    /// Write the lowest bits of a value. Up to 32 bits.
+    void WriteBits(unsigned value, unsigned numBits);
+    /// Write a bool as a single bit.
+    void WriteBool(bool value);
+    /// Write a variable-length unsigned integer in groups of four bits.
+    void WriteVLE(unsigned value);
+    /// Write a variable-length signed integer in groups of four bits.
+    void WriteSignedVLE(int value);
+    /// Write the last partial byte padded with zero bits. Further writes start from a new byte.
+    void Flush();
+
+    /// Return number of bits written.
+    unsigned GetNumBits() const { return numBits_; }
+
+    /// Return the bit size of a variable-length unsigned integer.
+    static unsigned GetVLESize(unsigned value);
+    /// Return the bit size of a variable-length signed integer.
+    static unsigned GetSignedVLESize(int value);
+
+private:
+    /// Destination serializer.
+    Serializer& dest_;
+    /// Partial byte being written.
+    unsigned current_;
+    /// Number of bits in the partial byte.
+    unsigned pendingBits_;
+    /// Total number of bits written.
+    unsigned numBits_;
+};
+
+/// Bit-packed reader on top of a deserializer, reading what BitWriter wrote. Bits remaining in the last read byte are discarded when reading stops.
+class ATOMIC_API BitReader
+{
+public:
+    /// Construct with source deserializer.
+    BitReader(Deserializer& source);
+
+    /// Read bits into the lowest bits of the return value. Up to 32 bits.
+    unsigned ReadBits(unsigned numBits);
+    /// Read a single bit as a bool.
+    bool ReadBool();
+    /// Read a variable-length unsigned integer.
+    unsigned ReadVLE();
+    /// Read a variable-length signed integer.
+    int ReadSignedVLE();
+
+private:
+    /// Source deserializer.
+    Deserializer& source_;
+    /// Remaining bits of the last read byte.
+    unsigned current_;
+    /// Number of remaining bits in the last read byte.
+    unsigned availableBits_;
+};
+
+}
@@ -22,7 +22,10 @@
 
 #include "../IO/Log.h"
 
+#include "../Graphics/Drawable.h"
+#include "../Graphics/Material.h"
 #include "../Scene/Node.h"
+#include "../Scene/Scene.h"
 #include "../Script/ScriptComponent.h"
 #include "../Metrics/Metrics.h"
 
@@ -378,6 +381,79 @@ String Metrics::PrintNodeNames() const
     return output;
 }
 
+String Metrics::PrintDuplicateMaterials(Scene* scene) const
+{
+    String output;
+
+    if (!scene)
+        return output;
+
+    PODVector<Drawable*> drawables;
+    scene->GetDerivedComponents<Drawable>(drawables, true);
+
+    // state hash => distinct materials with that state, material => number of batches using it
+    HashMap<unsigned, PODVector<Material*> > states;
+    HashMap<Material*, unsigned> batchCounts;
+
+    for (unsigned i = 0; i < drawables.Size(); i++)
+    {
+        const Vector<SourceBatch>& batches = drawables[i]->GetBatches();
+
+        for (unsigned j = 0; j < batches.Size(); j++)
+        {
+            Material* material = batches[j].material_;
+
+            if (!material)
+                continue;
+
+            HashMap<Material*, unsigned>::Iterator itr = batchCounts.Find(material);
+
+            if (itr != batchCounts.End())
+            {
+                itr->second_++;
+                continue;
+            }
+
+            batchCounts[material] = 1;
+
+            // Only count materials as duplicates when their state actually matches, not just the hash
+            PODVector<Material*>& materials = states[material->GetStateHash()];
+
+            if (!materials.Size() || material->HasSameState(materials[0]))
+                materials.Push(material);
+        }
+    }
+
+    unsigned numDuplicates = 0;
+
+    String groups;
+
+    HashMap<unsigned, PODVector<Material*> >::ConstIterator stateItr = states.Begin();
+
+    for (; stateItr != states.End(); stateItr++)
+    {
+        const PODVector<Material*>& materials = stateItr->second_;
+
+        if (materials.Size() < 2)
+            continue;
+
+        numDuplicates += materials.Size() - 1;
+
+        groups.AppendWithFormat("%u materials with identical state:\n", materials.Size());
+
+        for (unsigned i = 0; i < materials.Size(); i++)
+        {
+            const String& name = materials[i]->GetName();
+            groups.AppendWithFormat("    %s (%u batches)\n", name.Length() ? name.CString() : "Unnamed Material", batchCounts[materials[i]]);
+        }
+    }
+
+    output.AppendWithFormat("Scene: %s, %u materials, %u duplicates\n", scene->GetName().CString(), batchCounts.Size(), numDuplicates);
+    output += groups;
+
+    return output;
+}
+
 void Metrics::AddRefCounted(RefCounted* refCounted)
 {
     // We're called from the RefCounted constructor, so we don't know whether we're an object, etc
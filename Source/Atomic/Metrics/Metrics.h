@@ -28,6 +28,8 @@
 namespace Atomic
 {
 
+class Scene;
+
 class ATOMIC_API MetricsSnapshot : public RefCounted
 {
     friend class Metrics;
@@ -124,6 +126,9 @@ public:
     /// Prints names of registered node instances output string
     String PrintNodeNames() const;
 
+    /// Prints materials of a scene's drawables which have identical render state, and could be replaced by a single material
+    String PrintDuplicateMaterials(Scene* scene) const;
+
 private:
 
     // A RefCountedInfo entry, necessary as we need to access instances in RefCounted constructor/destructor
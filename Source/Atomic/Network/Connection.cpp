@@ -23,12 +23,14 @@
 #include "../Precompiled.h"
 
 #include "../Core/Profiler.h"
+#include "../IO/Compression.h"
 #include "../IO/File.h"
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
 #include "../IO/MemoryBuffer.h"
 #include "../IO/PackageFile.h"
 #include "../Network/Connection.h"
+#include "../Network/InterestManager.h"
 #include "../Network/Network.h"
 #include "../Network/NetworkEvents.h"
 #include "../Network/NetworkPriority.h"
@@ -48,24 +50,69 @@ namespace Atomic
 {
 
 static const int STATS_INTERVAL_MSEC = 2000;
+static const unsigned MAX_INPUT_HISTORY = 64;
+
+static const unsigned char REMOTEEVENT_NODE = 0x1;
+static const unsigned char REMOTEEVENT_SCHEMA = 0x2;
+
+/// Verify a downloaded package file against the size and checksum announced by the server.
+static bool VerifyPackageFile(Context* context, const String& fileName, unsigned fileSize, unsigned checksum)
+{
+    ATOMIC_PROFILE(VerifyPackageFile);
+
+    SharedPtr<PackageFile> package(new PackageFile(context));
+    if (!package->Open(fileName) || package->GetTotalSize() != fileSize || package->GetChecksum() != checksum)
+        return false;
+
+    // The package checksum is calculated over the uncompressed data of all entries in the order they are stored,
+    // so recompute it from the contents instead of trusting the header
+    unsigned contentChecksum = 0;
+    unsigned char buffer[4096];
+    const HashMap<String, PackageEntry>& entries = package->GetEntries();
+    for (HashMap<String, PackageEntry>::ConstIterator i = entries.Begin(); i != entries.End(); ++i)
+    {
+        File file(context, package, i->first_);
+        if (!file.IsOpen())
+            return false;
+
+        unsigned remaining = file.GetSize();
+        while (remaining)
+        {
+            unsigned readSize = Min(remaining, (unsigned)sizeof buffer);
+            if (file.Read(buffer, readSize) != readSize)
+                return false;
+            for (unsigned j = 0; j < readSize; ++j)
+                contentChecksum = SDBMHash(contentChecksum, buffer[j]);
+            remaining -= readSize;
+        }
+    }
+
+    return contentChecksum == checksum;
+}
 
 PackageDownload::PackageDownload() :
-    totalFragments_(0),
+    fileSize_(0),
     checksum_(0),
+    chunksInFlight_(0),
+    remainingChunks_(0),
     initiated_(false)
 {
 }
 
 PackageUpload::PackageUpload() :
-    fragment_(0),
-    totalFragments_(0)
+    numChunks_(0),
+    compress_(false),
+    manifestPending_(false)
 {
 }
 
 // ATOMIC BEGIN
 Connection::Connection(Context* context) : Object(context),
     timeStamp_(0),
+    serverTick_(0),
     sendMode_(OPSM_NONE),
+    team_(0),
+    attributeBandwidthStats_(false),
     connectPending_(false),
     sceneLoaded_(false),
     logStatistics_(false)
@@ -77,8 +124,11 @@ Connection::Connection(Context* context) : Object(context),
 Connection::Connection(Context* context, bool isClient, kNet::SharedPtr<kNet::MessageConnection> connection) :
     Object(context),
     timeStamp_(0),
+    serverTick_(0),
     connection_(connection),
     sendMode_(OPSM_NONE),
+    team_(0),
+    attributeBandwidthStats_(false),
     isClient_(isClient),
     connectPending_(false),
     sceneLoaded_(false),
@@ -140,12 +190,7 @@ void Connection::SendMessage(int msgID, bool reliable, bool inOrder, const unsig
 
 void Connection::SendRemoteEvent(StringHash eventType, bool inOrder, const VariantMap& eventData)
 {
-    RemoteEvent queuedEvent;
-    queuedEvent.senderID_ = 0;
-    queuedEvent.eventType_ = eventType;
-    queuedEvent.eventData_ = eventData;
-    queuedEvent.inOrder_ = inOrder;
-    remoteEvents_.Push(queuedEvent);
+    QueueRemoteEvent(0, eventType, inOrder, eventData);
 }
 
 void Connection::SendRemoteEvent(Node* node, StringHash eventType, bool inOrder, const VariantMap& eventData)
@@ -166,12 +211,7 @@ void Connection::SendRemoteEvent(Node* node, StringHash eventType, bool inOrder,
         return;
     }
 
-    RemoteEvent queuedEvent;
-    queuedEvent.senderID_ = node->GetID();
-    queuedEvent.eventType_ = eventType;
-    queuedEvent.eventData_ = eventData;
-    queuedEvent.inOrder_ = inOrder;
-    remoteEvents_.Push(queuedEvent);
+    QueueRemoteEvent(node->GetID(), eventType, inOrder, eventData);
 }
 
 void Connection::SetScene(Scene* newScene)
@@ -205,7 +245,11 @@ void Connection::SetScene(Scene* newScene)
             msg_.WriteString(GetFileNameAndExtension(package->GetName()));
             msg_.WriteUInt(package->GetTotalSize());
             msg_.WriteUInt(package->GetChecksum());
+            // Start calculating the chunk hashes now, so that they are usually ready when the client requests the package
+            GetSubsystem<Network>()->GetPackageChunkHashes(package);
         }
+        // The update rate lets the client convert the server ticks of the scene updates to time
+        msg_.WriteVLE(GetSubsystem<Network>()->GetUpdateFps());
         SendMessage(MSG_LOADSCENE, true, true, msg_);
     }
     else
@@ -244,6 +288,18 @@ void Connection::SetRotation(const Quaternion& rotation)
         sendMode_ = OPSM_POSITION_ROTATION;
 }
 
+void Connection::SetPredictedNode(Node* node)
+{
+    if (scene_ && predictedNode_)
+        scene_->GetSnapshotBuffer().SetInterpolated(predictedNode_, true);
+
+    predictedNode_ = node;
+    inputHistory_.Clear();
+
+    if (scene_ && node)
+        scene_->GetSnapshotBuffer().SetInterpolated(node, false);
+}
+
 void Connection::SetConnectPending(bool connectPending)
 {
     connectPending_ = connectPending;
@@ -261,6 +317,18 @@ void Connection::Disconnect(int waitMSec)
 
 void Connection::SendServerUpdate()
 {
+    PrepareServerUpdate();
+    FlushServerUpdate();
+}
+
+void Connection::PrepareServerUpdate()
+{
+    serverUpdateMessages_.Clear();
+
+    Network* network = GetSubsystem<Network>();
+    attributeBandwidthStats_ = network && network->GetAttributeBandwidthStats();
+    serverTick_ = network ? (unsigned short)network->GetServerTick() : 0;
+
     if (!scene_ || !sceneLoaded_)
         return;
 
@@ -270,6 +338,40 @@ void Connection::SendServerUpdate()
     nodesToProcess_.Insert(sceneID);
     ProcessNode(sceneID);
 
+    InterestManager* interest = scene_->GetComponent<InterestManager>();
+    if (interest && interest->IsEnabledEffective())
+    {
+        // With interest management, only go through the nodes relevant to this client
+        interest->GetRelevantNodes(this, sceneState_, relevantNodes_);
+        RemoveIrrelevantNodes();
+
+        for (HashSet<unsigned>::ConstIterator i = relevantNodes_.Begin(); i != relevantNodes_.End(); ++i)
+        {
+            // Nodes that became relevant are dirty for this client, so that depended on nodes get created first
+            if (!sceneState_.nodeStates_.Contains(*i))
+                sceneState_.dirtyNodes_.Insert(*i);
+            if (sceneState_.dirtyNodes_.Contains(*i))
+                nodesToProcess_.Insert(*i);
+        }
+        nodesToProcess_.Erase(sceneID);
+
+        while (nodesToProcess_.Size())
+        {
+            unsigned nodeID = nodesToProcess_.Front();
+            ProcessNode(nodeID);
+        }
+
+        // Forget dirty nodes the client does not have. They will be sent in full if they become relevant
+        for (HashSet<unsigned>::Iterator i = sceneState_.dirtyNodes_.Begin(); i != sceneState_.dirtyNodes_.End();)
+        {
+            if (!sceneState_.nodeStates_.Contains(*i))
+                i = sceneState_.dirtyNodes_.Erase(i);
+            else
+                ++i;
+        }
+        return;
+    }
+
     // Then go through all dirtied nodes
     nodesToProcess_.Insert(sceneState_.dirtyNodes_);
     nodesToProcess_.Erase(sceneID); // Do not process the root node twice
@@ -281,6 +383,24 @@ void Connection::SendServerUpdate()
     }
 }
 
+void Connection::FlushServerUpdate()
+{
+    MemoryBuffer messages(serverUpdateMessages_.GetData(), serverUpdateMessages_.GetSize());
+    while (!messages.IsEof())
+    {
+        int msgID = messages.ReadInt();
+        unsigned char flags = messages.ReadUByte();
+        unsigned contentID = messages.ReadUInt();
+        unsigned numBytes = messages.ReadVLE();
+        unsigned position = messages.GetPosition();
+
+        SendMessage(msgID, (flags & 1) != 0, (flags & 2) != 0, messages.GetData() + position, numBytes, contentID);
+        messages.Seek(position + numBytes);
+    }
+
+    serverUpdateMessages_.Clear();
+}
+
 void Connection::SendClientUpdate()
 {
     if (!scene_ || !sceneLoaded_)
@@ -298,6 +418,44 @@ void Connection::SendClientUpdate()
         msg_.WritePackedQuaternion(rotation_);
     SendMessage(MSG_CONTROLS, false, false, msg_, CONTROLS_CONTENT_ID);
 
+    // Acknowledge the received latest data updates, so that the server can delta encode against them. A lost
+    // acknowledgement only makes the server use an older baseline
+    if (nodeLatestDataAcks_.Size() || componentLatestDataAcks_.Size())
+    {
+        msg_.Clear();
+        msg_.WriteVLE(nodeLatestDataAcks_.Size());
+        for (HashMap<unsigned, unsigned>::ConstIterator i = nodeLatestDataAcks_.Begin(); i != nodeLatestDataAcks_.End(); ++i)
+        {
+            msg_.WriteNetID(i->first_);
+            msg_.WriteUShort((unsigned short)i->second_);
+        }
+        msg_.WriteVLE(componentLatestDataAcks_.Size());
+        for (HashMap<unsigned, unsigned>::ConstIterator i = componentLatestDataAcks_.Begin(); i != componentLatestDataAcks_.End();
+             ++i)
+        {
+            msg_.WriteNetID(i->first_);
+            msg_.WriteUShort((unsigned short)i->second_);
+        }
+        SendMessage(MSG_LATESTDATAACK, false, false, msg_);
+
+        nodeLatestDataAcks_.Clear();
+        componentLatestDataAcks_.Clear();
+    }
+
+    if (predictedNode_)
+    {
+        // Remember the input and the transform predicted so far, to compare with the server state acknowledging it
+        if (inputHistory_.Size() >= MAX_INPUT_HISTORY)
+            inputHistory_.Erase(0);
+
+        PredictedInput input;
+        input.controls_ = controls_;
+        input.position_ = predictedNode_->GetPosition();
+        input.rotation_ = predictedNode_->GetRotation();
+        input.timeStamp_ = timeStamp_;
+        inputHistory_.Push(input);
+    }
+
     ++timeStamp_;
 }
 
@@ -315,57 +473,128 @@ void Connection::SendRemoteEvents()
     }
 #endif
 
-    if (remoteEvents_.Empty())
+    if (!orderedRemoteEvents_.GetSize() && !unorderedRemoteEvents_.GetSize())
         return;
 
     ATOMIC_PROFILE(SendRemoteEvents);
 
-    for (Vector<RemoteEvent>::ConstIterator i = remoteEvents_.Begin(); i != remoteEvents_.End(); ++i)
+    // All events queued during the update go in one message per ordering mode
+    if (orderedRemoteEvents_.GetSize())
     {
-        msg_.Clear();
-        if (!i->senderID_)
+        SendMessage(MSG_REMOTEEVENTS, true, true, orderedRemoteEvents_);
+        orderedRemoteEvents_.Clear();
+    }
+    if (unorderedRemoteEvents_.GetSize())
+    {
+        SendMessage(MSG_REMOTEEVENTS, true, false, unorderedRemoteEvents_);
+        unorderedRemoteEvents_.Clear();
+    }
+}
+
+void Connection::QueueRemoteEvent(unsigned senderID, StringHash eventType, bool inOrder, const VariantMap& eventData)
+{
+    Network* network = GetSubsystem<Network>();
+    const RemoteEventSchema* schema = network ? network->GetRemoteEventSchema(eventType) : 0;
+    bool useSchema = schema && schema->Matches(eventData);
+
+    VectorBuffer& dest = inOrder ? orderedRemoteEvents_ : unorderedRemoteEvents_;
+    dest.WriteStringHash(eventType);
+    dest.WriteUByte((unsigned char)((senderID ? REMOTEEVENT_NODE : 0) | (useSchema ? REMOTEEVENT_SCHEMA : 0)));
+    if (senderID)
+        dest.WriteNetID(senderID);
+
+    if (useSchema)
+    {
+        // Write the field values in the schema's order without keys or type tags
+        for (unsigned i = 0; i < schema->keys_.Size(); ++i)
         {
-            msg_.WriteStringHash(i->eventType_);
-            msg_.WriteVariantMap(i->eventData_);
-            SendMessage(MSG_REMOTEEVENT, true, i->inOrder_, msg_);
+            VariantMap::ConstIterator j = eventData.Find(schema->keys_[i]);
+            dest.WriteVariantData(j != eventData.End() ? j->second_ : schema->defaults_[i]);
         }
-        else
+    }
+    else
+        dest.WriteVariantMap(eventData);
+}
+
+void Connection::SendPackages()
+{
+    for (HashMap<StringHash, PackageUpload>::Iterator i = uploads_.Begin(); i != uploads_.End(); ++i)
+    {
+        PackageUpload& upload = i->second_;
+        if (upload.manifestPending_)
+            upload.manifestPending_ = !SendPackageManifest(i->first_, upload);
+    }
+
+    while (!uploads_.Empty() && connection_->NumOutboundMessagesPending() < 1000)
+    {
+        // Send one requested chunk of each upload in turn, so that the packages download in parallel
+        bool sent = false;
+        for (HashMap<StringHash, PackageUpload>::Iterator i = uploads_.Begin(); i != uploads_.End(); ++i)
         {
-            msg_.WriteNetID(i->senderID_);
-            msg_.WriteStringHash(i->eventType_);
-            msg_.WriteVariantMap(i->eventData_);
-            SendMessage(MSG_REMOTENODEEVENT, true, i->inOrder_, msg_);
+            PackageUpload& upload = i->second_;
+            if (upload.requestedChunks_.Empty())
+                continue;
+
+            unsigned index = upload.requestedChunks_.Front();
+            upload.requestedChunks_.Erase(0);
+            SendPackageChunk(i->first_, upload, index);
+            sent = true;
         }
+
+        if (!sent)
+            break;
     }
+}
+
+bool Connection::SendPackageManifest(StringHash nameHash, PackageUpload& upload)
+{
+    const PODVector<unsigned>* chunkHashes = GetSubsystem<Network>()->GetPackageChunkHashes(upload.package_);
+    if (!chunkHashes)
+        return false;
 
-    remoteEvents_.Clear();
+    msg_.Clear();
+    msg_.WriteStringHash(nameHash);
+    msg_.WriteUInt(upload.file_->GetSize());
+    msg_.WriteVLE(chunkHashes->Size());
+    for (unsigned i = 0; i < chunkHashes->Size(); ++i)
+        msg_.WriteUInt((*chunkHashes)[i]);
+    SendMessage(MSG_PACKAGEMANIFEST, true, true, msg_);
+    return true;
 }
 
-void Connection::SendPackages()
+void Connection::SendPackageChunk(StringHash nameHash, PackageUpload& upload, unsigned index)
 {
-    while (!uploads_.Empty() && connection_->NumOutboundMessagesPending() < 1000)
+    unsigned offset = index * PACKAGE_CHUNK_SIZE;
+    unsigned chunkSize = Min(upload.file_->GetSize() - offset, PACKAGE_CHUNK_SIZE);
+    chunkBuffer_.Resize(chunkSize);
+    upload.file_->Seek(offset);
+    if (upload.file_->Read(&chunkBuffer_[0], chunkSize) != chunkSize)
     {
-        unsigned char buffer[PACKAGE_FRAGMENT_SIZE];
+        ATOMIC_LOGERROR("Failed to read package chunk " + String(index) + " of " + upload.file_->GetName());
+        return;
+    }
 
-        for (HashMap<StringHash, PackageUpload>::Iterator i = uploads_.Begin(); i != uploads_.End();)
+    const unsigned char* data = &chunkBuffer_[0];
+    unsigned dataSize = chunkSize;
+    bool compressed = false;
+    if (upload.compress_)
+    {
+        compressBuffer_.Resize(EstimateCompressBound(chunkSize));
+        unsigned compressedSize = CompressData(&compressBuffer_[0], data, chunkSize);
+        if (compressedSize && compressedSize < chunkSize)
         {
-            HashMap<StringHash, PackageUpload>::Iterator current = i++;
-            PackageUpload& upload = current->second_;
-            unsigned fragmentSize =
-                Min((upload.file_->GetSize() - upload.file_->GetPosition()), PACKAGE_FRAGMENT_SIZE);
-            upload.file_->Read(buffer, fragmentSize);
-
-            msg_.Clear();
-            msg_.WriteStringHash(current->first_);
-            msg_.WriteUInt(upload.fragment_++);
-            msg_.Write(buffer, fragmentSize);
-            SendMessage(MSG_PACKAGEDATA, true, false, msg_);
-
-            // Check if upload finished
-            if (upload.fragment_ == upload.totalFragments_)
-                uploads_.Erase(current);
+            data = &compressBuffer_[0];
+            dataSize = compressedSize;
+            compressed = true;
         }
     }
+
+    msg_.Clear();
+    msg_.WriteStringHash(nameHash);
+    msg_.WriteVLE(index);
+    msg_.WriteBool(compressed);
+    msg_.Write(data, dataSize);
+    SendMessage(MSG_PACKAGECHUNK, true, false, msg_);
 }
 
 void Connection::ProcessPendingLatestData()
@@ -382,7 +611,8 @@ void Connection::ProcessPendingLatestData()
         {
             MemoryBuffer msg(current->second_);
             msg.ReadNetID(); // Skip the node ID
-            node->ReadLatestDataUpdate(msg);
+            unsigned short tick = msg.ReadUShort();
+            ReadNodeUpdate(node, msg, tick, true);
             // ApplyAttributes() is deliberately skipped, as Node has no attributes that require late applying.
             // Furthermore it would propagate to components and child nodes, which is not desired in this case
             nodeLatestData_.Erase(current);
@@ -398,8 +628,11 @@ void Connection::ProcessPendingLatestData()
         {
             MemoryBuffer msg(current->second_);
             msg.ReadNetID(); // Skip the component ID
-            if (component->ReadLatestDataUpdate(msg))
+            unsigned ackSequence = M_MAX_UNSIGNED;
+            if (component->ReadLatestDataUpdate(msg, &ackSequence))
                 component->ApplyAttributes();
+            if (ackSequence != M_MAX_UNSIGNED)
+                componentLatestDataAcks_[component->GetID()] = ackSequence;
             componentLatestData_.Erase(current);
         }
     }
@@ -425,6 +658,9 @@ bool Connection::ProcessMessage(int msgID, MemoryBuffer& msg)
 
     case MSG_REQUESTPACKAGE:
     case MSG_PACKAGEDATA:
+    case MSG_PACKAGEMANIFEST:
+    case MSG_REQUESTPACKAGECHUNKS:
+    case MSG_PACKAGECHUNK:
         ProcessPackageDownload(msgID, msg);
         break;
 
@@ -452,6 +688,14 @@ bool Connection::ProcessMessage(int msgID, MemoryBuffer& msg)
         ProcessRemoteEvent(msgID, msg);
         break;
 
+    case MSG_REMOTEEVENTS:
+        ProcessRemoteEvents(msg);
+        break;
+
+    case MSG_LATESTDATAACK:
+        ProcessLatestDataAck(msg);
+        break;
+
     case MSG_PACKAGEINFO:
         ProcessPackageInfo(msgID, msg);
         break;
@@ -490,6 +734,8 @@ void Connection::ProcessLoadScene(int msgID, MemoryBuffer& msg)
     // Clear previous pending latest data and package downloads if any
     nodeLatestData_.Clear();
     componentLatestData_.Clear();
+    nodeLatestDataAcks_.Clear();
+    componentLatestDataAcks_.Clear();
     downloads_.Clear();
 
     // In case we have joined other scenes in this session, remove first all downloaded package files from the resource system
@@ -513,6 +759,12 @@ void Connection::ProcessLoadScene(int msgID, MemoryBuffer& msg)
         return;
     }
 
+    SnapshotBuffer& snapshots = scene_->GetSnapshotBuffer();
+    snapshots.Clear();
+    if (!msg.IsEof())
+        snapshots.SetTickInterval(1.0f / (float)Max((int)msg.ReadVLE(), 1));
+    inputHistory_.Clear();
+
     // If no downloads were queued, can load the scene directly
     if (downloads_.Empty())
         OnPackagesReady();
@@ -548,18 +800,21 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
     case MSG_CREATENODE:
         {
             unsigned nodeID = msg.ReadNetID();
+            unsigned short tick = msg.ReadUShort();
             // In case of the root node (scene), it should already exist. Do not create in that case
             Node* node = scene_->GetNode(nodeID);
             if (!node)
             {
                 // Add initially to the root level. May be moved as we receive the parent attribute
                 node = scene_->CreateChild(nodeID, REPLICATED);
-                // Create smoothed transform component
-                node->CreateComponent<SmoothedTransform>(LOCAL);
+                // Create smoothed transform component, unless the scene uses snapshot interpolation
+                if (!scene_->GetSnapshotInterpolation())
+                    node->CreateComponent<SmoothedTransform>(LOCAL);
             }
 
             // Read initial attributes, then snap the motion smoothing immediately to the end
-            node->ReadDeltaUpdate(msg);
+            ReadNodeUpdate(node, msg, tick, false);
+            scene_->GetSnapshotBuffer().Snap(node);
             SmoothedTransform* transform = node->GetComponent<SmoothedTransform>();
             if (transform)
                 transform->Update(1.0f, 0.0f);
@@ -608,10 +863,11 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
     case MSG_NODEDELTAUPDATE:
         {
             unsigned nodeID = msg.ReadNetID();
+            unsigned short tick = msg.ReadUShort();
             Node* node = scene_->GetNode(nodeID);
             if (node)
             {
-                node->ReadDeltaUpdate(msg);
+                ReadNodeUpdate(node, msg, tick, false);
                 // ApplyAttributes() is deliberately skipped, as Node has no attributes that require late applying.
                 // Furthermore it would propagate to components and child nodes, which is not desired in this case
                 unsigned changedVars = msg.ReadVLE();
@@ -633,7 +889,8 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
             Node* node = scene_->GetNode(nodeID);
             if (node)
             {
-                node->ReadLatestDataUpdate(msg);
+                unsigned short tick = msg.ReadUShort();
+                ReadNodeUpdate(node, msg, tick, true);
                 // ApplyAttributes() is deliberately skipped, as Node has no attributes that require late applying.
                 // Furthermore it would propagate to components and child nodes, which is not desired in this case
             }
@@ -711,8 +968,11 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
             Component* component = scene_->GetComponent(componentID);
             if (component)
             {
-                if (component->ReadLatestDataUpdate(msg))
+                unsigned ackSequence = M_MAX_UNSIGNED;
+                if (component->ReadLatestDataUpdate(msg, &ackSequence))
                     component->ApplyAttributes();
+                if (ackSequence != M_MAX_UNSIGNED)
+                    componentLatestDataAcks_[componentID] = ackSequence;
             }
             else
             {
@@ -767,28 +1027,33 @@ void Connection::ProcessPackageDownload(int msgID, MemoryBuffer& msg)
                 if (!GetFileNameAndExtension(packageFullName).Compare(name, false))
                 {
                     StringHash nameHash(name);
+                    Network* network = GetSubsystem<Network>();
 
-                    // Do not restart upload if already exists
-                    if (uploads_.Contains(nameHash))
+                    // Open the file now, unless already uploading. The client may request the manifest again
+                    if (!uploads_.Contains(nameHash))
                     {
-                        ATOMIC_LOGWARNING("Received a request for package " + name + " already in transfer");
-                        return;
+                        SharedPtr<File> file(new File(context_, packageFullName));
+                        if (!file->IsOpen())
+                        {
+                            ATOMIC_LOGERROR("Failed to transmit package file " + name);
+                            SendPackageError(name);
+                            return;
+                        }
+
+                        ATOMIC_LOGINFO("Transmitting package file " + name + " to client " + ToString());
+
+                        PackageUpload& upload = uploads_[nameHash];
+                        upload.file_ = file;
+                        upload.package_ = package;
+                        upload.numChunks_ = (file->GetSize() + PACKAGE_CHUNK_SIZE - 1) / PACKAGE_CHUNK_SIZE;
+                        // Chunks of a compressed package would not get any smaller
+                        upload.compress_ = network->GetPackageCompression() && !package->IsCompressed();
                     }
 
-                    // Try to open the file now
-                    SharedPtr<File> file(new File(context_, packageFullName));
-                    if (!file->IsOpen())
-                    {
-                        ATOMIC_LOGERROR("Failed to transmit package file " + name);
-                        SendPackageError(name);
-                        return;
-                    }
-
-                    ATOMIC_LOGINFO("Transmitting package file " + name + " to client " + ToString());
-
-                    uploads_[nameHash].file_ = file;
-                    uploads_[nameHash].fragment_ = 0;
-                    uploads_[nameHash].totalFragments_ = (file->GetSize() + PACKAGE_FRAGMENT_SIZE - 1) / PACKAGE_FRAGMENT_SIZE;
+                    // Send the manifest, from which the client finds the chunks it is missing. If the chunk hashes are
+                    // still being calculated, SendPackages() sends it later
+                    PackageUpload& upload = uploads_[nameHash];
+                    upload.manifestPending_ = !SendPackageManifest(nameHash, upload);
                     return;
                 }
             }
@@ -800,79 +1065,69 @@ void Connection::ProcessPackageDownload(int msgID, MemoryBuffer& msg)
         }
         break;
 
-    case MSG_PACKAGEDATA:
-        if (IsClient())
+    case MSG_REQUESTPACKAGECHUNKS:
+        if (!IsClient())
         {
-            ATOMIC_LOGWARNING("Received unexpected PackageData message from client");
+            ATOMIC_LOGWARNING("Received unexpected RequestPackageChunks message from server");
             return;
         }
         else
         {
             StringHash nameHash = msg.ReadStringHash();
-
-            HashMap<StringHash, PackageDownload>::Iterator i = downloads_.Find(nameHash);
-            // In case of being unable to create the package file into the cache, we will still receive all data from the server.
-            // Simply disregard it
-            if (i == downloads_.End())
+            HashMap<StringHash, PackageUpload>::Iterator i = uploads_.Find(nameHash);
+            if (i == uploads_.End())
+            {
+                ATOMIC_LOGWARNING("Received a request for chunks of a package not in transfer from client " + ToString());
                 return;
+            }
 
-            PackageDownload& download = i->second_;
-
-            // If no further data, this is an error reply
-            if (msg.IsEof())
+            PackageUpload& upload = i->second_;
+            unsigned numChunks = msg.ReadVLE();
+            // An empty request means the client has all the chunks
+            if (!numChunks)
             {
-                OnPackageDownloadFailed(download.name_);
+                uploads_.Erase(i);
                 return;
             }
 
-            // If file has not yet been opened, try to open now. Prepend the checksum to the filename to allow multiple versions
-            if (!download.file_)
+            for (unsigned j = 0; j < numChunks && !msg.IsEof(); ++j)
             {
-                download.file_ = new File(context_,
-                    GetSubsystem<Network>()->GetPackageCacheDir() + ToStringHex(download.checksum_) + "_" + download.name_,
-                    FILE_WRITE);
-                if (!download.file_->IsOpen())
-                {
-                    OnPackageDownloadFailed(download.name_);
-                    return;
-                }
+                unsigned index = msg.ReadVLE();
+                if (index < upload.numChunks_ && upload.requestedChunks_.Size() < upload.numChunks_)
+                    upload.requestedChunks_.Push(index);
             }
+        }
+        break;
 
-            // Write the fragment data to the proper index
-            unsigned char buffer[PACKAGE_FRAGMENT_SIZE];
-            unsigned index = msg.ReadUInt();
-            unsigned fragmentSize = msg.GetSize() - msg.GetPosition();
-
-            msg.Read(buffer, fragmentSize);
-            download.file_->Seek(index * PACKAGE_FRAGMENT_SIZE);
-            download.file_->Write(buffer, fragmentSize);
-            download.receivedFragments_.Insert(index);
-
-            // Check if all fragments received
-            if (download.receivedFragments_.Size() == download.totalFragments_)
-            {
-                ATOMIC_LOGINFO("Package " + download.name_ + " downloaded successfully");
+    case MSG_PACKAGEDATA:
+        if (IsClient())
+        {
+            ATOMIC_LOGWARNING("Received unexpected PackageData message from client");
+            return;
+        }
+        else
+        {
+            StringHash nameHash = msg.ReadStringHash();
 
-                // Instantiate the package and add to the resource system, as we will need it to load the scene
-                download.file_->Close();
-                GetSubsystem<ResourceCache>()->AddPackageFile(download.file_->GetName(), 0);
+            // Package data is sent in chunks, so this can only be an error reply
+            HashMap<StringHash, PackageDownload>::Iterator i = downloads_.Find(nameHash);
+            if (i != downloads_.End() && msg.IsEof())
+                OnPackageDownloadFailed(i->second_.name_);
+        }
+        break;
 
-                // Then start the next download if there are more
-                downloads_.Erase(i);
-                if (downloads_.Empty())
-                    OnPackagesReady();
-                else
-                {
-                    PackageDownload& nextDownload = downloads_.Begin()->second_;
+    case MSG_PACKAGEMANIFEST:
+        if (IsClient())
+            ATOMIC_LOGWARNING("Received unexpected PackageManifest message from client");
+        else
+            ProcessPackageManifest(msg);
+        break;
 
-                    ATOMIC_LOGINFO("Requesting package " + nextDownload.name_ + " from server");
-                    msg_.Clear();
-                    msg_.WriteString(nextDownload.name_);
-                    SendMessage(MSG_REQUESTPACKAGE, true, true, msg_);
-                    nextDownload.initiated_ = true;
-                }
-            }
-        }
+    case MSG_PACKAGECHUNK:
+        if (IsClient())
+            ATOMIC_LOGWARNING("Received unexpected PackageChunk message from client");
+        else
+            ProcessPackageChunk(msg);
         break;
 
     default: break;
@@ -1005,6 +1260,111 @@ void Connection::ProcessRemoteEvent(int msgID, MemoryBuffer& msg)
     }
 }
 
+void Connection::ProcessRemoteEvents(MemoryBuffer& msg)
+{
+    using namespace RemoteEventData;
+
+    Network* network = GetSubsystem<Network>();
+
+    while (!msg.IsEof())
+    {
+        StringHash eventType = msg.ReadStringHash();
+        unsigned char flags = msg.ReadUByte();
+        unsigned senderID = (flags & REMOTEEVENT_NODE) ? msg.ReadNetID() : 0;
+
+        // Decode into the same map for every event to avoid allocating a new one
+        remoteEventData_.Clear();
+        if (flags & REMOTEEVENT_SCHEMA)
+        {
+            const RemoteEventSchema* schema = network->GetRemoteEventSchema(eventType);
+            if (!schema)
+            {
+                // The field layout is unknown, so the rest of the batch can not be read either
+                ATOMIC_LOGERROR("No schema registered for remote event " + eventType.ToString() + ", discarding remote events");
+                return;
+            }
+
+            for (unsigned i = 0; i < schema->keys_.Size(); ++i)
+                remoteEventData_[schema->keys_[i]] = msg.ReadVariant(schema->defaults_[i].GetType());
+        }
+        else
+        {
+            unsigned numVariants = msg.ReadVLE();
+            for (unsigned i = 0; i < numVariants; ++i)
+            {
+                StringHash key = msg.ReadStringHash();
+                remoteEventData_[key] = msg.ReadVariant();
+            }
+        }
+
+        if (!network->CheckRemoteEvent(eventType))
+        {
+            ATOMIC_LOGWARNING("Discarding not allowed remote event " + eventType.ToString());
+            continue;
+        }
+
+        remoteEventData_[P_CONNECTION] = this;
+        if (!senderID)
+            SendEvent(eventType, remoteEventData_);
+        else
+        {
+            if (!scene_)
+            {
+                ATOMIC_LOGERROR("Can not receive remote node event without an assigned scene");
+                continue;
+            }
+
+            Node* sender = scene_->GetNode(senderID);
+            if (!sender)
+            {
+                ATOMIC_LOGWARNING("Missing sender for remote node event, discarding");
+                continue;
+            }
+            sender->SendEvent(eventType, remoteEventData_);
+        }
+    }
+}
+
+void Connection::ProcessLatestDataAck(MemoryBuffer& msg)
+{
+    if (!IsClient())
+    {
+        ATOMIC_LOGWARNING("Received unexpected LatestDataAck message from server");
+        return;
+    }
+
+    if (!scene_)
+        return;
+
+    unsigned numNodes = msg.ReadVLE();
+    for (unsigned i = 0; i < numNodes && !msg.IsEof(); ++i)
+    {
+        unsigned nodeID = msg.ReadNetID();
+        unsigned short sequence = msg.ReadUShort();
+        HashMap<unsigned, NodeReplicationState>::Iterator j = sceneState_.nodeStates_.Find(nodeID);
+        if (j != sceneState_.nodeStates_.End())
+            j->second_.latestData_.Acknowledge(sequence);
+    }
+
+    unsigned numComponents = msg.ReadVLE();
+    for (unsigned i = 0; i < numComponents && !msg.IsEof(); ++i)
+    {
+        unsigned componentID = msg.ReadNetID();
+        unsigned short sequence = msg.ReadUShort();
+        Component* component = scene_->GetComponent(componentID);
+        Node* node = component ? component->GetNode() : 0;
+        if (!node)
+            continue;
+
+        HashMap<unsigned, NodeReplicationState>::Iterator j = sceneState_.nodeStates_.Find(node->GetID());
+        if (j == sceneState_.nodeStates_.End())
+            continue;
+        HashMap<unsigned, ComponentReplicationState>::Iterator k = j->second_.componentStates_.Find(componentID);
+        if (k != j->second_.componentStates_.End())
+            k->second_.latestData_.Acknowledge(sequence);
+    }
+}
+
 kNet::MessageConnection* Connection::GetMessageConnection() const
 {
     return const_cast<kNet::MessageConnection*>(connection_.ptr());
@@ -1075,7 +1435,10 @@ float Connection::GetDownloadProgress() const
     for (HashMap<StringHash, PackageDownload>::ConstIterator i = downloads_.Begin(); i != downloads_.End(); ++i)
     {
         if (i->second_.initiated_)
-            return (float)i->second_.receivedFragments_.Size() / (float)i->second_.totalFragments_;
+        {
+            unsigned numChunks = i->second_.chunkHashes_.Size();
+            return numChunks ? 1.0f - (float)i->second_.remainingChunks_ / (float)numChunks : 0.0f;
+        }
     }
     return 1.0f;
 }
@@ -1148,6 +1511,121 @@ void Connection::HandleAsyncLoadFinished(StringHash eventType, VariantMap& event
     SendMessage(MSG_SCENELOADED, true, true, msg_);
 }
 
+void Connection::ReadNodeUpdate(Node* node, MemoryBuffer& msg, unsigned short tick, bool latestData)
+{
+    // The attribute data begins with the timestamp of the last controls the server had received
+    unsigned char timeStamp = msg.GetPosition() < msg.GetSize() ? msg.GetData()[msg.GetPosition()] : 0;
+
+    SnapshotBuffer& snapshots = scene_->GetSnapshotBuffer();
+    snapshots.BeginReceive(tick);
+    if (latestData)
+    {
+        unsigned ackSequence = M_MAX_UNSIGNED;
+        node->ReadLatestDataUpdate(msg, &ackSequence);
+        if (ackSequence != M_MAX_UNSIGNED)
+            nodeLatestDataAcks_[node->GetID()] = ackSequence;
+    }
+    else
+        node->ReadDeltaUpdate(msg);
+    snapshots.EndReceive();
+
+    if (node == predictedNode_)
+        ReconcilePrediction(node, timeStamp);
+}
+
+void Connection::ReconcilePrediction(Node* node, unsigned char timeStamp)
+{
+    // Forget the inputs included in the server state. If there are none, the state is older than one already reconciled
+    unsigned numAcked = 0;
+    while (numAcked < inputHistory_.Size() && (signed char)(inputHistory_[numAcked].timeStamp_ - timeStamp) <= 0)
+        ++numAcked;
+    if (!numAcked)
+        return;
+
+    Vector3 position = node->GetPosition();
+    Quaternion rotation = node->GetRotation();
+    scene_->GetSnapshotBuffer().GetLatest(node, position, rotation);
+
+    Vector3 positionError = position - inputHistory_[numAcked - 1].position_;
+    inputHistory_.Erase(0, numAcked);
+
+    using namespace PredictionReconcile;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_CONNECTION] = this;
+    eventData[P_NODE] = node;
+    eventData[P_POSITION] = position;
+    eventData[P_ROTATION] = rotation;
+    eventData[P_POSITIONERROR] = positionError;
+    eventData[P_TIMESTAMP] = (unsigned)timeStamp;
+    SendEvent(E_PREDICTIONRECONCILE, eventData);
+}
+
+void Connection::RemoveIrrelevantNodes()
+{
+    for (HashMap<unsigned, NodeReplicationState>::Iterator i = sceneState_.nodeStates_.Begin();
+         i != sceneState_.nodeStates_.End();)
+    {
+        HashMap<unsigned, NodeReplicationState>::Iterator current = i++;
+        if (relevantNodes_.Contains(current->first_))
+            continue;
+
+        // The node is either removed from the scene or no longer relevant. Either way the client removes it
+        msg_.Clear();
+        msg_.WriteNetID(current->first_);
+        QueueServerMessage(MSG_REMOVENODE, true, true, msg_);
+
+        // Detach the replication states from the node and its components, which other connections may be modifying
+        MutexLock lock(scene_->GetReplicationMutex());
+        NodeReplicationState& nodeState = current->second_;
+        Node* node = nodeState.node_;
+        if (node)
+        {
+            node->RemoveReplicationState(&nodeState);
+            for (HashMap<unsigned, ComponentReplicationState>::Iterator j = nodeState.componentStates_.Begin();
+                 j != nodeState.componentStates_.End(); ++j)
+            {
+                Component* component = j->second_.component_;
+                if (component)
+                    component->RemoveReplicationState(&j->second_);
+            }
+        }
+
+        sceneState_.dirtyNodes_.Erase(current->first_);
+        sceneState_.nodeStates_.Erase(current);
+    }
+}
+
+unsigned* Connection::GetAttributeBitCounts(Serializable* serializable)
+{
+    if (!attributeBandwidthStats_)
+        return 0;
+
+    const Vector<AttributeInfo>* attributes = serializable->GetNetworkAttributes();
+    if (!attributes || attributes->Empty())
+        return 0;
+
+    PODVector<unsigned>& counts = attributeBitCounts_[serializable->GetType()];
+    if (counts.Size() < attributes->Size())
+    {
+        unsigned oldSize = counts.Size();
+        counts.Resize(attributes->Size());
+        for (unsigned i = oldSize; i < counts.Size(); ++i)
+            counts[i] = 0;
+    }
+
+    return &counts[0];
+}
+
+void Connection::QueueServerMessage(int msgID, bool reliable, bool inOrder, const VectorBuffer& msg, unsigned contentID)
+{
+    serverUpdateMessages_.WriteInt(msgID);
+    serverUpdateMessages_.WriteUByte((unsigned char)((reliable ? 1 : 0) | (inOrder ? 2 : 0)));
+    serverUpdateMessages_.WriteUInt(contentID);
+    serverUpdateMessages_.WriteVLE(msg.GetSize());
+    serverUpdateMessages_.Write(msg.GetData(), msg.GetSize());
+}
+
 void Connection::ProcessNode(unsigned nodeID)
 {
     // Check that we have not already processed this due to dependency recursion
@@ -1168,7 +1646,10 @@ void Connection::ProcessNode(unsigned nodeID)
             // Note: we will send MSG_REMOVENODE redundantly for each node in the hierarchy, even if removing the root node
             // would be enough. However, this may be better due to the client not possibly having updated parenting
             // information at the time of receiving this message
-            SendMessage(MSG_REMOVENODE, true, true, msg_);
+            QueueServerMessage(MSG_REMOVENODE, true, true, msg_);
+
+            // Releasing the replication state modifies weak reference counts shared with other connections
+            MutexLock lock(scene_->GetReplicationMutex());
             sceneState_.nodeStates_.Erase(nodeID);
         }
         else
@@ -1203,13 +1684,18 @@ void Connection::ProcessNewNode(Node* node)
     msg_.WriteNetID(node->GetID());
 
     NodeReplicationState& nodeState = sceneState_.nodeStates_[node->GetID()];
-    nodeState.connection_ = this;
-    nodeState.sceneState_ = &sceneState_;
-    nodeState.node_ = node;
-    node->AddReplicationState(&nodeState);
+    {
+        // Other connections may be adding their replication states to the same objects in worker threads
+        MutexLock lock(scene_->GetReplicationMutex());
+        nodeState.connection_ = this;
+        nodeState.sceneState_ = &sceneState_;
+        nodeState.node_ = node;
+        node->AddReplicationState(&nodeState);
+    }
 
     // Write node's attributes
-    node->WriteInitialDeltaUpdate(msg_, timeStamp_);
+    msg_.WriteUShort(serverTick_);
+    node->WriteInitialDeltaUpdate(msg_, timeStamp_, &nodeState.quantizedValues_, GetAttributeBitCounts(node));
 
     // Write node's user variables
     const VariantMap& vars = node->GetVars();
@@ -1231,17 +1717,21 @@ void Connection::ProcessNewNode(Node* node)
             continue;
 
         ComponentReplicationState& componentState = nodeState.componentStates_[component->GetID()];
-        componentState.connection_ = this;
-        componentState.nodeState_ = &nodeState;
-        componentState.component_ = component;
-        component->AddReplicationState(&componentState);
+        {
+            MutexLock lock(scene_->GetReplicationMutex());
+            componentState.connection_ = this;
+            componentState.nodeState_ = &nodeState;
+            componentState.component_ = component;
+            component->AddReplicationState(&componentState);
+        }
 
         msg_.WriteStringHash(component->GetType());
         msg_.WriteNetID(component->GetID());
-        component->WriteInitialDeltaUpdate(msg_, timeStamp_);
+        component->WriteInitialDeltaUpdate(msg_, timeStamp_, &componentState.quantizedValues_,
+            GetAttributeBitCounts(component));
     }
 
-    SendMessage(MSG_CREATENODE, true, true, msg_);
+    QueueServerMessage(MSG_CREATENODE, true, true, msg_);
 
     nodeState.markedDirty_ = false;
     sceneState_.dirtyNodes_.Erase(node->GetID());
@@ -1289,9 +1779,10 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
         {
             msg_.Clear();
             msg_.WriteNetID(node->GetID());
-            node->WriteLatestDataUpdate(msg_, timeStamp_);
+            msg_.WriteUShort(serverTick_);
+            node->WriteLatestDataUpdate(msg_, timeStamp_, &nodeState.latestData_, GetAttributeBitCounts(node));
 
-            SendMessage(MSG_NODELATESTDATA, true, false, msg_, node->GetID());
+            QueueServerMessage(MSG_NODELATESTDATA, true, false, msg_, node->GetID());
         }
 
         // Send deltaupdate if remaining dirty bits, or vars have changed
@@ -1299,7 +1790,9 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
         {
             msg_.Clear();
             msg_.WriteNetID(node->GetID());
-            node->WriteDeltaUpdate(msg_, nodeState.dirtyAttributes_, timeStamp_);
+            msg_.WriteUShort(serverTick_);
+            node->WriteDeltaUpdate(msg_, nodeState.dirtyAttributes_, timeStamp_, &nodeState.quantizedValues_,
+                GetAttributeBitCounts(node));
 
             // Write changed variables
             msg_.WriteVLE(nodeState.dirtyVars_.Size());
@@ -1321,7 +1814,7 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
                 }
             }
 
-            SendMessage(MSG_NODEDELTAUPDATE, true, true, msg_);
+            QueueServerMessage(MSG_NODEDELTAUPDATE, true, true, msg_);
 
             nodeState.dirtyAttributes_.ClearAll();
             nodeState.dirtyVars_.Clear();
@@ -1341,7 +1834,9 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
             msg_.Clear();
             msg_.WriteNetID(current->first_);
 
-            SendMessage(MSG_REMOVECOMPONENT, true, true, msg_);
+            QueueServerMessage(MSG_REMOVECOMPONENT, true, true, msg_);
+
+            MutexLock lock(scene_->GetReplicationMutex());
             nodeState.componentStates_.Erase(current);
         }
         else
@@ -1367,9 +1862,10 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
                 {
                     msg_.Clear();
                     msg_.WriteNetID(component->GetID());
-                    component->WriteLatestDataUpdate(msg_, timeStamp_);
+                    component->WriteLatestDataUpdate(msg_, timeStamp_, &componentState.latestData_,
+                        GetAttributeBitCounts(component));
 
-                    SendMessage(MSG_COMPONENTLATESTDATA, true, false, msg_, component->GetID());
+                    QueueServerMessage(MSG_COMPONENTLATESTDATA, true, false, msg_, component->GetID());
                 }
 
                 // Send deltaupdate if remaining dirty bits
@@ -1377,9 +1873,10 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
                 {
                     msg_.Clear();
                     msg_.WriteNetID(component->GetID());
-                    component->WriteDeltaUpdate(msg_, componentState.dirtyAttributes_, timeStamp_);
+                    component->WriteDeltaUpdate(msg_, componentState.dirtyAttributes_, timeStamp_,
+                        &componentState.quantizedValues_, GetAttributeBitCounts(component));
 
-                    SendMessage(MSG_COMPONENTDELTAUPDATE, true, true, msg_);
+                    QueueServerMessage(MSG_COMPONENTDELTAUPDATE, true, true, msg_);
 
                     componentState.dirtyAttributes_.ClearAll();
                 }
@@ -1403,18 +1900,22 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
             {
                 // New component
                 ComponentReplicationState& componentState = nodeState.componentStates_[component->GetID()];
-                componentState.connection_ = this;
-                componentState.nodeState_ = &nodeState;
-                componentState.component_ = component;
-                component->AddReplicationState(&componentState);
+                {
+                    MutexLock lock(scene_->GetReplicationMutex());
+                    componentState.connection_ = this;
+                    componentState.nodeState_ = &nodeState;
+                    componentState.component_ = component;
+                    component->AddReplicationState(&componentState);
+                }
 
                 msg_.Clear();
                 msg_.WriteNetID(node->GetID());
                 msg_.WriteStringHash(component->GetType());
                 msg_.WriteNetID(component->GetID());
-                component->WriteInitialDeltaUpdate(msg_, timeStamp_);
+                component->WriteInitialDeltaUpdate(msg_, timeStamp_, &componentState.quantizedValues_,
+                    GetAttributeBitCounts(component));
 
-                SendMessage(MSG_CREATECOMPONENT, true, true, msg_);
+                QueueServerMessage(MSG_CREATECOMPONENT, true, true, msg_);
             }
         }
     }
@@ -1502,18 +2003,201 @@ void Connection::RequestPackage(const String& name, unsigned fileSize, unsigned
 
     PackageDownload& download = downloads_[nameHash];
     download.name_ = name;
-    download.totalFragments_ = (fileSize + PACKAGE_FRAGMENT_SIZE - 1) / PACKAGE_FRAGMENT_SIZE;
+    download.fileSize_ = fileSize;
     download.checksum_ = checksum;
 
-    // Start download now only if no existing downloads, else wait for the existing ones to finish
-    if (downloads_.Size() == 1)
+    // Packages download in parallel, so start now. The server replies with the manifest
+    ATOMIC_LOGINFO("Requesting package " + name + " from server");
+    msg_.Clear();
+    msg_.WriteString(name);
+    SendMessage(MSG_REQUESTPACKAGE, true, true, msg_);
+    download.initiated_ = true;
+}
+
+void Connection::ProcessPackageManifest(MemoryBuffer& msg)
+{
+    StringHash nameHash = msg.ReadStringHash();
+    HashMap<StringHash, PackageDownload>::Iterator i = downloads_.Find(nameHash);
+    if (i == downloads_.End())
+        return;
+
+    PackageDownload& download = i->second_;
+    download.fileSize_ = msg.ReadUInt();
+    unsigned numChunks = msg.ReadVLE();
+    if (numChunks != (download.fileSize_ + PACKAGE_CHUNK_SIZE - 1) / PACKAGE_CHUNK_SIZE)
     {
-        ATOMIC_LOGINFO("Requesting package " + name + " from server");
-        msg_.Clear();
-        msg_.WriteString(name);
-        SendMessage(MSG_REQUESTPACKAGE, true, true, msg_);
-        download.initiated_ = true;
+        OnPackageDownloadFailed(download.name_);
+        return;
+    }
+
+    download.chunkHashes_.Resize(numChunks);
+    for (unsigned j = 0; j < numChunks; ++j)
+        download.chunkHashes_[j] = msg.ReadUInt();
+
+    // Open the partial file left by an earlier attempt, or create it. Prepend the checksum to the filename to allow
+    // multiple versions
+    if (!download.file_)
+    {
+        download.file_ = new File(context_, GetSubsystem<Network>()->GetPackageCacheDir() + ToStringHex(download.checksum_) +
+            "_" + download.name_ + ".part", FILE_READWRITE);
+        if (!download.file_->IsOpen())
+        {
+            OnPackageDownloadFailed(download.name_);
+            return;
+        }
     }
+
+    // Keep the chunks already in the file whose content matches, request the rest. Request in reverse order,
+    // as the missing chunks are taken from the back
+    ATOMIC_PROFILE(CheckPackageChunks);
+
+    unsigned partialSize = download.file_->GetSize();
+    download.missingChunks_.Clear();
+    download.chunksInFlight_ = 0;
+    for (unsigned j = numChunks - 1; j < numChunks; --j)
+    {
+        unsigned offset = j * PACKAGE_CHUNK_SIZE;
+        unsigned chunkSize = Min(download.fileSize_ - offset, PACKAGE_CHUNK_SIZE);
+        if (offset + chunkSize <= partialSize)
+        {
+            chunkBuffer_.Resize(chunkSize);
+            download.file_->Seek(offset);
+            if (download.file_->Read(&chunkBuffer_[0], chunkSize) == chunkSize &&
+                HashPackageChunk(&chunkBuffer_[0], chunkSize) == download.chunkHashes_[j])
+                continue;
+        }
+        download.missingChunks_.Push(j);
+    }
+    download.remainingChunks_ = download.missingChunks_.Size();
+
+    if (download.remainingChunks_ < numChunks)
+    {
+        ATOMIC_LOGINFO("Resuming download of package " + download.name_ + ", " + String(numChunks - download.remainingChunks_) +
+            " of " + String(numChunks) + " chunks in cache");
+    }
+
+    if (!download.remainingChunks_)
+        OnPackageDownloaded(nameHash);
+    else
+        RequestPackageChunks(nameHash, download);
+}
+
+void Connection::ProcessPackageChunk(MemoryBuffer& msg)
+{
+    StringHash nameHash = msg.ReadStringHash();
+    HashMap<StringHash, PackageDownload>::Iterator i = downloads_.Find(nameHash);
+    // In case of being unable to create the package file into the cache, we may still receive requested chunks from
+    // the server. Simply disregard them
+    if (i == downloads_.End() || !i->second_.file_)
+        return;
+
+    PackageDownload& download = i->second_;
+    unsigned index = msg.ReadVLE();
+    bool compressed = msg.ReadBool();
+    if (index >= download.chunkHashes_.Size())
+        return;
+
+    unsigned offset = index * PACKAGE_CHUNK_SIZE;
+    unsigned chunkSize = Min(download.fileSize_ - offset, PACKAGE_CHUNK_SIZE);
+    unsigned dataSize = msg.GetSize() - msg.GetPosition();
+    const unsigned char* data = msg.GetData() + msg.GetPosition();
+
+    chunkBuffer_.Resize(chunkSize);
+    bool valid;
+    if (compressed)
+        valid = DecompressData(&chunkBuffer_[0], data, chunkSize) == dataSize;
+    else
+    {
+        valid = dataSize == chunkSize;
+        if (valid)
+            memcpy(&chunkBuffer_[0], data, chunkSize);
+    }
+
+    if (download.chunksInFlight_)
+        --download.chunksInFlight_;
+
+    // Request a corrupted chunk again
+    if (!valid || HashPackageChunk(&chunkBuffer_[0], chunkSize) != download.chunkHashes_[index])
+    {
+        ATOMIC_LOGWARNING("Received corrupted chunk " + String(index) + " of package " + download.name_);
+        download.missingChunks_.Push(index);
+        RequestPackageChunks(nameHash, download);
+        return;
+    }
+
+    if (download.file_->Seek(offset) != offset || download.file_->Write(&chunkBuffer_[0], chunkSize) != chunkSize)
+    {
+        ATOMIC_LOGERROR("Could not write chunk " + String(index) + " of package " + download.name_);
+        OnPackageDownloadFailed(download.name_);
+        return;
+    }
+
+    if (!--download.remainingChunks_)
+        OnPackageDownloaded(nameHash);
+    else
+        RequestPackageChunks(nameHash, download);
+}
+
+void Connection::RequestPackageChunks(StringHash nameHash, PackageDownload& download)
+{
+    if (download.chunksInFlight_ >= PACKAGE_CHUNKS_IN_FLIGHT || download.missingChunks_.Empty())
+        return;
+
+    unsigned numChunks = Min(PACKAGE_CHUNKS_IN_FLIGHT - download.chunksInFlight_, download.missingChunks_.Size());
+    msg_.Clear();
+    msg_.WriteStringHash(nameHash);
+    msg_.WriteVLE(numChunks);
+    for (unsigned i = 0; i < numChunks; ++i)
+    {
+        msg_.WriteVLE(download.missingChunks_.Back());
+        download.missingChunks_.Pop();
+    }
+    SendMessage(MSG_REQUESTPACKAGECHUNKS, true, false, msg_);
+    download.chunksInFlight_ += numChunks;
+}
+
+void Connection::OnPackageDownloaded(StringHash nameHash)
+{
+    HashMap<StringHash, PackageDownload>::Iterator i = downloads_.Find(nameHash);
+    if (i == downloads_.End())
+        return;
+
+    PackageDownload& download = i->second_;
+
+    // Let the server close the upload
+    msg_.Clear();
+    msg_.WriteStringHash(nameHash);
+    msg_.WriteVLE(0);
+    SendMessage(MSG_REQUESTPACKAGECHUNKS, true, false, msg_);
+
+    // Rename the complete file to the name the download cache is scanned for
+    String partName = download.file_->GetName();
+    String fileName = partName.Substring(0, partName.Length() - 5);
+    download.file_->Close();
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    if (!VerifyPackageFile(context_, partName, download.fileSize_, download.checksum_))
+    {
+        ATOMIC_LOGWARNING("Checksum mismatch in downloaded package " + download.name_);
+        fileSystem->Delete(partName);
+        OnPackageDownloadFailed(download.name_);
+        return;
+    }
+    if (fileSystem->FileExists(fileName))
+        fileSystem->Delete(fileName);
+    if (!fileSystem->Rename(partName, fileName))
+    {
+        OnPackageDownloadFailed(download.name_);
+        return;
+    }
+
+    ATOMIC_LOGINFO("Package " + download.name_ + " downloaded successfully");
+
+    // Instantiate the package and add to the resource system, as we will need it to load the scene
+    GetSubsystem<ResourceCache>()->AddPackageFile(fileName, 0);
+
+    downloads_.Erase(i);
+    if (downloads_.Empty())
+        OnPackagesReady();
 }
 
 void Connection::SendPackageError(const String& name)
@@ -48,17 +48,17 @@ class Scene;
 class Serializable;
 class PackageFile;
 
-/// Queued remote event.
-struct RemoteEvent
+/// Client input sent to the server, with the transform of the predicted node at the time of sending.
+struct PredictedInput
 {
-    /// Remote sender node ID (0 if not a remote node event.)
-    unsigned senderID_;
-    /// Event type.
-    StringHash eventType_;
-    /// Event data.
-    VariantMap eventData_;
-    /// In order flag.
-    bool inOrder_;
+    /// Controls.
+    Controls controls_;
+    /// Predicted node position.
+    Vector3 position_;
+    /// Predicted node rotation.
+    Quaternion rotation_;
+    /// Controls timestamp.
+    unsigned char timeStamp_;
 };
 
 /// Package file receive transfer.
@@ -67,16 +67,22 @@ struct PackageDownload
     /// Construct with defaults.
     PackageDownload();
 
-    /// Destination file.
+    /// Destination file. Named with a .part suffix until all chunks have been received.
     SharedPtr<File> file_;
-    /// Already received fragments.
-    HashSet<unsigned> receivedFragments_;
+    /// Content hashes of the chunks, from the package manifest.
+    PODVector<unsigned> chunkHashes_;
+    /// Chunks not yet requested.
+    PODVector<unsigned> missingChunks_;
     /// Package name.
     String name_;
-    /// Total number of fragments.
-    unsigned totalFragments_;
+    /// File size.
+    unsigned fileSize_;
     /// Checksum.
     unsigned checksum_;
+    /// Number of chunks requested and not yet received.
+    unsigned chunksInFlight_;
+    /// Number of chunks not yet received.
+    unsigned remainingChunks_;
     /// Download initiated flag.
     bool initiated_;
 };
@@ -89,10 +95,16 @@ struct PackageUpload
 
     /// Source file.
     SharedPtr<File> file_;
-    /// Current fragment index.
-    unsigned fragment_;
-    /// Total number of fragments
-    unsigned totalFragments_;
+    /// Source package.
+    SharedPtr<PackageFile> package_;
+    /// Chunks requested by the client, in request order.
+    PODVector<unsigned> requestedChunks_;
+    /// Total number of chunks.
+    unsigned numChunks_;
+    /// Compress chunks flag.
+    bool compress_;
+    /// Manifest requested but not yet sent flag. Set while the chunk hashes are being calculated.
+    bool manifestPending_;
 };
 
 /// Send modes for observer position/rotation. Activated by the client setting either position or rotation.
@@ -135,6 +147,10 @@ public:
     void SetPosition(const Vector3& position);
     /// Set the observer rotation for interest management, to be sent to the server. Note: not used by the NetworkPriority component.
     void SetRotation(const Quaternion& rotation);
+    /// Set team for interest management. Nodes with the team relevance rule are relevant to connections on the same team. Team 0 is no team.
+    void SetTeam(unsigned team) { team_ = team; }
+    /// Set the node the client moves locally ahead of the server. It is excluded from snapshot interpolation, the sent inputs are kept in the input history, and E_PREDICTIONRECONCILE is sent when the server state for it arrives.
+    void SetPredictedNode(Node* node);
     /// Set the connection pending status. Called by Network.
     void SetConnectPending(bool connectPending);
     /// Set whether to log data in/out statistics.
@@ -143,6 +159,14 @@ public:
     void Disconnect(int waitMSec = 0);
     /// Send scene update messages. Called by Network.
     void SendServerUpdate();
+    /// Build scene update messages without sending them. Connections may be prepared simultaneously from worker threads. Called by Network.
+    void PrepareServerUpdate();
+    /// Send the scene update messages built by PrepareServerUpdate(). Called by Network.
+    void FlushServerUpdate();
+    /// Return bits sent per network attribute by object type since the last reset, when collected. Called by Network.
+    const HashMap<StringHash, PODVector<unsigned> >& GetAttributeBitCounts() const { return attributeBitCounts_; }
+    /// Reset the bits sent per network attribute. Called by Network.
+    void ResetAttributeBitCounts() { attributeBitCounts_.Clear(); }
     /// Send latest controls from the client. Called by Network.
     void SendClientUpdate();
     /// Send queued remote events. Called by Network.
@@ -172,9 +196,18 @@ public:
     /// Return the observer position sent by the client for interest management.
     const Vector3& GetPosition() const { return position_; }
 
+    /// Return the client-predicted node.
+    Node* GetPredictedNode() const { return predictedNode_; }
+
+    /// Return the inputs sent but not yet acknowledged by the server, oldest first. To reconcile, replay them from the server state of the predicted node.
+    const Vector<PredictedInput>& GetInputHistory() const { return inputHistory_; }
+
     /// Return the observer rotation sent by the client for interest management.
     const Quaternion& GetRotation() const { return rotation_; }
 
+    /// Return team for interest management.
+    unsigned GetTeam() const { return team_; }
+
     /// Return whether is a client connection.
     bool IsClient() const { return isClient_; }
 
@@ -232,6 +265,12 @@ public:
     Controls controls_;
     /// Controls timestamp. Incremented after each sent update.
     unsigned char timeStamp_;
+    /// Server network update counter of the scene update being built.
+    unsigned short serverTick_;
+    /// Client-predicted node.
+    WeakPtr<Node> predictedNode_;
+    /// Inputs sent but not yet acknowledged by the server.
+    Vector<PredictedInput> inputHistory_;
     /// Identity map.
     VariantMap identity_;
     
@@ -271,12 +310,28 @@ private:
     void ProcessSceneLoaded(int msgID, MemoryBuffer& msg);
     /// Process a remote event message from the client or server. Called by Network.
     void ProcessRemoteEvent(int msgID, MemoryBuffer& msg);
+    /// Process a batch of remote events.
+    void ProcessRemoteEvents(MemoryBuffer& msg);
+    /// Process a latest data acknowledgement message from the client.
+    void ProcessLatestDataAck(MemoryBuffer& msg);
+    /// Encode a remote event into the batch to send on the next network update.
+    void QueueRemoteEvent(unsigned senderID, StringHash eventType, bool inOrder, const VariantMap& eventData);
     /// Process a node for sending a network update. Recurses to process depended on node(s) first.
     void ProcessNode(unsigned nodeID);
     /// Process a node that the client has not yet received.
     void ProcessNewNode(Node* node);
     /// Process a node that the client has already received.
     void ProcessExistingNode(Node* node, NodeReplicationState& nodeState);
+    /// Send removal of replicated nodes that are no longer relevant and forget their replication states.
+    void RemoveIrrelevantNodes();
+    /// Read a node update on the client, buffering its transform for snapshot interpolation.
+    void ReadNodeUpdate(Node* node, MemoryBuffer& msg, unsigned short tick, bool latestData);
+    /// Compare the server state of the predicted node with the prediction for the input it acknowledges.
+    void ReconcilePrediction(Node* node, unsigned char timeStamp);
+    /// Return the bits sent counters of an object's network attributes, or null if not collecting them.
+    unsigned* GetAttributeBitCounts(Serializable* serializable);
+    /// Queue a scene update message to be sent by FlushServerUpdate().
+    void QueueServerMessage(int msgID, bool reliable, bool inOrder, const VectorBuffer& msg, unsigned contentID = 0);
     /// Process a SyncPackagesInfo message from server.
     void ProcessPackageInfo(int msgID, MemoryBuffer& msg);
     /// Check a package list received from server and initiate package downloads as necessary. Return true on success, or false if failed to initialze downloads (cache dir not set)
@@ -285,6 +340,18 @@ private:
     void RequestPackage(const String& name, unsigned fileSize, unsigned checksum);
     /// Send an error reply for a package download.
     void SendPackageError(const String& name);
+    /// Send a package manifest to the client if the chunk hashes are available. Return true if sent.
+    bool SendPackageManifest(StringHash nameHash, PackageUpload& upload);
+    /// Send a requested package chunk to the client.
+    void SendPackageChunk(StringHash nameHash, PackageUpload& upload, unsigned index);
+    /// Compare a package manifest with the partially downloaded file in the cache and request the missing chunks.
+    void ProcessPackageManifest(MemoryBuffer& msg);
+    /// Write a received package chunk. Finish the download if it was the last one.
+    void ProcessPackageChunk(MemoryBuffer& msg);
+    /// Request more chunks for a download, up to the number allowed in flight.
+    void RequestPackageChunks(StringHash nameHash, PackageDownload& download);
+    /// Finish a download whose chunks have all been received.
+    void OnPackageDownloaded(StringHash nameHash);
     /// Handle scene load failure on the server or client.
     void OnSceneLoadFailed();
     /// Handle a package download failure on the client.
@@ -310,16 +377,34 @@ private:
     HashMap<StringHash, PackageDownload> downloads_;
     /// Ongoing package send transfers.
     HashMap<StringHash, PackageUpload> uploads_;
+    /// Package chunk data buffer.
+    PODVector<unsigned char> chunkBuffer_;
+    /// Package chunk compression buffer.
+    PODVector<unsigned char> compressBuffer_;
     /// Pending latest data for not yet received nodes.
     HashMap<unsigned, PODVector<unsigned char> > nodeLatestData_;
     /// Pending latest data for not yet received components.
     HashMap<unsigned, PODVector<unsigned char> > componentLatestData_;
+    /// Latest data sequence numbers to acknowledge by node ID.
+    HashMap<unsigned, unsigned> nodeLatestDataAcks_;
+    /// Latest data sequence numbers to acknowledge by component ID.
+    HashMap<unsigned, unsigned> componentLatestDataAcks_;
     /// Node ID's to process during a replication update.
     HashSet<unsigned> nodesToProcess_;
+    /// Node ID's relevant to this connection during a replication update when using interest management.
+    HashSet<unsigned> relevantNodes_;
     /// Reusable message buffer.
     VectorBuffer msg_;
-    /// Queued remote events.
-    Vector<RemoteEvent> remoteEvents_;
+    /// Scene update messages waiting to be sent.
+    VectorBuffer serverUpdateMessages_;
+    /// Bits sent per network attribute by object type.
+    HashMap<StringHash, PODVector<unsigned> > attributeBitCounts_;
+    /// Queued in order remote events.
+    VectorBuffer orderedRemoteEvents_;
+    /// Queued unordered remote events.
+    VectorBuffer unorderedRemoteEvents_;
+    /// Received remote event data, reused for each event.
+    VariantMap remoteEventData_;
     /// Scene file to load once all packages (if any) have been downloaded.
     String sceneFileName_;
     /// Statistics timer.
@@ -334,6 +419,10 @@ private:
     Quaternion rotation_;
     /// Send mode for the observer position & rotation.
     ObserverPositionSendMode sendMode_;
+    /// Interest management team.
+    unsigned team_;
+    /// Collect bits sent per network attribute flag.
+    bool attributeBandwidthStats_;
     /// Client connection flag.
     bool isClient_;
     /// Connection pending flag.
@@ -0,0 +1,238 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Network/Connection.h"
+#include "../Network/InterestManager.h"
+#include "../Network/NetworkPriority.h"
+#include "../Scene/Scene.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+extern const char* NETWORK_CATEGORY;
+
+static const float DEFAULT_CELL_SIZE = 32.0f;
+static const float DEFAULT_RELEVANCE_RADIUS = 100.0f;
+static const float DEFAULT_RELEASE_RADIUS = 120.0f;
+/// Smallest grid cell size, to keep the number of cells within the release radius reasonable.
+static const float MIN_CELL_SIZE = 1.0f;
+
+InterestManager::InterestManager(Context* context) :
+    Component(context),
+    cellSize_(DEFAULT_CELL_SIZE),
+    relevanceRadius_(DEFAULT_RELEVANCE_RADIUS),
+    releaseRadius_(DEFAULT_RELEASE_RADIUS)
+{
+}
+
+InterestManager::~InterestManager()
+{
+}
+
+void InterestManager::RegisterObject(Context* context)
+{
+    context->RegisterFactory<InterestManager>(NETWORK_CATEGORY);
+
+    ATOMIC_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Cell Size", GetCellSize, SetCellSize, float, DEFAULT_CELL_SIZE, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Relevance Radius", GetRelevanceRadius, SetRelevanceRadius, float, DEFAULT_RELEVANCE_RADIUS,
+        AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Release Radius", GetReleaseRadius, SetReleaseRadius, float, DEFAULT_RELEASE_RADIUS, AM_DEFAULT);
+}
+
+void InterestManager::SetCellSize(float size)
+{
+    cellSize_ = Max(size, MIN_CELL_SIZE);
+    // Rebin all nodes on the next update
+    cells_.Clear();
+}
+
+void InterestManager::SetRelevanceRadius(float radius)
+{
+    relevanceRadius_ = Max(radius, 0.0f);
+}
+
+void InterestManager::SetReleaseRadius(float radius)
+{
+    releaseRadius_ = Max(radius, 0.0f);
+}
+
+void InterestManager::Update()
+{
+    Scene* scene = GetScene();
+    if (!scene)
+        return;
+
+    ATOMIC_PROFILE(UpdateInterestManager);
+
+    // Keep the occupied cells' vectors allocated between updates
+    for (HashMap<IntVector2, PODVector<Node*> >::Iterator i = cells_.Begin(); i != cells_.End(); ++i)
+        i->second_.Clear();
+    alwaysNodes_.Clear();
+    ownedNodes_.Clear();
+    teamNodes_.Clear();
+
+    const HashMap<unsigned, Node*>& nodes = scene->GetReplicatedNodes();
+    for (HashMap<unsigned, Node*>::ConstIterator i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Node* node = i->second_;
+        if (node == scene)
+            continue;
+
+        if (node->GetOwner())
+            ownedNodes_.Push(node);
+
+        NetworkPriority* priority = node->GetComponent<NetworkPriority>();
+        RelevanceMode mode = priority ? priority->GetRelevance() : RM_DISTANCE;
+        switch (mode)
+        {
+        case RM_DISTANCE:
+            cells_[GetCell(node->GetWorldPosition())].Push(node);
+            break;
+
+        case RM_ALWAYS:
+            alwaysNodes_.Push(node);
+            break;
+
+        case RM_TEAM:
+            teamNodes_.Push(priority);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // Drop the cells no node occupies anymore, so that the map does not grow with every cell ever visited
+    for (HashMap<IntVector2, PODVector<Node*> >::Iterator i = cells_.Begin(); i != cells_.End();)
+    {
+        if (i->second_.Empty())
+            i = cells_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void InterestManager::GetRelevantNodes(Connection* connection, const SceneReplicationState& sceneState,
+    HashSet<unsigned>& dest) const
+{
+    dest.Clear();
+
+    Scene* scene = GetScene();
+    if (!scene)
+        return;
+
+    dest.Insert(scene->GetID());
+
+    for (PODVector<Node*>::ConstIterator i = alwaysNodes_.Begin(); i != alwaysNodes_.End(); ++i)
+        AddRelevantNode(*i, dest);
+
+    // Owned nodes are always relevant to the owner, regardless of their relevance rule
+    for (PODVector<Node*>::ConstIterator i = ownedNodes_.Begin(); i != ownedNodes_.End(); ++i)
+    {
+        if ((*i)->GetOwner() == connection)
+            AddRelevantNode(*i, dest);
+    }
+
+    unsigned team = connection->GetTeam();
+    if (team)
+    {
+        for (PODVector<NetworkPriority*>::ConstIterator i = teamNodes_.Begin(); i != teamNodes_.End(); ++i)
+        {
+            if ((*i)->GetTeam() == team)
+                AddRelevantNode((*i)->GetNode(), dest);
+        }
+    }
+
+    // Query only the cells within the release radius. Nodes the client already has stay relevant until they are
+    // beyond the release radius, new nodes become relevant within the relevance radius
+    const Vector3& position = connection->GetPosition();
+    float releaseRadius = Max(releaseRadius_, relevanceRadius_);
+    float relevanceDistSquared = relevanceRadius_ * relevanceRadius_;
+    float releaseDistSquared = releaseRadius * releaseRadius;
+    IntVector2 minCell = GetCell(position - Vector3(releaseRadius, 0.0f, releaseRadius));
+    IntVector2 maxCell = GetCell(position + Vector3(releaseRadius, 0.0f, releaseRadius));
+
+    // When the radius covers more cells than are occupied, check the occupied cells instead of looking up each one
+    unsigned long long numRangeCells = (unsigned long long)(maxCell.x_ - minCell.x_ + 1) * (maxCell.y_ - minCell.y_ + 1);
+    if (numRangeCells > cells_.Size())
+    {
+        for (HashMap<IntVector2, PODVector<Node*> >::ConstIterator i = cells_.Begin(); i != cells_.End(); ++i)
+        {
+            const IntVector2& cell = i->first_;
+            if (cell.x_ >= minCell.x_ && cell.x_ <= maxCell.x_ && cell.y_ >= minCell.y_ && cell.y_ <= maxCell.y_)
+                AddCellNodes(i->second_, sceneState, position, relevanceDistSquared, releaseDistSquared, dest);
+        }
+    }
+    else
+    {
+        for (int y = minCell.y_; y <= maxCell.y_; ++y)
+        {
+            for (int x = minCell.x_; x <= maxCell.x_; ++x)
+            {
+                HashMap<IntVector2, PODVector<Node*> >::ConstIterator cell = cells_.Find(IntVector2(x, y));
+                if (cell != cells_.End())
+                    AddCellNodes(cell->second_, sceneState, position, relevanceDistSquared, releaseDistSquared, dest);
+            }
+        }
+    }
+}
+
+void InterestManager::AddCellNodes(const PODVector<Node*>& cellNodes, const SceneReplicationState& sceneState,
+    const Vector3& position, float relevanceDistSquared, float releaseDistSquared, HashSet<unsigned>& dest) const
+{
+    for (PODVector<Node*>::ConstIterator i = cellNodes.Begin(); i != cellNodes.End(); ++i)
+    {
+        Node* node = *i;
+        float distSquared = (node->GetWorldPosition() - position).LengthSquared();
+        if (distSquared <= relevanceDistSquared || (distSquared <= releaseDistSquared &&
+            sceneState.nodeStates_.Contains(node->GetID())))
+            AddRelevantNode(node, dest);
+    }
+}
+
+void InterestManager::AddRelevantNode(Node* node, HashSet<unsigned>& dest) const
+{
+    if (dest.Contains(node->GetID()))
+        return;
+
+    dest.Insert(node->GetID());
+
+    // The client needs the depended on nodes, such as the parent, to create the node
+    const PODVector<Node*>& dependencyNodes = node->GetDependencyNodes();
+    for (PODVector<Node*>::ConstIterator i = dependencyNodes.Begin(); i != dependencyNodes.End(); ++i)
+        AddRelevantNode(*i, dest);
+}
+
+IntVector2 InterestManager::GetCell(const Vector3& worldPosition) const
+{
+    return IntVector2((int)floorf(worldPosition.x_ / cellSize_), (int)floorf(worldPosition.z_ / cellSize_));
+}
+
+}
@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/HashSet.h"
+#include "../Scene/Component.h"
+
+namespace Atomic
+{
+
+class Connection;
+class NetworkPriority;
+struct SceneReplicationState;
+
+/// %Network interest management component for the scene. When present, client connections only replicate the nodes
+/// relevant to them: nodes near the observer position, found from a uniform grid on the XZ plane, plus nodes whose
+/// NetworkPriority component specifies an always, owner or team relevance rule. Nodes leaving relevance are removed from
+/// the client and created again when they re-enter.
+class ATOMIC_API InterestManager : public Component
+{
+    ATOMIC_OBJECT(InterestManager, Component);
+
+public:
+    /// Construct.
+    InterestManager(Context* context);
+    /// Destruct.
+    virtual ~InterestManager();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Set grid cell size. Minimum 1.
+    void SetCellSize(float size);
+    /// Set distance from the observer position within which nodes become relevant.
+    void SetRelevanceRadius(float radius);
+    /// Set distance from the observer position beyond which relevant nodes are removed. Should be larger than the relevance radius to avoid repeated removal and creation.
+    void SetReleaseRadius(float radius);
+
+    /// Return grid cell size.
+    float GetCellSize() const { return cellSize_; }
+    /// Return relevance radius.
+    float GetRelevanceRadius() const { return relevanceRadius_; }
+    /// Return release radius.
+    float GetReleaseRadius() const { return releaseRadius_; }
+
+    /// Sort the scene's replicated nodes into the grid and relevance rule lists. Called by Network before connections are updated.
+    void Update();
+    /// Collect the IDs of nodes relevant to a connection, including the nodes they depend on. Safe to call from worker threads after Update(). Called by Connection.
+    void GetRelevantNodes(Connection* connection, const SceneReplicationState& sceneState, HashSet<unsigned>& dest) const;
+
+private:
+    /// Add the nodes of a grid cell that are within the relevance radius, or within the release radius and already on the client.
+    void AddCellNodes(const PODVector<Node*>& cellNodes, const SceneReplicationState& sceneState, const Vector3& position,
+        float relevanceDistSquared, float releaseDistSquared, HashSet<unsigned>& dest) const;
+    /// Add a node and the nodes it depends on to the relevant set.
+    void AddRelevantNode(Node* node, HashSet<unsigned>& dest) const;
+    /// Return grid cell coordinates of a world position.
+    IntVector2 GetCell(const Vector3& worldPosition) const;
+
+    /// Distance relevant nodes by grid cell.
+    HashMap<IntVector2, PODVector<Node*> > cells_;
+    /// Always relevant nodes.
+    PODVector<Node*> alwaysNodes_;
+    /// Nodes that have an owner connection.
+    PODVector<Node*> ownedNodes_;
+    /// Team relevance rules of team relevant nodes.
+    PODVector<NetworkPriority*> teamNodes_;
+    /// Grid cell size.
+    float cellSize_;
+    /// Relevance radius.
+    float relevanceRadius_;
+    /// Release radius.
+    float releaseRadius_;
+};
+
+}
@@ -0,0 +1,634 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Core/Timer.h"
+#include "../Graphics/Drawable.h"
+#include "../Math/Ray.h"
+#include "../Math/Sphere.h"
+#include "../Network/Connection.h"
+#include "../Network/LagCompensation.h"
+#ifdef ATOMIC_PHYSICS
+#include "../Physics/CollisionShape.h"
+#include "../Physics/PhysicsUtils.h"
+#endif
+#include "../Scene/Scene.h"
+
+#ifdef ATOMIC_PHYSICS
+#include <Bullet/src/BulletCollision/CollisionShapes/btCollisionShape.h>
+#endif
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+extern const char* NETWORK_CATEGORY;
+
+static const unsigned DEFAULT_HISTORY_LENGTH = 64;
+static const float DEFAULT_MAX_REWIND_TIME = 1.0f;
+
+inline bool CompareLagCompensationResults(const LagCompensationResult& lhs, const LagCompensationResult& rhs)
+{
+    return lhs.distance_ < rhs.distance_;
+}
+
+#ifdef ATOMIC_PHYSICS
+/// Convert a collision shape to a hit shape. Bullet scales the primitive shapes along their own axes, using the X scale
+/// for radii. Return false for shapes that can not be hit.
+static bool GetCollisionHitShape(CollisionShape* collisionShape, const Vector3& worldScale, LagCompensationShape& shape)
+{
+    btCollisionShape* btShape = collisionShape->GetCollisionShape();
+    if (!btShape)
+        return false;
+
+    const Vector3& size = collisionShape->GetSize();
+    shape.position_ = worldScale * collisionShape->GetPosition();
+    shape.rotation_ = collisionShape->GetRotation();
+
+    switch (collisionShape->GetShapeType())
+    {
+    case SHAPE_BOX:
+        shape.type_ = HITSHAPE_BOX;
+        shape.size_ = worldScale * size * 0.5f;
+        break;
+
+    case SHAPE_SPHERE:
+        shape.type_ = HITSHAPE_SPHERE;
+        shape.size_ = Vector3(worldScale.x_ * size.x_ * 0.5f, 0.0f, 0.0f);
+        break;
+
+    case SHAPE_CAPSULE:
+        shape.type_ = HITSHAPE_CAPSULE;
+        shape.size_ = Vector3(worldScale.x_ * size.x_ * 0.5f, worldScale.y_ * Max(size.y_ - size.x_, 0.0f) * 0.5f, 0.0f);
+        break;
+
+    case SHAPE_CYLINDER:
+        shape.type_ = HITSHAPE_CYLINDER;
+        shape.size_ = Vector3(worldScale.x_ * size.x_ * 0.5f, worldScale.y_ * size.y_ * 0.5f, 0.0f);
+        break;
+
+    case SHAPE_STATICPLANE:
+        return false;
+
+    default:
+        {
+            // The local scaling of the Bullet shape already includes the world scale
+            btVector3 aabbMin, aabbMax;
+            btShape->getAabb(btTransform::getIdentity(), aabbMin, aabbMax);
+            BoundingBox box(ToVector3(aabbMin), ToVector3(aabbMax));
+            shape.type_ = HITSHAPE_BOX;
+            shape.position_ += shape.rotation_ * box.Center();
+            shape.size_ = box.HalfSize();
+        }
+        break;
+    }
+
+    return true;
+}
+#endif
+
+/// Return the distance along a shape space ray to the side of a Y axis aligned cylinder, or infinity if not hit.
+static float HitDistanceCylinderSide(const Ray& ray, float radius, float halfLength)
+{
+    float a = ray.direction_.x_ * ray.direction_.x_ + ray.direction_.z_ * ray.direction_.z_;
+    if (a < M_EPSILON)
+        return M_INFINITY;
+
+    float b = 2.0f * (ray.origin_.x_ * ray.direction_.x_ + ray.origin_.z_ * ray.direction_.z_);
+    float c = ray.origin_.x_ * ray.origin_.x_ + ray.origin_.z_ * ray.origin_.z_ - radius * radius;
+    float d = b * b - 4.0f * a * c;
+    if (d < 0.0f)
+        return M_INFINITY;
+
+    // Only the entry point matters, as origins inside the shape are handled by the callers
+    float distance = (-b - sqrtf(d)) / (2.0f * a);
+    if (distance < 0.0f || Abs(ray.origin_.y_ + distance * ray.direction_.y_) > halfLength)
+        return M_INFINITY;
+    return distance;
+}
+
+/// Return the distance along a shape space ray to a sphere, or infinity if not hit.
+static float HitDistanceSphere(const Ray& ray, const Vector3& center, float radius)
+{
+    // Ray::HitDistance() returns a negative distance for spheres behind the ray origin
+    float distance = ray.HitDistance(Sphere(center, radius));
+    return distance >= 0.0f ? distance : M_INFINITY;
+}
+
+/// Return the distance along a shape space ray to a hit shape, or infinity if not hit.
+static float HitDistance(const Ray& ray, const LagCompensationShape& shape)
+{
+    switch (shape.type_)
+    {
+    case HITSHAPE_SPHERE:
+        return HitDistanceSphere(ray, Vector3::ZERO, shape.size_.x_);
+
+    case HITSHAPE_CAPSULE:
+        {
+            Vector3 axisPosition(0.0f, Clamp(ray.origin_.y_, -shape.size_.y_, shape.size_.y_), 0.0f);
+            if ((ray.origin_ - axisPosition).LengthSquared() <= shape.size_.x_ * shape.size_.x_)
+                return 0.0f;
+
+            Vector3 capOffset(0.0f, shape.size_.y_, 0.0f);
+            return Min(HitDistanceCylinderSide(ray, shape.size_.x_, shape.size_.y_),
+                Min(HitDistanceSphere(ray, capOffset, shape.size_.x_), HitDistanceSphere(ray, -capOffset, shape.size_.x_)));
+        }
+
+    case HITSHAPE_CYLINDER:
+        {
+            float radius = shape.size_.x_;
+            float halfLength = shape.size_.y_;
+            const Vector3& origin = ray.origin_;
+            if (origin.x_ * origin.x_ + origin.z_ * origin.z_ <= radius * radius && Abs(origin.y_) <= halfLength)
+                return 0.0f;
+
+            float distance = HitDistanceCylinderSide(ray, radius, halfLength);
+            if (Abs(ray.direction_.y_) >= M_EPSILON)
+            {
+                // Test the cap facing the ray origin
+                float capDistance = ((origin.y_ > 0.0f ? halfLength : -halfLength) - origin.y_) / ray.direction_.y_;
+                Vector3 capPosition = origin + capDistance * ray.direction_;
+                if (capDistance >= 0.0f && capPosition.x_ * capPosition.x_ + capPosition.z_ * capPosition.z_ <= radius * radius)
+                    distance = Min(distance, capDistance);
+            }
+            return distance;
+        }
+
+    default:
+        return ray.HitDistance(BoundingBox(-shape.size_, shape.size_));
+    }
+}
+
+/// Return the closest point of a hit shape to a shape space position.
+static Vector3 ClosestPoint(const LagCompensationShape& shape, const Vector3& position)
+{
+    switch (shape.type_)
+    {
+    case HITSHAPE_SPHERE:
+        {
+            float length = position.Length();
+            return length > shape.size_.x_ ? position * (shape.size_.x_ / length) : position;
+        }
+
+    case HITSHAPE_CAPSULE:
+        {
+            Vector3 axisPosition(0.0f, Clamp(position.y_, -shape.size_.y_, shape.size_.y_), 0.0f);
+            Vector3 offset = position - axisPosition;
+            float length = offset.Length();
+            return length > shape.size_.x_ ? axisPosition + offset * (shape.size_.x_ / length) : position;
+        }
+
+    case HITSHAPE_CYLINDER:
+        {
+            Vector3 radial(position.x_, 0.0f, position.z_);
+            float length = radial.Length();
+            if (length > shape.size_.x_)
+                radial *= shape.size_.x_ / length;
+            return Vector3(radial.x_, Clamp(position.y_, -shape.size_.y_, shape.size_.y_), radial.z_);
+        }
+
+    default:
+        return Vector3(Clamp(position.x_, -shape.size_.x_, shape.size_.x_), Clamp(position.y_, -shape.size_.y_, shape.size_.y_),
+            Clamp(position.z_, -shape.size_.z_, shape.size_.z_));
+    }
+}
+
+LagCompensation::LagCompensation(Context* context) :
+    Component(context),
+    latestTick_(0),
+    numTicks_(0),
+    historyLength_(DEFAULT_HISTORY_LENGTH),
+    maxRewindTime_(DEFAULT_MAX_REWIND_TIME)
+{
+}
+
+LagCompensation::~LagCompensation()
+{
+}
+
+void LagCompensation::RegisterObject(Context* context)
+{
+    context->RegisterFactory<LagCompensation>(NETWORK_CATEGORY);
+
+    ATOMIC_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("History Length", GetHistoryLength, SetHistoryLength, unsigned, DEFAULT_HISTORY_LENGTH, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Max Rewind Time", GetMaxRewindTime, SetMaxRewindTime, float, DEFAULT_MAX_REWIND_TIME, AM_DEFAULT);
+}
+
+void LagCompensation::SetHistoryLength(unsigned ticks)
+{
+    ticks = Max(ticks, 1U);
+    if (ticks != historyLength_)
+    {
+        historyLength_ = ticks;
+        ClearHistory();
+    }
+}
+
+void LagCompensation::SetMaxRewindTime(float time)
+{
+    maxRewindTime_ = Max(time, 0.0f);
+}
+
+void LagCompensation::Record()
+{
+    Scene* scene = GetScene();
+    if (!scene)
+        return;
+
+    ATOMIC_PROFILE(RecordLagCompensation);
+
+    if (ticks_.Size() != historyLength_)
+        ticks_.Resize(historyLength_);
+
+    // Collect the nodes that can be hit and their hit shapes
+    recordNodes_.Clear();
+    recordShapes_.Clear();
+    const HashMap<unsigned, Node*>& nodes = scene->GetReplicatedNodes();
+    for (HashMap<unsigned, Node*>::ConstIterator i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Node* node = i->second_;
+        if (node == scene || !node->IsEnabled())
+            continue;
+
+        unsigned firstShape = recordShapes_.Size();
+        Vector3 worldScale = node->GetWorldScale();
+        BoundingBox drawableBox;
+        const Vector<SharedPtr<Component> >& components = node->GetComponents();
+        for (Vector<SharedPtr<Component> >::ConstIterator j = components.Begin(); j != components.End(); ++j)
+        {
+            Component* component = *j;
+            if (!component->IsEnabled())
+                continue;
+
+            if (component->IsInstanceOf<Drawable>())
+            {
+                Drawable* drawable = static_cast<Drawable*>(component);
+                if (drawable->GetDrawableFlags() & DRAWABLE_GEOMETRY)
+                    drawableBox.Merge(drawable->GetBoundingBox());
+            }
+#ifdef ATOMIC_PHYSICS
+            else if (component->IsInstanceOf<CollisionShape>())
+            {
+                LagCompensationShape shape;
+                if (GetCollisionHitShape(static_cast<CollisionShape*>(component), worldScale, shape))
+                    recordShapes_.Push(shape);
+            }
+#endif
+        }
+
+        // Fall back to the drawable bounds if the node has no collision shapes
+        if (recordShapes_.Size() == firstShape && drawableBox.Defined())
+        {
+            LagCompensationShape shape;
+            shape.type_ = HITSHAPE_BOX;
+            shape.position_ = worldScale * drawableBox.Center();
+            shape.rotation_ = Quaternion::IDENTITY;
+            shape.size_ = worldScale * drawableBox.HalfSize();
+            recordShapes_.Push(shape);
+        }
+
+        if (recordShapes_.Size() > firstShape)
+            recordNodes_.Push(MakePair(node, firstShape));
+    }
+
+    latestTick_ = numTicks_ ? (latestTick_ + 1) % historyLength_ : 0;
+    numTicks_ = Min(numTicks_ + 1, historyLength_);
+
+    LagCompensationTick& tick = ticks_[latestTick_];
+    Time* time = GetSubsystem<Time>();
+    tick.time_ = time ? time->GetElapsedTime() : 0.0f;
+
+    for (unsigned i = 0; i < recordNodes_.Size(); ++i)
+    {
+        unsigned nodeID = recordNodes_[i].first_->GetID();
+        if (!slots_.Contains(nodeID))
+        {
+            unsigned slot;
+            if (freeSlots_.Size())
+            {
+                slot = freeSlots_.Back();
+                freeSlots_.Pop();
+            }
+            else
+            {
+                slot = slotNodeIDs_.Size();
+                slotNodeIDs_.Push(0);
+            }
+            slotNodeIDs_[slot] = nodeID;
+            slots_[nodeID] = slot;
+        }
+    }
+
+    unsigned numSlots = slotNodeIDs_.Size();
+    tick.nodeIDs_.Resize(numSlots);
+    tick.positions_.Resize(numSlots);
+    tick.rotations_.Resize(numSlots);
+    tick.scales_.Resize(numSlots);
+    tick.firstShapes_.Resize(numSlots);
+    tick.numShapes_.Resize(numSlots);
+    tick.shapes_ = recordShapes_;
+    for (unsigned i = 0; i < numSlots; ++i)
+        tick.nodeIDs_[i] = 0;
+
+    for (unsigned i = 0; i < recordNodes_.Size(); ++i)
+    {
+        Node* node = recordNodes_[i].first_;
+        unsigned slot = slots_[node->GetID()];
+        tick.nodeIDs_[slot] = node->GetID();
+        tick.positions_[slot] = node->GetWorldPosition();
+        tick.rotations_[slot] = node->GetWorldRotation();
+        tick.scales_[slot] = node->GetWorldScale();
+        tick.firstShapes_[slot] = recordNodes_[i].second_;
+        tick.numShapes_[slot] = (i + 1 < recordNodes_.Size() ? recordNodes_[i + 1].second_ : recordShapes_.Size()) -
+            recordNodes_[i].second_;
+    }
+
+    // Release the slots of nodes that were not recorded. Their older history stays queryable until the slot is reused
+    for (unsigned i = 0; i < numSlots; ++i)
+    {
+        if (slotNodeIDs_[i] && !tick.nodeIDs_[i])
+        {
+            slots_.Erase(slotNodeIDs_[i]);
+            slotNodeIDs_[i] = 0;
+            freeSlots_.Push(i);
+        }
+    }
+}
+
+void LagCompensation::ClearHistory()
+{
+    ticks_.Clear();
+    slots_.Clear();
+    slotNodeIDs_.Clear();
+    freeSlots_.Clear();
+    latestTick_ = 0;
+    numTicks_ = 0;
+}
+
+float LagCompensation::GetRewindTime(Connection* connection) const
+{
+    if (!connection)
+        return 0.0f;
+
+    // The round trip time is in milliseconds
+    float rewindTime = connection->GetRoundTripTime() * 0.001f;
+    Scene* scene = GetScene();
+    if (scene && scene->GetSnapshotInterpolation())
+        rewindTime += scene->GetInterpolationDelay();
+    return rewindTime;
+}
+
+void LagCompensation::Raycast(PODVector<LagCompensationResult>& result, const Ray& ray, float maxDistance, float rewindTime) const
+{
+    ATOMIC_PROFILE(LagCompensationRaycast);
+
+    result.Clear();
+
+    Scene* scene = GetScene();
+    unsigned older, newer;
+    float t;
+    if (!scene || !FindTicks(rewindTime, older, newer, t))
+        return;
+
+    PODVector<LagCompensationShape> shapes;
+    unsigned numSlots = ticks_[older].nodeIDs_.Size();
+    for (unsigned i = 0; i < numSlots; ++i)
+    {
+        Vector3 position, scale;
+        Quaternion rotation;
+        if (!GetSlotTransform(i, older, newer, t, position, rotation, scale))
+            continue;
+
+        // Test each shape in its own space. The shape transforms exclude scale, so distances are the same as in world space
+        Matrix3x4 nodeTransform(position, rotation, 1.0f);
+        GetSlotShapes(i, older, newer, t, shapes);
+        float distance = M_INFINITY;
+        for (unsigned j = 0; j < shapes.Size(); ++j)
+        {
+            Matrix3x4 shapeTransform = nodeTransform * Matrix3x4(shapes[j].position_, shapes[j].rotation_, 1.0f);
+            distance = Min(distance, HitDistance(ray.Transformed(shapeTransform.Inverse()), shapes[j]));
+        }
+        if (distance > maxDistance)
+            continue;
+
+        Node* node = scene->GetNode(ticks_[older].nodeIDs_[i]);
+        if (!node)
+            continue;
+
+        LagCompensationResult hit;
+        hit.node_ = node;
+        hit.nodePosition_ = position;
+        hit.position_ = ray.origin_ + distance * ray.direction_;
+        hit.distance_ = distance;
+        result.Push(hit);
+    }
+
+    Sort(result.Begin(), result.End(), CompareLagCompensationResults);
+}
+
+void LagCompensation::Raycast(PODVector<LagCompensationResult>& result, const Ray& ray, float maxDistance,
+    Connection* connection) const
+{
+    Raycast(result, ray, maxDistance, GetRewindTime(connection));
+}
+
+void LagCompensation::RaycastSingle(LagCompensationResult& result, const Ray& ray, float maxDistance, float rewindTime) const
+{
+    PODVector<LagCompensationResult> hits;
+    Raycast(hits, ray, maxDistance, rewindTime);
+    result = hits.Size() ? hits[0] : LagCompensationResult();
+}
+
+void LagCompensation::RaycastSingle(LagCompensationResult& result, const Ray& ray, float maxDistance, Connection* connection) const
+{
+    RaycastSingle(result, ray, maxDistance, GetRewindTime(connection));
+}
+
+void LagCompensation::SphereQuery(PODVector<LagCompensationResult>& result, const Sphere& sphere, float rewindTime) const
+{
+    ATOMIC_PROFILE(LagCompensationSphereQuery);
+
+    result.Clear();
+
+    Scene* scene = GetScene();
+    unsigned older, newer;
+    float t;
+    if (!scene || !FindTicks(rewindTime, older, newer, t))
+        return;
+
+    PODVector<LagCompensationShape> shapes;
+    unsigned numSlots = ticks_[older].nodeIDs_.Size();
+    for (unsigned i = 0; i < numSlots; ++i)
+    {
+        Vector3 position, scale;
+        Quaternion rotation;
+        if (!GetSlotTransform(i, older, newer, t, position, rotation, scale))
+            continue;
+
+        // Find the closest point of the node's shapes to the sphere center
+        Matrix3x4 nodeTransform(position, rotation, 1.0f);
+        GetSlotShapes(i, older, newer, t, shapes);
+        Vector3 closestPosition;
+        float distance = M_INFINITY;
+        for (unsigned j = 0; j < shapes.Size(); ++j)
+        {
+            Matrix3x4 shapeTransform = nodeTransform * Matrix3x4(shapes[j].position_, shapes[j].rotation_, 1.0f);
+            Vector3 shapePosition = shapeTransform * ClosestPoint(shapes[j], shapeTransform.Inverse() * sphere.center_);
+            float shapeDistance = (shapePosition - sphere.center_).Length();
+            if (shapeDistance < distance)
+            {
+                closestPosition = shapePosition;
+                distance = shapeDistance;
+            }
+        }
+        if (distance > sphere.radius_)
+            continue;
+
+        Node* node = scene->GetNode(ticks_[older].nodeIDs_[i]);
+        if (!node)
+            continue;
+
+        LagCompensationResult hit;
+        hit.node_ = node;
+        hit.nodePosition_ = position;
+        hit.position_ = closestPosition;
+        hit.distance_ = distance;
+        result.Push(hit);
+    }
+
+    Sort(result.Begin(), result.End(), CompareLagCompensationResults);
+}
+
+void LagCompensation::SphereQuery(PODVector<LagCompensationResult>& result, const Sphere& sphere, Connection* connection) const
+{
+    SphereQuery(result, sphere, GetRewindTime(connection));
+}
+
+bool LagCompensation::GetWorldTransform(Node* node, float rewindTime, Matrix3x4& transform) const
+{
+    if (!node)
+        return false;
+
+    HashMap<unsigned, unsigned>::ConstIterator i = slots_.Find(node->GetID());
+    unsigned older, newer;
+    float t;
+    Vector3 position, scale;
+    Quaternion rotation;
+    if (i == slots_.End() || !FindTicks(rewindTime, older, newer, t) ||
+        !GetSlotTransform(i->second_, older, newer, t, position, rotation, scale))
+        return false;
+
+    transform = Matrix3x4(position, rotation, scale);
+    return true;
+}
+
+bool LagCompensation::FindTicks(float rewindTime, unsigned& older, unsigned& newer, float& t) const
+{
+    if (!numTicks_)
+        return false;
+
+    Time* time = GetSubsystem<Time>();
+    float targetTime = (time ? time->GetElapsedTime() : ticks_[latestTick_].time_) - Clamp(rewindTime, 0.0f, maxRewindTime_);
+
+    // Walk back from the latest tick until one is at or before the target time. Clamp to the oldest tick
+    newer = latestTick_;
+    older = latestTick_;
+    t = 0.0f;
+    for (unsigned i = 0; i < numTicks_; ++i)
+    {
+        older = (latestTick_ + historyLength_ - i) % historyLength_;
+        if (ticks_[older].time_ <= targetTime)
+            break;
+        newer = older;
+    }
+
+    if (newer != older)
+    {
+        float interval = ticks_[newer].time_ - ticks_[older].time_;
+        if (interval > M_EPSILON)
+            t = Clamp((targetTime - ticks_[older].time_) / interval, 0.0f, 1.0f);
+    }
+
+    return true;
+}
+
+bool LagCompensation::GetSlotTransform(unsigned slot, unsigned older, unsigned newer, float t, Vector3& position,
+    Quaternion& rotation, Vector3& scale) const
+{
+    const LagCompensationTick& olderTick = ticks_[older];
+    // If the slot has since been reused by another node, the history belongs to a different node
+    if (slot >= olderTick.nodeIDs_.Size() || !olderTick.nodeIDs_[slot] ||
+        (slotNodeIDs_[slot] && slotNodeIDs_[slot] != olderTick.nodeIDs_[slot]))
+        return false;
+
+    const LagCompensationTick& newerTick = ticks_[newer];
+    if (t > 0.0f && slot < newerTick.nodeIDs_.Size() && newerTick.nodeIDs_[slot] == olderTick.nodeIDs_[slot])
+    {
+        position = olderTick.positions_[slot].Lerp(newerTick.positions_[slot], t);
+        rotation = olderTick.rotations_[slot].Slerp(newerTick.rotations_[slot], t);
+        scale = olderTick.scales_[slot].Lerp(newerTick.scales_[slot], t);
+    }
+    else
+    {
+        position = olderTick.positions_[slot];
+        rotation = olderTick.rotations_[slot];
+        scale = olderTick.scales_[slot];
+    }
+
+    return true;
+}
+
+void LagCompensation::GetSlotShapes(unsigned slot, unsigned older, unsigned newer, float t,
+    PODVector<LagCompensationShape>& shapes) const
+{
+    const LagCompensationTick& olderTick = ticks_[older];
+    const LagCompensationTick& newerTick = ticks_[newer];
+    unsigned numShapes = olderTick.numShapes_[slot];
+    const LagCompensationShape* olderShapes = &olderTick.shapes_[olderTick.firstShapes_[slot]];
+    shapes.Resize(numShapes);
+
+    if (t > 0.0f && slot < newerTick.nodeIDs_.Size() && newerTick.nodeIDs_[slot] == olderTick.nodeIDs_[slot] &&
+        newerTick.numShapes_[slot] == numShapes)
+    {
+        const LagCompensationShape* newerShapes = &newerTick.shapes_[newerTick.firstShapes_[slot]];
+        for (unsigned i = 0; i < numShapes; ++i)
+        {
+            shapes[i].type_ = olderShapes[i].type_;
+            shapes[i].position_ = olderShapes[i].position_.Lerp(newerShapes[i].position_, t);
+            shapes[i].rotation_ = olderShapes[i].rotation_.Slerp(newerShapes[i].rotation_, t);
+            shapes[i].size_ = olderShapes[i].size_.Lerp(newerShapes[i].size_, t);
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < numShapes; ++i)
+            shapes[i] = olderShapes[i];
+    }
+}
+
+}
@@ -0,0 +1,191 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Math/Quaternion.h"
+#include "../Scene/Component.h"
+
+namespace Atomic
+{
+
+class Connection;
+class Ray;
+class Sphere;
+
+/// Lag compensated hit query result.
+struct LagCompensationResult
+{
+    /// Construct with defaults.
+    LagCompensationResult() :
+        node_(0),
+        distance_(M_INFINITY)
+    {
+    }
+
+    /// Hit node.
+    Node* node_;
+    /// Rewound world position of the node.
+    Vector3 nodePosition_;
+    /// Hit position in world space. For sphere queries, the closest point of the hit shape to the sphere center.
+    Vector3 position_;
+    /// Hit distance from the ray origin. For sphere queries, distance from the sphere center to the hit shape.
+    float distance_;
+};
+
+/// Lag compensation hit shape type.
+enum HitShapeType
+{
+    HITSHAPE_BOX = 0,
+    HITSHAPE_SPHERE,
+    HITSHAPE_CAPSULE,
+    HITSHAPE_CYLINDER
+};
+
+/// Lag compensation hit shape, relative to the unscaled node transform. The node's world scale is applied to the position and size.
+struct LagCompensationShape
+{
+    /// Shape type.
+    HitShapeType type_;
+    /// Position relative to the node.
+    Vector3 position_;
+    /// Rotation relative to the node.
+    Quaternion rotation_;
+    /// Half extents for boxes. For spheres, capsules and cylinders the radius in X and the half length of the Y axis
+    /// in Y, which for capsules excludes the end caps.
+    Vector3 size_;
+};
+
+/// Recorded state of the lag compensated nodes for one network update. The arrays are indexed by node slot.
+struct LagCompensationTick
+{
+    /// Construct.
+    LagCompensationTick() :
+        time_(0.0f)
+    {
+    }
+
+    /// Elapsed time at recording.
+    float time_;
+    /// Node IDs. Zero if the slot was not in use.
+    PODVector<unsigned> nodeIDs_;
+    /// World positions.
+    PODVector<Vector3> positions_;
+    /// World rotations.
+    PODVector<Quaternion> rotations_;
+    /// World scales.
+    PODVector<Vector3> scales_;
+    /// Index of the first hit shape.
+    PODVector<unsigned> firstShapes_;
+    /// Number of hit shapes.
+    PODVector<unsigned> numShapes_;
+    /// Hit shapes of all nodes.
+    PODVector<LagCompensationShape> shapes_;
+};
+
+/// %Network lag compensation component for the scene. On the server, records the world transforms of replicated nodes
+/// that have geometry drawables or collision shapes each network update into a ring of history ticks, and answers ray
+/// and sphere queries against the state a client was seeing when it acted. Box, sphere, capsule and cylinder collision
+/// shapes are tested exactly and other collision shapes as their oriented local bounding boxes. Nodes without collision
+/// shapes are tested as the merged local bounds of their drawables.
+class ATOMIC_API LagCompensation : public Component
+{
+    ATOMIC_OBJECT(LagCompensation, Component);
+
+public:
+    /// Construct.
+    LagCompensation(Context* context);
+    /// Destruct.
+    virtual ~LagCompensation();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Set number of network updates to keep history for. Clears the history.
+    void SetHistoryLength(unsigned ticks);
+    /// Set maximum time in seconds that queries may rewind.
+    void SetMaxRewindTime(float time);
+
+    /// Return number of network updates to keep history for.
+    unsigned GetHistoryLength() const { return historyLength_; }
+    /// Return maximum rewind time.
+    float GetMaxRewindTime() const { return maxRewindTime_; }
+    /// Return number of recorded network updates.
+    unsigned GetNumRecordedTicks() const { return numTicks_; }
+    /// Return number of nodes in the latest recorded network update.
+    unsigned GetNumNodes() const { return slots_.Size(); }
+
+    /// Record the current state of the scene's nodes. Called by Network on each server network update.
+    void Record();
+    /// Clear the history.
+    void ClearHistory();
+
+    /// Return how far back in seconds the connection's client was seeing when its latest controls were sent: the round trip time plus the snapshot interpolation delay of the scene.
+    float GetRewindTime(Connection* connection) const;
+    /// Perform a raycast against the state the given time ago and return all hits sorted by distance.
+    void Raycast(PODVector<LagCompensationResult>& result, const Ray& ray, float maxDistance, float rewindTime) const;
+    /// Perform a raycast against the state the connection's client was seeing and return all hits sorted by distance.
+    void Raycast(PODVector<LagCompensationResult>& result, const Ray& ray, float maxDistance, Connection* connection) const;
+    /// Perform a raycast against the state the given time ago and return the closest hit.
+    void RaycastSingle(LagCompensationResult& result, const Ray& ray, float maxDistance, float rewindTime) const;
+    /// Perform a raycast against the state the connection's client was seeing and return the closest hit.
+    void RaycastSingle(LagCompensationResult& result, const Ray& ray, float maxDistance, Connection* connection) const;
+    /// Return the nodes whose hit boxes intersect a sphere in the state the given time ago, sorted by distance.
+    void SphereQuery(PODVector<LagCompensationResult>& result, const Sphere& sphere, float rewindTime) const;
+    /// Return the nodes whose hit boxes intersect a sphere in the state the connection's client was seeing, sorted by distance.
+    void SphereQuery(PODVector<LagCompensationResult>& result, const Sphere& sphere, Connection* connection) const;
+    /// Return the world transform of a node the given time ago. Return false if the node is not in the history.
+    bool GetWorldTransform(Node* node, float rewindTime, Matrix3x4& transform) const;
+
+private:
+    /// Find the recorded ticks around the given time ago and the interpolation factor between them. Return false if nothing has been recorded.
+    bool FindTicks(float rewindTime, unsigned& older, unsigned& newer, float& t) const;
+    /// Return the interpolated world transform of a slot. Return false if the slot's node is not in the older tick.
+    bool GetSlotTransform(unsigned slot, unsigned older, unsigned newer, float t, Vector3& position, Quaternion& rotation,
+        Vector3& scale) const;
+    /// Return the hit shapes of a slot, interpolated if the node had the same number of shapes in both ticks.
+    void GetSlotShapes(unsigned slot, unsigned older, unsigned newer, float t, PODVector<LagCompensationShape>& shapes) const;
+
+    /// History ticks, used as a ring.
+    Vector<LagCompensationTick> ticks_;
+    /// Slots by node ID.
+    HashMap<unsigned, unsigned> slots_;
+    /// Node IDs by slot. Zero if the slot is free.
+    PODVector<unsigned> slotNodeIDs_;
+    /// Free slots.
+    PODVector<unsigned> freeSlots_;
+    /// Nodes and the indices of their first hit shapes collected during recording.
+    PODVector<Pair<Node*, unsigned> > recordNodes_;
+    /// Hit shapes collected during recording.
+    PODVector<LagCompensationShape> recordShapes_;
+    /// Index of the latest recorded tick.
+    unsigned latestTick_;
+    /// Number of recorded ticks.
+    unsigned numTicks_;
+    /// Number of network updates to keep history for.
+    unsigned historyLength_;
+    /// Maximum rewind time.
+    float maxRewindTime_;
+};
+
+}
@@ -25,13 +25,19 @@
 #include "../Core/Context.h"
 #include "../Core/CoreEvents.h"
 #include "../Core/Profiler.h"
+#include "../Core/Timer.h"
+#include "../Core/WorkQueue.h"
 #include "../Engine/EngineEvents.h"
+#include "../IO/File.h"
 #include "../IO/FileSystem.h"
 #include "../Input/InputEvents.h"
 #include "../IO/IOEvents.h"
 #include "../IO/Log.h"
 #include "../IO/MemoryBuffer.h"
+#include "../IO/PackageFile.h"
 #include "../Network/HttpRequest.h"
+#include "../Network/InterestManager.h"
+#include "../Network/LagCompensation.h"
 #include "../Network/Network.h"
 #include "../Network/NetworkEvents.h"
 #include "../Network/NetworkPriority.h"
@@ -50,6 +56,50 @@ namespace Atomic
 
 static const int DEFAULT_UPDATE_FPS = 30;
 
+static bool CompareAttributeBandwidth(const Pair<unsigned long long, String>& lhs, const Pair<unsigned long long, String>& rhs)
+{
+    return lhs.first_ > rhs.first_;
+}
+
+void PrepareServerUpdateWork(const WorkItem* item, unsigned threadIndex)
+{
+    Connection** start = reinterpret_cast<Connection**>(item->start_);
+    Connection** end = reinterpret_cast<Connection**>(item->end_);
+
+    while (start != end)
+    {
+        (*start)->PrepareServerUpdate();
+        ++start;
+    }
+}
+
+void CalculatePackageChunkHashesWork(const WorkItem* item, unsigned threadIndex)
+{
+    Context* context = reinterpret_cast<Context*>(item->start_);
+    PackageChunkHashes* entry = reinterpret_cast<PackageChunkHashes*>(item->aux_);
+
+    File file(context, entry->fileName_);
+    if (!file.IsOpen())
+        return;
+
+    unsigned char buffer[PACKAGE_CHUNK_SIZE];
+    unsigned numChunks = (file.GetSize() + PACKAGE_CHUNK_SIZE - 1) / PACKAGE_CHUNK_SIZE;
+    entry->hashes_.Resize(numChunks);
+    for (unsigned i = 0; i < numChunks; ++i)
+    {
+        unsigned chunkSize = file.Read(buffer, PACKAGE_CHUNK_SIZE);
+        entry->hashes_[i] = HashPackageChunk(buffer, chunkSize);
+    }
+}
+
+unsigned HashPackageChunk(const unsigned char* data, unsigned size)
+{
+    unsigned hash = 0;
+    for (unsigned i = 0; i < size; ++i)
+        hash = SDBMHash(hash, data[i]);
+    return hash;
+}
+
 Network::Network(Context* context) :
     Object(context),
     updateFps_(DEFAULT_UPDATE_FPS),
@@ -57,6 +107,10 @@ Network::Network(Context* context) :
     simulatedPacketLoss_(0.0f),
     updateInterval_(1.0f / (float)DEFAULT_UPDATE_FPS),
     updateAcc_(0.0f),
+    serverTick_(0),
+    parallelServerUpdate_(true),
+    attributeBandwidthStats_(false),
+    packageCompression_(true),
 // ATOMIC BEGIN
     serverPort_(0xFFFF)
 // ATOMIC END
@@ -120,6 +174,18 @@ Network::~Network()
     serverConnection_.Reset();
 
     clientConnections_.Clear();
+
+    // Wait for package hash calculations still in progress, as they refer to the entries
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    for (HashMap<StringHash, PackageChunkHashes>::Iterator i = packageChunkHashes_.Begin(); i != packageChunkHashes_.End(); ++i)
+    {
+        WorkItem* item = i->second_.item_;
+        if (item && (!queue || !queue->RemoveWorkItem(i->second_.item_)))
+        {
+            while (!item->completed_)
+                Time::Sleep(1);
+        }
+    }
 }
 
 void Network::HandleMessage(kNet::MessageConnection* source, kNet::packet_id_t packetId, kNet::message_id_t msgId, const char* data,
@@ -349,6 +415,23 @@ void Network::SetUpdateFps(int fps)
     updateAcc_ = 0.0f;
 }
 
+void Network::SetAttributeBandwidthStats(bool enable)
+{
+    if (enable && !attributeBandwidthStats_)
+        ResetAttributeBandwidthStats();
+
+    attributeBandwidthStats_ = enable;
+}
+
+void Network::ResetAttributeBandwidthStats()
+{
+    attributeBitCounts_.Clear();
+    for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+         i != clientConnections_.End(); ++i)
+        i->second_->ResetAttributeBitCounts();
+    attributeStatsTimer_.Reset();
+}
+
 void Network::SetSimulatedLatency(int ms)
 {
     simulatedLatency_ = Max(ms, 0);
@@ -372,14 +455,44 @@ void Network::RegisterRemoteEvent(StringHash eventType)
     allowedRemoteEvents_.Insert(eventType);
 }
 
+void Network::RegisterRemoteEventSchema(StringHash eventType, const VariantMap& schema)
+{
+    if (blacklistedRemoteEvents_.Find(eventType) != blacklistedRemoteEvents_.End())
+    {
+        ATOMIC_LOGERROR("Attempted to register blacklisted remote event type " + String(eventType));
+        return;
+    }
+
+    RemoteEventSchema newSchema;
+    for (VariantMap::ConstIterator i = schema.Begin(); i != schema.End(); ++i)
+    {
+        VariantType type = i->second_.GetType();
+        if (type == VAR_NONE || type == VAR_VOIDPTR || type == VAR_PTR)
+        {
+            ATOMIC_LOGERROR("Remote event schema field " + i->first_.ToString() + " has a type that can not be sent");
+            return;
+        }
+        newSchema.keys_.Push(i->first_);
+    }
+
+    Sort(newSchema.keys_.Begin(), newSchema.keys_.End());
+    for (unsigned i = 0; i < newSchema.keys_.Size(); ++i)
+        newSchema.defaults_.Push(*schema[newSchema.keys_[i]]);
+
+    allowedRemoteEvents_.Insert(eventType);
+    remoteEventSchemas_[eventType] = newSchema;
+}
+
 void Network::UnregisterRemoteEvent(StringHash eventType)
 {
     allowedRemoteEvents_.Erase(eventType);
+    remoteEventSchemas_.Erase(eventType);
 }
 
 void Network::UnregisterAllRemoteEvents()
 {
     allowedRemoteEvents_.Clear();
+    remoteEventSchemas_.Clear();
 }
 
 void Network::SetPackageCacheDir(const String& path)
@@ -387,6 +500,49 @@ void Network::SetPackageCacheDir(const String& path)
     packageCacheDir_ = AddTrailingSlash(path);
 }
 
+const PODVector<unsigned>* Network::GetPackageChunkHashes(PackageFile* package)
+{
+    if (!package)
+        return 0;
+
+    StringHash key(package->GetName() + "_" + ToStringHex(package->GetChecksum()));
+    HashMap<StringHash, PackageChunkHashes>::Iterator i = packageChunkHashes_.Find(key);
+    if (i == packageChunkHashes_.End())
+    {
+        // Reading and hashing a large package takes a while, so do it in a worker thread. The entry stays in place
+        // while the work item refers to it, as hash map nodes do not move
+        i = packageChunkHashes_.Insert(MakePair(key, PackageChunkHashes()));
+        PackageChunkHashes& entry = i->second_;
+        entry.fileName_ = package->GetName();
+
+        SharedPtr<WorkItem> item(new WorkItem());
+        item->workFunction_ = CalculatePackageChunkHashesWork;
+        item->start_ = context_;
+        item->aux_ = &entry;
+
+        WorkQueue* queue = GetSubsystem<WorkQueue>();
+        if (!queue)
+        {
+            CalculatePackageChunkHashesWork(item, 0);
+            return &entry.hashes_;
+        }
+
+        entry.item_ = item;
+        queue->AddWorkItem(item);
+        return 0;
+    }
+
+    PackageChunkHashes& entry = i->second_;
+    if (entry.item_)
+    {
+        if (!entry.item_->completed_)
+            return 0;
+        entry.item_.Reset();
+    }
+
+    return &entry.hashes_;
+}
+
 void Network::SendPackageToClients(Scene* scene, PackageFile* package)
 {
     if (!scene)
@@ -418,6 +574,42 @@ SharedPtr<HttpRequest> Network::MakeHttpRequest(const String& url, const String&
     return request;
 }
 
+String Network::GetAttributeBandwidthReport() const
+{
+    Vector<Pair<unsigned long long, String> > entries;
+    unsigned long long totalBits = 0;
+
+    for (HashMap<StringHash, PODVector<unsigned long long> >::ConstIterator i = attributeBitCounts_.Begin();
+         i != attributeBitCounts_.End(); ++i)
+    {
+        const Vector<AttributeInfo>* attributes = context_->GetNetworkAttributes(i->first_);
+        if (!attributes)
+            continue;
+
+        const String& typeName = context_->GetTypeName(i->first_);
+        for (unsigned j = 0; j < i->second_.Size() && j < attributes->Size(); ++j)
+        {
+            if (!i->second_[j])
+                continue;
+
+            entries.Push(MakePair(i->second_[j], typeName + "." + attributes->At(j).name_));
+            totalBits += i->second_[j];
+        }
+    }
+
+    Sort(entries.Begin(), entries.End(), CompareAttributeBandwidth);
+
+    float elapsed = Max(attributeStatsTimer_.GetMSec(false) * 0.001f, M_EPSILON);
+    String report = ToString("Attribute bandwidth over %.1f seconds, %u bytes total\n", elapsed, (unsigned)(totalBits / 8));
+    for (Vector<Pair<unsigned long long, String> >::ConstIterator i = entries.Begin(); i != entries.End(); ++i)
+    {
+        report += ToString("%-48s %10u bytes %9.1f bytes/s %5.1f%%\n", i->second_.CString(), (unsigned)(i->first_ / 8),
+            (float)(i->first_ / 8) / elapsed, 100.0f * (float)i->first_ / (float)totalBits);
+    }
+
+    return report;
+}
+
 Connection* Network::GetConnection(kNet::MessageConnection* connection) const
 {
     if (serverConnection_ && serverConnection_->GetMessageConnection() == connection)
@@ -457,6 +649,26 @@ bool Network::CheckRemoteEvent(StringHash eventType) const
     return allowedRemoteEvents_.Contains(eventType);
 }
 
+const RemoteEventSchema* Network::GetRemoteEventSchema(StringHash eventType) const
+{
+    HashMap<StringHash, RemoteEventSchema>::ConstIterator i = remoteEventSchemas_.Find(eventType);
+    return i != remoteEventSchemas_.End() ? &i->second_ : 0;
+}
+
+bool RemoteEventSchema::Matches(const VariantMap& eventData) const
+{
+    for (VariantMap::ConstIterator i = eventData.Begin(); i != eventData.End(); ++i)
+    {
+        unsigned j = 0;
+        while (j < keys_.Size() && keys_[j] != i->first_)
+            ++j;
+        if (j == keys_.Size() || defaults_[j].GetType() != i->second_.GetType())
+            return false;
+    }
+
+    return true;
+}
+
 void Network::Update(float timeStep)
 {
     ATOMIC_PROFILE(UpdateNetwork);
@@ -504,6 +716,8 @@ void Network::PostUpdate(float timeStep)
 
         if (IsServerRunning())
         {
+            ++serverTick_;
+
             // Collect and prepare all networked scenes
             {
                 ATOMIC_PROFILE(PrepareServerUpdate);
@@ -518,19 +732,96 @@ void Network::PostUpdate(float timeStep)
                 }
 
                 for (HashSet<Scene*>::ConstIterator i = networkScenes_.Begin(); i != networkScenes_.End(); ++i)
+                {
                     (*i)->PrepareNetworkUpdate();
+
+                    InterestManager* interest = (*i)->GetComponent<InterestManager>();
+                    if (interest && interest->IsEnabledEffective())
+                        interest->Update();
+
+                    // Record the state being sent for hit queries against what the clients will see
+                    LagCompensation* lagCompensation = (*i)->GetComponent<LagCompensation>();
+                    if (lagCompensation && lagCompensation->IsEnabledEffective())
+                        lagCompensation->Record();
+                }
+            }
+
+            updateConnections_.Clear();
+            for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+                 i != clientConnections_.End(); ++i)
+                updateConnections_.Push(i->second_);
+
+            {
+                ATOMIC_PROFILE(BuildServerUpdate);
+
+                // Build the server update messages for each client connection. The scene is not modified during this,
+                // so the connections can be processed in worker threads
+                WorkQueue* queue = GetSubsystem<WorkQueue>();
+                if (parallelServerUpdate_ && queue && queue->GetNumThreads() && updateConnections_.Size() > 1)
+                {
+                    int numWorkItems = Min((int)updateConnections_.Size(), (int)queue->GetNumThreads() + 1);
+                    int connectionsPerItem = updateConnections_.Size() / numWorkItems;
+
+                    PODVector<Connection*>::Iterator start = updateConnections_.Begin();
+                    for (int i = 0; i < numWorkItems; ++i)
+                    {
+                        SharedPtr<WorkItem> item = queue->GetFreeItem();
+                        item->priority_ = M_MAX_UNSIGNED;
+                        item->workFunction_ = PrepareServerUpdateWork;
+                        item->aux_ = this;
+
+                        PODVector<Connection*>::Iterator end = updateConnections_.End();
+                        if (i < numWorkItems - 1 && end - start > connectionsPerItem)
+                            end = start + connectionsPerItem;
+
+                        item->start_ = &(*start);
+                        item->end_ = &(*end);
+                        queue->AddWorkItem(item);
+
+                        start = end;
+                    }
+
+                    queue->Complete(M_MAX_UNSIGNED);
+                }
+                else
+                {
+                    for (PODVector<Connection*>::Iterator i = updateConnections_.Begin(); i != updateConnections_.End(); ++i)
+                        (*i)->PrepareServerUpdate();
+                }
             }
 
             {
                 ATOMIC_PROFILE(SendServerUpdate);
 
-                // Then send server updates for each client connection
-                for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
-                     i != clientConnections_.End(); ++i)
+                // Then send the built messages, remote events and packages on the main thread
+                for (PODVector<Connection*>::Iterator i = updateConnections_.Begin(); i != updateConnections_.End(); ++i)
+                {
+                    (*i)->FlushServerUpdate();
+                    (*i)->SendRemoteEvents();
+                    (*i)->SendPackages();
+                }
+            }
+
+            if (attributeBandwidthStats_)
+            {
+                // Collect the connections' per-attribute counts, as they are lost when the connections go away
+                for (PODVector<Connection*>::Iterator i = updateConnections_.Begin(); i != updateConnections_.End(); ++i)
                 {
-                    i->second_->SendServerUpdate();
-                    i->second_->SendRemoteEvents();
-                    i->second_->SendPackages();
+                    const HashMap<StringHash, PODVector<unsigned> >& counts = (*i)->GetAttributeBitCounts();
+                    for (HashMap<StringHash, PODVector<unsigned> >::ConstIterator j = counts.Begin(); j != counts.End(); ++j)
+                    {
+                        PODVector<unsigned long long>& totals = attributeBitCounts_[j->first_];
+                        if (totals.Size() < j->second_.Size())
+                        {
+                            unsigned oldSize = totals.Size();
+                            totals.Resize(j->second_.Size());
+                            for (unsigned k = oldSize; k < totals.Size(); ++k)
+                                totals[k] = 0;
+                        }
+                        for (unsigned k = 0; k < j->second_.Size(); ++k)
+                            totals[k] += j->second_[k];
+                    }
+                    (*i)->ResetAttributeBitCounts();
                 }
             }
         }
@@ -606,6 +897,8 @@ void Network::ConfigureNetworkSimulator()
 void RegisterNetworkLibrary(Context* context)
 {
     NetworkPriority::RegisterObject(context);
+    InterestManager::RegisterObject(context);
+    LagCompensation::RegisterObject(context);
 }
 
 // ATOMIC BEGIN
@@ -24,6 +24,7 @@
 
 #include "../Container/HashSet.h"
 #include "../Core/Object.h"
+#include "../Core/WorkQueue.h"
 #include "../IO/VectorBuffer.h"
 #include "../Network/Connection.h"
 
@@ -43,6 +44,32 @@ template <class T> unsigned MakeHash(kNet::MessageConnection* value)
     return ((unsigned)(size_t)value) >> 9;
 }
 
+/// Fixed data layout of a remote event. Must be registered identically on the server and the clients.
+struct ATOMIC_API RemoteEventSchema
+{
+    /// Return whether event data fits the layout: every key is a field with the same value type.
+    bool Matches(const VariantMap& eventData) const;
+
+    /// Field keys, sorted by hash value so that the layout does not depend on registration order.
+    PODVector<StringHash> keys_;
+    /// Field default values, which also define the field types. Used for fields missing from the sent data.
+    Vector<Variant> defaults_;
+};
+
+/// Download chunk hashes of a package file, calculated in a worker thread.
+struct PackageChunkHashes
+{
+    /// Package file name.
+    String fileName_;
+    /// Chunk hashes.
+    PODVector<unsigned> hashes_;
+    /// Work item calculating the hashes. Null when finished.
+    SharedPtr<WorkItem> item_;
+};
+
+/// Return the content hash of a package download chunk.
+ATOMIC_API unsigned HashPackageChunk(const unsigned char* data, unsigned size);
+
 /// %Network subsystem. Manages client-server communications using the UDP protocol.
 class ATOMIC_API Network : public Object, public kNet::IMessageHandler, public kNet::INetworkServerListener
 {
@@ -87,18 +114,28 @@ public:
         (Node* node, StringHash eventType, bool inOrder, const VariantMap& eventData = Variant::emptyVariantMap);
     /// Set network update FPS.
     void SetUpdateFps(int fps);
+    /// Set whether to build client connections' server updates in worker threads. Sending stays on the main thread.
+    void SetParallelServerUpdate(bool enable) { parallelServerUpdate_ = enable; }
+    /// Set whether to collect the bytes sent per replicated attribute in server updates, for tuning the attributes' quantization.
+    void SetAttributeBandwidthStats(bool enable);
+    /// Reset the bytes sent per replicated attribute.
+    void ResetAttributeBandwidthStats();
     /// Set simulated latency in milliseconds. This adds a fixed delay before sending each packet.
     void SetSimulatedLatency(int ms);
     /// Set simulated packet loss probability between 0.0 - 1.0.
     void SetSimulatedPacketLoss(float probability);
     /// Register a remote event as allowed to be received. There is also a fixed blacklist of events that can not be allowed in any case, such as ConsoleCommand.
     void RegisterRemoteEvent(StringHash eventType);
+    /// Register a remote event as allowed to be received, with a fixed data layout given by the keys and value types of the schema map. Data that fits the layout is sent as the field values only, without keys and type tags. Received data has all the fields, with the schema values as defaults.
+    void RegisterRemoteEventSchema(StringHash eventType, const VariantMap& schema);
     /// Unregister a remote event as allowed to received.
     void UnregisterRemoteEvent(StringHash eventType);
     /// Unregister all remote events.
     void UnregisterAllRemoteEvents();
     /// Set the package download cache directory.
     void SetPackageCacheDir(const String& path);
+    /// Set whether to LZ4 compress package download chunks. Chunks of compressed packages, or that do not get smaller, are sent as is. Enabled by default.
+    void SetPackageCompression(bool enable) { packageCompression_ = enable; }
     /// Trigger all client connections in the specified scene to download a package file from the server. Can be used to download additional resource packages when clients are already joined in the scene. The package must have been added as a requirement to the scene, or else the eventual download will fail.
     void SendPackageToClients(Scene* scene, PackageFile* package);
     /// Perform an HTTP request to the specified URL. Empty verb defaults to a GET request. Return a request object which can be used to read the response data.
@@ -109,6 +146,18 @@ public:
     /// Return network update FPS.
     int GetUpdateFps() const { return updateFps_; }
 
+    /// Return whether server updates are built in worker threads.
+    bool GetParallelServerUpdate() const { return parallelServerUpdate_; }
+
+    /// Return number of server network updates sent. Used as the time of the snapshots sent to clients.
+    unsigned GetServerTick() const { return serverTick_; }
+
+    /// Return whether the bytes sent per replicated attribute are collected.
+    bool GetAttributeBandwidthStats() const { return attributeBandwidthStats_; }
+
+    /// Return a report of the bytes sent per replicated attribute since the last reset, largest first.
+    String GetAttributeBandwidthReport() const;
+
     /// Return simulated latency in milliseconds.
     int GetSimulatedLatency() const { return simulatedLatency_; }
 
@@ -125,9 +174,15 @@ public:
     bool IsServerRunning() const;
     /// Return whether a remote event is allowed to be received.
     bool CheckRemoteEvent(StringHash eventType) const;
+    /// Return the data layout of a remote event, or null if it has none.
+    const RemoteEventSchema* GetRemoteEventSchema(StringHash eventType) const;
 
     /// Return the package download cache directory.
     const String& GetPackageCacheDir() const { return packageCacheDir_; }
+    /// Return whether package download chunks are compressed.
+    bool GetPackageCompression() const { return packageCompression_; }
+    /// Return the content hashes of a package file's download chunks, or null while they are being calculated in a worker thread. The first call starts the calculation.
+    const PODVector<unsigned>* GetPackageChunkHashes(PackageFile* package);
 
     /// Process incoming messages from connections. Called by HandleBeginFrame.
     void Update(float timeStep);
@@ -169,8 +224,12 @@ private:
     HashSet<StringHash> allowedRemoteEvents_;
     /// Remote event fixed blacklist.
     HashSet<StringHash> blacklistedRemoteEvents_;
+    /// Remote event data layouts.
+    HashMap<StringHash, RemoteEventSchema> remoteEventSchemas_;
     /// Networked scenes.
     HashSet<Scene*> networkScenes_;
+    /// Client connections being updated.
+    PODVector<Connection*> updateConnections_;
     /// Update FPS.
     int updateFps_;
     /// Simulated latency (send delay) in milliseconds.
@@ -181,8 +240,22 @@ private:
     float updateInterval_;
     /// Update time accumulator.
     float updateAcc_;
+    /// Server network update counter.
+    unsigned serverTick_;
     /// Package cache directory.
     String packageCacheDir_;
+    /// Package download chunk hashes by package file name and checksum.
+    HashMap<StringHash, PackageChunkHashes> packageChunkHashes_;
+    /// Bits sent per replicated attribute by object type, collected from the client connections.
+    HashMap<StringHash, PODVector<unsigned long long> > attributeBitCounts_;
+    /// Time since the per-attribute bandwidth statistics were reset.
+    mutable Timer attributeStatsTimer_;
+    /// Parallel server update flag.
+    bool parallelServerUpdate_;
+    /// Collect bytes sent per replicated attribute flag.
+    bool attributeBandwidthStats_;
+    /// Package download chunk compression flag.
+    bool packageCompression_;
 
     // ATOMIC BEGIN
     
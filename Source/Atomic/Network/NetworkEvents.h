@@ -85,6 +85,17 @@ ATOMIC_EVENT(E_NETWORKUPDATESENT, NetworkUpdateSent)
 {
 }
 
+/// Server state of the client-predicted node received. The inputs it does not include remain in the connection's input history.
+ATOMIC_EVENT(E_PREDICTIONRECONCILE, PredictionReconcile)
+{
+    ATOMIC_PARAM(P_CONNECTION, Connection);      // Connection pointer
+    ATOMIC_PARAM(P_NODE, Node);                  // Node pointer
+    ATOMIC_PARAM(P_POSITION, Position);          // Vector3, server position
+    ATOMIC_PARAM(P_ROTATION, Rotation);          // Quaternion, server rotation
+    ATOMIC_PARAM(P_POSITIONERROR, PositionError); // Vector3, server position minus the prediction for the acknowledged input
+    ATOMIC_PARAM(P_TIMESTAMP, TimeStamp);        // unsigned, timestamp of the acknowledged input
+}
+
 /// Scene load failed, either due to file not found or checksum error.
 ATOMIC_EVENT(E_NETWORKSCENELOADFAILED, NetworkSceneLoadFailed)
 {
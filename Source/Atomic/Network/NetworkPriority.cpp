@@ -37,11 +37,22 @@ static const float DEFAULT_DISTANCE_FACTOR = 0.0f;
 static const float DEFAULT_MIN_PRIORITY = 0.0f;
 static const float UPDATE_THRESHOLD = 100.0f;
 
+static const char* relevanceModeNames[] =
+{
+    "Distance",
+    "Always",
+    "Owner",
+    "Team",
+    0
+};
+
 NetworkPriority::NetworkPriority(Context* context) :
     Component(context),
     basePriority_(DEFAULT_BASE_PRIORITY),
     distanceFactor_(DEFAULT_DISTANCE_FACTOR),
     minPriority_(DEFAULT_MIN_PRIORITY),
+    relevance_(RM_DISTANCE),
+    team_(0),
     alwaysUpdateOwner_(true)
 {
 }
@@ -58,6 +69,8 @@ void NetworkPriority::RegisterObject(Context* context)
     ATOMIC_ATTRIBUTE("Distance Factor", float, distanceFactor_, DEFAULT_DISTANCE_FACTOR, AM_DEFAULT);
     ATOMIC_ATTRIBUTE("Minimum Priority", float, minPriority_, DEFAULT_MIN_PRIORITY, AM_DEFAULT);
     ATOMIC_ATTRIBUTE("Always Update Owner", bool, alwaysUpdateOwner_, true, AM_DEFAULT);
+    ATOMIC_ENUM_ATTRIBUTE("Relevance", relevance_, relevanceModeNames, RM_DISTANCE, AM_DEFAULT);
+    ATOMIC_ATTRIBUTE("Team", unsigned, team_, 0, AM_DEFAULT);
 }
 
 void NetworkPriority::SetBasePriority(float priority)
@@ -84,6 +97,18 @@ void NetworkPriority::SetAlwaysUpdateOwner(bool enable)
     MarkNetworkUpdate();
 }
 
+void NetworkPriority::SetRelevance(RelevanceMode mode)
+{
+    relevance_ = mode;
+    MarkNetworkUpdate();
+}
+
+void NetworkPriority::SetTeam(unsigned team)
+{
+    team_ = team;
+    MarkNetworkUpdate();
+}
+
 bool NetworkPriority::CheckUpdate(float distance, float& accumulator)
 {
     float currentPriority = Max(basePriority_ - distanceFactor_ * distance, minPriority_);
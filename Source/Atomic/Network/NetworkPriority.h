@@ -27,6 +27,19 @@
 namespace Atomic
 {
 
+/// Rule for which client connections a node is relevant to, when the scene has an InterestManager.
+enum RelevanceMode
+{
+    /// Relevant to connections whose observer position is within the relevance radius.
+    RM_DISTANCE = 0,
+    /// Relevant to all connections.
+    RM_ALWAYS,
+    /// Relevant only to the owner connection.
+    RM_OWNER,
+    /// Relevant to connections on the same team.
+    RM_TEAM
+};
+
 /// %Network interest management settings component.
 class ATOMIC_API NetworkPriority : public Component
 {
@@ -48,6 +61,10 @@ public:
     void SetMinPriority(float priority);
     /// Set whether updates to owner should be sent always at full rate. Default true.
     void SetAlwaysUpdateOwner(bool enable);
+    /// Set relevance rule. Default distance. Only used when the scene has an InterestManager.
+    void SetRelevance(RelevanceMode mode);
+    /// Set team for the team relevance rule. Team 0 is relevant to no connection.
+    void SetTeam(unsigned team);
 
     /// Return base priority.
     float GetBasePriority() const { return basePriority_; }
@@ -61,6 +78,12 @@ public:
     /// Return whether updates to owner should be sent always at full rate.
     bool GetAlwaysUpdateOwner() const { return alwaysUpdateOwner_; }
 
+    /// Return relevance rule.
+    RelevanceMode GetRelevance() const { return relevance_; }
+
+    /// Return team.
+    unsigned GetTeam() const { return team_; }
+
     /// Increment and check priority accumulator. Return true if should update. Called by Connection.
     bool CheckUpdate(float distance, float& accumulator);
 
@@ -71,6 +94,10 @@ private:
     float distanceFactor_;
     /// Minimum priority.
     float minPriority_;
+    /// Relevance rule.
+    RelevanceMode relevance_;
+    /// Team.
+    unsigned team_;
     /// Update owner at full rate flag.
     bool alwaysUpdateOwner_;
 };
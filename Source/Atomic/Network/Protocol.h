@@ -31,10 +31,10 @@ static const int MSG_IDENTITY = 0x5;
 static const int MSG_CONTROLS = 0x6;
 /// Client->server: scene has been loaded and client is ready to proceed.
 static const int MSG_SCENELOADED = 0x7;
-/// Client->server: request a package file.
+/// Client->server: request a package file. The server replies with the package manifest.
 static const int MSG_REQUESTPACKAGE = 0x8;
 
-/// Server->client: package file data fragment.
+/// Server->client: package file data fragment. Sent without data as an error reply to a package request.
 static const int MSG_PACKAGEDATA = 0x9;
 /// Server->client: load new scene. In case of empty filename the client should just empty the scene.
 static const int MSG_LOADSCENE = 0xa;
@@ -71,9 +71,22 @@ static const int MSG_STRING = 0x17;
 
 // ATOMIC END
 
+/// Client->server and server->client: remote events and remote node events queued during one network update.
+static const int MSG_REMOTEEVENTS = 0x18;
+/// Server->client: package size and content hashes of its chunks.
+static const int MSG_PACKAGEMANIFEST = 0x19;
+/// Client->server: request package chunks by index. An empty request ends the upload.
+static const int MSG_REQUESTPACKAGECHUNKS = 0x1a;
+/// Server->client: package chunk data, optionally LZ4 compressed.
+static const int MSG_PACKAGECHUNK = 0x1b;
+/// Client->server: sequence numbers of the received node and component latest data updates.
+static const int MSG_LATESTDATAACK = 0x1c;
+
 /// Fixed content ID for client controls update.
 static const unsigned CONTROLS_CONTENT_ID = 1;
-/// Package file fragment size.
-static const unsigned PACKAGE_FRAGMENT_SIZE = 1024;
+/// Package file download chunk size.
+static const unsigned PACKAGE_CHUNK_SIZE = 16384;
+/// Package file chunks requested at a time per download. 4 MB in flight keeps a high latency link busy; the server paces the actual sending.
+static const unsigned PACKAGE_CHUNKS_IN_FLIGHT = 256;
 
 }
@@ -705,6 +705,22 @@ bool PhysicsWorld::GetSplitImpulse() const
     return world_->getSolverInfo().m_splitImpulse != 0;
 }
 
+void PhysicsWorld::SetApplyingTransforms(bool enable)
+{
+    applyingTransforms_ = enable;
+
+    // With batched transforms the listeners are notified later, so the scene records the flag with the queued nodes
+    Scene* scene = GetScene();
+    if (scene)
+        scene->GetTransformHierarchy().SetApplyingTransforms(enable);
+}
+
+bool PhysicsWorld::IsApplyingTransforms() const
+{
+    Scene* scene = GetScene();
+    return applyingTransforms_ || (scene && scene->GetTransformHierarchy().IsApplyingTransforms());
+}
+
 void PhysicsWorld::AddRigidBody(RigidBody* body)
 {
     rigidBodies_.Push(body);
@@ -275,10 +275,10 @@ public:
     HashMap<Pair<Model*, unsigned>, SharedPtr<CollisionGeometryData> >& GetConvexCache() { return convexCache_; }
 
     /// Set node dirtying to be disregarded.
-    void SetApplyingTransforms(bool enable) { applyingTransforms_ = enable; }
+    void SetApplyingTransforms(bool enable);
 
     /// Return whether node dirtying should be disregarded.
-    bool IsApplyingTransforms() const { return applyingTransforms_; }
+    bool IsApplyingTransforms() const;
 
     /// Return whether is currently inside the Bullet substep loop.
     bool IsSimulating() const { return simulating_; }
@@ -162,6 +162,12 @@ void Component::AddReplicationState(ComponentReplicationState* state)
     networkState_->replicationStates_.Push(state);
 }
 
+void Component::RemoveReplicationState(ComponentReplicationState* state)
+{
+    if (networkState_)
+        networkState_->replicationStates_.Remove(state);
+}
+
 void Component::PrepareNetworkUpdate()
 {
     if (!networkState_)
@@ -183,31 +189,40 @@ void Component::PrepareNetworkUpdate()
 
         OnGetAttribute(attr, networkState_->currentValues_[i]);
 
-        if (networkState_->currentValues_[i] != networkState_->previousValues_[i])
+        if (!NetworkValuesEqual(networkState_->currentValues_[i], networkState_->previousValues_[i]))
         {
             networkState_->previousValues_[i] = networkState_->currentValues_[i];
-
-            // Mark the attribute dirty in all replication states that are tracking this component
-            for (PODVector<ReplicationState*>::Iterator j = networkState_->replicationStates_.Begin();
-                 j != networkState_->replicationStates_.End(); ++j)
-            {
-                ComponentReplicationState* compState = static_cast<ComponentReplicationState*>(*j);
-                compState->dirtyAttributes_.Set(i);
-
-                // Add component's parent node to the dirty set if not added yet
-                NodeReplicationState* nodeState = compState->nodeState_;
-                if (!nodeState->markedDirty_)
-                {
-                    nodeState->markedDirty_ = true;
-                    nodeState->sceneState_->dirtyNodes_.Insert(node_->GetID());
-                }
-            }
+            networkState_->changedAttributes_.Set(i);
         }
     }
 
     networkUpdate_ = false;
 }
 
+void Component::MarkAttributesDirty()
+{
+    if (!networkState_ || !networkState_->changedAttributes_.Count())
+        return;
+
+    // Mark the attributes dirty in all replication states that are tracking this component
+    for (PODVector<ReplicationState*>::Iterator i = networkState_->replicationStates_.Begin();
+         i != networkState_->replicationStates_.End(); ++i)
+    {
+        ComponentReplicationState* compState = static_cast<ComponentReplicationState*>(*i);
+        compState->dirtyAttributes_.Merge(networkState_->changedAttributes_);
+
+        // Add component's parent node to the dirty set if not added yet
+        NodeReplicationState* nodeState = compState->nodeState_;
+        if (!nodeState->markedDirty_)
+        {
+            nodeState->markedDirty_ = true;
+            nodeState->sceneState_->dirtyNodes_.Insert(node_->GetID());
+        }
+    }
+
+    networkState_->changedAttributes_.ClearAll();
+}
+
 void Component::CleanupConnection(Connection* connection)
 {
     if (networkState_)
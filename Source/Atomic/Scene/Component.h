@@ -101,8 +101,12 @@ public:
 
     /// Add a replication state that is tracking this component.
     void AddReplicationState(ComponentReplicationState* state);
-    /// Prepare network update by comparing attributes and marking replication states dirty as necessary.
+    /// Remove a replication state that is no longer tracking this component.
+    void RemoveReplicationState(ComponentReplicationState* state);
+    /// Prepare network update by comparing attributes to the previous update. Only writes the component's own network state, so different components can be prepared in worker threads.
     void PrepareNetworkUpdate();
+    /// Mark the attributes changed in PrepareNetworkUpdate() dirty in the replication states. Must be called from the main thread.
+    void MarkAttributesDirty();
     /// Clean up all references to a network connection that is about to be removed.
     void CleanupConnection(Connection* connection);
 
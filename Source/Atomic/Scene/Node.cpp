@@ -45,6 +45,12 @@
 namespace Atomic
 {
 
+/// Cell size and bits within the cell of the replicated node position. Gives a precision of about 2 millimeters.
+static const float NETWORK_POSITION_CELL_SIZE = 32.0f;
+static const unsigned NETWORK_POSITION_BITS = 14;
+/// Bits per component of the replicated node rotation.
+static const unsigned NETWORK_ROTATION_BITS = 10;
+
 Node::Node(Context* context) :
     Animatable(context),
     worldTransform_(Matrix3x4::IDENTITY),
@@ -58,7 +64,10 @@ Node::Node(Context* context) :
     position_(Vector3::ZERO),
     rotation_(Quaternion::IDENTITY),
     scale_(Vector3::ONE),
-    worldRotation_(Quaternion::IDENTITY)
+    worldRotation_(Quaternion::IDENTITY),
+    transformIndex_(M_MAX_UNSIGNED),
+    transformNotifyPending_(false),
+    transformNotifyApplied_(false)
 {
     impl_ = new NodeImpl();
     impl_->owner_ = 0;
@@ -87,10 +96,12 @@ void Node::RegisterObject(Context* context)
     ATOMIC_ATTRIBUTE("Variables", VariantMap, vars_, Variant::emptyVariantMap, AM_FILE); // Network replication of vars uses custom data
     ATOMIC_ACCESSOR_ATTRIBUTE("Network Position", GetNetPositionAttr, SetNetPositionAttr, Vector3, Vector3::ZERO,
         AM_NET | AM_LATESTDATA | AM_NOEDIT);
-    ATOMIC_ACCESSOR_ATTRIBUTE("Network Rotation", GetNetRotationAttr, SetNetRotationAttr, PODVector<unsigned char>, Variant::emptyBuffer,
+    ATOMIC_ACCESSOR_ATTRIBUTE("Network Rotation", GetNetRotationAttr, SetNetRotationAttr, Quaternion, Quaternion::IDENTITY,
         AM_NET | AM_LATESTDATA | AM_NOEDIT);
     ATOMIC_ACCESSOR_ATTRIBUTE("Network Parent Node", GetNetParentAttr, SetNetParentAttr, PODVector<unsigned char>, Variant::emptyBuffer,
         AM_NET | AM_NOEDIT);
+    ATOMIC_ATTRIBUTE_QUANTIZATION("Network Position", QM_CELL, 0.0f, NETWORK_POSITION_CELL_SIZE, NETWORK_POSITION_BITS);
+    ATOMIC_ATTRIBUTE_QUANTIZATION("Network Rotation", QM_QUATERNION, 0.0f, 0.0f, NETWORK_ROTATION_BITS);
 }
 
 bool Node::Load(Deserializer& source, bool setInstanceDefault)
@@ -307,6 +318,12 @@ void Node::AddReplicationState(NodeReplicationState* state)
     networkState_->replicationStates_.Push(state);
 }
 
+void Node::RemoveReplicationState(NodeReplicationState* state)
+{
+    if (networkState_)
+        networkState_->replicationStates_.Remove(state);
+}
+
 bool Node::SaveXML(Serializer& dest, const String& indentation) const
 {
     SharedPtr<XMLFile> xml(new XMLFile(context_));
@@ -744,6 +761,14 @@ void Node::SetOwner(Connection* owner)
 
 void Node::MarkDirty()
 {
+    // With batched transforms the scene flags the subtree and defers the listener notification to its transform update.
+    // Worker threads of a threaded update use the immediate path
+    if (scene_ && scene_->GetTransformHierarchy().IsEnabled() && !scene_->IsThreadedUpdate())
+    {
+        scene_->GetTransformHierarchy().MarkDirty(this);
+        return;
+    }
+
     Node *cur = this;
     for (;;)
     {
@@ -759,21 +784,7 @@ void Node::MarkDirty()
         cur->dirty_ = true;
 
         // Notify listener components first, then mark child nodes
-        for (Vector<WeakPtr<Component> >::Iterator i = cur->listeners_.Begin(); i != cur->listeners_.End();)
-        {
-            Component *c = *i;
-            if (c)
-            {
-                c->OnMarkedDirty(cur);
-                ++i;
-            }
-            // If listener has expired, erase from list (swap with the last element to avoid O(n^2) behavior)
-            else
-            {
-                *i = cur->listeners_.Back();
-                cur->listeners_.Pop();
-            }
-        }
+        cur->NotifyListeners();
 
         // Tail call optimization: Don't recurse to mark the first child dirty, but
         // instead process it in the context of the current function. If there are more
@@ -791,6 +802,25 @@ void Node::MarkDirty()
     }
 }
 
+void Node::NotifyListeners()
+{
+    for (Vector<WeakPtr<Component> >::Iterator i = listeners_.Begin(); i != listeners_.End();)
+    {
+        Component *c = *i;
+        if (c)
+        {
+            c->OnMarkedDirty(this);
+            ++i;
+        }
+        // If listener has expired, erase from list (swap with the last element to avoid O(n^2) behavior)
+        else
+        {
+            *i = listeners_.Back();
+            listeners_.Pop();
+        }
+    }
+}
+
 Node* Node::CreateChild(const String& name, CreateMode mode, unsigned id, bool temporary)
 {
     Node* newNode = CreateChild(id, mode, temporary);
@@ -836,6 +866,10 @@ void Node::AddChild(Node* node, unsigned index)
             }
 
             oldParent->children_.Remove(nodeShared);
+
+            // Moved within the same scene, which changes the node order of batched transforms
+            if (scene_)
+                scene_->GetTransformHierarchy().MarkStructureDirty();
         }
     }
 
@@ -1469,18 +1503,17 @@ void Node::SetNetPositionAttr(const Vector3& value)
     SmoothedTransform* transform = GetComponent<SmoothedTransform>();
     if (transform)
         transform->SetTargetPosition(value);
-    else
+    else if (!scene_ || !scene_->GetSnapshotBuffer().SetPosition(this, value))
         SetPosition(value);
 }
 
-void Node::SetNetRotationAttr(const PODVector<unsigned char>& value)
+void Node::SetNetRotationAttr(const Quaternion& value)
 {
-    MemoryBuffer buf(value);
     SmoothedTransform* transform = GetComponent<SmoothedTransform>();
     if (transform)
-        transform->SetTargetRotation(buf.ReadPackedQuaternion());
-    else
-        SetRotation(buf.ReadPackedQuaternion());
+        transform->SetTargetRotation(value);
+    else if (!scene_ || !scene_->GetSnapshotBuffer().SetRotation(this, value))
+        SetRotation(value);
 }
 
 void Node::SetNetParentAttr(const PODVector<unsigned char>& value)
@@ -1525,11 +1558,9 @@ const Vector3& Node::GetNetPositionAttr() const
     return position_;
 }
 
-const PODVector<unsigned char>& Node::GetNetRotationAttr() const
+const Quaternion& Node::GetNetRotationAttr() const
 {
-    impl_->attrBuffer_.Clear();
-    impl_->attrBuffer_.WritePackedQuaternion(rotation_);
-    return impl_->attrBuffer_.GetBuffer();
+    return rotation_;
 }
 
 const PODVector<unsigned char>& Node::GetNetParentAttr() const
@@ -1735,24 +1766,10 @@ void Node::PrepareNetworkUpdate()
 
         OnGetAttribute(attr, networkState_->currentValues_[i]);
 
-        if (networkState_->currentValues_[i] != networkState_->previousValues_[i])
+        if (!NetworkValuesEqual(networkState_->currentValues_[i], networkState_->previousValues_[i]))
         {
             networkState_->previousValues_[i] = networkState_->currentValues_[i];
-
-            // Mark the attribute dirty in all replication states that are tracking this node
-            for (PODVector<ReplicationState*>::Iterator j = networkState_->replicationStates_.Begin();
-                 j != networkState_->replicationStates_.End(); ++j)
-            {
-                NodeReplicationState* nodeState = static_cast<NodeReplicationState*>(*j);
-                nodeState->dirtyAttributes_.Set(i);
-
-                // Add node to the dirty set if not added yet
-                if (!nodeState->markedDirty_)
-                {
-                    nodeState->markedDirty_ = true;
-                    nodeState->sceneState_->dirtyNodes_.Insert(id_);
-                }
-            }
+            networkState_->changedAttributes_.Set(i);
         }
     }
 
@@ -1763,26 +1780,39 @@ void Node::PrepareNetworkUpdate()
         if (j == networkState_->previousVars_.End() || j->second_ != i->second_)
         {
             networkState_->previousVars_[i->first_] = i->second_;
-
-            // Mark the var dirty in all replication states that are tracking this node
-            for (PODVector<ReplicationState*>::Iterator j = networkState_->replicationStates_.Begin();
-                 j != networkState_->replicationStates_.End(); ++j)
-            {
-                NodeReplicationState* nodeState = static_cast<NodeReplicationState*>(*j);
-                nodeState->dirtyVars_.Insert(i->first_);
-
-                if (!nodeState->markedDirty_)
-                {
-                    nodeState->markedDirty_ = true;
-                    nodeState->sceneState_->dirtyNodes_.Insert(id_);
-                }
-            }
+            networkState_->changedVars_.Push(i->first_);
         }
     }
 
     networkUpdate_ = false;
 }
 
+void Node::MarkAttributesDirty()
+{
+    if (!networkState_ || (!networkState_->changedAttributes_.Count() && networkState_->changedVars_.Empty()))
+        return;
+
+    // Mark the attributes and vars dirty in all replication states that are tracking this node
+    for (PODVector<ReplicationState*>::Iterator i = networkState_->replicationStates_.Begin();
+         i != networkState_->replicationStates_.End(); ++i)
+    {
+        NodeReplicationState* nodeState = static_cast<NodeReplicationState*>(*i);
+        nodeState->dirtyAttributes_.Merge(networkState_->changedAttributes_);
+        for (PODVector<StringHash>::ConstIterator j = networkState_->changedVars_.Begin(); j != networkState_->changedVars_.End(); ++j)
+            nodeState->dirtyVars_.Insert(*j);
+
+        // Add node to the dirty set if not added yet
+        if (!nodeState->markedDirty_)
+        {
+            nodeState->markedDirty_ = true;
+            nodeState->sceneState_->dirtyNodes_.Insert(id_);
+        }
+    }
+
+    networkState_->changedAttributes_.ClearAll();
+    networkState_->changedVars_.Clear();
+}
+
 void Node::CleanupConnection(Connection* connection)
 {
     if (impl_->owner_ == connection)
@@ -75,6 +75,7 @@ class ATOMIC_API Node : public Animatable
     ATOMIC_OBJECT(Node, Animatable);
 
     friend class Connection;
+    friend class TransformHierarchy;
 
 public:
     /// Construct.
@@ -106,6 +107,8 @@ public:
     virtual void MarkNetworkUpdate();
     /// Add a replication state that is tracking this node.
     virtual void AddReplicationState(NodeReplicationState* state);
+    /// Remove a replication state that is no longer tracking this node.
+    void RemoveReplicationState(NodeReplicationState* state);
 
     /// Save to an XML file. Return true if successful.
     bool SaveXML(Serializer& dest, const String& indentation = "\t") const;
@@ -579,13 +582,13 @@ public:
     /// Set network position attribute.
     void SetNetPositionAttr(const Vector3& value);
     /// Set network rotation attribute.
-    void SetNetRotationAttr(const PODVector<unsigned char>& value);
+    void SetNetRotationAttr(const Quaternion& value);
     /// Set network parent attribute.
     void SetNetParentAttr(const PODVector<unsigned char>& value);
     /// Return network position attribute.
     const Vector3& GetNetPositionAttr() const;
     /// Return network rotation attribute.
-    const PODVector<unsigned char>& GetNetRotationAttr() const;
+    const Quaternion& GetNetRotationAttr() const;
     /// Return network parent attribute.
     const PODVector<unsigned char>& GetNetParentAttr() const;
     /// Load components and optionally load child nodes.
@@ -600,8 +603,10 @@ public:
     /// Return the depended on nodes to order network updates.
     const PODVector<Node*>& GetDependencyNodes() const { return impl_->dependencyNodes_; }
 
-    /// Prepare network update by comparing attributes and marking replication states dirty as necessary.
+    /// Prepare network update by comparing attributes and user variables to the previous update. Only writes the node's own network state, so different nodes can be prepared in worker threads.
     void PrepareNetworkUpdate();
+    /// Mark the attributes and user variables changed in PrepareNetworkUpdate() dirty in the replication states. Must be called from the main thread.
+    void MarkAttributesDirty();
     /// Clean up all references to a network connection that is about to be removed.
     void CleanupConnection(Connection* connection);
     /// Mark node dirty in scene replication states.
@@ -689,6 +694,8 @@ private:
 
     /// Recalculate the world transform.
     void UpdateWorldTransform() const;
+    /// Notify the listener components that the transform has changed, and erase expired listeners.
+    void NotifyListeners();
     /// Remove child node by iterator.
     void RemoveChild(Vector<SharedPtr<Node> >::Iterator i);
     /// Return child nodes recursively.
@@ -740,6 +747,12 @@ private:
     Vector<SharedPtr<Node> > children_;
     /// Node listeners.
     Vector<WeakPtr<Component> > listeners_;
+    /// Index in the scene's batched transform hierarchy.
+    unsigned transformIndex_;
+    /// Listeners queued for notification by the scene's batched transform hierarchy flag.
+    bool transformNotifyPending_;
+    /// Listeners queued while physics applied transforms flag.
+    bool transformNotifyApplied_;
     /// Pointer to implementation.
     UniquePtr<NodeImpl> impl_;
 
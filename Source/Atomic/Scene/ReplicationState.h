@@ -92,6 +92,18 @@ struct ATOMIC_API DirtyBits
         }
     }
 
+    /// Set all bits that are set in another structure.
+    void Merge(const DirtyBits& bits)
+    {
+        for (unsigned i = 0; i < MAX_NETWORK_ATTRIBUTES / 8; ++i)
+        {
+            unsigned char added = (unsigned char)(bits.data_[i] & ~data_[i]);
+            data_[i] |= bits.data_[i];
+            for (; added; added &= (unsigned char)(added - 1))
+                ++count_;
+        }
+    }
+
     /// Clear all bits.
     void ClearAll()
     {
@@ -121,6 +133,75 @@ struct ATOMIC_API DirtyBits
     unsigned char count_;
 };
 
+/// Number of latest data updates remembered per object for delta encoding.
+static const unsigned LATEST_DATA_HISTORY = 16;
+
+/// Quantized attribute values of the recent latest data updates of an object, by sequence number. The server keeps one per
+/// connection and delta encodes against the newest update the client has acknowledged; the client keeps one to decode.
+struct ATOMIC_API LatestDataHistory
+{
+    /// Construct.
+    LatestDataHistory() :
+        sequence_(0),
+        ackedSequence_(0),
+        hasAck_(false)
+    {
+    }
+
+    /// Return storage for the quantized values of an update, replacing an older update. Return null if a newer update occupies it.
+    int* Store(unsigned short sequence, unsigned slotSize)
+    {
+        if (!slotSize)
+            return 0;
+
+        if (values_.Size() != LATEST_DATA_HISTORY * slotSize)
+        {
+            values_.Resize(LATEST_DATA_HISTORY * slotSize);
+            sequences_.Resize(LATEST_DATA_HISTORY);
+            for (unsigned i = 0; i < LATEST_DATA_HISTORY; ++i)
+                sequences_[i] = M_MAX_UNSIGNED;
+        }
+
+        unsigned index = sequence % LATEST_DATA_HISTORY;
+        if (sequences_[index] != M_MAX_UNSIGNED && (short)(sequence - sequences_[index]) < 0)
+            return 0;
+
+        sequences_[index] = sequence;
+        return &values_[index * slotSize];
+    }
+
+    /// Return the quantized values of an update, or null if no longer remembered.
+    int* Find(unsigned short sequence, unsigned slotSize)
+    {
+        if (!slotSize || values_.Size() != LATEST_DATA_HISTORY * slotSize)
+            return 0;
+
+        unsigned index = sequence % LATEST_DATA_HISTORY;
+        return sequences_[index] == sequence ? &values_[index * slotSize] : 0;
+    }
+
+    /// Acknowledge an update received by the client. Acknowledgements older than the current one are ignored.
+    void Acknowledge(unsigned short sequence)
+    {
+        if (!hasAck_ || (short)(sequence - ackedSequence_) > 0)
+        {
+            ackedSequence_ = sequence;
+            hasAck_ = true;
+        }
+    }
+
+    /// Sequence number of each remembered update.
+    PODVector<unsigned> sequences_;
+    /// Quantized values of the remembered updates.
+    PODVector<int> values_;
+    /// Sequence number of the last sent update. Used on the server only.
+    unsigned short sequence_;
+    /// Newest acknowledged sequence number. Used on the server only.
+    unsigned short ackedSequence_;
+    /// Acknowledgement received flag. Used on the server only.
+    bool hasAck_;
+};
+
 /// Per-object attribute state for network replication, allocated on demand.
 struct ATOMIC_API NetworkState
 {
@@ -140,10 +221,79 @@ struct ATOMIC_API NetworkState
     PODVector<ReplicationState*> replicationStates_;
     /// Previous user variables.
     VariantMap previousVars_;
+    /// Attributes changed since the previous network update. Written by PrepareNetworkUpdate(), which may run in a worker thread, and applied to the replication states afterward.
+    DirtyBits changedAttributes_;
+    /// User variables changed since the previous network update.
+    PODVector<StringHash> changedVars_;
+    /// Quantized attribute values of the last received delta update, the baseline for the next one. Used on the client only.
+    PODVector<int> quantizedValues_;
+    /// Quantized attribute values of the recently received latest data updates. Used on the client only.
+    LatestDataHistory latestData_;
     /// Bitmask for intercepting network messages. Used on the client only.
     unsigned long long interceptMask_;
 };
 
+/// Return whether two network attribute values are equal. Value types are compared as raw memory, which also avoids an
+/// attribute holding a NaN being sent on every update.
+inline bool NetworkValuesEqual(const Variant& lhs, const Variant& rhs)
+{
+    VariantType type = lhs.GetType();
+    if (type != rhs.GetType())
+        return false;
+
+    switch (type)
+    {
+    case VAR_INT:
+        return lhs.GetInt() == rhs.GetInt();
+
+    case VAR_BOOL:
+        return lhs.GetBool() == rhs.GetBool();
+
+    case VAR_FLOAT:
+    {
+        float lhsValue = lhs.GetFloat();
+        float rhsValue = rhs.GetFloat();
+        return !memcmp(&lhsValue, &rhsValue, sizeof(float));
+    }
+
+    case VAR_VECTOR2:
+        return !memcmp(&lhs.GetVector2(), &rhs.GetVector2(), sizeof(Vector2));
+
+    case VAR_VECTOR3:
+        return !memcmp(&lhs.GetVector3(), &rhs.GetVector3(), sizeof(Vector3));
+
+    case VAR_VECTOR4:
+    case VAR_QUATERNION:
+    case VAR_COLOR:
+        // Same memory structure for all of these
+        return !memcmp(&lhs.GetVector4(), &rhs.GetVector4(), sizeof(Vector4));
+
+    case VAR_INTRECT:
+        return !memcmp(&lhs.GetIntRect(), &rhs.GetIntRect(), sizeof(IntRect));
+
+    case VAR_INTVECTOR2:
+        return !memcmp(&lhs.GetIntVector2(), &rhs.GetIntVector2(), sizeof(IntVector2));
+
+    case VAR_INTVECTOR3:
+        return !memcmp(&lhs.GetIntVector3(), &rhs.GetIntVector3(), sizeof(IntVector3));
+
+    case VAR_RECT:
+        return !memcmp(&lhs.GetRect(), &rhs.GetRect(), sizeof(Rect));
+
+    case VAR_MATRIX3:
+        return !memcmp(&lhs.GetMatrix3(), &rhs.GetMatrix3(), sizeof(Matrix3));
+
+    case VAR_MATRIX3X4:
+        return !memcmp(&lhs.GetMatrix3x4(), &rhs.GetMatrix3x4(), sizeof(Matrix3x4));
+
+    case VAR_MATRIX4:
+        return !memcmp(&lhs.GetMatrix4(), &rhs.GetMatrix4(), sizeof(Matrix4));
+
+    default:
+        return lhs == rhs;
+    }
+}
+
 /// Base class for per-user network replication states.
 struct ATOMIC_API ReplicationState
 {
@@ -160,6 +310,10 @@ struct ATOMIC_API ComponentReplicationState : public ReplicationState
     WeakPtr<Component> component_;
     /// Dirty attribute bits.
     DirtyBits dirtyAttributes_;
+    /// Quantized attribute values of the last sent delta update, the baseline for the next one.
+    PODVector<int> quantizedValues_;
+    /// Quantized attribute values of the recently sent latest data updates.
+    LatestDataHistory latestData_;
 };
 
 /// Per-user node network replication state.
@@ -181,6 +335,10 @@ struct ATOMIC_API NodeReplicationState : public ReplicationState
     DirtyBits dirtyAttributes_;
     /// Dirty user vars.
     HashSet<StringHash> dirtyVars_;
+    /// Quantized attribute values of the last sent delta update, the baseline for the next one.
+    PODVector<int> quantizedValues_;
+    /// Quantized attribute values of the recently sent latest data updates.
+    LatestDataHistory latestData_;
     /// Components by ID.
     HashMap<unsigned, ComponentReplicationState> componentStates_;
     /// Interest management priority accumulator.
@@ -58,6 +58,33 @@ const char* SUBSYSTEM_CATEGORY = "Subsystem";
 
 static const float DEFAULT_SMOOTHING_CONSTANT = 50.0f;
 static const float DEFAULT_SNAP_THRESHOLD = 5.0f;
+static const float DEFAULT_INTERPOLATION_DELAY = 0.1f;
+static const float DEFAULT_MAX_EXTRAPOLATION = 0.25f;
+static const unsigned MIN_PARALLEL_NETWORK_UPDATE = 256;
+
+static void PrepareNodesNetworkUpdateWork(const WorkItem* item, unsigned threadIndex)
+{
+    Node** start = reinterpret_cast<Node**>(item->start_);
+    Node** end = reinterpret_cast<Node**>(item->end_);
+
+    while (start != end)
+    {
+        (*start)->PrepareNetworkUpdate();
+        ++start;
+    }
+}
+
+static void PrepareComponentsNetworkUpdateWork(const WorkItem* item, unsigned threadIndex)
+{
+    Component** start = reinterpret_cast<Component**>(item->start_);
+    Component** end = reinterpret_cast<Component**>(item->end_);
+
+    while (start != end)
+    {
+        (*start)->PrepareNetworkUpdate();
+        ++start;
+    }
+}
 
 Scene::Scene(Context* context) :
     Node(context),
@@ -113,6 +140,12 @@ void Scene::RegisterObject(Context* context)
     ATOMIC_ATTRIBUTE("Next Local Component ID", unsigned, localComponentID_, FIRST_LOCAL_ID, AM_FILE | AM_NOEDIT);
     ATOMIC_ATTRIBUTE("Variables", VariantMap, vars_, Variant::emptyVariantMap, AM_FILE); // Network replication of vars uses custom data
     ATOMIC_MIXED_ACCESSOR_ATTRIBUTE("Variable Names", GetVarNamesAttr, SetVarNamesAttr, String, String::EMPTY, AM_FILE | AM_NOEDIT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Snapshot Interpolation", GetSnapshotInterpolation, SetSnapshotInterpolation, bool, true, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Interpolation Delay", GetInterpolationDelay, SetInterpolationDelay, float,
+        DEFAULT_INTERPOLATION_DELAY, AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Max Extrapolation", GetMaxExtrapolation, SetMaxExtrapolation, float, DEFAULT_MAX_EXTRAPOLATION,
+        AM_DEFAULT);
+    ATOMIC_ACCESSOR_ATTRIBUTE("Batched Transforms", GetBatchedTransforms, SetBatchedTransforms, bool, false, AM_DEFAULT);
 }
 
 bool Scene::Load(Deserializer& source, bool setInstanceDefault)
@@ -668,6 +701,33 @@ void Scene::SetSnapThreshold(float threshold)
     Node::MarkNetworkUpdate();
 }
 
+void Scene::SetSnapshotInterpolation(bool enable)
+{
+    snapshotBuffer_.SetEnabled(enable);
+    Node::MarkNetworkUpdate();
+}
+
+void Scene::SetBatchedTransforms(bool enable)
+{
+    // Apply the pending transforms and notifications before switching back to the immediate path
+    if (!enable)
+        UpdateTransforms();
+
+    transformHierarchy_.SetEnabled(enable);
+}
+
+void Scene::SetInterpolationDelay(float delay)
+{
+    snapshotBuffer_.SetInterpolationDelay(delay);
+    Node::MarkNetworkUpdate();
+}
+
+void Scene::SetMaxExtrapolation(float time)
+{
+    snapshotBuffer_.SetMaxExtrapolation(time);
+    Node::MarkNetworkUpdate();
+}
+
 void Scene::SetAsyncLoadingMs(int ms)
 {
     asyncLoadingMs_ = Max(ms, 1);
@@ -773,6 +833,8 @@ void Scene::Update(float timeStep)
 
     ATOMIC_PROFILE(UpdateScene);
 
+    // The server time of network snapshots advances in real time
+    float realTimeStep = timeStep;
     timeStep *= timeScale_;
 
     using namespace SceneUpdate;
@@ -787,6 +849,9 @@ void Scene::Update(float timeStep)
     // Update scene attribute animation.
     SendEvent(E_ATTRIBUTEANIMATIONUPDATE, eventData);
 
+    // Apply batched transforms so that the subsystems see the nodes moved by the logic update
+    UpdateTransforms();
+
     // Update scene subsystems. If a physics world is present, it will be updated, triggering fixed timestep logic updates
     SendEvent(E_SCENESUBSYSTEMUPDATE, eventData);
 
@@ -804,6 +869,14 @@ void Scene::Update(float timeStep)
         SendEvent(E_UPDATESMOOTHING, smoothingData_);
     }
 
+    // Update network snapshot interpolation of all replicated nodes in one pass
+    if (snapshotBuffer_.GetNumNodes())
+    {
+        ATOMIC_PROFILE(UpdateSnapshotInterpolation);
+
+        snapshotBuffer_.Update(realTimeStep, snapThreshold_);
+    }
+
     // Post-update variable timestep logic
     SendEvent(E_SCENEPOSTUPDATE, eventData);
 
@@ -843,6 +916,11 @@ void Scene::DelayedMarkedDirty(Component* component)
     delayedDirtyComponents_.Push(component);
 }
 
+void Scene::UpdateTransforms()
+{
+    transformHierarchy_.Update(this);
+}
+
 unsigned Scene::GetFreeNodeID(CreateMode mode)
 {
     if (mode == REPLICATED)
@@ -918,6 +996,7 @@ void Scene::NodeAdded(Node* node)
         oldScene->NodeRemoved(node);
 
     node->SetScene(this);
+    transformHierarchy_.MarkStructureDirty();
 
     // If the new node has an ID of zero (default), assign a replicated ID now
     unsigned id = node->GetID();
@@ -990,10 +1069,12 @@ void Scene::NodeRemoved(Node* node)
     {
         replicatedNodes_.Erase(id);
         MarkReplicationDirty(node);
+        snapshotBuffer_.RemoveNode(node);
     }
     else
         localNodes_.Erase(id);
 
+    transformHierarchy_.MarkStructureDirty();
     node->ResetScene();
 
     // Remove node from tag cache
@@ -1094,22 +1175,99 @@ String Scene::GetVarNamesAttr() const
 
 void Scene::PrepareNetworkUpdate()
 {
+    UpdateTransforms();
+
+    // Attribute getters and the connections may read world transforms in worker threads, so bring dirty ones up to date now
+    for (HashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
+    {
+        if (i->second_->IsDirty())
+            i->second_->GetWorldTransform();
+    }
+
+    prepareNodes_.Clear();
     for (HashSet<unsigned>::Iterator i = networkUpdateNodes_.Begin(); i != networkUpdateNodes_.End(); ++i)
     {
         Node* node = GetNode(*i);
         if (node)
-            node->PrepareNetworkUpdate();
+            prepareNodes_.Push(node);
     }
 
+    prepareComponents_.Clear();
     for (HashSet<unsigned>::Iterator i = networkUpdateComponents_.Begin(); i != networkUpdateComponents_.End(); ++i)
     {
         Component* component = GetComponent(*i);
         if (component)
-            component->PrepareNetworkUpdate();
+            prepareComponents_.Push(component);
     }
 
     networkUpdateNodes_.Clear();
     networkUpdateComponents_.Clear();
+
+    // Compare the attributes. Each object only writes its own network state, so this can be split to worker threads
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    unsigned numObjects = prepareNodes_.Size() + prepareComponents_.Size();
+    if (queue && queue->GetNumThreads() && numObjects >= MIN_PARALLEL_NETWORK_UPDATE)
+    {
+        ATOMIC_PROFILE(PrepareNetworkUpdateThreaded);
+
+        int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
+        unsigned nodesPerItem = Max(prepareNodes_.Size() / numWorkItems, 1U);
+        unsigned componentsPerItem = Max(prepareComponents_.Size() / numWorkItems, 1U);
+
+        PODVector<Node*>::Iterator nodeStart = prepareNodes_.Begin();
+        PODVector<Component*>::Iterator componentStart = prepareComponents_.Begin();
+        for (int i = 0; i < numWorkItems; ++i)
+        {
+            PODVector<Node*>::Iterator nodeEnd = prepareNodes_.End();
+            PODVector<Component*>::Iterator componentEnd = prepareComponents_.End();
+            if (i < numWorkItems - 1)
+            {
+                if ((unsigned)(nodeEnd - nodeStart) > nodesPerItem)
+                    nodeEnd = nodeStart + nodesPerItem;
+                if ((unsigned)(componentEnd - componentStart) > componentsPerItem)
+                    componentEnd = componentStart + componentsPerItem;
+            }
+
+            if (nodeStart != nodeEnd)
+            {
+                SharedPtr<WorkItem> item = queue->GetFreeItem();
+                item->priority_ = M_MAX_UNSIGNED;
+                item->workFunction_ = PrepareNodesNetworkUpdateWork;
+                item->aux_ = this;
+                item->start_ = &(*nodeStart);
+                item->end_ = &(*nodeEnd);
+                queue->AddWorkItem(item);
+            }
+            if (componentStart != componentEnd)
+            {
+                SharedPtr<WorkItem> item = queue->GetFreeItem();
+                item->priority_ = M_MAX_UNSIGNED;
+                item->workFunction_ = PrepareComponentsNetworkUpdateWork;
+                item->aux_ = this;
+                item->start_ = &(*componentStart);
+                item->end_ = &(*componentEnd);
+                queue->AddWorkItem(item);
+            }
+
+            nodeStart = nodeEnd;
+            componentStart = componentEnd;
+        }
+
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+    else
+    {
+        for (PODVector<Node*>::Iterator i = prepareNodes_.Begin(); i != prepareNodes_.End(); ++i)
+            (*i)->PrepareNetworkUpdate();
+        for (PODVector<Component*>::Iterator i = prepareComponents_.Begin(); i != prepareComponents_.End(); ++i)
+            (*i)->PrepareNetworkUpdate();
+    }
+
+    // Then mark the changes dirty in the replication states, which are shared between the objects of a connection
+    for (PODVector<Node*>::Iterator i = prepareNodes_.Begin(); i != prepareNodes_.End(); ++i)
+        (*i)->MarkAttributesDirty();
+    for (PODVector<Component*>::Iterator i = prepareComponents_.Begin(); i != prepareComponents_.End(); ++i)
+        (*i)->MarkAttributesDirty();
 }
 
 void Scene::CleanupConnection(Connection* connection)
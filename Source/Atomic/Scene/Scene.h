@@ -28,6 +28,8 @@
 #include "../Resource/JSONFile.h"
 #include "../Scene/Node.h"
 #include "../Scene/SceneResolver.h"
+#include "../Scene/SnapshotBuffer.h"
+#include "../Scene/TransformHierarchy.h"
 
 namespace Atomic
 {
@@ -152,6 +154,14 @@ public:
     void SetSmoothingConstant(float constant);
     /// Set network client motion smoothing snap threshold.
     void SetSnapThreshold(float threshold);
+    /// Set whether network clients display replicated nodes interpolated between timestamped snapshots. When disabled, SmoothedTransform is used.
+    void SetSnapshotInterpolation(bool enable);
+    /// Set network client snapshot interpolation delay in seconds. Should cover a few server updates plus network jitter.
+    void SetInterpolationDelay(float delay);
+    /// Set network client maximum time in seconds to extrapolate past the newest snapshot.
+    void SetMaxExtrapolation(float time);
+    /// Set whether node world transforms are updated and their listeners notified in a batched pass. Drawable bounds and rigid body positions are stale until UpdateTransforms(). Default false.
+    void SetBatchedTransforms(bool enable);
     /// Set maximum milliseconds per frame to spend on async scene loading.
     void SetAsyncLoadingMs(int ms);
     /// Add a required package file for networking. To be called on the server.
@@ -202,6 +212,24 @@ public:
     /// Return motion smoothing snap threshold.
     float GetSnapThreshold() const { return snapThreshold_; }
 
+    /// Return whether snapshot interpolation is used.
+    bool GetSnapshotInterpolation() const { return snapshotBuffer_.IsEnabled(); }
+
+    /// Return snapshot interpolation delay.
+    float GetInterpolationDelay() const { return snapshotBuffer_.GetInterpolationDelay(); }
+
+    /// Return maximum snapshot extrapolation time.
+    float GetMaxExtrapolation() const { return snapshotBuffer_.GetMaxExtrapolation(); }
+
+    /// Return network client snapshot buffer.
+    SnapshotBuffer& GetSnapshotBuffer() { return snapshotBuffer_; }
+
+    /// Return whether node world transforms are updated in a batched pass.
+    bool GetBatchedTransforms() const { return transformHierarchy_.IsEnabled(); }
+
+    /// Return batched transform hierarchy.
+    TransformHierarchy& GetTransformHierarchy() { return transformHierarchy_; }
+
     /// Return maximum milliseconds per frame to spend on async loading.
     int GetAsyncLoadingMs() const { return asyncLoadingMs_; }
 
@@ -219,6 +247,8 @@ public:
     void EndThreadedUpdate();
     /// Add a component to the delayed dirty notify queue. Is thread-safe.
     void DelayedMarkedDirty(Component* component);
+    /// Update the batched world transforms and notify their listeners.
+    void UpdateTransforms();
 
     /// Return threaded update flag.
     bool IsThreadedUpdate() const { return threadedUpdate_; }
@@ -255,6 +285,10 @@ public:
     void MarkNetworkUpdate(Component* component);
     /// Mark a node dirty in scene replication states. The node does not need to have own replication state yet.
     void MarkReplicationDirty(Node* node);
+    /// Return replicated nodes by ID.
+    const HashMap<unsigned, Node*>& GetReplicatedNodes() const { return replicatedNodes_; }
+    /// Return the mutex for modifying replication states during parallel connection updates.
+    Mutex& GetReplicationMutex() { return replicationMutex_; }
 
 private:
     /// Handle the logic update event to update the scene, if active.
@@ -300,12 +334,22 @@ private:
     HashSet<unsigned> networkUpdateNodes_;
     /// Components to check for attribute changes on the next network update.
     HashSet<unsigned> networkUpdateComponents_;
+    /// Nodes being checked for attribute changes.
+    PODVector<Node*> prepareNodes_;
+    /// Components being checked for attribute changes.
+    PODVector<Component*> prepareComponents_;
     /// Delayed dirty notification queue for components.
     PODVector<Component*> delayedDirtyComponents_;
     /// Mutex for the delayed dirty notification queue.
     Mutex sceneMutex_;
+    /// Mutex for modifying replication states from simultaneous connection updates.
+    Mutex replicationMutex_;
     /// Preallocated event data map for smoothing update events.
     VariantMap smoothingData_;
+    /// Network client transform snapshots.
+    SnapshotBuffer snapshotBuffer_;
+    /// Batched node world transforms.
+    TransformHierarchy transformHierarchy_;
     /// Next free non-local node ID.
     unsigned replicatedNodeID_;
     /// Next free non-local component ID.
@@ -23,6 +23,7 @@
 #include "../Precompiled.h"
 
 #include "../Core/Context.h"
+#include "../IO/BitStream.h"
 #include "../IO/Deserializer.h"
 #include "../IO/Log.h"
 #include "../IO/Serializer.h"
@@ -55,6 +56,425 @@ static unsigned RemapAttributeIndex(const Vector<AttributeInfo>* attributes, con
     return netAttrIndex; // Could not remap
 }
 
+static const unsigned MAX_QUANTIZED_COMPONENTS = 6;
+static const float SQRT_TWO = 1.41421356f;
+
+/// Serializer that counts the bytes written through it to another serializer.
+class CountingSerializer : public Serializer
+{
+public:
+    /// Construct with destination serializer.
+    CountingSerializer(Serializer& dest) :
+        dest_(dest),
+        size_(0)
+    {
+    }
+
+    /// Write bytes to the destination.
+    virtual unsigned Write(const void* data, unsigned size)
+    {
+        size_ += size;
+        return dest_.Write(data, size);
+    }
+
+    /// Destination serializer.
+    Serializer& dest_;
+    /// Number of bytes written.
+    unsigned size_;
+};
+
+/// Return whether an attribute is quantized and delta encoded in delta updates, or in latest data updates.
+static inline bool IsDeltaQuantized(const AttributeInfo& attr, bool latestData)
+{
+    return attr.quantization_.mode_ != QM_NONE && ((attr.mode_ & AM_LATESTDATA) != 0) == latestData;
+}
+
+/// Return number of quantized components of an attribute and their bit widths. Zero width is a variable-length signed integer.
+static unsigned GetQuantizedComponents(const AttributeQuantization& quantization, VariantType type, unsigned char* widths)
+{
+    unsigned num = 0;
+
+    switch (quantization.mode_)
+    {
+    case QM_RANGE:
+        num = type == VAR_VECTOR4 ? 4 : type == VAR_VECTOR3 ? 3 : type == VAR_VECTOR2 ? 2 : 1;
+        for (unsigned i = 0; i < num; ++i)
+            widths[i] = (unsigned char)quantization.bits_;
+        break;
+
+    case QM_QUATERNION:
+        num = 4;
+        widths[0] = 2;
+        for (unsigned i = 1; i < num; ++i)
+            widths[i] = (unsigned char)quantization.bits_;
+        break;
+
+    case QM_CELL:
+        num = 6;
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            widths[i] = 0;
+            widths[i + 3] = (unsigned char)quantization.bits_;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return num;
+}
+
+/// Quantize a value to an integer in the 0 - maxValue range.
+static inline int QuantizeUnit(float value, unsigned maxValue)
+{
+    return (int)(Clamp(value, 0.0f, 1.0f) * (float)maxValue + 0.5f);
+}
+
+/// Quantize an attribute value to integer components.
+static void QuantizeAttribute(const AttributeQuantization& quantization, const Variant& value, int* dest)
+{
+    unsigned maxValue = (1u << quantization.bits_) - 1;
+
+    switch (quantization.mode_)
+    {
+    case QM_RANGE:
+        {
+            float components[4];
+            unsigned num = 1;
+            switch (value.GetType())
+            {
+            case VAR_VECTOR2:
+                num = 2;
+                memcpy(components, value.GetVector2().Data(), num * sizeof(float));
+                break;
+
+            case VAR_VECTOR3:
+                num = 3;
+                memcpy(components, value.GetVector3().Data(), num * sizeof(float));
+                break;
+
+            case VAR_VECTOR4:
+                num = 4;
+                memcpy(components, value.GetVector4().Data(), num * sizeof(float));
+                break;
+
+            default:
+                components[0] = value.GetFloat();
+                break;
+            }
+
+            float invRange = 1.0f / (quantization.max_ - quantization.min_);
+            for (unsigned i = 0; i < num; ++i)
+                dest[i] = QuantizeUnit((components[i] - quantization.min_) * invRange, maxValue);
+        }
+        break;
+
+    case QM_QUATERNION:
+        {
+            // Send the three smallest components, which are within +-1/sqrt(2). The largest is reconstructed from them and
+            // made positive by negating the quaternion if necessary, as q and -q represent the same rotation
+            Quaternion rotation = value.GetQuaternion().Normalized();
+            const float components[4] = { rotation.w_, rotation.x_, rotation.y_, rotation.z_ };
+            unsigned largest = 0;
+            for (unsigned i = 1; i < 4; ++i)
+            {
+                if (Abs(components[i]) > Abs(components[largest]))
+                    largest = i;
+            }
+
+            float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+            dest[0] = (int)largest;
+            unsigned j = 1;
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                if (i != largest)
+                    dest[j++] = QuantizeUnit(components[i] * sign * SQRT_TWO * 0.5f + 0.5f, maxValue);
+            }
+        }
+        break;
+
+    case QM_CELL:
+        {
+            const float* components = value.GetVector3().Data();
+            float cellSize = quantization.max_;
+            for (unsigned i = 0; i < 3; ++i)
+            {
+                float cell = floorf(components[i] / cellSize);
+                dest[i] = (int)cell;
+                dest[i + 3] = QuantizeUnit(components[i] / cellSize - cell, maxValue);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/// Reconstruct an attribute value from integer components.
+static Variant DequantizeAttribute(const AttributeQuantization& quantization, VariantType type, const int* src)
+{
+    float invMaxValue = 1.0f / (float)((1u << quantization.bits_) - 1);
+
+    switch (quantization.mode_)
+    {
+    case QM_RANGE:
+        {
+            float range = quantization.max_ - quantization.min_;
+            unsigned num = type == VAR_VECTOR4 ? 4 : type == VAR_VECTOR3 ? 3 : type == VAR_VECTOR2 ? 2 : 1;
+            float components[4];
+            for (unsigned i = 0; i < num; ++i)
+                components[i] = quantization.min_ + (float)src[i] * invMaxValue * range;
+
+            switch (type)
+            {
+            case VAR_VECTOR2:
+                return Vector2(components);
+
+            case VAR_VECTOR3:
+                return Vector3(components);
+
+            case VAR_VECTOR4:
+                return Vector4(components);
+
+            default:
+                return components[0];
+            }
+        }
+
+    case QM_QUATERNION:
+        {
+            float components[4];
+            unsigned largest = (unsigned)src[0] & 3;
+            float sumSquares = 0.0f;
+            unsigned j = 1;
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                if (i != largest)
+                {
+                    components[i] = ((float)src[j++] * invMaxValue - 0.5f) * 2.0f / SQRT_TWO;
+                    sumSquares += components[i] * components[i];
+                }
+            }
+            components[largest] = sqrtf(Max(1.0f - sumSquares, 0.0f));
+
+            return Quaternion(components[0], components[1], components[2], components[3]).Normalized();
+        }
+
+    case QM_CELL:
+        {
+            float cellSize = quantization.max_;
+            return Vector3(((float)src[0] + (float)src[3] * invMaxValue) * cellSize,
+                ((float)src[1] + (float)src[4] * invMaxValue) * cellSize,
+                ((float)src[2] + (float)src[5] * invMaxValue) * cellSize);
+        }
+
+    default:
+        return Variant::EMPTY;
+    }
+}
+
+/// Write quantized components, delta encoded against the baseline if given.
+static void WriteQuantizedComponents(BitWriter& writer, const int* values, const unsigned char* widths, unsigned num,
+    const int* baseline)
+{
+    for (unsigned i = 0; i < num; ++i)
+    {
+        if (baseline)
+        {
+            int delta = values[i] - baseline[i];
+            if (!widths[i])
+                writer.WriteSignedVLE(delta);
+            else if (BitWriter::GetSignedVLESize(delta) < widths[i])
+            {
+                writer.WriteBool(true);
+                writer.WriteSignedVLE(delta);
+            }
+            else
+            {
+                writer.WriteBool(false);
+                writer.WriteBits((unsigned)values[i], widths[i]);
+            }
+        }
+        else if (widths[i])
+            writer.WriteBits((unsigned)values[i], widths[i]);
+        else
+            writer.WriteSignedVLE(values[i]);
+    }
+}
+
+/// Read quantized components, delta decoded against the baseline if given.
+static void ReadQuantizedComponents(BitReader& reader, int* values, const unsigned char* widths, unsigned num,
+    const int* baseline)
+{
+    for (unsigned i = 0; i < num; ++i)
+    {
+        if (baseline)
+        {
+            if (!widths[i] || reader.ReadBool())
+                values[i] = baseline[i] + reader.ReadSignedVLE();
+            else
+                values[i] = (int)reader.ReadBits(widths[i]);
+        }
+        else if (widths[i])
+            values[i] = (int)reader.ReadBits(widths[i]);
+        else
+            values[i] = reader.ReadSignedVLE();
+    }
+}
+
+/// Return number of delta baseline values needed for the network attributes of delta or latest data updates.
+static unsigned GetBaselineSize(const Vector<AttributeInfo>& attributes, bool latestData)
+{
+    unsigned numSlots = 0;
+    for (unsigned i = 0; i < attributes.Size(); ++i)
+    {
+        if (IsDeltaQuantized(attributes[i], latestData))
+            ++numSlots;
+    }
+    return numSlots * MAX_QUANTIZED_COMPONENTS;
+}
+
+/// Resize a delta baseline to the size needed. Return whether it still holds valid values.
+static bool ResizeBaseline(PODVector<int>& baseline, unsigned size)
+{
+    if (baseline.Size() == size)
+        return true;
+
+    baseline.Resize(size);
+    if (size)
+        memset(&baseline.Front(), 0, size * sizeof(int));
+    return false;
+}
+
+/// Write network attribute values selected by the bits. Quantized values are written first as a bit-packed block, then the
+/// rest as byte aligned variant data. Quantized values are delta encoded if a baseline is given, and stored to the optional
+/// store, which may be the same as the baseline.
+static void WriteNetworkAttributes(Serializer& dest, const Vector<AttributeInfo>& attributes, const Vector<Variant>& values,
+    const DirtyBits& attributeBits, const int* baseline, int* store, bool latestData, unsigned* attributeBitCounts)
+{
+    unsigned numAttributes = attributes.Size();
+    bool hasQuantized = false;
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        if (attributeBits.IsSet(i) && attributes[i].quantization_.mode_ != QM_NONE)
+        {
+            hasQuantized = true;
+            break;
+        }
+    }
+
+    if (hasQuantized)
+    {
+        // An absolute update resets the stored values, as the receiver does
+        if (store && !baseline)
+            memset(store, 0, GetBaselineSize(attributes, latestData) * sizeof(int));
+
+        BitWriter writer(dest);
+        writer.WriteBool(baseline != 0);
+
+        unsigned slot = 0;
+        for (unsigned i = 0; i < numAttributes; ++i)
+        {
+            const AttributeInfo& attr = attributes[i];
+            unsigned offset = IsDeltaQuantized(attr, latestData) ? slot++ * MAX_QUANTIZED_COMPONENTS : M_MAX_UNSIGNED;
+            if (!attributeBits.IsSet(i) || attr.quantization_.mode_ == QM_NONE)
+                continue;
+
+            int quantized[MAX_QUANTIZED_COMPONENTS];
+            unsigned char widths[MAX_QUANTIZED_COMPONENTS];
+            unsigned num = GetQuantizedComponents(attr.quantization_, attr.type_, widths);
+            QuantizeAttribute(attr.quantization_, values[i], quantized);
+
+            const int* slotBaseline = baseline && offset != M_MAX_UNSIGNED ? baseline + offset : 0;
+            unsigned startBits = writer.GetNumBits();
+            WriteQuantizedComponents(writer, quantized, widths, num, slotBaseline);
+            if (attributeBitCounts)
+                attributeBitCounts[i] += writer.GetNumBits() - startBits;
+            if (store && offset != M_MAX_UNSIGNED)
+                memcpy(store + offset, quantized, num * sizeof(int));
+        }
+    }
+
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        if (!attributeBits.IsSet(i) || attributes[i].quantization_.mode_ != QM_NONE)
+            continue;
+
+        if (attributeBitCounts)
+        {
+            CountingSerializer counter(dest);
+            counter.WriteVariantData(values[i]);
+            attributeBitCounts[i] += counter.size_ * 8;
+        }
+        else
+            dest.WriteVariantData(values[i]);
+    }
+}
+
+/// Read network attribute values selected by the bits, written by WriteNetworkAttributes. Values not read are left empty.
+/// Delta encoded quantized values are decoded against the baseline, and all quantized values stored to the optional store.
+/// Return false if the values are delta encoded but no baseline is given.
+static bool ReadNetworkAttributes(Deserializer& source, const Vector<AttributeInfo>& attributes, const DirtyBits& attributeBits,
+    const int* baseline, int* store, bool latestData, Vector<Variant>& values)
+{
+    unsigned numAttributes = attributes.Size();
+    values.Clear();
+    values.Resize(numAttributes);
+
+    bool hasQuantized = false;
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        if (attributeBits.IsSet(i) && attributes[i].quantization_.mode_ != QM_NONE)
+        {
+            hasQuantized = true;
+            break;
+        }
+    }
+
+    if (hasQuantized)
+    {
+        BitReader reader(source);
+        bool deltaEncoded = reader.ReadBool();
+        if (!deltaEncoded)
+        {
+            baseline = 0;
+            if (store)
+                memset(store, 0, GetBaselineSize(attributes, latestData) * sizeof(int));
+        }
+        else if (!baseline)
+            return false;
+
+        unsigned slot = 0;
+        for (unsigned i = 0; i < numAttributes; ++i)
+        {
+            const AttributeInfo& attr = attributes[i];
+            unsigned offset = IsDeltaQuantized(attr, latestData) ? slot++ * MAX_QUANTIZED_COMPONENTS : M_MAX_UNSIGNED;
+            if (!attributeBits.IsSet(i) || attr.quantization_.mode_ == QM_NONE)
+                continue;
+
+            int quantized[MAX_QUANTIZED_COMPONENTS];
+            unsigned char widths[MAX_QUANTIZED_COMPONENTS];
+            unsigned num = GetQuantizedComponents(attr.quantization_, attr.type_, widths);
+            const int* slotBaseline = baseline && offset != M_MAX_UNSIGNED ? baseline + offset : 0;
+            ReadQuantizedComponents(reader, quantized, widths, num, slotBaseline);
+            if (store && offset != M_MAX_UNSIGNED)
+                memcpy(store + offset, quantized, num * sizeof(int));
+
+            values[i] = DequantizeAttribute(attr.quantization_, attr.type_, quantized);
+        }
+    }
+
+    for (unsigned i = 0; i < numAttributes && !source.IsEof(); ++i)
+    {
+        if (attributeBits.IsSet(i) && attributes[i].quantization_.mode_ == QM_NONE)
+            values[i] = source.ReadVariant(attributes[i].type_);
+    }
+
+    return true;
+}
+
 Serializable::Serializable(Context* context) :
     Object(context),
     temporary_(false)
@@ -736,7 +1156,8 @@ void Serializable::AllocateNetworkState()
     }
 }
 
-void Serializable::WriteInitialDeltaUpdate(Serializer& dest, unsigned char timeStamp)
+void Serializable::WriteInitialDeltaUpdate(Serializer& dest, unsigned char timeStamp, PODVector<int>* baseline,
+    unsigned* attributeBitCounts)
 {
     if (!networkState_)
     {
@@ -763,14 +1184,18 @@ void Serializable::WriteInitialDeltaUpdate(Serializer& dest, unsigned char timeS
     dest.WriteUByte(timeStamp);
     dest.Write(attributeBits.data_, (numAttributes + 7) >> 3);
 
-    for (unsigned i = 0; i < numAttributes; ++i)
+    int* store = 0;
+    if (baseline)
     {
-        if (attributeBits.IsSet(i))
-            dest.WriteVariantData(networkState_->currentValues_[i]);
+        ResizeBaseline(*baseline, GetBaselineSize(*attributes, false));
+        store = baseline->Size() ? &baseline->Front() : 0;
     }
+
+    WriteNetworkAttributes(dest, *attributes, networkState_->currentValues_, attributeBits, 0, store, false, attributeBitCounts);
 }
 
-void Serializable::WriteDeltaUpdate(Serializer& dest, const DirtyBits& attributeBits, unsigned char timeStamp)
+void Serializable::WriteDeltaUpdate(Serializer& dest, const DirtyBits& attributeBits, unsigned char timeStamp,
+    PODVector<int>* baseline, unsigned* attributeBitCounts)
 {
     if (!networkState_)
     {
@@ -789,14 +1214,20 @@ void Serializable::WriteDeltaUpdate(Serializer& dest, const DirtyBits& attribute
     dest.WriteUByte(timeStamp);
     dest.Write(attributeBits.data_, (numAttributes + 7) >> 3);
 
-    for (unsigned i = 0; i < numAttributes; ++i)
+    int* store = 0;
+    bool deltaEncode = false;
+    if (baseline)
     {
-        if (attributeBits.IsSet(i))
-            dest.WriteVariantData(networkState_->currentValues_[i]);
+        deltaEncode = ResizeBaseline(*baseline, GetBaselineSize(*attributes, false));
+        store = baseline->Size() ? &baseline->Front() : 0;
     }
+
+    WriteNetworkAttributes(dest, *attributes, networkState_->currentValues_, attributeBits, deltaEncode ? store : 0, store, false,
+        attributeBitCounts);
 }
 
-void Serializable::WriteLatestDataUpdate(Serializer& dest, unsigned char timeStamp)
+void Serializable::WriteLatestDataUpdate(Serializer& dest, unsigned char timeStamp, LatestDataHistory* history,
+    unsigned* attributeBitCounts)
 {
     if (!networkState_)
     {
@@ -809,14 +1240,45 @@ void Serializable::WriteLatestDataUpdate(Serializer& dest, unsigned char timeSta
         return;
 
     unsigned numAttributes = attributes->Size();
-
-    dest.WriteUByte(timeStamp);
+    DirtyBits attributeBits;
 
     for (unsigned i = 0; i < numAttributes; ++i)
     {
         if (attributes->At(i).mode_ & AM_LATESTDATA)
-            dest.WriteVariantData(networkState_->currentValues_[i]);
+            attributeBits.Set(i);
+    }
+
+    dest.WriteUByte(timeStamp);
+
+    // Latest data may be superseded or arrive out of order, so delta encode only against an update the receiver has
+    // acknowledged, and write its age relative to this update. Zero age is an absolute update
+    unsigned short sequence = 0;
+    unsigned char baselineAge = 0;
+    const int* baseline = 0;
+    int* store = 0;
+
+    if (history)
+    {
+        unsigned baselineSize = GetBaselineSize(*attributes, true);
+        sequence = ++history->sequence_;
+        if (history->hasAck_)
+        {
+            unsigned short age = (unsigned short)(sequence - history->ackedSequence_);
+            if (age && age < LATEST_DATA_HISTORY)
+            {
+                baseline = history->Find(history->ackedSequence_, baselineSize);
+                if (baseline)
+                    baselineAge = (unsigned char)age;
+            }
+        }
+        store = history->Store(sequence, baselineSize);
     }
+
+    dest.WriteUShort(sequence);
+    dest.WriteUByte(baselineAge);
+
+    WriteNetworkAttributes(dest, *attributes, networkState_->currentValues_, attributeBits, baseline, store, true,
+        attributeBitCounts);
 }
 
 bool Serializable::ReadDeltaUpdate(Deserializer& source)
@@ -829,18 +1291,33 @@ bool Serializable::ReadDeltaUpdate(Deserializer& source)
     DirtyBits attributeBits;
     bool changed = false;
 
+    // Delta encoded attributes need the previous values stored in the network state
+    unsigned baselineSize = GetBaselineSize(*attributes, false);
+    if (!networkState_ && baselineSize)
+        AllocateNetworkState();
+
     unsigned long long interceptMask = networkState_ ? networkState_->interceptMask_ : 0;
     unsigned char timeStamp = source.ReadUByte();
     source.Read(attributeBits.data_, (numAttributes + 7) >> 3);
 
-    for (unsigned i = 0; i < numAttributes && !source.IsEof(); ++i)
+    int* baseline = 0;
+    if (baselineSize)
+    {
+        ResizeBaseline(networkState_->quantizedValues_, baselineSize);
+        baseline = &networkState_->quantizedValues_.Front();
+    }
+
+    Vector<Variant> values;
+    ReadNetworkAttributes(source, *attributes, attributeBits, baseline, baseline, false, values);
+
+    for (unsigned i = 0; i < numAttributes; ++i)
     {
-        if (attributeBits.IsSet(i))
+        if (attributeBits.IsSet(i) && !values[i].IsEmpty())
         {
             const AttributeInfo& attr = attributes->At(i);
             if (!(interceptMask & (1ULL << i)))
             {
-                OnSetAttribute(attr, source.ReadVariant(attr.type_));
+                OnSetAttribute(attr, values[i]);
                 changed = true;
             }
             else
@@ -852,7 +1329,7 @@ bool Serializable::ReadDeltaUpdate(Deserializer& source)
                 eventData[P_TIMESTAMP] = (unsigned)timeStamp;
                 eventData[P_INDEX] = RemapAttributeIndex(GetAttributes(), attr, i);
                 eventData[P_NAME] = attr.name_;
-                eventData[P_VALUE] = source.ReadVariant(attr.type_);
+                eventData[P_VALUE] = values[i];
                 SendEvent(E_INTERCEPTNETWORKUPDATE, eventData);
             }
         }
@@ -861,26 +1338,65 @@ bool Serializable::ReadDeltaUpdate(Deserializer& source)
     return changed;
 }
 
-bool Serializable::ReadLatestDataUpdate(Deserializer& source)
+bool Serializable::ReadLatestDataUpdate(Deserializer& source, unsigned* ackSequence)
 {
     const Vector<AttributeInfo>* attributes = GetNetworkAttributes();
     if (!attributes)
         return false;
 
     unsigned numAttributes = attributes->Size();
+    DirtyBits attributeBits;
     bool changed = false;
 
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        if (attributes->At(i).mode_ & AM_LATESTDATA)
+            attributeBits.Set(i);
+    }
+
+    // The received quantized values are remembered in the network state to decode the following delta encoded updates
+    unsigned baselineSize = GetBaselineSize(*attributes, true);
+    if (!networkState_ && baselineSize)
+        AllocateNetworkState();
+
     unsigned long long interceptMask = networkState_ ? networkState_->interceptMask_ : 0;
     unsigned char timeStamp = source.ReadUByte();
+    unsigned short sequence = source.ReadUShort();
+    unsigned char baselineAge = source.ReadUByte();
 
-    for (unsigned i = 0; i < numAttributes && !source.IsEof(); ++i)
+    const int* baseline = 0;
+    int* store = 0;
+    if (baselineSize)
     {
-        const AttributeInfo& attr = attributes->At(i);
-        if (attr.mode_ & AM_LATESTDATA)
+        LatestDataHistory& history = networkState_->latestData_;
+        if (baselineAge)
+        {
+            baseline = history.Find((unsigned short)(sequence - baselineAge), baselineSize);
+            if (!baseline)
+            {
+                ATOMIC_LOGWARNING("Latest data update of " + GetTypeName() + " refers to a forgotten update, skipping");
+                return false;
+            }
+        }
+        store = history.Store(sequence, baselineSize);
+    }
+
+    Vector<Variant> values;
+    if (!ReadNetworkAttributes(source, *attributes, attributeBits, baseline, store, true, values))
+        return false;
+
+    // Acknowledge only updates that are remembered, so that the sender can use them as a baseline
+    if (ackSequence && store)
+        *ackSequence = sequence;
+
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        if (attributeBits.IsSet(i) && !values[i].IsEmpty())
         {
+            const AttributeInfo& attr = attributes->At(i);
             if (!(interceptMask & (1ULL << i)))
             {
-                OnSetAttribute(attr, source.ReadVariant(attr.type_));
+                OnSetAttribute(attr, values[i]);
                 changed = true;
             }
             else
@@ -892,7 +1408,7 @@ bool Serializable::ReadLatestDataUpdate(Deserializer& source)
                 eventData[P_TIMESTAMP] = (unsigned)timeStamp;
                 eventData[P_INDEX] = RemapAttributeIndex(GetAttributes(), attr, i);
                 eventData[P_NAME] = attr.name_;
-                eventData[P_VALUE] = source.ReadVariant(attr.type_);
+                eventData[P_VALUE] = values[i];
                 SendEvent(E_INTERCEPTNETWORKUPDATE, eventData);
             }
         }
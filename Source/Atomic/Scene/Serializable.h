@@ -37,6 +37,7 @@ class XMLElement;
 class JSONValue;
 
 struct DirtyBits;
+struct LatestDataHistory;
 struct NetworkState;
 struct ReplicationState;
 
@@ -95,16 +96,17 @@ public:
     void SetInterceptNetworkUpdate(const String& attributeName, bool enable);
     /// Allocate network attribute state.
     void AllocateNetworkState();
-    /// Write initial delta network update.
-    void WriteInitialDeltaUpdate(Serializer& dest, unsigned char timeStamp);
-    /// Write a delta network update according to dirty attribute bits.
-    void WriteDeltaUpdate(Serializer& dest, const DirtyBits& attributeBits, unsigned char timeStamp);
-    /// Write a latest data network update.
-    void WriteLatestDataUpdate(Serializer& dest, unsigned char timeStamp);
-    /// Read and apply a network delta update. Return true if attributes were changed.
+    /// Write initial delta network update. Quantized values are stored to the optional delta baseline, and bits written per attribute are added to the optional counters.
+    void WriteInitialDeltaUpdate(Serializer& dest, unsigned char timeStamp, PODVector<int>* baseline = 0, unsigned* attributeBitCounts = 0);
+    /// Write a delta network update according to dirty attribute bits. Quantized values are delta encoded against the optional baseline, which is then updated.
+    void WriteDeltaUpdate(Serializer& dest, const DirtyBits& attributeBits, unsigned char timeStamp, PODVector<int>* baseline = 0,
+        unsigned* attributeBitCounts = 0);
+    /// Write a latest data network update. Quantized values are delta encoded against the newest acknowledged update in the optional history.
+    void WriteLatestDataUpdate(Serializer& dest, unsigned char timeStamp, LatestDataHistory* history = 0, unsigned* attributeBitCounts = 0);
+    /// Read and apply a network delta update, which may be delta encoded against the previous one. Return true if attributes were changed.
     bool ReadDeltaUpdate(Deserializer& source);
-    /// Read and apply a network latest data update. Return true if attributes were changed.
-    bool ReadLatestDataUpdate(Deserializer& source);
+    /// Read and apply a network latest data update. The sequence number to acknowledge to the sender is written to the optional pointer. Return true if attributes were changed.
+    bool ReadLatestDataUpdate(Deserializer& source, unsigned* ackSequence = 0);
 
     /// Return attribute value by index. Return empty if illegal index.
     Variant GetAttribute(unsigned index) const;
@@ -365,6 +367,8 @@ public:
 #define ATOMIC_MIXED_ACCESSOR_ATTRIBUTE_FREE(name, getFunction, setFunction, typeName, defaultValue, mode) context->RegisterAttribute<ClassName>(Atomic::AttributeInfo(Atomic::GetVariantType<typeName >(), name, new Atomic::AttributeAccessorFreeImpl<ClassName, typeName, Atomic::MixedAttributeTrait<typeName > >(getFunction, setFunction), defaultValue, mode))
 /// Update the default value of an already registered attribute.
 #define ATOMIC_UPDATE_ATTRIBUTE_DEFAULT_VALUE(name, defaultValue) context->UpdateAttributeDefaultValue<ClassName>(name, defaultValue)
+/// Set the network replication quantization hint of an attribute.
+#define ATOMIC_ATTRIBUTE_QUANTIZATION(name, mode, min, max, bits) context->SetAttributeQuantization<ClassName>(name, Atomic::AttributeQuantization(mode, min, max, bits))
 /// Define a variant structure attribute that uses get and set functions.
 #define ATOMIC_ACCESSOR_VARIANT_VECTOR_STRUCTURE_ATTRIBUTE(name, getFunction, setFunction, typeName, defaultValue, variantStructureElementNames, mode) context->RegisterAttribute<ClassName>(Atomic::AttributeInfo(Atomic::GetVariantType<typeName >(), name, new Atomic::AttributeAccessorImpl<ClassName, typeName, Atomic::AttributeTrait<typeName > >(&ClassName::getFunction, &ClassName::setFunction), defaultValue, variantStructureElementNames, mode))
 /// Define a variant structure attribute that uses get and set functions, where the get function returns by value, but the set function uses a reference.
@@ -0,0 +1,394 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Scene/Node.h"
+#include "../Scene/SnapshotBuffer.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+static const float DEFAULT_INTERPOLATION_DELAY = 0.1f;
+static const float DEFAULT_MAX_EXTRAPOLATION = 0.25f;
+static const float DEFAULT_TICK_INTERVAL = 1.0f / 30.0f;
+/// Fraction of the difference to the server time of a newly received tick to correct the estimated server time by.
+static const float SERVER_TIME_CORRECTION = 0.05f;
+/// Difference to the server time of a newly received tick at which the estimated server time is reset.
+static const float SERVER_TIME_RESET_THRESHOLD = 1.0f;
+
+SnapshotBuffer::SnapshotBuffer() :
+    latestTick_(0),
+    receiveTime_(0.0f),
+    serverTime_(0.0f),
+    interpolationDelay_(DEFAULT_INTERPOLATION_DELAY),
+    maxExtrapolation_(DEFAULT_MAX_EXTRAPOLATION),
+    tickInterval_(DEFAULT_TICK_INTERVAL),
+    enabled_(true),
+    receiving_(false),
+    hasServerTime_(false)
+{
+}
+
+void SnapshotBuffer::SetEnabled(bool enable)
+{
+    if (enable != enabled_)
+    {
+        enabled_ = enable;
+        Clear();
+    }
+}
+
+void SnapshotBuffer::SetInterpolationDelay(float delay)
+{
+    interpolationDelay_ = Max(delay, 0.0f);
+}
+
+void SnapshotBuffer::SetMaxExtrapolation(float time)
+{
+    maxExtrapolation_ = Max(time, 0.0f);
+}
+
+void SnapshotBuffer::SetTickInterval(float interval)
+{
+    tickInterval_ = Max(interval, M_EPSILON);
+}
+
+void SnapshotBuffer::BeginReceive(unsigned short tick)
+{
+    if (!enabled_)
+        return;
+
+    // The tick wraps around, so take it relative to the newest tick
+    int unwrappedTick = tick;
+    if (hasServerTime_)
+        unwrappedTick = latestTick_ + (short)(tick - (unsigned short)latestTick_);
+
+    receiveTime_ = (float)unwrappedTick * tickInterval_;
+
+    if (!hasServerTime_ || Abs(receiveTime_ - serverTime_) > SERVER_TIME_RESET_THRESHOLD)
+    {
+        // The buffered snapshot times are relative to the old server time, so forget them. The nodes hold their current
+        // transform until new snapshots arrive
+        for (unsigned slot = 0; slot < numSnapshots_.Size(); ++slot)
+        {
+            numSnapshots_[slot] = 0;
+            idle_[slot] = 0;
+        }
+
+        serverTime_ = receiveTime_;
+        latestTick_ = unwrappedTick;
+        hasServerTime_ = true;
+    }
+    else if (unwrappedTick > latestTick_)
+    {
+        // Correct the estimated server time slowly towards the arrival of new ticks, so that network jitter averages out
+        serverTime_ += (receiveTime_ - serverTime_) * SERVER_TIME_CORRECTION;
+        latestTick_ = unwrappedTick;
+    }
+
+    receiving_ = true;
+}
+
+void SnapshotBuffer::EndReceive()
+{
+    receiving_ = false;
+}
+
+bool SnapshotBuffer::SetPosition(Node* node, const Vector3& position)
+{
+    if (!receiving_)
+        return false;
+
+    unsigned index;
+    if (GetReceiveSnapshot(GetSlot(node), index))
+        positions_[index] = position;
+    return true;
+}
+
+bool SnapshotBuffer::SetRotation(Node* node, const Quaternion& rotation)
+{
+    if (!receiving_)
+        return false;
+
+    unsigned index;
+    if (GetReceiveSnapshot(GetSlot(node), index))
+        rotations_[index] = rotation;
+    return true;
+}
+
+void SnapshotBuffer::SetInterpolated(Node* node, bool enable)
+{
+    if (node)
+        interpolated_[GetSlot(node)] = enable ? 1 : 0;
+}
+
+void SnapshotBuffer::Snap(Node* node)
+{
+    HashMap<Node*, unsigned>::ConstIterator i = slots_.Find(node);
+    if (i == slots_.End())
+        return;
+
+    unsigned slot = i->second_;
+    unsigned count = numSnapshots_[slot];
+    if (!count)
+        return;
+
+    DropSnapshots(slot, count - 1);
+    unsigned base = slot * MAX_NODE_SNAPSHOTS;
+    node->SetTransform(positions_[base], rotations_[base]);
+    idle_[slot] = 1;
+}
+
+void SnapshotBuffer::RemoveNode(Node* node)
+{
+    HashMap<Node*, unsigned>::Iterator i = slots_.Find(node);
+    if (i == slots_.End())
+        return;
+
+    unsigned slot = i->second_;
+    nodes_[slot] = 0;
+    numSnapshots_[slot] = 0;
+    freeSlots_.Push(slot);
+    slots_.Erase(i);
+}
+
+void SnapshotBuffer::Clear()
+{
+    nodes_.Clear();
+    numSnapshots_.Clear();
+    interpolated_.Clear();
+    idle_.Clear();
+    times_.Clear();
+    positions_.Clear();
+    rotations_.Clear();
+    slots_.Clear();
+    freeSlots_.Clear();
+    latestTick_ = 0;
+    serverTime_ = 0.0f;
+    receiving_ = false;
+    hasServerTime_ = false;
+}
+
+void SnapshotBuffer::Update(float timeStep, float snapThreshold)
+{
+    if (!hasServerTime_)
+        return;
+
+    serverTime_ += timeStep;
+    float renderTime = serverTime_ - interpolationDelay_;
+    float squaredSnapThreshold = snapThreshold * snapThreshold;
+
+    for (unsigned slot = 0; slot < nodes_.Size(); ++slot)
+    {
+        Node* node = nodes_[slot];
+        unsigned count = numSnapshots_[slot];
+        if (!node || !count || idle_[slot] || !interpolated_[slot])
+            continue;
+
+        unsigned base = slot * MAX_NODE_SNAPSHOTS;
+        const float* times = &times_[base];
+        const Vector3* positions = &positions_[base];
+        const Quaternion* rotations = &rotations_[base];
+
+        unsigned next = 0;
+        while (next < count && times[next] <= renderTime)
+            ++next;
+
+        Vector3 position;
+        Quaternion rotation;
+
+        if (!next)
+        {
+            // Render time is before the oldest snapshot, hold it
+            position = positions[0];
+            rotation = rotations[0];
+        }
+        else if (next < count)
+        {
+            unsigned prev = next - 1;
+            if ((positions[next] - positions[prev]).LengthSquared() > squaredSnapThreshold)
+            {
+                // Do not interpolate across a teleport
+                position = positions[prev];
+                rotation = rotations[prev];
+            }
+            else
+            {
+                float t = (renderTime - times[prev]) / (times[next] - times[prev]);
+                position = positions[prev].Lerp(positions[next], t);
+                rotation = rotations[prev].Slerp(rotations[next], t);
+            }
+
+            // The snapshots before the previous one are no longer needed
+            DropSnapshots(slot, prev);
+        }
+        else
+        {
+            // Render time is past the newest snapshot: extrapolate along the last snapshot interval for a limited time,
+            // then hold until the next snapshot arrives
+            unsigned last = count - 1;
+            float extrapolation = renderTime - times[last];
+            position = positions[last];
+            rotation = rotations[last];
+
+            if (last && (positions[last] - positions[last - 1]).LengthSquared() <= squaredSnapThreshold)
+            {
+                float interval = times[last] - times[last - 1];
+                float t = 1.0f + Min(extrapolation, maxExtrapolation_) / interval;
+                position = positions[last - 1].Lerp(positions[last], t);
+                rotation = rotations[last - 1].Nlerp(rotations[last], t, true);
+            }
+
+            if (extrapolation >= maxExtrapolation_)
+                idle_[slot] = 1;
+
+            // Keep the last two snapshots for extrapolation
+            if (count > 2)
+                DropSnapshots(slot, count - 2);
+        }
+
+        node->SetTransform(position, rotation);
+    }
+}
+
+bool SnapshotBuffer::GetLatest(Node* node, Vector3& position, Quaternion& rotation) const
+{
+    HashMap<Node*, unsigned>::ConstIterator i = slots_.Find(node);
+    if (i == slots_.End() || !numSnapshots_[i->second_])
+        return false;
+
+    unsigned index = i->second_ * MAX_NODE_SNAPSHOTS + numSnapshots_[i->second_] - 1;
+    position = positions_[index];
+    rotation = rotations_[index];
+    return true;
+}
+
+unsigned SnapshotBuffer::GetSlot(Node* node)
+{
+    HashMap<Node*, unsigned>::ConstIterator i = slots_.Find(node);
+    if (i != slots_.End())
+        return i->second_;
+
+    unsigned slot;
+    if (freeSlots_.Size())
+    {
+        slot = freeSlots_.Back();
+        freeSlots_.Pop();
+    }
+    else
+    {
+        slot = nodes_.Size();
+        nodes_.Push(0);
+        numSnapshots_.Push(0);
+        interpolated_.Push(1);
+        idle_.Push(0);
+        times_.Resize(times_.Size() + MAX_NODE_SNAPSHOTS);
+        positions_.Resize(positions_.Size() + MAX_NODE_SNAPSHOTS);
+        rotations_.Resize(rotations_.Size() + MAX_NODE_SNAPSHOTS);
+    }
+
+    nodes_[slot] = node;
+    numSnapshots_[slot] = 0;
+    interpolated_[slot] = 1;
+    idle_[slot] = 0;
+    slots_[node] = slot;
+    return slot;
+}
+
+bool SnapshotBuffer::GetReceiveSnapshot(unsigned slot, unsigned& index)
+{
+    unsigned base = slot * MAX_NODE_SNAPSHOTS;
+    unsigned count = numSnapshots_[slot];
+
+    // Find the position by time from the newest snapshot, as snapshots mostly arrive in order. Position and rotation of
+    // the same update go to the same snapshot
+    unsigned i = count;
+    while (i && times_[base + i - 1] > receiveTime_)
+        --i;
+    if (i && times_[base + i - 1] == receiveTime_)
+    {
+        index = base + i - 1;
+        return true;
+    }
+
+    if (count == MAX_NODE_SNAPSHOTS)
+    {
+        // Make room by forgetting the oldest snapshot, unless the new one would be older still
+        if (!i)
+            return false;
+        DropSnapshots(slot, 1);
+        --i;
+    }
+
+    count = numSnapshots_[slot];
+    for (unsigned j = count; j > i; --j)
+    {
+        times_[base + j] = times_[base + j - 1];
+        positions_[base + j] = positions_[base + j - 1];
+        rotations_[base + j] = rotations_[base + j - 1];
+    }
+    ++numSnapshots_[slot];
+
+    // Start from the transform of the previous snapshot, as the update may contain only position or rotation
+    index = base + i;
+    times_[index] = receiveTime_;
+    if (i)
+    {
+        positions_[index] = positions_[index - 1];
+        rotations_[index] = rotations_[index - 1];
+    }
+    else if (i < count)
+    {
+        positions_[index] = positions_[index + 1];
+        rotations_[index] = rotations_[index + 1];
+    }
+    else
+    {
+        positions_[index] = nodes_[slot]->GetPosition();
+        rotations_[index] = nodes_[slot]->GetRotation();
+    }
+
+    idle_[slot] = 0;
+    return true;
+}
+
+void SnapshotBuffer::DropSnapshots(unsigned slot, unsigned num)
+{
+    if (!num)
+        return;
+
+    unsigned base = slot * MAX_NODE_SNAPSHOTS;
+    unsigned count = numSnapshots_[slot] - num;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        times_[base + i] = times_[base + i + num];
+        positions_[base + i] = positions_[base + i + num];
+        rotations_[base + i] = rotations_[base + i + num];
+    }
+    numSnapshots_[slot] = count;
+}
+
+}
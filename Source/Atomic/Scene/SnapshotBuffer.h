@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Math/Quaternion.h"
+
+namespace Atomic
+{
+
+class Node;
+
+/// Maximum number of snapshots buffered per node.
+static const unsigned MAX_NODE_SNAPSHOTS = 16;
+
+/// Client-side buffer of timestamped network transform snapshots of the replicated nodes. Nodes are displayed interpolated
+/// between the snapshots at a render delay behind the estimated server time, and extrapolated for a limited time if the
+/// snapshots run out. The snapshots are stored in flat arrays and all nodes are updated in one pass per frame.
+class ATOMIC_API SnapshotBuffer
+{
+public:
+    /// Construct.
+    SnapshotBuffer();
+
+    /// Set enabled. When disabled, network transforms are applied immediately or through SmoothedTransform.
+    void SetEnabled(bool enable);
+    /// Set render delay behind the estimated server time in seconds.
+    void SetInterpolationDelay(float delay);
+    /// Set maximum time in seconds to extrapolate past the newest snapshot.
+    void SetMaxExtrapolation(float time);
+    /// Set server network update interval in seconds, used to convert the server ticks to time.
+    void SetTickInterval(float interval);
+    /// Begin receiving a node's network update with the server tick it was sent on.
+    void BeginReceive(unsigned short tick);
+    /// End receiving a node's network update.
+    void EndReceive();
+    /// Store a received network position. Return false if not receiving, in which case the position should be applied directly.
+    bool SetPosition(Node* node, const Vector3& position);
+    /// Store a received network rotation. Return false if not receiving, in which case the rotation should be applied directly.
+    bool SetRotation(Node* node, const Quaternion& rotation);
+    /// Set whether a node is interpolated. A client-predicted node should not be; its snapshots are still buffered.
+    void SetInterpolated(Node* node, bool enable);
+    /// Apply the newest snapshot to a node immediately and forget the older ones.
+    void Snap(Node* node);
+    /// Forget a node.
+    void RemoveNode(Node* node);
+    /// Forget all nodes and the server time.
+    void Clear();
+    /// Advance the estimated server time and update all interpolated nodes.
+    void Update(float timeStep, float snapThreshold);
+
+    /// Return whether enabled.
+    bool IsEnabled() const { return enabled_; }
+
+    /// Return render delay.
+    float GetInterpolationDelay() const { return interpolationDelay_; }
+
+    /// Return maximum extrapolation time.
+    float GetMaxExtrapolation() const { return maxExtrapolation_; }
+
+    /// Return server network update interval.
+    float GetTickInterval() const { return tickInterval_; }
+
+    /// Return estimated server time.
+    float GetServerTime() const { return serverTime_; }
+
+    /// Return the newest snapshot of a node. Return false if the node has none.
+    bool GetLatest(Node* node, Vector3& position, Quaternion& rotation) const;
+    /// Return number of buffered nodes.
+    unsigned GetNumNodes() const { return slots_.Size(); }
+
+private:
+    /// Return the slot of a node, allocating if necessary.
+    unsigned GetSlot(Node* node);
+    /// Return the index of the snapshot being received in a slot, inserting it if necessary. Return false if it is too old.
+    bool GetReceiveSnapshot(unsigned slot, unsigned& index);
+    /// Forget the oldest snapshots of a slot.
+    void DropSnapshots(unsigned slot, unsigned num);
+
+    /// Nodes by slot. Null for free slots.
+    PODVector<Node*> nodes_;
+    /// Number of snapshots by slot.
+    PODVector<unsigned> numSnapshots_;
+    /// Interpolated (non-predicted) flag by slot.
+    PODVector<unsigned char> interpolated_;
+    /// Interpolation finished until the next snapshot flag by slot.
+    PODVector<unsigned char> idle_;
+    /// Snapshot server times, MAX_NODE_SNAPSHOTS per slot from oldest to newest.
+    PODVector<float> times_;
+    /// Snapshot positions.
+    PODVector<Vector3> positions_;
+    /// Snapshot rotations.
+    PODVector<Quaternion> rotations_;
+    /// Slots by node.
+    HashMap<Node*, unsigned> slots_;
+    /// Free slots.
+    PODVector<unsigned> freeSlots_;
+    /// Newest server tick received, unwrapped.
+    int latestTick_;
+    /// Server time of the snapshot being received.
+    float receiveTime_;
+    /// Estimated current server time.
+    float serverTime_;
+    /// Render delay.
+    float interpolationDelay_;
+    /// Maximum extrapolation time.
+    float maxExtrapolation_;
+    /// Server network update interval.
+    float tickInterval_;
+    /// Enabled flag.
+    bool enabled_;
+    /// Receiving a network update flag.
+    bool receiving_;
+    /// Server time received flag.
+    bool hasServerTime_;
+};
+
+}
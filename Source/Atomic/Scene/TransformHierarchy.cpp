@@ -0,0 +1,338 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
+#include "../Scene/Scene.h"
+#include "../Scene/TransformHierarchy.h"
+
+#include "../DebugNew.h"
+
+namespace Atomic
+{
+
+/// Minimum number of nodes in a dirty subtree to update it in worker threads.
+static const unsigned MIN_PARALLEL_TRANSFORMS = 1024;
+
+static void UpdateTransformsWork(const WorkItem* item, unsigned threadIndex)
+{
+    TransformHierarchy* hierarchy = reinterpret_cast<TransformHierarchy*>(item->aux_);
+    hierarchy->UpdateRange((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+TransformHierarchy::TransformHierarchy() :
+    workQueue_(0),
+    enabled_(false),
+    structureDirty_(true),
+    applyingTransforms_(false),
+    notifyingApplied_(false)
+{
+}
+
+void TransformHierarchy::SetEnabled(bool enable)
+{
+    if (enable != enabled_)
+    {
+        enabled_ = enable;
+        Clear();
+
+        // The structure is not tracked while disabled
+        structureDirty_ = true;
+    }
+}
+
+void TransformHierarchy::MarkDirty(Node* node)
+{
+    // A dirty node always has a dirty subtree, see Node::MarkDirty()
+    if (!node || node->dirty_)
+        return;
+
+    // The subtrees of the nodes below are dirty already, so they are not listed separately
+    dirtyRoots_.Push(WeakPtr<Node>(node));
+    markStack_.Push(node);
+
+    while (markStack_.Size())
+    {
+        Node* current = markStack_.Back();
+        markStack_.Pop();
+        if (current->dirty_)
+            continue;
+        current->dirty_ = true;
+
+        // Queue the listeners only once, no matter how many times the node moves before the update. Remember whether
+        // physics moved it, so that the rigid bodies do not feed their own transforms back. Any other move clears that
+        if (!current->listeners_.Empty())
+        {
+            if (!current->transformNotifyPending_)
+            {
+                current->transformNotifyPending_ = true;
+                current->transformNotifyApplied_ = applyingTransforms_;
+                pendingListeners_.Push(WeakPtr<Node>(current));
+            }
+            else if (!applyingTransforms_)
+                current->transformNotifyApplied_ = false;
+        }
+
+        for (Vector<SharedPtr<Node> >::ConstIterator i = current->children_.Begin(); i != current->children_.End(); ++i)
+            markStack_.Push(*i);
+    }
+}
+
+void TransformHierarchy::Clear()
+{
+    for (unsigned i = 0; i < pendingListeners_.Size(); ++i)
+    {
+        Node* node = pendingListeners_[i];
+        if (node)
+            node->transformNotifyPending_ = false;
+    }
+
+    dirtyRoots_.Clear();
+    pendingListeners_.Clear();
+}
+
+void TransformHierarchy::Update(Scene* scene)
+{
+    if (!enabled_ || !scene || (dirtyRoots_.Empty() && pendingListeners_.Empty()))
+        return;
+
+    ATOMIC_PROFILE(UpdateTransforms);
+
+    if (structureDirty_)
+        Rebuild(scene);
+
+    // Find the node indices of the dirty roots. Nodes marked dirty from worker threads during a threaded update are not
+    // listed, they update on demand as usual. A dirty scene dirties all nodes
+    bool allDirty = false;
+    rootIndices_.Clear();
+    for (unsigned i = 0; i < dirtyRoots_.Size(); ++i)
+    {
+        Node* root = dirtyRoots_[i];
+        if (!root)
+            continue;
+        if (root == scene)
+        {
+            allDirty = true;
+            break;
+        }
+
+        unsigned index = root->transformIndex_;
+        if (index < nodes_.Size() && nodes_[index] == root)
+            rootIndices_.Push(index);
+    }
+
+    dirtyRoots_.Clear();
+
+    workQueue_ = scene->GetSubsystem<WorkQueue>();
+    if (allDirty)
+    {
+        scene->GetWorldTransform();
+        SplitSubtrees(0, nodes_.Size(), MIN_PARALLEL_TRANSFORMS);
+    }
+    else
+    {
+        // Subtree ranges are either nested or disjoint, so in index order a root inside the previous range is covered by it
+        Sort(rootIndices_.Begin(), rootIndices_.End());
+        unsigned coveredEnd = 0;
+        for (PODVector<unsigned>::ConstIterator i = rootIndices_.Begin(); i != rootIndices_.End(); ++i)
+        {
+            if (*i < coveredEnd)
+                continue;
+            UpdateSubtree(*i);
+            coveredEnd = *i + subtreeSizes_[*i];
+        }
+    }
+
+    if (workQueue_)
+        workQueue_->Complete(M_MAX_UNSIGNED);
+    workQueue_ = 0;
+
+    // Notify the listeners now that the world transforms are up to date. A listener may move nodes again, which
+    // appends to the queue, so iterate by index
+    for (unsigned i = 0; i < pendingListeners_.Size(); ++i)
+    {
+        Node* node = pendingListeners_[i];
+        if (node)
+        {
+            node->transformNotifyPending_ = false;
+            notifyingApplied_ = node->transformNotifyApplied_;
+            node->NotifyListeners();
+        }
+    }
+
+    notifyingApplied_ = false;
+
+    pendingListeners_.Clear();
+}
+
+void TransformHierarchy::UpdateRange(unsigned begin, unsigned end)
+{
+    // Gather the local transforms first, then compose the world transforms. In pre-order a parent always precedes its
+    // children, so it is either up to date before the range or composed earlier in it
+    for (unsigned i = begin; i < end; ++i)
+    {
+        const Node* node = nodes_[i];
+        localTransforms_[i] = Matrix3x4(node->position_, node->rotation_, node->scale_);
+    }
+
+    for (unsigned i = begin; i < end; ++i)
+    {
+        Node* node = nodes_[i];
+        unsigned parent = parents_[i];
+        if (parent == M_MAX_UNSIGNED)
+        {
+            worldTransforms_[i] = localTransforms_[i];
+            worldRotations_[i] = node->rotation_;
+        }
+        else
+        {
+            worldTransforms_[i] = worldTransforms_[parent] * localTransforms_[i];
+            worldRotations_[i] = worldRotations_[parent] * node->rotation_;
+        }
+
+        node->worldTransform_ = worldTransforms_[i];
+        node->worldRotation_ = worldRotations_[i];
+        node->dirty_ = false;
+    }
+}
+
+void TransformHierarchy::Rebuild(Scene* scene)
+{
+    ATOMIC_PROFILE(RebuildTransformHierarchy);
+
+    nodes_.Clear();
+    parents_.Clear();
+
+    // Depth-first in child order, pushing the children in reverse so that they are popped in order
+    markStack_.Clear();
+    const Vector<SharedPtr<Node> >& sceneChildren = scene->children_;
+    for (unsigned i = sceneChildren.Size(); i > 0; --i)
+        markStack_.Push(sceneChildren[i - 1]);
+
+    while (markStack_.Size())
+    {
+        Node* node = markStack_.Back();
+        markStack_.Pop();
+
+        node->transformIndex_ = nodes_.Size();
+        nodes_.Push(node);
+        parents_.Push(node->parent_ == scene ? M_MAX_UNSIGNED : node->parent_->transformIndex_);
+
+        const Vector<SharedPtr<Node> >& children = node->children_;
+        for (unsigned i = children.Size(); i > 0; --i)
+            markStack_.Push(children[i - 1]);
+    }
+
+    // The children follow their parent, so accumulating the subtree sizes backward finishes each child before its parent
+    unsigned numNodes = nodes_.Size();
+    subtreeSizes_.Resize(numNodes);
+    for (unsigned i = 0; i < numNodes; ++i)
+        subtreeSizes_[i] = 1;
+    for (unsigned i = numNodes; i > 0; --i)
+    {
+        if (parents_[i - 1] != M_MAX_UNSIGNED)
+            subtreeSizes_[parents_[i - 1]] += subtreeSizes_[i - 1];
+    }
+
+    localTransforms_.Resize(numNodes);
+    worldTransforms_.Resize(numNodes);
+    worldRotations_.Resize(numNodes);
+
+    structureDirty_ = false;
+}
+
+void TransformHierarchy::UpdateSubtree(unsigned root)
+{
+    // The parent of the root is outside the range and may be dirty or stale in the arrays, so get it from the node
+    unsigned parent = parents_[root];
+    if (parent != M_MAX_UNSIGNED)
+    {
+        Node* parentNode = nodes_[parent];
+        worldTransforms_[parent] = parentNode->GetWorldTransform();
+        worldRotations_[parent] = parentNode->GetWorldRotation();
+    }
+
+    UpdateRange(root, root + 1);
+
+    unsigned numThreads = workQueue_ ? workQueue_->GetNumThreads() : 0;
+    unsigned size = subtreeSizes_[root] - 1;
+    if (numThreads && size >= MIN_PARALLEL_TRANSFORMS)
+        SplitSubtrees(root + 1, root + 1 + size, Max(size / (numThreads + 1), MIN_PARALLEL_TRANSFORMS / 4));
+    else
+        UpdateRange(root + 1, root + 1 + size);
+}
+
+void TransformHierarchy::SplitSubtrees(unsigned begin, unsigned end, unsigned itemSize)
+{
+    if (!workQueue_ || !workQueue_->GetNumThreads())
+    {
+        UpdateRange(begin, end);
+        return;
+    }
+
+    // Collect runs of consecutive siblings into work items. A subtree too large for one item has its root updated here,
+    // after which its children are split in turn. All parents are up to date before the work items using them are added
+    unsigned runBegin = begin;
+    unsigned i = begin;
+    while (i < end)
+    {
+        unsigned size = subtreeSizes_[i];
+        if (size > itemSize)
+        {
+            if (runBegin < i)
+                AddWorkItem(runBegin, i);
+            UpdateRange(i, i + 1);
+            SplitSubtrees(i + 1, i + size, itemSize);
+            i += size;
+            runBegin = i;
+        }
+        else
+        {
+            if (i + size - runBegin > itemSize)
+            {
+                AddWorkItem(runBegin, i);
+                runBegin = i;
+            }
+            i += size;
+        }
+    }
+
+    if (runBegin < end)
+        AddWorkItem(runBegin, end);
+}
+
+void TransformHierarchy::AddWorkItem(unsigned begin, unsigned end)
+{
+    SharedPtr<WorkItem> item = workQueue_->GetFreeItem();
+    item->priority_ = M_MAX_UNSIGNED;
+    item->workFunction_ = UpdateTransformsWork;
+    item->aux_ = this;
+    item->start_ = (void*)(size_t)begin;
+    item->end_ = (void*)(size_t)end;
+    workQueue_->AddWorkItem(item);
+}
+
+}
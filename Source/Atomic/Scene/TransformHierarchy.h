@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/Ptr.h"
+#include "../Container/Vector.h"
+#include "../Math/Matrix3x4.h"
+#include "../Math/Quaternion.h"
+
+namespace Atomic
+{
+
+class Node;
+class Scene;
+class WorkQueue;
+
+/// Scene-wide batched update of the node world transforms. When enabled, moving a node only flags its subtree dirty and
+/// queues each transform listener node once, instead of notifying the listener components of every node on every move.
+/// The scene nodes are kept in contiguous arrays in pre-order, so that each dirty subtree is an index range after its
+/// root. The update composes the world transforms of these ranges from the arrays, splitting large ranges into child
+/// subtree ranges for worker threads, writes the results back to the nodes, and then notifies the queued listeners.
+class ATOMIC_API TransformHierarchy
+{
+public:
+    /// Construct.
+    TransformHierarchy();
+
+    /// Set enabled. When disabled, nodes calculate their world transforms on demand and notify their listeners immediately.
+    void SetEnabled(bool enable);
+    /// Mark a node and its children dirty and queue the nodes that have listeners.
+    void MarkDirty(Node* node);
+    /// Mark the node arrays to be rebuilt after nodes have been added, removed or reparented.
+    void MarkStructureDirty() { structureDirty_ = true; }
+    /// Forget the dirty subtrees and queued listeners.
+    void Clear();
+    /// Update the dirty world transforms and notify the queued listeners.
+    void Update(Scene* scene);
+    /// Update the world transforms of a node index range. The parents outside the range must be up to date. Called by worker threads.
+    void UpdateRange(unsigned begin, unsigned end);
+    /// Set whether a physics world is applying simulated transforms. Recorded with the nodes queued meanwhile.
+    void SetApplyingTransforms(bool enable) { applyingTransforms_ = enable; }
+
+    /// Return whether enabled.
+    bool IsEnabled() const { return enabled_; }
+
+    /// Return whether physics is applying transforms, or the listeners being notified were queued while it did.
+    bool IsApplyingTransforms() const { return applyingTransforms_ || notifyingApplied_; }
+
+private:
+    /// Rebuild the node arrays from the scene in pre-order.
+    void Rebuild(Scene* scene);
+    /// Update a dirty subtree, whose root may have a dirty parent outside the range.
+    void UpdateSubtree(unsigned root);
+    /// Update consecutive sibling subtrees, whose parent is up to date. Subtrees larger than the item size are split further.
+    void SplitSubtrees(unsigned begin, unsigned end, unsigned itemSize);
+    /// Update a range of whole subtrees in a worker thread.
+    void AddWorkItem(unsigned begin, unsigned end);
+
+    /// Scene nodes in pre-order, excluding the scene itself.
+    PODVector<Node*> nodes_;
+    /// Parent index of each node, or M_MAX_UNSIGNED when the parent is the scene.
+    PODVector<unsigned> parents_;
+    /// Number of nodes in the subtree of each node, including itself.
+    PODVector<unsigned> subtreeSizes_;
+    /// Local transforms, gathered from the nodes for the ranges being updated.
+    PODVector<Matrix3x4> localTransforms_;
+    /// World transforms.
+    PODVector<Matrix3x4> worldTransforms_;
+    /// World rotations.
+    PODVector<Quaternion> worldRotations_;
+    /// Roots of the subtrees marked dirty since the last update.
+    Vector<WeakPtr<Node> > dirtyRoots_;
+    /// Sorted node indices of the dirty roots during the update.
+    PODVector<unsigned> rootIndices_;
+    /// Stack for marking subtrees dirty and rebuilding the node arrays.
+    PODVector<Node*> markStack_;
+    /// Nodes whose listeners need to be notified.
+    Vector<WeakPtr<Node> > pendingListeners_;
+    /// Work queue during the update.
+    WorkQueue* workQueue_;
+    /// Enabled flag.
+    bool enabled_;
+    /// Node arrays need rebuild flag.
+    bool structureDirty_;
+    /// Physics applying transforms flag.
+    bool applyingTransforms_;
+    /// Notifying listeners queued while physics applied transforms flag.
+    bool notifyingApplied_;
+};
+
+}
@@ -25,6 +25,7 @@
 #include <Atomic/Input/InputEvents.h>
 
 #include <Atomic/Resource/ResourceCache.h>
+#include <Atomic/Graphics/Graphics.h>
 #include <Atomic/Graphics/Renderer.h>
 #include <Atomic/Graphics/Camera.h>
 
@@ -35,7 +36,8 @@ namespace AtomicPlayer
 {
 
 Player::Player(Context* context) :
-    Object(context)
+    Object(context),
+    shadersPrecached_(false)
 {
     viewport_ = new Viewport(context_);
     GetSubsystem<Renderer>()->SetViewport(0, viewport_);
@@ -73,6 +75,8 @@ Scene* Player::LoadScene(const String& filename, Camera *camera)
 
     scene->SendEvent(E_PLAYERSCENELOADBEGIN, eventData);
 
+    PrecacheShaders();
+
     if (!scene->LoadXML(*file))
     {
         eventData[PlayerSceneLoadEnd::P_SCENE] = scene;
@@ -96,6 +100,24 @@ Scene* Player::LoadScene(const String& filename, Camera *camera)
     return scene;
 }
 
+void Player::PrecacheShaders()
+{
+    if (shadersPrecached_)
+        return;
+
+    shadersPrecached_ = true;
+
+    // Compile the shader combinations listed by the shadercache tool while loading, so that they do not hitch on first use.
+    // This uses all worker threads, and on OpenGL links the programs on the main thread
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (cache->Exists("ShaderPrecache.xml"))
+    {
+        SharedPtr<File> file = cache->GetFile("ShaderPrecache.xml");
+        if (file)
+            GetSubsystem<Graphics>()->PrecacheShaders(*file);
+    }
+}
+
 void Player::SetCurrentScene(Scene* scene, Camera* camera)
 {
     Vector<SharedPtr<Scene>>::ConstIterator citr = loadedScenes_.Find(SharedPtr<Scene>(scene));
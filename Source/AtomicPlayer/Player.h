@@ -70,6 +70,9 @@ private:
 
     void HandleExitRequested(StringHash eventType, VariantMap& eventData);
 
+    /// Precache the shaders listed in ShaderPrecache.xml, on the first scene load
+    void PrecacheShaders();
+
     // Strong reference
     SharedPtr<Scene> currentScene_;
 
@@ -77,6 +80,8 @@ private:
 
     SharedPtr<Viewport> viewport_;
 
+    bool shadersPrecached_;
+
 };
 
 }
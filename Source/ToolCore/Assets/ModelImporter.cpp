@@ -66,6 +66,15 @@ void ModelImporter::SetDefaults()
     importAnimations_ = false;
     importMaterials_ = importer->GetImportMaterialsDefault();
     includeNonSkinningBones_ = importer->GetIncludeNonSkinningBones();
+    compressAnimations_ = false;
+    animationPositionError_ = 0.001f;
+    animationRotationError_ = 0.1f;
+    animationScaleError_ = 0.001f;
+    generateLods_ = false;
+    lodErrors_.Clear();
+    lodErrors_.Push(0.002f);
+    lodErrors_.Push(0.008f);
+    lodErrors_.Push(0.03f);
     animationInfo_.Clear();
 
 }
@@ -85,6 +94,9 @@ bool ModelImporter::ImportModel()
     importer->SetImportMaterials(importMaterials_);
     importer->SetIncludeNonSkinningBones(includeNonSkinningBones_);
 
+    if (generateLods_)
+        importer->SetLodErrors(lodErrors_);
+
     if (importer->Load(asset_->GetPath()))
     {
         importer->ExportModel(asset_->GetCachePath());
@@ -116,6 +128,7 @@ bool ModelImporter::ImportAnimation(const String& filename, const String& name,
     importer->SetExportAnimations(true);
     importer->SetStartTime(startTime);
     importer->SetEndTime(endTime);
+    importer->SetAnimationCompression(compressAnimations_, animationPositionError_, animationRotationError_, animationScaleError_);
 
     if (importer->Load(filename))
     {
@@ -391,6 +404,34 @@ bool ModelImporter::LoadSettingsInternal(JSONValue& jsonRoot)
 
     }
 
+    if (import.Get("compressAnimations").IsBool())
+        compressAnimations_ = import.Get("compressAnimations").GetBool();
+
+    if (import.Get("animationPositionError").IsNumber())
+        animationPositionError_ = import.Get("animationPositionError").GetFloat();
+
+    if (import.Get("animationRotationError").IsNumber())
+        animationRotationError_ = import.Get("animationRotationError").GetFloat();
+
+    if (import.Get("animationScaleError").IsNumber())
+        animationScaleError_ = import.Get("animationScaleError").GetFloat();
+
+    if (import.Get("generateLods").IsBool())
+        generateLods_ = import.Get("generateLods").GetBool();
+
+    if (import.Get("lodErrors").IsArray())
+    {
+        JSONArray lodErrors = import.Get("lodErrors").GetArray();
+
+        lodErrors_.Clear();
+
+        for (unsigned i = 0; i < lodErrors.Size(); i++)
+        {
+            if (lodErrors[i].IsNumber())
+                lodErrors_.Push(lodErrors[i].GetFloat());
+        }
+    }
+
     if (import.Get("animInfo").IsArray())
     {
         JSONArray animInfo = import.Get("animInfo").GetArray();
@@ -421,6 +462,18 @@ bool ModelImporter::SaveSettingsInternal(JSONValue& jsonRoot)
     save.Set("scale", scale_);
     save.Set("importAnimations", importAnimations_);
     save.Set("importMaterials", importMaterials_);
+    save.Set("compressAnimations", compressAnimations_);
+    save.Set("animationPositionError", animationPositionError_);
+    save.Set("animationRotationError", animationRotationError_);
+    save.Set("animationScaleError", animationScaleError_);
+    save.Set("generateLods", generateLods_);
+
+    JSONArray lodErrors;
+
+    for (unsigned i = 0; i < lodErrors_.Size(); i++)
+        lodErrors.Push(lodErrors_[i]);
+
+    save.Set("lodErrors", lodErrors);
 
     JSONArray animInfo;
 
@@ -84,6 +84,24 @@ public:
     bool GetImportMaterials() { return importMaterials_; }
     void SetImportMaterials(bool importMat) { importMaterials_ = importMat; };
 
+    /// Animation compression, errors above which keys are kept. Rotation error is in degrees
+    bool GetCompressAnimations() { return compressAnimations_; }
+    void SetCompressAnimations(bool compress) { compressAnimations_ = compress; }
+    float GetAnimationPositionError() { return animationPositionError_; }
+    void SetAnimationPositionError(float error) { animationPositionError_ = error; }
+    float GetAnimationRotationError() { return animationRotationError_; }
+    void SetAnimationRotationError(float error) { animationRotationError_ = error; }
+    float GetAnimationScaleError() { return animationScaleError_; }
+    void SetAnimationScaleError(float error) { animationScaleError_ = error; }
+
+    /// LOD generation, errors of the LOD levels relative to the model size
+    bool GetGenerateLods() { return generateLods_; }
+    void SetGenerateLods(bool generate) { generateLods_ = generate; }
+    unsigned GetNumLodErrors() { return lodErrors_.Size(); }
+    void SetNumLodErrors(unsigned num) { lodErrors_.Resize(num); }
+    float GetLodError(unsigned index) { return index < lodErrors_.Size() ? lodErrors_[index] : 0.0f; }
+    void SetLodError(unsigned index, float error) { if (index < lodErrors_.Size()) lodErrors_[index] = error; }
+
     unsigned GetAnimationCount();
     void SetAnimationCount(unsigned count);
 
@@ -113,6 +131,12 @@ protected:
     bool importAnimations_;
     bool importMaterials_;
     bool includeNonSkinningBones_;
+    bool compressAnimations_;
+    float animationPositionError_;
+    float animationRotationError_;
+    float animationScaleError_;
+    bool generateLods_;
+    PODVector<float> lodErrors_;
     Vector<SharedPtr<AnimationImportInfo>> animationInfo_;
 
     SharedPtr<Node> importNode_;
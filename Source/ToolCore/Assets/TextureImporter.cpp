@@ -25,6 +25,8 @@
 #include <Atomic/Atomic2D/Sprite2D.h>
 #include <Atomic/Atomic2D/StaticSprite2D.h>
 #include <Atomic/IO/FileSystem.h>
+#include <Atomic/IO/Log.h>
+#include <Atomic/Resource/XMLFile.h>
 
 #include <ToolCore/Import/ImportConfig.h>
 #include <Atomic/Graphics/Renderer.h>
@@ -37,7 +39,7 @@ namespace ToolCore
 {
 
     TextureImporter::TextureImporter(Context* context, Asset *asset) : AssetImporter(context, asset),
-        compressTextures_(false), compressedSize_(0)
+        compressTextures_(false), compressedSize_(0), terrainTileSize_(0)
 {
     requiresCacheFile_ = true;
 
@@ -54,6 +56,7 @@ void TextureImporter::SetDefaults()
     AssetImporter::SetDefaults();
 
     compressedSize_ = 0;
+    terrainTileSize_ = 0;
 
 }
 
@@ -103,6 +106,13 @@ bool TextureImporter::Import()
         }
     }
 
+    String tilePath = cachePath + "TerrainTiles/" + ReplaceExtension(asset_->GetRelativePath(), "");
+    if (fileSystem->DirExists(tilePath))
+        fileSystem->RemoveDir(tilePath, true);
+
+    if (terrainTileSize_ && !ImportTerrainTiles(image))
+        return false;
+
     // todo, proper proportions
     image->Resize(64, 64);
 
@@ -116,6 +126,77 @@ bool TextureImporter::Import()
     return true;
 }
 
+bool TextureImporter::ImportTerrainTiles(Image* image)
+{
+    if (image->IsCompressed() || image->GetDepth() > 1)
+    {
+        ATOMIC_LOGERRORF("TextureImporter::ImportTerrainTiles - %s is not an uncompressed 2D heightmap", asset_->GetPath().CString());
+        return false;
+    }
+
+    int tileSize = (int)terrainTileSize_;
+    if (tileSize < 4 || !IsPowerOfTwo(terrainTileSize_))
+    {
+        ATOMIC_LOGERRORF("TextureImporter::ImportTerrainTiles - tile size %d is not a power of two", tileSize);
+        return false;
+    }
+
+    AssetDatabase* db = GetSubsystem<AssetDatabase>();
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+
+    // The tile set lives in the cache, which is a resource dir, so TerrainStreamer can refer to it as
+    // TerrainTiles/<asset path without extension>/TileSet.xml
+    String tileDir = "TerrainTiles/" + ReplaceExtension(asset_->GetRelativePath(), "");
+    String tilePath = db->GetCachePath() + tileDir + "/";
+    fileSystem->CreateDirs(db->GetCachePath(), tileDir);
+
+    int width = image->GetWidth();
+    int height = image->GetHeight();
+    unsigned components = image->GetComponents();
+    int tilesX = Max((width - 1 + tileSize - 1) / tileSize, 1);
+    int tilesZ = Max((height - 1 + tileSize - 1) / tileSize, 1);
+    const unsigned char* src = image->GetData();
+
+    SharedPtr<Image> tile(new Image(context_));
+    tile->SetSize(tileSize + 1, tileSize + 1, components);
+
+    // Adjacent tiles share their edge row and column so that the tile terrains line up. The top of the image is the
+    // terrain's north edge, so tile Z coordinates count upwards from the bottom row. Tiles that extend beyond the
+    // image clamp to its edge
+    for (int tz = 0; tz < tilesZ; ++tz)
+    {
+        for (int tx = 0; tx < tilesX; ++tx)
+        {
+            unsigned char* dest = tile->GetData();
+
+            for (int y = 0; y <= tileSize; ++y)
+            {
+                int srcY = Max(height - 1 - ((tz + 1) * tileSize - y), 0);
+
+                for (int x = 0; x <= tileSize; ++x)
+                {
+                    int srcX = Min(tx * tileSize + x, width - 1);
+                    memcpy(dest, src + (srcY * width + srcX) * components, components);
+                    dest += components;
+                }
+            }
+
+            if (!tile->SavePNG(tilePath + "Tile_" + String(tx) + "_" + String(tz) + ".png"))
+                return false;
+        }
+    }
+
+    SharedPtr<XMLFile> tileSet(new XMLFile(context_));
+    XMLElement rootElem = tileSet->CreateRoot("terraintiles");
+    rootElem.SetInt("tileSize", tileSize);
+    rootElem.SetInt("tilesX", tilesX);
+    rootElem.SetInt("tilesZ", tilesZ);
+    rootElem.SetAttribute("prefix", "Tile_");
+    rootElem.SetAttribute("extension", ".png");
+
+    return tileSet->SaveFile(tilePath + "TileSet.xml");
+}
+
 void TextureImporter::ApplyProjectImportConfig()
 {
     if (ImportConfig::IsLoaded())
@@ -144,6 +225,9 @@ bool TextureImporter::LoadSettingsInternal(JSONValue& jsonRoot)
     if (import.Get("compressionSize").IsNumber())
         compressedSize_ = (CompressedFormat)import.Get("compressionSize").GetInt();
 
+    if (import.Get("terrainTileSize").IsNumber())
+        terrainTileSize_ = (unsigned)import.Get("terrainTileSize").GetInt();
+
     return true;
 }
 
@@ -154,6 +238,7 @@ bool TextureImporter::SaveSettingsInternal(JSONValue& jsonRoot)
 
     JSONValue import(JSONValue::emptyObject);
     import.Set("compressionSize", compressedSize_);
+    import.Set("terrainTileSize", terrainTileSize_);
 
     jsonRoot.Set("TextureImporter", import);
 
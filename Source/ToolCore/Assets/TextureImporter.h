@@ -24,6 +24,11 @@
 
 #include "AssetImporter.h"
 
+namespace Atomic
+{
+class Image;
+}
+
 namespace ToolCore
 {
 
@@ -44,10 +49,16 @@ public:
     void SetCompressedImageSize(unsigned int compressedSize) { compressedSize_ = compressedSize; }
     unsigned int GetCompressedImageSize() { return compressedSize_; }
 
+    /// Set heightmap quads per terrain tile side, zero disables splitting the image into TerrainStreamer tiles
+    void SetTerrainTileSize(unsigned tileSize) { terrainTileSize_ = tileSize; }
+    unsigned GetTerrainTileSize() const { return terrainTileSize_; }
+
 protected:
 
     bool Import();
     void ApplyProjectImportConfig();
+    /// Split a heightmap into overlapping terrain tiles and a tile set description in the cache
+    bool ImportTerrainTiles(Image* image);
 
     virtual bool LoadSettingsInternal(JSONValue& jsonRoot);
     virtual bool SaveSettingsInternal(JSONValue& jsonRoot);
@@ -55,6 +66,8 @@ protected:
     bool compressTextures_;
 
     unsigned int compressedSize_;
+
+    unsigned terrainTileSize_;
 };
 
 }
@@ -31,6 +31,7 @@
 #include "NETCmd.h"
 #include "ProjectCmd.h"
 #include "CacheCmd.h"
+#include "ShaderCacheCmd.h"
 
 namespace ToolCore
 {
@@ -91,6 +92,10 @@ Command* CommandParser::Parse(const Vector<String>& arguments)
             {
                 cmd = new CacheCmd(context_);
             }
+            else if (argument == "shadercache")
+            {
+                cmd = new ShaderCacheCmd(context_);
+            }
 
         }
 
@@ -0,0 +1,374 @@
+//
+// Copyright (c) 2014-2017 THUNDERBEAST GAMES LLC
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Core/StringUtils.h>
+#include <Atomic/IO/Log.h>
+#include <Atomic/IO/File.h>
+#include <Atomic/IO/FileSystem.h>
+#include <Atomic/Resource/ResourceCache.h>
+#include <Atomic/Resource/XMLFile.h>
+#include <Atomic/Graphics/Graphics.h>
+#include <Atomic/Graphics/Renderer.h>
+#include <Atomic/Graphics/Technique.h>
+
+#include "../ToolSystem.h"
+#include "../Project/Project.h"
+
+#include "ShaderCacheCmd.h"
+
+namespace ToolCore
+{
+
+// Sort the defines the same way as the shader variation lookup, so that equal combinations are written once
+static String NormalizeDefines(const String& defines)
+{
+    Vector<String> definesVec = defines.ToUpper().Split(' ');
+    Sort(definesVec.Begin(), definesVec.End());
+    return String::Joined(definesVec, " ");
+}
+
+// Return the value of a serialized component attribute, or empty if it has the default value
+static String GetComponentAttribute(const XMLElement& component, const String& name)
+{
+    XMLElement attribute = component.GetChild("attribute");
+
+    while (attribute)
+    {
+        if (attribute.GetAttribute("name") == name)
+            return attribute.GetAttribute("value");
+
+        attribute = attribute.GetNext("attribute");
+    }
+
+    return String::EMPTY;
+}
+
+ShaderCacheCmd::ShaderCacheCmd(Context* context) : Command(context)
+{
+
+}
+
+ShaderCacheCmd::~ShaderCacheCmd()
+{
+
+}
+
+bool ShaderCacheCmd::ParseInternal(const Vector<String>& arguments, unsigned startIndex, String& errorMsg)
+{
+    for (unsigned i = startIndex; i < arguments.Size(); i++)
+    {
+        if (arguments[i].Length() > 1 && arguments[i][0] == '-')
+        {
+            String argument = arguments[i].ToLower();
+
+            // eat additonal argument '-'
+            while (argument.StartsWith("-"))
+            {
+                argument.Erase(0);
+            }
+
+            String value = i + 1 < arguments.Size() ? arguments[i + 1] : String::EMPTY;
+
+            if (argument == "output")
+            {
+                if (!value.Length())
+                {
+                    errorMsg = "Unable to parse shader precache output filename";
+                    return false;
+                }
+
+                outputFile_ = value;
+                i++;
+            }
+        }
+    }
+
+    return true;
+}
+
+void ShaderCacheCmd::Run()
+{
+    ToolSystem* tsystem = GetSubsystem<ToolSystem>();
+    Project* project = tsystem->GetProject();
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+
+    String resourcePath = AddTrailingSlash(project->GetResourcePath());
+
+    if (!outputFile_.Length())
+        outputFile_ = resourcePath + "ShaderPrecache.xml";
+
+    // Only enumerate the materials, lights and geometry types that the scenes and prefabs use
+    Vector<String> sceneFiles;
+    Vector<String> prefabFiles;
+    fileSystem->ScanDir(sceneFiles, resourcePath, "*.scene", SCAN_FILES, true);
+    fileSystem->ScanDir(prefabFiles, resourcePath, "*.prefab", SCAN_FILES, true);
+    sceneFiles.Push(prefabFiles);
+
+    for (unsigned i = 0; i < sceneFiles.Size(); i++)
+        AddScene(resourcePath + sceneFiles[i]);
+
+    Vector<String> materials;
+
+    if (usedMaterials_.Size())
+    {
+        ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+        for (HashSet<String>::ConstIterator i = usedMaterials_.Begin(); i != usedMaterials_.End(); ++i)
+        {
+            String fileName = cache->GetResourceFileName(*i);
+            if (fileName.Length())
+                materials.Push(fileName);
+            else
+                ATOMIC_LOGWARNINGF("Unable to find material: %s", i->CString());
+        }
+    }
+    else
+    {
+        ATOMIC_LOGRAW("No materials referenced by scenes, enumerating every material with every light\n");
+
+        fileSystem->ScanDir(materials, resourcePath, "*.material", SCAN_FILES, true);
+        for (unsigned i = 0; i < materials.Size(); i++)
+            materials[i] = resourcePath + materials[i];
+
+        usage_.AddAll();
+    }
+
+    SharedPtr<XMLFile> xmlFile(new XMLFile(context_));
+    XMLElement root = xmlFile->CreateRoot("shaders");
+
+    for (unsigned i = 0; i < materials.Size(); i++)
+        AddMaterial(materials[i], root);
+
+    File file(context_, outputFile_, FILE_WRITE);
+
+    if (!file.IsOpen() || !xmlFile->Save(file))
+    {
+        Error(ToString("Unable to write shader precache file: %s", outputFile_.CString()));
+        return;
+    }
+
+    file.Close();
+
+    ATOMIC_LOGRAWF("Wrote %u shader combinations of %u materials to %s\n", combinations_.Size(), materials.Size(), outputFile_.CString());
+
+    // With a graphics subsystem compile the combinations now, in parallel, to fill the shader cache
+    Graphics* graphics = GetSubsystem<Graphics>();
+
+    if (graphics && graphics->IsInitialized())
+    {
+        File source(context_, outputFile_);
+        graphics->PrecacheShaders(source);
+        ATOMIC_LOGRAW("Compiled shader combinations into the shader cache\n");
+    }
+    else
+    {
+        ATOMIC_LOGRAW("No graphics subsystem, shaders will be compiled by the player in the background on first run\n");
+    }
+
+    Finished();
+}
+
+void ShaderCacheCmd::AddMaterial(const String& fileName, XMLElement& root)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    // Parse the material XML directly, as materials are not loaded when running headless
+    SharedPtr<XMLFile> material(new XMLFile(context_));
+    File file(context_, fileName);
+
+    if (!file.IsOpen() || !material->Load(file))
+    {
+        ATOMIC_LOGWARNINGF("Unable to parse material: %s", fileName.CString());
+        return;
+    }
+
+    XMLElement materialElem = material->GetRoot("material");
+    XMLElement shaderElem = materialElem.GetChild("shader");
+    String vsDefines = shaderElem ? shaderElem.GetAttribute("vsdefines") : String::EMPTY;
+    String psDefines = shaderElem ? shaderElem.GetAttribute("psdefines") : String::EMPTY;
+
+    XMLElement techniqueElem = materialElem.GetChild("technique");
+
+    while (techniqueElem)
+    {
+        SharedPtr<Technique> technique(cache->GetResource<Technique>(techniqueElem.GetAttribute("name")));
+
+        if (technique)
+        {
+            technique = technique->CloneWithDefines(vsDefines, psDefines);
+
+            PODVector<Pass*> passes = technique->GetPasses();
+
+            for (unsigned i = 0; i < passes.Size(); i++)
+            {
+                Pass* pass = passes[i];
+
+                // Shadowed variations for the default shadow quality
+                Vector<Pair<String, String> > defines;
+                Renderer::GetPassShaderCombinations(pass, "PCF_SHADOW ", usage_, defines);
+
+                for (unsigned j = 0; j < defines.Size(); j++)
+                    AddCombination(root, pass->GetVertexShader(), defines[j].first_, pass->GetPixelShader(), defines[j].second_);
+            }
+        }
+
+        techniqueElem = techniqueElem.GetNext("technique");
+    }
+}
+
+void ShaderCacheCmd::AddScene(const String& fileName)
+{
+    // Parse the scene XML directly, as the components are not registered when running headless
+    SharedPtr<XMLFile> scene(new XMLFile(context_));
+    File file(context_, fileName);
+
+    if (!file.IsOpen() || !scene->Load(file))
+    {
+        ATOMIC_LOGWARNINGF("Unable to parse scene: %s", fileName.CString());
+        return;
+    }
+
+    AddNode(scene->GetRoot());
+}
+
+void ShaderCacheCmd::AddNode(const XMLElement& node)
+{
+    XMLElement component = node.GetChild("component");
+
+    while (component)
+    {
+        AddComponent(component);
+        component = component.GetNext("component");
+    }
+
+    XMLElement child = node.GetChild("node");
+
+    while (child)
+    {
+        AddNode(child);
+        child = child.GetNext("node");
+    }
+}
+
+void ShaderCacheCmd::AddComponent(const XMLElement& component)
+{
+    String type = component.GetAttribute("type");
+    bool hasMaterial = false;
+
+    // Collect the materials of any drawable, including those of particle effects
+    XMLElement attribute = component.GetChild("attribute");
+
+    while (attribute)
+    {
+        String value = attribute.GetAttribute("value");
+
+        if (value.StartsWith("Material;"))
+        {
+            Vector<String> names = value.Split(';');
+            for (unsigned i = 1; i < names.Size(); i++)
+                usedMaterials_.Insert(names[i]);
+            hasMaterial = true;
+        }
+        else if (value.StartsWith("ParticleEffect;"))
+        {
+            AddParticleEffect(value.Substring(15));
+            hasMaterial = true;
+        }
+
+        attribute = attribute.GetNext("attribute");
+    }
+
+    if (type == "Light")
+    {
+        if (ToBool(GetComponentAttribute(component, "Per Vertex")))
+            return;
+
+        String lightType = GetComponentAttribute(component, "Light Type");
+        String specular = GetComponentAttribute(component, "Specular Intensity");
+        Vector<String> shapeTexture = GetComponentAttribute(component, "Light Shape Texture").Split(';');
+
+        usage_.AddLight(lightType == "Directional" ? LIGHT_DIRECTIONAL : (lightType == "Spot" ? LIGHT_SPOT : LIGHT_POINT),
+            shapeTexture.Size() > 1, specular.Empty() || ToFloat(specular) > 0.0f,
+            ToBool(GetComponentAttribute(component, "Cast Shadows")), ToFloat(GetComponentAttribute(component, "Normal Offset")) > 0.0f);
+    }
+    else if (type == "Zone")
+    {
+        if (ToBool(GetComponentAttribute(component, "Height Fog Mode")))
+            usage_.heightFog_ = true;
+    }
+    else if (type == "AnimatedModel")
+        usage_.AddGeometryType(GEOM_SKINNED);
+    else if (type == "BillboardSet" || type == "ParticleEmitter")
+    {
+        bool direction = GetComponentAttribute(component, "Face Camera Mode") == "Direction";
+        usage_.AddGeometryType(direction ? GEOM_DIRBILLBOARD : GEOM_BILLBOARD);
+    }
+    else if (type == "RibbonTrail")
+    {
+        bool bone = GetComponentAttribute(component, "Trail Type") == "Bone";
+        usage_.AddGeometryType(bone ? GEOM_TRAIL_BONE : GEOM_TRAIL_FACE_CAMERA);
+    }
+    else if (hasMaterial)
+    {
+        // Static geometry may be drawn instanced
+        usage_.AddGeometryType(GEOM_STATIC);
+        usage_.AddGeometryType(GEOM_INSTANCED);
+    }
+}
+
+void ShaderCacheCmd::AddParticleEffect(const String& name)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SharedPtr<XMLFile> effect(new XMLFile(context_));
+    File file(context_, cache->GetResourceFileName(name));
+
+    if (!file.IsOpen() || !effect->Load(file))
+    {
+        ATOMIC_LOGWARNINGF("Unable to parse particle effect: %s", name.CString());
+        return;
+    }
+
+    String material = effect->GetRoot().GetChild("material").GetAttribute("name");
+    if (material.Length())
+        usedMaterials_.Insert(material);
+}
+
+void ShaderCacheCmd::AddCombination(XMLElement& root, const String& vs, const String& vsDefines, const String& ps, const String& psDefines)
+{
+    String vsNormalized = NormalizeDefines(vsDefines);
+    String psNormalized = NormalizeDefines(psDefines);
+
+    String key = vs + " " + vsNormalized + " " + ps + " " + psNormalized;
+
+    if (combinations_.Contains(key))
+        return;
+
+    combinations_.Insert(key);
+
+    XMLElement shaderElem = root.CreateChild("shader");
+    shaderElem.SetAttribute("vs", vs);
+    shaderElem.SetAttribute("vsdefines", vsNormalized);
+    shaderElem.SetAttribute("ps", ps);
+    shaderElem.SetAttribute("psdefines", psNormalized);
+}
+
+}
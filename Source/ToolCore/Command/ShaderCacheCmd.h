@@ -0,0 +1,91 @@
+//
+// Copyright (c) 2014-2017 THUNDERBEAST GAMES LLC
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Atomic/Container/HashSet.h>
+#include <Atomic/Graphics/Renderer.h>
+
+#include "Command.h"
+
+using namespace Atomic;
+
+namespace Atomic
+{
+class XMLElement;
+}
+
+namespace ToolCore
+{
+
+/// Command for generating a shader precache file from the materials and lights used by the scenes of a Project
+class ShaderCacheCmd: public Command
+{
+
+    /// Example usage:
+    /// AtomicTool shadercache --project C:\Path\To\MyProject (writes Resources/ShaderPrecache.xml)
+    /// AtomicTool shadercache --output C:\Path\To\ShaderPrecache.xml --project C:\Path\To\MyProject
+
+    ATOMIC_OBJECT(ShaderCacheCmd, Command)
+
+public:
+
+    ShaderCacheCmd(Context* context);
+    virtual ~ShaderCacheCmd();
+
+    void Run();
+
+protected:
+
+    bool ParseInternal(const Vector<String>& arguments, unsigned startIndex, String& errorMsg);
+
+private:
+
+    /// Collect the materials, lights and geometry types used by a scene or prefab file
+    void AddScene(const String& fileName);
+
+    /// Collect the materials, lights and geometry types used by a scene node and its children
+    void AddNode(const XMLElement& node);
+
+    /// Collect the materials, lights and geometry types used by a component
+    void AddComponent(const XMLElement& component);
+
+    /// Collect the material of a particle effect
+    void AddParticleEffect(const String& name);
+
+    /// Add the shader combinations of a material file
+    void AddMaterial(const String& fileName, XMLElement& root);
+
+    /// Add a unique shader combination
+    void AddCombination(XMLElement& root, const String& vs, const String& vsDefines, const String& ps, const String& psDefines);
+
+    String outputFile_;
+
+    HashSet<String> combinations_;
+
+    HashSet<String> usedMaterials_;
+
+    ShaderCombinationUsage usage_;
+
+};
+
+}
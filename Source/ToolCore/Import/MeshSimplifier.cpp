@@ -0,0 +1,334 @@
+//
+// Copyright (c) 2014-2017 THUNDERBEAST GAMES LLC
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Atomic/Container/HashMap.h>
+#include <Atomic/Container/Sort.h>
+#include <Atomic/Math/MathDefs.h>
+
+#include "MeshSimplifier.h"
+
+namespace ToolCore
+{
+
+/// Weight of the planes that keep open borders in place.
+static const double BORDER_WEIGHT = 10.0;
+/// Minimum cosine between a triangle's normal before and after a collapse.
+static const float MIN_FLIP_COSINE = 0.2f;
+
+/// Symmetric 4x4 error quadric.
+struct Quadric
+{
+    Quadric() :
+        weight_(0.0)
+    {
+        for (unsigned i = 0; i < 10; ++i)
+            q_[i] = 0.0;
+    }
+
+    /// Add plane ax + by + cz + d = 0 with weight.
+    void AddPlane(double a, double b, double c, double d, double weight)
+    {
+        q_[0] += weight * a * a; q_[1] += weight * a * b; q_[2] += weight * a * c; q_[3] += weight * a * d;
+        q_[4] += weight * b * b; q_[5] += weight * b * c; q_[6] += weight * b * d;
+        q_[7] += weight * c * c; q_[8] += weight * c * d;
+        q_[9] += weight * d * d;
+        weight_ += weight;
+    }
+
+    /// Add another quadric.
+    void Add(const Quadric& rhs)
+    {
+        for (unsigned i = 0; i < 10; ++i)
+            q_[i] += rhs.q_[i];
+        weight_ += rhs.weight_;
+    }
+
+    /// Return the sum of weighted squared distances of a point from the planes.
+    double Evaluate(const Vector3& v) const
+    {
+        double x = v.x_, y = v.y_, z = v.z_;
+        double error = q_[0] * x * x + 2.0 * q_[1] * x * y + 2.0 * q_[2] * x * z + 2.0 * q_[3] * x +
+            q_[4] * y * y + 2.0 * q_[5] * y * z + 2.0 * q_[6] * y +
+            q_[7] * z * z + 2.0 * q_[8] * z + q_[9];
+        return error > 0.0 ? error : 0.0;
+    }
+
+    /// Return the weighted mean squared distance of a point from the planes.
+    double EvaluateMean(const Vector3& v) const { return weight_ > 0.0 ? Evaluate(v) / weight_ : 0.0; }
+
+    /// Upper triangle of the matrix.
+    double q_[10];
+    /// Sum of the plane weights.
+    double weight_;
+};
+
+/// Edge collapse candidate.
+struct Collapse
+{
+    /// Vertex to remove.
+    unsigned from_;
+    /// Vertex to move onto.
+    unsigned to_;
+    /// Mean squared distance of the moved vertex from the planes merged into it.
+    double error_;
+};
+
+static bool CompareCollapses(const Collapse& lhs, const Collapse& rhs)
+{
+    return lhs.error_ < rhs.error_;
+}
+
+static Vector3 TriangleNormal(const Vector3& v0, const Vector3& v1, const Vector3& v2)
+{
+    return (v1 - v0).CrossProduct(v2 - v0);
+}
+
+/// Return whether moving vertex from onto vertex to flips or degenerates any triangle around from that survives the collapse.
+static bool CollapseFlips(const PODVector<Vector3>& positions, const PODVector<unsigned>& positionIDs,
+    const PODVector<unsigned>& indices, const PODVector<unsigned>& triangles, unsigned start, unsigned end, unsigned from,
+    unsigned to)
+{
+    const Vector3& target = positions[to];
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        const unsigned* tri = &indices[triangles[i] * 3];
+
+        // Triangles that contain the collapsed edge disappear
+        if (positionIDs[tri[0]] == positionIDs[to] || positionIDs[tri[1]] == positionIDs[to] ||
+            positionIDs[tri[2]] == positionIDs[to])
+            continue;
+
+        Vector3 v[3];
+        for (unsigned j = 0; j < 3; ++j)
+            v[j] = positions[tri[j]];
+
+        Vector3 oldNormal = TriangleNormal(v[0], v[1], v[2]);
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            if (tri[j] == from)
+                v[j] = target;
+        }
+        Vector3 newNormal = TriangleNormal(v[0], v[1], v[2]);
+
+        float oldLength = oldNormal.Length();
+        float newLength = newNormal.Length();
+        if (newLength < M_EPSILON * oldLength || oldNormal.DotProduct(newNormal) < MIN_FLIP_COSINE * oldLength * newLength)
+            return true;
+    }
+
+    return false;
+}
+
+float SimplifyMesh(const PODVector<Vector3>& positions, const PODVector<unsigned>& indices, unsigned targetIndexCount,
+    float maxError, PODVector<unsigned>& dest)
+{
+    dest = indices;
+
+    unsigned numVertices = positions.Size();
+    if (!numVertices || dest.Size() < 3)
+        return 0.0f;
+
+    // Weld vertices by position. Positions shared by several vertices are attribute seams and are locked
+    PODVector<unsigned> positionIDs(numVertices);
+    PODVector<unsigned> positionCounts;
+    HashMap<Vector3, unsigned> welded;
+    for (unsigned i = 0; i < numVertices; ++i)
+    {
+        HashMap<Vector3, unsigned>::Iterator j = welded.Find(positions[i]);
+        if (j == welded.End())
+        {
+            j = welded.Insert(MakePair(positions[i], positionCounts.Size()));
+            positionCounts.Push(0);
+        }
+        positionIDs[i] = j->second_;
+        ++positionCounts[j->second_];
+    }
+
+    unsigned numPositions = positionCounts.Size();
+
+    // Plane quadrics of the triangles, plus perpendicular planes along open borders
+    Vector<Quadric> quadrics(numPositions);
+    HashMap<Pair<unsigned, unsigned>, unsigned> edgeCounts;
+    for (unsigned i = 0; i + 2 < dest.Size(); i += 3)
+    {
+        const Vector3& v0 = positions[dest[i]];
+        Vector3 normal = TriangleNormal(v0, positions[dest[i + 1]], positions[dest[i + 2]]);
+        if (normal.Length() < M_EPSILON)
+            continue;
+        normal.Normalize();
+
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            quadrics[positionIDs[dest[i + j]]].AddPlane(normal.x_, normal.y_, normal.z_, -normal.DotProduct(v0), 1.0);
+
+            unsigned a = positionIDs[dest[i + j]];
+            unsigned b = positionIDs[dest[i + (j + 1) % 3]];
+            ++edgeCounts[MakePair(Min(a, b), Max(a, b))];
+        }
+    }
+    for (unsigned i = 0; i + 2 < dest.Size(); i += 3)
+    {
+        const Vector3& v0 = positions[dest[i]];
+        Vector3 normal = TriangleNormal(v0, positions[dest[i + 1]], positions[dest[i + 2]]);
+        if (normal.Length() < M_EPSILON)
+            continue;
+        normal.Normalize();
+
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            unsigned a = positionIDs[dest[i + j]];
+            unsigned b = positionIDs[dest[i + (j + 1) % 3]];
+            if (edgeCounts[MakePair(Min(a, b), Max(a, b))] != 1)
+                continue;
+
+            const Vector3& p0 = positions[dest[i + j]];
+            Vector3 edge = positions[dest[i + (j + 1) % 3]] - p0;
+            Vector3 borderNormal = edge.CrossProduct(normal);
+            if (borderNormal.Length() < M_EPSILON)
+                continue;
+            borderNormal.Normalize();
+
+            double d = -borderNormal.DotProduct(p0);
+            quadrics[a].AddPlane(borderNormal.x_, borderNormal.y_, borderNormal.z_, d, BORDER_WEIGHT);
+            quadrics[b].AddPlane(borderNormal.x_, borderNormal.y_, borderNormal.z_, d, BORDER_WEIGHT);
+        }
+    }
+
+    double maxErrorSquared = (double)maxError * maxError;
+    double reachedError = 0.0;
+
+    PODVector<unsigned> triangleOffsets(numVertices + 1);
+    PODVector<unsigned> vertexTriangles;
+    PODVector<unsigned> remap(numVertices);
+    PODVector<bool> touched(numPositions);
+    PODVector<Collapse> collapses;
+
+    // Collapse in passes: rank all candidate edges, then collapse the cheapest ones that do not touch each other
+    while (dest.Size() > targetIndexCount)
+    {
+        unsigned numTriangles = dest.Size() / 3;
+
+        // Vertex to triangle adjacency
+        for (unsigned i = 0; i <= numVertices; ++i)
+            triangleOffsets[i] = 0;
+        for (unsigned i = 0; i < dest.Size(); ++i)
+            ++triangleOffsets[dest[i] + 1];
+        for (unsigned i = 0; i < numVertices; ++i)
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        vertexTriangles.Resize(dest.Size());
+        PODVector<unsigned> fill(triangleOffsets);
+        for (unsigned i = 0; i < dest.Size(); ++i)
+            vertexTriangles[fill[dest[i]]++] = i / 3;
+
+        collapses.Clear();
+        for (unsigned i = 0; i < dest.Size(); ++i)
+        {
+            unsigned from = dest[i];
+            unsigned to = dest[i - i % 3 + (i + 1) % 3];
+
+            // Check both directions of the edge
+            for (unsigned j = 0; j < 2; ++j)
+            {
+                if (positionCounts[positionIDs[from]] == 1)
+                {
+                    Collapse collapse;
+                    collapse.from_ = from;
+                    collapse.to_ = to;
+                    collapse.error_ = quadrics[positionIDs[from]].EvaluateMean(positions[to]);
+                    if (collapse.error_ <= maxErrorSquared)
+                        collapses.Push(collapse);
+                }
+                Swap(from, to);
+            }
+        }
+
+        if (collapses.Empty())
+            break;
+
+        Sort(collapses.Begin(), collapses.End(), CompareCollapses);
+
+        for (unsigned i = 0; i < numVertices; ++i)
+            remap[i] = i;
+        for (unsigned i = 0; i < numPositions; ++i)
+            touched[i] = false;
+
+        unsigned removedTriangles = 0;
+        unsigned wantedTriangles = (dest.Size() - targetIndexCount + 2) / 3;
+        bool collapsed = false;
+
+        for (unsigned i = 0; i < collapses.Size() && removedTriangles < wantedTriangles; ++i)
+        {
+            const Collapse& collapse = collapses[i];
+            unsigned from = collapse.from_;
+            unsigned to = collapse.to_;
+            if (touched[positionIDs[from]] || touched[positionIDs[to]])
+                continue;
+
+            unsigned start = triangleOffsets[from];
+            unsigned end = triangleOffsets[from + 1];
+            if (CollapseFlips(positions, positionIDs, dest, vertexTriangles, start, end, from, to))
+                continue;
+
+            remap[from] = to;
+            quadrics[positionIDs[to]].Add(quadrics[positionIDs[from]]);
+            reachedError = Max(reachedError, collapse.error_);
+            collapsed = true;
+
+            // Lock the neighborhood for the rest of the pass, as its triangles have changed
+            for (unsigned j = start; j < end; ++j)
+            {
+                const unsigned* tri = &dest[vertexTriangles[j] * 3];
+                touched[positionIDs[tri[0]]] = true;
+                touched[positionIDs[tri[1]]] = true;
+                touched[positionIDs[tri[2]]] = true;
+
+                if (positionIDs[tri[0]] == positionIDs[to] || positionIDs[tri[1]] == positionIDs[to] ||
+                    positionIDs[tri[2]] == positionIDs[to])
+                    ++removedTriangles;
+            }
+        }
+
+        if (!collapsed)
+            break;
+
+        // Apply the collapses and remove triangles that became degenerate
+        unsigned writeIndex = 0;
+        for (unsigned i = 0; i < numTriangles; ++i)
+        {
+            unsigned a = remap[dest[i * 3]];
+            unsigned b = remap[dest[i * 3 + 1]];
+            unsigned c = remap[dest[i * 3 + 2]];
+            if (positionIDs[a] == positionIDs[b] || positionIDs[b] == positionIDs[c] || positionIDs[a] == positionIDs[c])
+                continue;
+
+            dest[writeIndex++] = a;
+            dest[writeIndex++] = b;
+            dest[writeIndex++] = c;
+        }
+        dest.Resize(writeIndex);
+    }
+
+    return (float)sqrt(reachedError);
+}
+
+}
@@ -0,0 +1,41 @@
+//
+// Copyright (c) 2014-2017 THUNDERBEAST GAMES LLC
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Atomic/Container/Vector.h>
+#include <Atomic/Math/Vector3.h>
+
+using namespace Atomic;
+
+namespace ToolCore
+{
+
+/// Simplify an indexed triangle list for a lower LOD level, using quadric error metric edge collapses onto existing
+/// vertices, so that the result can share the vertex buffer of the source. Vertices that have been split for other
+/// vertex attributes, such as texture coordinate seams, are not moved. Collapses continue until the index count is at
+/// most targetIndexCount or the next collapse would exceed maxError. Returns the largest error of the performed collapses.
+/// Simplify a triangle list toward a target index count by edge collapses, keeping the mean distance of each collapsed vertex from the original surface planes within maxError. Return the largest such distance reached, in the units of the positions.
+float SimplifyMesh(const PODVector<Vector3>& positions, const PODVector<unsigned>& indices, unsigned targetIndexCount,
+    float maxError, PODVector<unsigned>& dest);
+
+}
@@ -44,11 +44,17 @@
 #include <ToolCore/ToolSystem.h>
 #include <ToolCore/Import/ImportConfig.h>
 
+#include "MeshSimplifier.h"
 #include "OpenAssetImporter.h"
 
 namespace ToolCore
 {
 
+// Angle of one pixel at 1080 vertical resolution and 60 degree field of view, the reference view for LOD distances
+static const float LOD_PIXEL_ANGLE = 0.00107f;
+// Minimum triangle reduction for a generated LOD level to be worth keeping
+static const float LOD_MIN_REDUCTION = 0.2f;
+
 OpenAssetImporter::OpenAssetImporter(Context* context) : Object(context) ,
     scene_(0),
     rootNode_(0),
@@ -74,7 +80,11 @@ OpenAssetImporter::OpenAssetImporter(Context* context) : Object(context) ,
     noOverwriteNewerTexture_(true),
     checkUniqueModel_(true),
     useVertexColors_(false),
+    compressAnimations_(false),
     scale_(1.0f),
+    animationPositionError_(0.001f),
+    animationRotationError_(0.1f),
+    animationScaleError_(0.001f),
     maxBones_(64),
     defaultTicksPerSecond_(4800.0f),
     startTime_(-1),
@@ -320,6 +330,22 @@ bool OpenAssetImporter::BuildAndSaveModel(OutModel& model)
     Vector<PODVector<unsigned> > allBoneMappings;
     BoundingBox box;
 
+    // Generate the lower LOD levels first, as their indices are stored in the same index buffers
+    Vector<Vector<PODVector<unsigned> > > lodIndices(model.meshes_.Size());
+    Vector<PODVector<float> > lodDistances(model.meshes_.Size());
+    if (lodErrors_.Size())
+        GenerateLodLevels(model, lodIndices, lodDistances);
+
+    PODVector<unsigned> numLodIndices(model.meshes_.Size());
+    unsigned totalLodIndices = 0;
+    for (unsigned i = 0; i < model.meshes_.Size(); ++i)
+    {
+        numLodIndices[i] = 0;
+        for (unsigned j = 0; j < lodIndices[i].Size(); ++j)
+            numLodIndices[i] += lodIndices[i][j].Size();
+        totalLodIndices += numLodIndices[i];
+    }
+
     unsigned numValidGeometries = 0;
 
     bool combineBuffers = true;
@@ -385,12 +411,12 @@ bool OpenAssetImporter::BuildAndSaveModel(OutModel& model)
 
             if (combineBuffers)
             {
-                ib->SetSize(model.totalIndices_, largeIndices);
+                ib->SetSize(model.totalIndices_ + totalLodIndices, largeIndices);
                 vb->SetSize(model.totalVertices_, elementMask);
             }
             else
             {
-                ib->SetSize(validFaces * 3, largeIndices);
+                ib->SetSize(validFaces * 3 + numLodIndices[i], largeIndices);
                 vb->SetSize(mesh->mNumVertices, elementMask);
             }
 
@@ -470,8 +496,37 @@ bool OpenAssetImporter::BuildAndSaveModel(OutModel& model)
         geom->SetIndexBuffer(ib);
         geom->SetVertexBuffer(0, vb);
         geom->SetDrawRange(TRIANGLE_LIST, startIndexOffset, validFaces * 3, true);
-        outModel->SetNumGeometryLodLevels(destGeomIndex, 1);
+        outModel->SetNumGeometryLodLevels(destGeomIndex, 1 + lodIndices[i].Size());
         outModel->SetGeometry(destGeomIndex, 0, geom);
+
+        // Define the generated LOD levels, which share the vertex data
+        unsigned lodIndexOffset = startIndexOffset + validFaces * 3;
+        for (unsigned j = 0; j < lodIndices[i].Size(); ++j)
+        {
+            const PODVector<unsigned>& indices = lodIndices[i][j];
+
+            if (!largeIndices)
+            {
+                unsigned short* dest = (unsigned short*)indexData + lodIndexOffset;
+                for (unsigned k = 0; k < indices.Size(); ++k)
+                    *dest++ = (unsigned short)(indices[k] + startVertexOffset);
+            }
+            else
+            {
+                unsigned* dest = (unsigned*)indexData + lodIndexOffset;
+                for (unsigned k = 0; k < indices.Size(); ++k)
+                    *dest++ = indices[k] + startVertexOffset;
+            }
+
+            SharedPtr<Geometry> lodGeom(new Geometry(context_));
+            lodGeom->SetIndexBuffer(ib);
+            lodGeom->SetVertexBuffer(0, vb);
+            lodGeom->SetDrawRange(TRIANGLE_LIST, lodIndexOffset, indices.Size(), true);
+            lodGeom->SetLodDistance(lodDistances[i][j]);
+            outModel->SetGeometry(destGeomIndex, j + 1, lodGeom);
+
+            lodIndexOffset += indices.Size();
+        }
         outModel->SetGeometryCenter(destGeomIndex, center);
         outModel->SetGeometryName(destGeomIndex, FromAIString(model.meshNodes_[i]->mName));
 
@@ -479,7 +534,7 @@ bool OpenAssetImporter::BuildAndSaveModel(OutModel& model)
             allBoneMappings.Push(boneMappings);
 
         startVertexOffset += mesh->mNumVertices;
-        startIndexOffset += validFaces * 3;
+        startIndexOffset = lodIndexOffset;
         ++destGeomIndex;
     }
 
@@ -958,6 +1013,86 @@ void OpenAssetImporter::BuildBoneCollisionInfo(OutModel& model)
     }
 }
 
+void OpenAssetImporter::GenerateLodLevels(OutModel& model, Vector<Vector<PODVector<unsigned> > >& lodIndices, Vector<PODVector<float> >& lodDistances)
+{
+    // Vertex positions as baked into the model
+    Vector<PODVector<Vector3> > positions(model.meshes_.Size());
+    BoundingBox modelBox;
+
+    for (unsigned i = 0; i < model.meshes_.Size(); ++i)
+    {
+        aiMesh* mesh = model.meshes_[i];
+        if (!GetNumValidFaces(mesh))
+            continue;
+
+        Vector3 pos, scale;
+        Quaternion rot;
+        GetPosRotScale(GetMeshBakingTransform(model.meshNodes_[i], model.rootNode_), pos, rot, scale);
+        Matrix3x4 vertexTransform(pos, rot, scale);
+
+        positions[i].Resize(mesh->mNumVertices);
+        for (unsigned j = 0; j < mesh->mNumVertices; ++j)
+        {
+            positions[i][j] = vertexTransform * ToVector3(mesh->mVertices[j]);
+            modelBox.Merge(positions[i][j]);
+        }
+    }
+
+    // Errors are relative to the average model dimension, which is also the scale that LOD distances are divided by
+    Vector3 size = modelBox.Size();
+    float modelSize = (size.x_ + size.y_ + size.z_) / 3.0f;
+    if (modelSize < M_EPSILON)
+        return;
+
+    for (unsigned i = 0; i < model.meshes_.Size(); ++i)
+    {
+        aiMesh* mesh = model.meshes_[i];
+        if (!GetNumValidFaces(mesh))
+            continue;
+
+        PODVector<unsigned> indices;
+        for (unsigned j = 0; j < mesh->mNumFaces; ++j)
+        {
+            const aiFace& face = mesh->mFaces[j];
+            if (face.mNumIndices == 3)
+            {
+                indices.Push(face.mIndices[0]);
+                indices.Push(face.mIndices[1]);
+                indices.Push(face.mIndices[2]);
+            }
+        }
+
+        // Each LOD level is simplified from the original mesh, so that its error bound is measured against the original
+        // surface and not accumulated over the previous levels
+        unsigned previousSize = indices.Size();
+        float previousDistance = 0.0f;
+        for (unsigned j = 0; j < lodErrors_.Size(); ++j)
+        {
+            PODVector<unsigned> simplified;
+            float error = SimplifyMesh(positions[i], indices, 0, lodErrors_[j] * modelSize, simplified);
+
+            if (simplified.Empty())
+                break;
+            if (simplified.Size() > (unsigned)(previousSize * (1.0f - LOD_MIN_REDUCTION)))
+                continue;
+
+            // The reached error is a model space distance. Switch when it projects to about one pixel in the reference
+            // view, converting the switch distance to the LOD distance scale, which divides by the average model dimension
+            float lodDistance = Max(error / modelSize / LOD_PIXEL_ANGLE, previousDistance);
+            lodIndices[i].Push(simplified);
+            lodDistances[i].Push(lodDistance);
+            previousSize = simplified.Size();
+            previousDistance = lodDistance;
+        }
+
+        if (verboseLog_ && lodIndices[i].Size())
+        {
+            ATOMIC_LOGINFOF("Generated %u LOD levels for geometry %s, lowest has %u of %u triangles", lodIndices[i].Size(),
+                FromAIString(model.meshNodes_[i]->mName).CString(), previousSize / 3, GetNumValidFaces(mesh));
+        }
+    }
+}
+
 bool OpenAssetImporter::BuildAndSaveAnimations(OutModel* model, const String &animNameOverride)
 {
     const PODVector<aiAnimation*>& animations = model ? model->animations_ : sceneAnimations_;
@@ -1173,6 +1308,9 @@ bool OpenAssetImporter::BuildAndSaveAnimations(OutModel* model, const String &an
 
         outAnim->SetTracks(tracks);
 
+        if (compressAnimations_)
+            outAnim->Compress(animationPositionError_, animationRotationError_, animationScaleError_);
+
         File outFile(context_);
         if (!outFile.Open(animOutName, FILE_WRITE))
         {
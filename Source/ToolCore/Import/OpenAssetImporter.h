@@ -63,6 +63,16 @@ public:
     void SetImportMaterials(bool importMaterials) { importMaterials_ = importMaterials; }
     void SetIncludeNonSkinningBones(bool includeNonSkinningBones) { includeNonSkinningBones_ = includeNonSkinningBones; }
     void SetVerboseLog(bool verboseLog) { verboseLog_ = verboseLog; }
+    /// Set whether to compress exported animations and the allowed errors. Rotation error is in degrees.
+    void SetAnimationCompression(bool compress, float positionError, float rotationError, float scaleError)
+    {
+        compressAnimations_ = compress;
+        animationPositionError_ = positionError;
+        animationRotationError_ = rotationError;
+        animationScaleError_ = scaleError;
+    }
+    /// Set errors of generated LOD levels, relative to the model size. Empty disables LOD generation.
+    void SetLodErrors(const PODVector<float>& errors) { lodErrors_ = errors; }
 
     bool GetImportMaterialsDefault() { return importMaterialsDefault_; }
 
@@ -76,6 +86,7 @@ private:
     void ApplyScale(aiNode* node);
 
     bool BuildAndSaveModel(OutModel& model);
+    void GenerateLodLevels(OutModel& model, Vector<Vector<PODVector<unsigned> > >& lodIndices, Vector<PODVector<float> >& lodDistances);
     bool BuildAndSaveAnimations(OutModel* model = 0, const String& animNameOverride = String::EMPTY);
 
     void ExportMaterials(HashSet<String>& usedTextures);
@@ -132,8 +143,13 @@ private:
     bool noOverwriteNewerTexture_;
     bool checkUniqueModel_;
     bool useVertexColors_;
+    bool compressAnimations_;
     float scale_;
+    float animationPositionError_;
+    float animationRotationError_;
+    float animationScaleError_;
     unsigned maxBones_;
+    PODVector<float> lodErrors_;
 
     unsigned aiFlagsDefault_;
     unsigned aiCurrentFlags_;
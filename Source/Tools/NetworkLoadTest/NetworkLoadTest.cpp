@@ -0,0 +1,838 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Atomic/Atomic.h>
+
+#include <Atomic/Container/Sort.h>
+#include <Atomic/Core/Context.h>
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Core/WorkQueue.h>
+#include <Atomic/IO/File.h>
+#include <Atomic/IO/FileSystem.h>
+#include <Atomic/IO/Log.h>
+#include <Atomic/IO/VectorBuffer.h>
+#include <Atomic/Math/Random.h>
+#include <Atomic/Network/Connection.h>
+#include <Atomic/Network/InterestManager.h>
+#include <Atomic/Network/Network.h>
+#include <Atomic/Network/NetworkEvents.h>
+#include <Atomic/Resource/JSONFile.h>
+#include <Atomic/Resource/ResourceCache.h>
+#include <Atomic/Scene/Scene.h>
+
+#include <kNet/include/kNet.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <Atomic/DebugNew.h>
+
+using namespace Atomic;
+
+static const unsigned short DEFAULT_PORT = 2345;
+static const unsigned DEFAULT_CLIENTS = 16;
+static const unsigned DEFAULT_NODES = 500;
+static const float DEFAULT_DURATION = 10.0f;
+static const float DEFAULT_WARMUP = 2.0f;
+static const int DEFAULT_FPS = 60;
+/// Time to wait for all clients to join after the warmup before measuring anyway.
+static const float JOIN_TIMEOUT = 30.0f;
+/// Half size of the square area the synthetic nodes move in.
+static const float AREA_SIZE = 250.0f;
+static const float PLAYER_SPEED = 5.0f;
+
+static const unsigned CTRL_FORWARD = 1;
+static const unsigned CTRL_BACK = 2;
+static const unsigned CTRL_LEFT = 4;
+static const unsigned CTRL_RIGHT = 8;
+static const unsigned CTRL_JUMP = 16;
+
+struct LoadTestSettings
+{
+    LoadTestSettings() :
+        port_(DEFAULT_PORT),
+        clients_(DEFAULT_CLIENTS),
+        processes_(0),
+        nodes_(DEFAULT_NODES),
+        firstClientIndex_(0),
+        threads_(M_MAX_UNSIGNED),
+        duration_(DEFAULT_DURATION),
+        warmup_(DEFAULT_WARMUP),
+        fps_(DEFAULT_FPS),
+        updateFps_(30),
+        latency_(0),
+        packetLoss_(0.0f),
+        interest_(false),
+        parallel_(true),
+        verbose_(false)
+    {
+    }
+
+    /// Server address to connect to. Empty runs the server.
+    String address_;
+    String output_;
+    unsigned short port_;
+    unsigned clients_;
+    unsigned processes_;
+    unsigned nodes_;
+    unsigned firstClientIndex_;
+    unsigned threads_;
+    float duration_;
+    float warmup_;
+    int fps_;
+    int updateFps_;
+    int latency_;
+    float packetLoss_;
+    bool interest_;
+    bool parallel_;
+    bool verbose_;
+};
+
+/// Synthetic node moving on a circle.
+struct NpcMotion
+{
+    WeakPtr<Node> node_;
+    Vector3 center_;
+    float radius_;
+    float angularSpeed_;
+    float phase_;
+};
+
+/// Simulated client, with its own context and network subsystem so that many can run in one process.
+class LoadTestClient : public Object
+{
+    ATOMIC_OBJECT(LoadTestClient, Object);
+
+public:
+    LoadTestClient(Context* context, unsigned index);
+
+    bool Connect(const String& address, unsigned short port);
+    void Update(float timeStep, float elapsed);
+    void Disconnect();
+
+    bool IsFinished() const { return finished_; }
+
+private:
+    void HandleServerDisconnected(StringHash eventType, VariantMap& eventData);
+
+    SharedPtr<Scene> scene_;
+    unsigned index_;
+    bool finished_;
+};
+
+/// Load test server running the synthetic scene and collecting the statistics.
+class LoadTestServer : public Object
+{
+    ATOMIC_OBJECT(LoadTestServer, Object);
+
+public:
+    LoadTestServer(Context* context, const LoadTestSettings& settings);
+
+    bool Start();
+    void Update(float timeStep, float elapsed);
+    void Stop();
+    void BeginMeasurement();
+    void EndMeasurement();
+    void WriteReport(JSONValue& root) const;
+
+    unsigned GetNumJoinedClients() const;
+
+private:
+    void CreateScene();
+    void HandleClientConnected(StringHash eventType, VariantMap& eventData);
+    void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
+    void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData);
+
+    LoadTestSettings settings_;
+    SharedPtr<Scene> scene_;
+    Vector<NpcMotion> npcs_;
+    HashMap<Connection*, WeakPtr<Node> > players_;
+    /// Total bytes sent and received per connection at the start of the measurement.
+    HashMap<Connection*, Pair<unsigned long long, unsigned long long> > startBytes_;
+    PODVector<float> tickTimes_;
+    PODVector<float> frameTimes_;
+    HiresTimer tickTimer_;
+    Timer measureTimer_;
+    float measureDuration_;
+    double messagesOut_;
+    double messagesIn_;
+    double roundTripTime_;
+    unsigned long long bytesOut_;
+    unsigned long long bytesIn_;
+    unsigned numMeasuredClients_;
+    unsigned numRoundTripSamples_;
+    bool measuring_;
+};
+
+SharedPtr<Context> context_(new Context());
+LoadTestSettings settings_;
+Vector<SharedPtr<Context> > clientContexts_;
+Vector<SharedPtr<LoadTestClient> > clients_;
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+void RegisterSubsystems(Context* context, bool logging);
+void CreateClients(const String& address);
+void UpdateClients(float timeStep, float elapsed);
+void DestroyClients();
+void RunServer();
+void RunClients();
+void Sleep(HiresTimer& frameTimer, long long frameUSec);
+JSONValue GetTimeStats(const PODVector<float>& times);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String option = arguments[i].ToLower();
+        String value = i + 1 < arguments.Size() ? arguments[i + 1] : String::EMPTY;
+
+        if (option == "-clients")
+            settings_.clients_ = ToUInt(value);
+        else if (option == "-processes")
+            settings_.processes_ = ToUInt(value);
+        else if (option == "-nodes")
+            settings_.nodes_ = ToUInt(value);
+        else if (option == "-duration")
+            settings_.duration_ = ToFloat(value);
+        else if (option == "-warmup")
+            settings_.warmup_ = ToFloat(value);
+        else if (option == "-fps")
+            settings_.fps_ = Max(ToInt(value), 1);
+        else if (option == "-updatefps")
+            settings_.updateFps_ = Max(ToInt(value), 1);
+        else if (option == "-latency")
+            settings_.latency_ = ToInt(value);
+        else if (option == "-loss")
+            settings_.packetLoss_ = ToFloat(value);
+        else if (option == "-port")
+            settings_.port_ = (unsigned short)ToUInt(value);
+        else if (option == "-threads")
+            settings_.threads_ = ToUInt(value);
+        else if (option == "-output")
+            settings_.output_ = value;
+        else if (option == "-connect")
+            settings_.address_ = value;
+        else if (option == "-index")
+            settings_.firstClientIndex_ = ToUInt(value);
+        else if (option == "-interest")
+        {
+            settings_.interest_ = true;
+            continue;
+        }
+        else if (option == "-serial")
+        {
+            settings_.parallel_ = false;
+            continue;
+        }
+        else if (option == "-v")
+        {
+            settings_.verbose_ = true;
+            continue;
+        }
+        else
+        {
+            ErrorExit(
+                "Usage: NetworkLoadTest [options]\n"
+                "\n"
+                "Runs a server with a synthetic scene and simulated clients over loopback, and prints the server tick time,\n"
+                "bandwidth and message counts as JSON.\n"
+                "\n"
+                "Options:\n"
+                "-clients <n>    Number of simulated clients, default 16\n"
+                "-processes <n>  Run the clients in n child processes instead of in-process\n"
+                "-nodes <n>      Number of moving replicated nodes, default 500\n"
+                "-duration <s>   Measurement time in seconds, default 10\n"
+                "-warmup <s>     Time before measuring in seconds, default 2\n"
+                "-fps <n>        Simulation frames per second, default 60\n"
+                "-updatefps <n>  Network updates per second, default 30\n"
+                "-latency <ms>   Simulated latency\n"
+                "-loss <p>       Simulated packet loss probability 0.0 - 1.0\n"
+                "-interest       Use an InterestManager in the scene\n"
+                "-serial         Build the server updates on the main thread only\n"
+                "-threads <n>    Number of worker threads, default number of logical CPUs minus one\n"
+                "-port <n>       Server port, default 2345\n"
+                "-output <file>  Write the JSON report to a file instead of stdout\n"
+                "-v              Verbose logging\n"
+                "\n"
+                "Client mode, used for the child processes: NetworkLoadTest -connect <address> [options]\n"
+                "-index <n>      Index of the first client, which offsets its scripted controls\n"
+            );
+        }
+
+        // Skip the option value
+        ++i;
+    }
+
+    RegisterSubsystems(context_, true);
+
+    if (settings_.address_.Empty())
+        RunServer();
+    else
+        RunClients();
+}
+
+void RegisterSubsystems(Context* context, bool logging)
+{
+    context->RegisterSubsystem(new Time(context));
+    context->RegisterSubsystem(new WorkQueue(context));
+    context->RegisterSubsystem(new FileSystem(context));
+#ifdef ATOMIC_LOGGING
+    if (logging)
+    {
+        Log* log = new Log(context);
+        log->SetLevel(settings_.verbose_ ? LOG_INFO : LOG_WARNING);
+        context->RegisterSubsystem(log);
+    }
+#endif
+    context->RegisterSubsystem(new ResourceCache(context));
+    context->RegisterSubsystem(new Network(context));
+
+    RegisterSceneLibrary(context);
+
+    Network* network = context->GetSubsystem<Network>();
+    network->SetUpdateFps(settings_.updateFps_);
+    network->SetSimulatedLatency(settings_.latency_);
+    network->SetSimulatedPacketLoss(settings_.packetLoss_);
+}
+
+void CreateClients(const String& address)
+{
+    for (unsigned i = 0; i < settings_.clients_; ++i)
+    {
+        // Only the main context logs, as the log is a singleton
+        SharedPtr<Context> context(new Context());
+        RegisterSubsystems(context, false);
+
+        SharedPtr<LoadTestClient> client(new LoadTestClient(context, settings_.firstClientIndex_ + i));
+        if (!client->Connect(address, settings_.port_))
+            ErrorExit("Failed to connect client " + String(settings_.firstClientIndex_ + i) + " to " + address);
+
+        clientContexts_.Push(context);
+        clients_.Push(client);
+    }
+}
+
+void UpdateClients(float timeStep, float elapsed)
+{
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+        clients_[i]->Update(timeStep, elapsed);
+}
+
+void DestroyClients()
+{
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+        clients_[i]->Disconnect();
+
+    // The clients must go before their contexts
+    clients_.Clear();
+    clientContexts_.Clear();
+}
+
+void RunServer()
+{
+    WorkQueue* queue = context_->GetSubsystem<WorkQueue>();
+    unsigned numThreads = settings_.threads_ != M_MAX_UNSIGNED ? settings_.threads_ : GetNumLogicalCPUs() - 1;
+    if (numThreads)
+        queue->CreateThreads(numThreads);
+
+    Network* network = context_->GetSubsystem<Network>();
+    network->SetParallelServerUpdate(settings_.parallel_);
+
+    SharedPtr<LoadTestServer> server(new LoadTestServer(context_, settings_));
+    if (!server->Start())
+        ErrorExit("Failed to start server on port " + String(settings_.port_));
+
+    if (settings_.processes_)
+    {
+        // Launch the clients as child processes that run until the server goes away
+        FileSystem* fileSystem = context_->GetSubsystem<FileSystem>();
+#ifdef WIN32
+        String programName = fileSystem->GetProgramDir() + "NetworkLoadTest.exe";
+#else
+        String programName = fileSystem->GetProgramDir() + "NetworkLoadTest";
+#endif
+        float runTime = settings_.warmup_ + JOIN_TIMEOUT + settings_.duration_ + 5.0f;
+        unsigned numProcesses = Min(settings_.processes_, settings_.clients_);
+        unsigned firstIndex = 0;
+
+        for (unsigned i = 0; i < numProcesses; ++i)
+        {
+            unsigned numClients = settings_.clients_ / numProcesses + (i < settings_.clients_ % numProcesses ? 1 : 0);
+
+            Vector<String> args;
+            args.Push("-connect");
+            args.Push("127.0.0.1");
+            args.Push("-port");
+            args.Push(String(settings_.port_));
+            args.Push("-clients");
+            args.Push(String(numClients));
+            args.Push("-index");
+            args.Push(String(firstIndex));
+            args.Push("-duration");
+            args.Push(String(runTime));
+            args.Push("-fps");
+            args.Push(String(settings_.fps_));
+            args.Push("-updatefps");
+            args.Push(String(settings_.updateFps_));
+            args.Push("-latency");
+            args.Push(String(settings_.latency_));
+            args.Push("-loss");
+            args.Push(String(settings_.packetLoss_));
+
+            if (fileSystem->SystemRunAsync(programName, args) == M_MAX_UNSIGNED)
+                ErrorExit("Failed to launch client process " + programName);
+
+            firstIndex += numClients;
+        }
+    }
+    else
+        CreateClients("127.0.0.1");
+
+    // Run at a fixed time step so that runs are comparable
+    float timeStep = 1.0f / (float)settings_.fps_;
+    long long frameUSec = 1000000 / settings_.fps_;
+    float elapsed = 0.0f;
+    float measureStart = -1.0f;
+    HiresTimer frameTimer;
+
+    for (;;)
+    {
+        frameTimer.Reset();
+
+        UpdateClients(timeStep, elapsed);
+        server->Update(timeStep, elapsed);
+        elapsed += timeStep;
+
+        if (measureStart < 0.0f)
+        {
+            if (elapsed >= settings_.warmup_ && (server->GetNumJoinedClients() >= settings_.clients_ ||
+                elapsed >= settings_.warmup_ + JOIN_TIMEOUT))
+            {
+                if (!server->GetNumJoinedClients())
+                    ErrorExit("No clients joined the server");
+
+                server->BeginMeasurement();
+                measureStart = elapsed;
+            }
+        }
+        else if (elapsed - measureStart >= settings_.duration_)
+        {
+            server->EndMeasurement();
+            break;
+        }
+
+        Sleep(frameTimer, frameUSec);
+    }
+
+    JSONFile report(context_);
+    server->WriteReport(report.GetRoot());
+
+    DestroyClients();
+    server->Stop();
+
+    if (settings_.output_.Empty())
+    {
+        VectorBuffer buffer;
+        report.Save(buffer, "  ");
+        PrintLine(String((const char*)buffer.GetData(), buffer.GetSize()));
+    }
+    else
+    {
+        File file(context_, settings_.output_, FILE_WRITE);
+        if (!file.IsOpen() || !report.Save(file, "  "))
+            ErrorExit("Failed to write report " + settings_.output_);
+    }
+}
+
+void RunClients()
+{
+    CreateClients(settings_.address_);
+
+    float timeStep = 1.0f / (float)settings_.fps_;
+    long long frameUSec = 1000000 / settings_.fps_;
+    float elapsed = 0.0f;
+    HiresTimer frameTimer;
+
+    while (elapsed < settings_.duration_)
+    {
+        frameTimer.Reset();
+
+        UpdateClients(timeStep, elapsed);
+        elapsed += timeStep;
+
+        bool finished = true;
+        for (unsigned i = 0; i < clients_.Size(); ++i)
+        {
+            if (!clients_[i]->IsFinished())
+            {
+                finished = false;
+                break;
+            }
+        }
+        if (finished)
+            break;
+
+        Sleep(frameTimer, frameUSec);
+    }
+
+    DestroyClients();
+}
+
+void Sleep(HiresTimer& frameTimer, long long frameUSec)
+{
+    long long usec = frameTimer.GetUSec(false);
+    if (usec < frameUSec)
+        Time::Sleep((unsigned)((frameUSec - usec) / 1000));
+}
+
+JSONValue GetTimeStats(const PODVector<float>& times)
+{
+    JSONValue stats;
+    if (times.Empty())
+        return stats;
+
+    PODVector<float> sorted = times;
+    Sort(sorted.Begin(), sorted.End());
+
+    float total = 0.0f;
+    for (unsigned i = 0; i < sorted.Size(); ++i)
+        total += sorted[i];
+
+    stats.Set("averageMs", total / (float)sorted.Size());
+    stats.Set("medianMs", sorted[sorted.Size() / 2]);
+    stats.Set("p95Ms", sorted[Min((unsigned)(sorted.Size() * 0.95f), sorted.Size() - 1)]);
+    stats.Set("maxMs", sorted.Back());
+    stats.Set("samples", sorted.Size());
+    return stats;
+}
+
+LoadTestClient::LoadTestClient(Context* context, unsigned index) :
+    Object(context),
+    index_(index),
+    finished_(false)
+{
+    scene_ = new Scene(context_);
+
+    SubscribeToEvent(E_SERVERDISCONNECTED, ATOMIC_HANDLER(LoadTestClient, HandleServerDisconnected));
+    SubscribeToEvent(E_CONNECTFAILED, ATOMIC_HANDLER(LoadTestClient, HandleServerDisconnected));
+}
+
+bool LoadTestClient::Connect(const String& address, unsigned short port)
+{
+    return GetSubsystem<Network>()->Connect(address, port, scene_);
+}
+
+void LoadTestClient::Update(float timeStep, float elapsed)
+{
+    Network* network = GetSubsystem<Network>();
+    network->Update(timeStep);
+
+    Connection* connection = network->GetServerConnection();
+    if (connection)
+    {
+        // Walk forward turning at a steady rate, with occasional strafing and jumping. Offset by the client index so
+        // that the clients do not move in lockstep
+        float time = elapsed + (float)index_ * 0.37f;
+        Controls controls;
+        controls.yaw_ = 30.0f * time + (float)index_ * 37.0f;
+        controls.Set(CTRL_FORWARD);
+        controls.Set(CTRL_LEFT, fmodf(time, 4.0f) < 1.0f);
+        controls.Set(CTRL_RIGHT, fmodf(time, 5.0f) < 0.5f);
+        controls.Set(CTRL_JUMP, fmodf(time, 3.0f) < 0.2f);
+        connection->SetControls(controls);
+    }
+
+    network->PostUpdate(timeStep);
+}
+
+void LoadTestClient::Disconnect()
+{
+    GetSubsystem<Network>()->Disconnect();
+    finished_ = true;
+}
+
+void LoadTestClient::HandleServerDisconnected(StringHash eventType, VariantMap& eventData)
+{
+    finished_ = true;
+}
+
+LoadTestServer::LoadTestServer(Context* context, const LoadTestSettings& settings) :
+    Object(context),
+    settings_(settings),
+    measureDuration_(0.0f),
+    messagesOut_(0.0),
+    messagesIn_(0.0),
+    roundTripTime_(0.0),
+    bytesOut_(0),
+    bytesIn_(0),
+    numMeasuredClients_(0),
+    numRoundTripSamples_(0),
+    measuring_(false)
+{
+    SubscribeToEvent(E_CLIENTCONNECTED, ATOMIC_HANDLER(LoadTestServer, HandleClientConnected));
+    SubscribeToEvent(E_CLIENTDISCONNECTED, ATOMIC_HANDLER(LoadTestServer, HandleClientDisconnected));
+    SubscribeToEvent(E_NETWORKUPDATE, ATOMIC_HANDLER(LoadTestServer, HandleNetworkUpdate));
+    SubscribeToEvent(E_NETWORKUPDATESENT, ATOMIC_HANDLER(LoadTestServer, HandleNetworkUpdateSent));
+}
+
+bool LoadTestServer::Start()
+{
+    CreateScene();
+    return GetSubsystem<Network>()->StartServer(settings_.port_);
+}
+
+void LoadTestServer::CreateScene()
+{
+    scene_ = new Scene(context_);
+    if (settings_.interest_)
+        scene_->CreateComponent<InterestManager>(LOCAL);
+
+    // Same seed every run, so that the runs are comparable
+    SetRandomSeed(1);
+
+    npcs_.Resize(settings_.nodes_);
+    for (unsigned i = 0; i < settings_.nodes_; ++i)
+    {
+        NpcMotion& npc = npcs_[i];
+        npc.node_ = scene_->CreateChild("Npc", REPLICATED);
+        npc.center_ = Vector3(Random(-AREA_SIZE, AREA_SIZE), 0.0f, Random(-AREA_SIZE, AREA_SIZE));
+        npc.radius_ = Random(2.0f, 20.0f);
+        npc.angularSpeed_ = Random(10.0f, 90.0f);
+        npc.phase_ = Random(360.0f);
+        npc.node_->SetVar("State", 0);
+    }
+}
+
+void LoadTestServer::Update(float timeStep, float elapsed)
+{
+    HiresTimer frameTimer;
+
+    Network* network = GetSubsystem<Network>();
+    network->Update(timeStep);
+
+    for (Vector<NpcMotion>::Iterator i = npcs_.Begin(); i != npcs_.End(); ++i)
+    {
+        float angle = i->phase_ + i->angularSpeed_ * elapsed;
+        i->node_->SetPosition(i->center_ + Vector3(Cos(angle) * i->radius_, 0.0f, Sin(angle) * i->radius_));
+        i->node_->SetRotation(Quaternion(-angle, Vector3::UP));
+        // Change a node variable every few seconds to also replicate variant attributes
+        i->node_->SetVar("State", (int)((i->phase_ + elapsed) * 0.25f) % 4);
+    }
+
+    for (HashMap<Connection*, WeakPtr<Node> >::Iterator i = players_.Begin(); i != players_.End(); ++i)
+    {
+        Node* node = i->second_;
+        if (!node)
+            continue;
+
+        const Controls& controls = i->first_->GetControls();
+        node->SetRotation(Quaternion(controls.yaw_, Vector3::UP));
+
+        Vector3 move = Vector3::ZERO;
+        if (controls.IsDown(CTRL_FORWARD))
+            move += Vector3::FORWARD;
+        if (controls.IsDown(CTRL_BACK))
+            move += Vector3::BACK;
+        if (controls.IsDown(CTRL_LEFT))
+            move += Vector3::LEFT;
+        if (controls.IsDown(CTRL_RIGHT))
+            move += Vector3::RIGHT;
+
+        Vector3 position = node->GetPosition() + node->GetRotation() * move.Normalized() * PLAYER_SPEED * timeStep;
+        position.x_ = Clamp(position.x_, -AREA_SIZE, AREA_SIZE);
+        position.y_ = controls.IsDown(CTRL_JUMP) ? 1.0f : 0.0f;
+        position.z_ = Clamp(position.z_, -AREA_SIZE, AREA_SIZE);
+        node->SetPosition(position);
+
+        // The interest manager uses the observer position, which real clients would send
+        if (settings_.interest_)
+            i->first_->SetPosition(position);
+    }
+
+    scene_->Update(timeStep);
+    network->PostUpdate(timeStep);
+
+    if (measuring_)
+    {
+        frameTimes_.Push(frameTimer.GetUSec(false) / 1000.0f);
+
+        for (HashMap<Connection*, WeakPtr<Node> >::ConstIterator i = players_.Begin(); i != players_.End(); ++i)
+        {
+            kNet::MessageConnection* connection = i->first_->GetMessageConnection();
+            messagesOut_ += connection->MsgsOutPerSec() * timeStep;
+            messagesIn_ += connection->MsgsInPerSec() * timeStep;
+            roundTripTime_ += i->first_->GetRoundTripTime();
+            ++numRoundTripSamples_;
+        }
+    }
+}
+
+void LoadTestServer::Stop()
+{
+    GetSubsystem<Network>()->StopServer();
+    players_.Clear();
+    scene_.Reset();
+}
+
+void LoadTestServer::BeginMeasurement()
+{
+    tickTimes_.Clear();
+    frameTimes_.Clear();
+    startBytes_.Clear();
+    messagesOut_ = 0.0;
+    messagesIn_ = 0.0;
+    roundTripTime_ = 0.0;
+    numRoundTripSamples_ = 0;
+
+    for (HashMap<Connection*, WeakPtr<Node> >::ConstIterator i = players_.Begin(); i != players_.End(); ++i)
+    {
+        kNet::MessageConnection* connection = i->first_->GetMessageConnection();
+        startBytes_[i->first_] = MakePair((unsigned long long)connection->BytesOutTotal(),
+            (unsigned long long)connection->BytesInTotal());
+    }
+
+    measureTimer_.Reset();
+    measuring_ = true;
+}
+
+void LoadTestServer::EndMeasurement()
+{
+    measuring_ = false;
+    measureDuration_ = Max(measureTimer_.GetMSec(false) * 0.001f, M_EPSILON);
+
+    // Only count the clients that stayed connected for the whole measurement
+    bytesOut_ = 0;
+    bytesIn_ = 0;
+    numMeasuredClients_ = 0;
+    for (HashMap<Connection*, Pair<unsigned long long, unsigned long long> >::ConstIterator i = startBytes_.Begin();
+         i != startBytes_.End(); ++i)
+    {
+        if (!players_.Contains(i->first_))
+            continue;
+
+        kNet::MessageConnection* connection = i->first_->GetMessageConnection();
+        bytesOut_ += connection->BytesOutTotal() - i->second_.first_;
+        bytesIn_ += connection->BytesInTotal() - i->second_.second_;
+        ++numMeasuredClients_;
+    }
+}
+
+void LoadTestServer::WriteReport(JSONValue& root) const
+{
+    Network* network = GetSubsystem<Network>();
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    float clientSeconds = Max((float)numMeasuredClients_, 1.0f) * measureDuration_;
+
+    JSONValue settings;
+    settings.Set("clients", settings_.clients_);
+    settings.Set("processes", settings_.processes_);
+    settings.Set("nodes", settings_.nodes_);
+    settings.Set("fps", settings_.fps_);
+    settings.Set("updateFps", settings_.updateFps_);
+    settings.Set("simulatedLatencyMs", settings_.latency_);
+    settings.Set("simulatedPacketLoss", settings_.packetLoss_);
+    settings.Set("interestManagement", settings_.interest_);
+    settings.Set("parallelServerUpdate", network->GetParallelServerUpdate());
+    settings.Set("workerThreads", queue->GetNumThreads());
+    root.Set("settings", settings);
+
+    root.Set("durationSec", measureDuration_);
+    root.Set("joinedClients", GetNumJoinedClients());
+    root.Set("measuredClients", numMeasuredClients_);
+    root.Set("replicatedNodes", scene_->GetReplicatedNodes().Size());
+    root.Set("networkUpdates", tickTimes_.Size());
+    root.Set("serverTick", GetTimeStats(tickTimes_));
+    root.Set("serverFrame", GetTimeStats(frameTimes_));
+    root.Set("bytesOutPerClientPerSec", (float)bytesOut_ / clientSeconds);
+    root.Set("bytesInPerClientPerSec", (float)bytesIn_ / clientSeconds);
+    root.Set("messagesOutPerClientPerSec", (float)messagesOut_ / clientSeconds);
+    root.Set("messagesInPerClientPerSec", (float)messagesIn_ / clientSeconds);
+    root.Set("averageRoundTripTimeMs", numRoundTripSamples_ ? (float)(roundTripTime_ / numRoundTripSamples_) : 0.0f);
+}
+
+unsigned LoadTestServer::GetNumJoinedClients() const
+{
+    unsigned numJoined = 0;
+    for (HashMap<Connection*, WeakPtr<Node> >::ConstIterator i = players_.Begin(); i != players_.End(); ++i)
+    {
+        if (i->first_->IsSceneLoaded())
+            ++numJoined;
+    }
+    return numJoined;
+}
+
+void LoadTestServer::HandleClientConnected(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ClientConnected;
+
+    Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+    connection->SetScene(scene_);
+
+    Node* player = scene_->CreateChild("Player", REPLICATED);
+    player->SetPosition(Vector3(Random(-AREA_SIZE, AREA_SIZE), 0.0f, Random(-AREA_SIZE, AREA_SIZE)));
+    player->SetOwner(connection);
+    players_[connection] = player;
+}
+
+void LoadTestServer::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ClientDisconnected;
+
+    Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+    HashMap<Connection*, WeakPtr<Node> >::Iterator i = players_.Find(connection);
+    if (i != players_.End())
+    {
+        if (i->second_)
+            i->second_->Remove();
+        players_.Erase(i);
+    }
+}
+
+void LoadTestServer::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+    tickTimer_.Reset();
+}
+
+void LoadTestServer::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData)
+{
+    if (measuring_)
+        tickTimes_.Push(tickTimer_.GetUSec(false) / 1000.0f);
+}